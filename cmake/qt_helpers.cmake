@@ -3,8 +3,8 @@ include_guard()
 macro(find_qt)
 	find_package(Qt5
 		COMPONENTS
-			Core Widgets Gui Multimedia MultimediaWidgets # Direct dependencies
-			OpenGl Network # Transitive dependencies
+			Core Widgets Gui Multimedia MultimediaWidgets Network # Direct dependencies
+			OpenGl # Transitive dependencies
 		REQUIRED
 	)
 endmacro()
@@ -1,15 +1,93 @@
 #include "mainwindow.hh"
+#include "event_log.hh"
+#include "metrics_exporter.hh"
+#include "trace.hh"
+
+#include <chrono>
+#include <memory>
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char * argv[])
 {
+	install_log_crash_handler();
+
 	QApplication app(argc, argv);
 
-	MainWindow window;
+	QCommandLineParser command_line_parser;
+	command_line_parser.addHelpOption();
+
+	const QCommandLineOption annotation_overlay_option("annotation-overlay", "Paint the annotations in a single overlay instead of using one button per annotation");
+	command_line_parser.addOption(annotation_overlay_option);
+
+	const QCommandLineOption seamless_loop_option("seamless-loop", "Loop the end of the videos by switching to a second player instead of seeking back. Decodes every video twice");
+	command_line_parser.addOption(seamless_loop_option);
+
+	const QCommandLineOption log_file_option("log-file", "Append the logged events to <file>", "file");
+	command_line_parser.addOption(log_file_option);
+
+	const QCommandLineOption trace_file_option("trace-file", "Record a trace of the whole run and write it to <file> (Chrome trace event format)", "file");
+	command_line_parser.addOption(trace_file_option);
+
+	const QCommandLineOption record_session_option("record-session", "Record what happens in the game to <file>, to replay it with tube-adventures-replay", "file");
+	command_line_parser.addOption(record_session_option);
+
+	const QCommandLineOption metrics_port_option("metrics-port", "Serve the metrics in the Prometheus text format on <port>", "port");
+	command_line_parser.addOption(metrics_port_option);
+
+	const QCommandLineOption metrics_address_option("metrics-address", "Serve the metrics on <address> (127.0.0.1 by default, 0.0.0.0 for every IPv4 address)", "address", "127.0.0.1");
+	command_line_parser.addOption(metrics_address_option);
+
+	const QCommandLineOption metrics_file_option("metrics-file", "Write the metrics in the Prometheus text format to <file> every 10 seconds", "file");
+	command_line_parser.addOption(metrics_file_option);
+
+	command_line_parser.process(app);
+
+	if (command_line_parser.isSet(trace_file_option))
+		start_tracing();
+
+	std::unique_ptr<EventLogDrain> log_drain;
+	if (command_line_parser.isSet(log_file_option))
+	{
+		log_drain = std::make_unique<EventLogDrain>(command_line_parser.value(log_file_option).toStdString());
+		if (!log_drain->is_open())
+			qWarning() << "Can't open the log file" << command_line_parser.value(log_file_option);
+	}
+
+	MainWindowOptions options;
+	options.annotation_overlay = command_line_parser.isSet(annotation_overlay_option);
+	options.seamless_loop = command_line_parser.isSet(seamless_loop_option);
+	options.session_recording = command_line_parser.value(record_session_option).toStdString();
+
+	MainWindow window(options);
+
+	MetricsExporter metrics_exporter(window.get_metrics());
+	if (command_line_parser.isSet(metrics_port_option))
+	{
+		bool valid_port = false;
+		const auto port = command_line_parser.value(metrics_port_option).toUShort(&valid_port);
+		const QHostAddress address(command_line_parser.value(metrics_address_option));
+		if (!valid_port || address.isNull() || !metrics_exporter.listen(port, address))
+		{
+			qWarning() << "Can't serve the metrics on" << command_line_parser.value(metrics_address_option) << "port" << command_line_parser.value(metrics_port_option)
+				<< metrics_exporter.error_string();
+		}
+	}
+
+	if (command_line_parser.isSet(metrics_file_option))
+		metrics_exporter.dump_periodically(command_line_parser.value(metrics_file_option), std::chrono::seconds(10));
+
 	window.show();
 
 	const auto retval = app.exec();
 
+	if (command_line_parser.isSet(trace_file_option))
+	{
+		const QString trace_filename = command_line_parser.value(trace_file_option);
+		if (!write_chrome_trace(trace_filename.toStdString(), stop_tracing()))
+			qWarning() << "Can't write the trace to" << trace_filename;
+	}
+
 	return retval;
 }
@@ -0,0 +1,64 @@
+#include "allocation_counter.hh"
+#include "session_recording.hh"
+#include "session_replay.hh"
+
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+TUBE_ADVENTURES_COUNT_ALLOCATIONS()
+
+// Replays a session recorded with `tube-adventures --record-session <file>` as fast as possible and reports
+// how long each step took and how much it allocated
+int main(int argc, char * argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser command_line_parser;
+	command_line_parser.setApplicationDescription("Replays a recorded game session without the window, with a virtual clock");
+	command_line_parser.addHelpOption();
+	command_line_parser.addPositionalArgument("recording", "File recorded with tube-adventures --record-session");
+
+	const QCommandLineOption directory_option("directory", "Directory the game was run from. The recorded paths are relative to it", "directory");
+	command_line_parser.addOption(directory_option);
+
+	const QCommandLineOption slowest_option("slowest", "Report the <count> slowest steps (10 by default)", "count", "10");
+	command_line_parser.addOption(slowest_option);
+
+	command_line_parser.process(app);
+
+	const QStringList positional_arguments = command_line_parser.positionalArguments();
+	if (positional_arguments.size() != 1)
+		command_line_parser.showHelp(1);
+
+	const std::string recording_filename = positional_arguments.front().toStdString();
+	const SessionRecordingReadResult recording = read_session_recording(recording_filename);
+	if (recording.error != SessionRecordingError::success)
+	{
+		std::fprintf(stderr, "Can't read the recording \"%s\" (error %d). Replaying the %zu events read\n", recording_filename.c_str(), static_cast<int>(recording.error), recording.events.size());
+		if (recording.events.empty())
+			return 1;
+	}
+
+	if (command_line_parser.isSet(directory_option))
+	{
+		std::error_code error;
+		std::filesystem::current_path(std::filesystem::u8path(command_line_parser.value(directory_option).toStdString()), error);
+		if (error)
+		{
+			std::fprintf(stderr, "Can't change to the directory \"%s\": %s\n", command_line_parser.value(directory_option).toStdString().c_str(), error.message().c_str());
+			return 1;
+		}
+	}
+
+	if (!counting_allocations())
+		std::fputs("Allocations are not being counted\n", stderr);
+
+	const ReplayReport report = replay_session(recording.events, recorded_session_options(recording.events), command_line_parser.value(slowest_option).toULongLong());
+	std::fputs(format_replay_report(report).c_str(), stdout);
+
+	return report.errors.empty() ? 0 : 2;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32) || defined(__GLIBC__)
+#	include <malloc.h>
+#elif defined(__APPLE__)
+#	include <malloc/malloc.h>
+#endif
+
+// Allocations made through the global operator new. Only counted in the executables that replace it by
+// expanding TUBE_ADVENTURES_COUNT_ALLOCATIONS() at namespace scope, in exactly one translation unit
+struct AllocationCounts
+{
+	std::uint64_t allocations = 0;
+	std::uint64_t bytes = 0;
+};
+
+namespace allocation_counter_detail
+{
+	inline std::atomic<std::uint64_t> allocations{ 0 };
+	inline std::atomic<std::uint64_t> bytes{ 0 };
+	inline std::atomic<bool> enabled{ false };
+
+	inline std::atomic<std::uint64_t> deallocations{ 0 };
+	inline std::atomic<std::int64_t> live_bytes{ 0 };
+
+	inline thread_local std::uint64_t thread_allocations = 0;
+	inline thread_local std::uint64_t thread_bytes = 0;
+
+	// What the allocator reserved for the block, which can be more than what was asked for. Zero where it can't tell
+	[[nodiscard]] inline std::size_t reserved_size([[maybe_unused]] void * const memory) noexcept
+	{
+#if defined(_WIN32)
+		return _msize(memory);
+#elif defined(__GLIBC__)
+		return malloc_usable_size(memory);
+#elif defined(__APPLE__)
+		return malloc_size(memory);
+#else
+		return 0;
+#endif
+	}
+
+	[[nodiscard]] inline void * counted_allocation(const std::size_t size)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		bytes.fetch_add(size, std::memory_order_relaxed);
+		++thread_allocations;
+		thread_bytes += size;
+
+		if (void * const memory = std::malloc(size == 0 ? 1 : size))
+		{
+			live_bytes.fetch_add(static_cast<std::int64_t>(reserved_size(memory)), std::memory_order_relaxed);
+			return memory;
+		}
+
+		throw std::bad_alloc();
+	}
+
+	inline void counted_deallocation(void * const memory) noexcept
+	{
+		if (memory == nullptr)
+			return;
+
+		deallocations.fetch_add(1, std::memory_order_relaxed);
+		live_bytes.fetch_sub(static_cast<std::int64_t>(reserved_size(memory)), std::memory_order_relaxed);
+		std::free(memory);
+	}
+} // namespace allocation_counter_detail
+
+[[nodiscard]] inline bool counting_allocations() noexcept
+{
+	return allocation_counter_detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Since the start of the program. All zero if allocations aren't counted
+[[nodiscard]] inline AllocationCounts allocation_counts() noexcept
+{
+	AllocationCounts counts;
+	counts.allocations = allocation_counter_detail::allocations.load(std::memory_order_relaxed);
+	counts.bytes = allocation_counter_detail::bytes.load(std::memory_order_relaxed);
+
+	return counts;
+}
+
+// Allocated and not deleted yet. The bytes are what the allocator reserved for them, zero on the platforms
+// where that isn't known. Memory deleted by another module with its own operator delete (a DLL) still counts
+[[nodiscard]] inline AllocationCounts live_allocations() noexcept
+{
+	const std::uint64_t allocations = allocation_counter_detail::allocations.load(std::memory_order_relaxed);
+	const std::uint64_t deallocations = allocation_counter_detail::deallocations.load(std::memory_order_relaxed);
+	const std::int64_t bytes = allocation_counter_detail::live_bytes.load(std::memory_order_relaxed);
+
+	AllocationCounts counts;
+	counts.allocations = allocations > deallocations ? allocations - deallocations : 0;
+	counts.bytes = bytes > 0 ? static_cast<std::uint64_t>(bytes) : 0;
+
+	return counts;
+}
+
+// Since the start of the current thread
+[[nodiscard]] inline AllocationCounts thread_allocation_counts() noexcept
+{
+	return { allocation_counter_detail::thread_allocations, allocation_counter_detail::thread_bytes };
+}
+
+[[nodiscard]] inline AllocationCounts operator-(const AllocationCounts & lhs, const AllocationCounts & rhs) noexcept
+{
+	return { lhs.allocations - rhs.allocations, lhs.bytes - rhs.bytes };
+}
+
+// What the current thread allocated since the scope started. Other threads (the event log writer,
+// the bubble prerendering pool, the media backend...) don't count
+class AllocationScope
+{
+public:
+	AllocationScope() noexcept : start(thread_allocation_counts()) {}
+
+	[[nodiscard]] AllocationCounts counts() const noexcept { return thread_allocation_counts() - start; }
+
+private:
+	AllocationCounts start;
+};
+
+#define TUBE_ADVENTURES_COUNT_ALLOCATIONS() \
+	void * operator new(std::size_t size) { return allocation_counter_detail::counted_allocation(size); } \
+	void * operator new[](std::size_t size) { return allocation_counter_detail::counted_allocation(size); } \
+	void operator delete(void * memory) noexcept { allocation_counter_detail::counted_deallocation(memory); } \
+	void operator delete[](void * memory) noexcept { allocation_counter_detail::counted_deallocation(memory); } \
+	void operator delete(void * memory, std::size_t) noexcept { allocation_counter_detail::counted_deallocation(memory); } \
+	void operator delete[](void * memory, std::size_t) noexcept { allocation_counter_detail::counted_deallocation(memory); } \
+	[[maybe_unused]] static const bool tube_adventures_allocations_counted = (allocation_counter_detail::enabled = true);
@@ -0,0 +1,224 @@
+#include "annotation_binary.hh"
+#include "binary_io.hh"
+#include "trace.hh"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+#include <string_view>
+#include <utility>
+
+#include <QRgba64>
+
+namespace
+{
+	constexpr char magic[4] = { 'T', 'A', 'A', 'N' };
+	constexpr std::uint8_t format_version = 2;
+
+	constexpr std::uint8_t type_count = static_cast<std::uint8_t>(Annotation::Type::external_link) + 1;
+
+	// Every keyframe is smaller than this, so it's only a sanity check for the count of a corrupt file
+	constexpr std::size_t min_rect_region_size = 4 * sizeof(float) + 1;
+	constexpr std::size_t min_style_size = 2 + sizeof(float); // Two colors of at least a byte
+
+	void write_rect_region(std::vector<std::uint8_t> & out, const Annotation::RectRegion & region)
+	{
+		write_float(out, region.x);
+		write_float(out, region.y);
+		write_float(out, region.width);
+		write_float(out, region.height);
+		write_signed_varint(out, region.time.count());
+	}
+
+	[[nodiscard]] bool read_rect_region(BinaryReader & reader, Annotation::RectRegion & region)
+	{
+		std::int64_t time;
+		if (!reader.read_float(region.x) || !reader.read_float(region.y) || !reader.read_float(region.width) || !reader.read_float(region.height)
+			|| !reader.read_signed_varint(time))
+		{
+			return false;
+		}
+
+		region.time = std::chrono::milliseconds(time);
+		return true;
+	}
+
+	[[nodiscard]] bool read_color(BinaryReader & reader, QColor & color)
+	{
+		std::uint64_t rgba64;
+		if (!reader.read_varint(rgba64))
+			return false;
+
+		color = QColor::fromRgba64(QRgba64::fromRgba64(rgba64));
+		return true;
+	}
+
+	void write_style(std::vector<std::uint8_t> & out, const AnnotationStyle & style)
+	{
+		write_varint(out, static_cast<quint64>(style.background_color.rgba64()));
+		write_varint(out, static_cast<quint64>(style.foreground_color.rgba64()));
+		write_float(out, style.text_size);
+	}
+
+	[[nodiscard]] bool read_style(BinaryReader & reader, AnnotationStyle & style)
+	{
+		return read_color(reader, style.background_color) && read_color(reader, style.foreground_color) && reader.read_float(style.text_size);
+	}
+
+	[[nodiscard]] ParseAnnotationsResult invalid(const char * const what)
+	{
+		return { ParseAnnotationsError::invalid_format, {}, what };
+	}
+} // namespace
+
+std::vector<std::uint8_t> serialize_annotations(const std::vector<Annotation> & annotations)
+{
+	const TraceSpan span("serialize_annotations");
+
+	// The styles the annotations use, numbered in the order they first appear in the file
+	std::vector<AnnotationStyleId> styles;
+	std::unordered_map<AnnotationStyleId, std::size_t> style_indices;
+	for (const Annotation & annotation : annotations)
+	{
+		if (style_indices.emplace(annotation.style, styles.size()).second)
+			styles.push_back(annotation.style);
+	}
+
+	std::vector<std::uint8_t> out(std::begin(magic), std::end(magic));
+	out.push_back(format_version);
+
+	write_varint(out, styles.size());
+	for (const AnnotationStyleId style : styles)
+		write_style(out, annotation_style(style));
+
+	write_varint(out, annotations.size());
+
+	for (const Annotation & annotation : annotations)
+	{
+		write_string(out, std::string_view(annotation.id));
+		write_string(out, u8string_view(annotation.text));
+		write_string(out, std::string_view(annotation.click_url));
+		out.push_back(static_cast<std::uint8_t>(annotation.type));
+
+		// Keyframes in order: start, intermediate, end. Only the start one if there's no end
+		write_varint(out, annotation.end_rect.has_value() ? annotation.intermediate_rects.size() + 2 : 1);
+		write_rect_region(out, annotation.start_rect);
+		for (const Annotation::RectRegion & region : annotation.intermediate_rects)
+			write_rect_region(out, region);
+		if (annotation.end_rect.has_value())
+			write_rect_region(out, *annotation.end_rect);
+
+		write_varint(out, style_indices[annotation.style]);
+	}
+
+	return out;
+}
+
+ParseAnnotationsResult parse_binary_annotations(const std::uint8_t * const data, const std::size_t size)
+{
+	const TraceSpan span("parse_binary_annotations");
+
+	if (size < sizeof(magic) + 1 || std::memcmp(data, magic, sizeof(magic)) != 0 || data[sizeof(magic)] != format_version)
+		return invalid("Not a binary annotation file (or a different version)");
+
+	BinaryReader reader(data + sizeof(magic) + 1, size - sizeof(magic) - 1);
+
+	std::uint64_t style_count;
+	if (!reader.read_varint(style_count) || style_count > size / min_style_size)
+		return invalid("Invalid style count");
+
+	// Interned only once the whole file is valid, since interned styles are kept forever
+	std::vector<AnnotationStyle> styles(static_cast<std::size_t>(style_count));
+	for (AnnotationStyle & style : styles)
+	{
+		if (!read_style(reader, style))
+			return invalid("Truncated style");
+
+		if (!std::isfinite(style.text_size))
+			return invalid("Invalid text size");
+	}
+
+	std::uint64_t count;
+	if (!reader.read_varint(count) || count > size)
+		return invalid("Invalid annotation count");
+
+	std::vector<Annotation> annotations(static_cast<std::size_t>(count));
+
+	for (Annotation & annotation : annotations)
+	{
+		std::uint8_t type;
+		if (!reader.read_string(annotation.id) || !reader.read_string(annotation.text) || !reader.read_string(annotation.click_url) || !reader.read_byte(type))
+			return invalid("Truncated annotation");
+
+		if (type >= type_count)
+			return invalid("Invalid annotation type");
+
+		annotation.type = static_cast<Annotation::Type>(type);
+
+		std::uint64_t region_count;
+		if (!reader.read_varint(region_count) || region_count == 0 || region_count > size / min_rect_region_size)
+			return invalid("Invalid keyframe count");
+
+		if (!read_rect_region(reader, annotation.start_rect))
+			return invalid("Truncated keyframe");
+
+		if (region_count > 1)
+		{
+			annotation.intermediate_rects.resize(static_cast<std::size_t>(region_count - 2));
+			for (Annotation::RectRegion & region : annotation.intermediate_rects)
+			{
+				if (!read_rect_region(reader, region))
+					return invalid("Truncated keyframe");
+			}
+
+			annotation.end_rect.emplace();
+			if (!read_rect_region(reader, *annotation.end_rect))
+				return invalid("Truncated keyframe");
+		}
+
+		std::uint64_t style_index;
+		if (!reader.read_varint(style_index))
+			return invalid("Truncated appearance");
+
+		if (style_index >= styles.size())
+			return invalid("Invalid style");
+
+		annotation.style = static_cast<AnnotationStyleId>(style_index); // Replaced by the interned style below
+	}
+
+	if (!reader.at_end())
+		return invalid("Data after the last annotation");
+
+	std::vector<AnnotationStyleId> style_ids;
+	style_ids.reserve(styles.size());
+	for (const AnnotationStyle & style : styles)
+		style_ids.push_back(intern_annotation_style(style));
+
+	for (Annotation & annotation : annotations)
+		annotation.style = style_ids[annotation.style];
+
+	return { ParseAnnotationsError::success, std::move(annotations), {} };
+}
+
+ParseAnnotationsResult read_binary_annotations(const std::filesystem::path & path)
+{
+	const std::optional<std::vector<std::uint8_t>> data = read_binary_file(path);
+	if (!data.has_value())
+		return { ParseAnnotationsError::cannot_read_file, {}, "Cannot open or read file" };
+
+	return parse_binary_annotations(data->data(), data->size());
+}
+
+bool write_binary_annotations(const std::filesystem::path & path, const std::vector<Annotation> & annotations)
+{
+	const std::vector<std::uint8_t> data = serialize_annotations(annotations);
+
+	std::FILE * const file = std::fopen(path.string().c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	const bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+	return std::fclose(file) == 0 && written;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "annotations.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Parsed annotations in a compact binary form, read back without an XML parser: a header, the styles the
+// annotations use, the number of annotations and then every field of each of them, with the index of their
+// style. The colors are kept at full precision, so reading it gives exactly what parse_annotations gave when
+// it was written
+const std::filesystem::path binary_annotation_file_extension = ".tab";
+
+[[nodiscard]] std::vector<std::uint8_t> serialize_annotations(const std::vector<Annotation> & annotations);
+
+// The errors are cannot_read_file and invalid_format (bad header, truncated or impossible values)
+[[nodiscard]] ParseAnnotationsResult parse_binary_annotations(const std::uint8_t * data, std::size_t size);
+[[nodiscard]] ParseAnnotationsResult read_binary_annotations(const std::filesystem::path & path);
+
+// Returns false if the file can't be written
+[[nodiscard]] bool write_binary_annotations(const std::filesystem::path & path, const std::vector<Annotation> & annotations);
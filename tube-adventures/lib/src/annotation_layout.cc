@@ -0,0 +1,110 @@
+#include "annotation_layout.hh"
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+	[[nodiscard]] int round_to_int(const float value) noexcept
+	{
+		return static_cast<int>(std::lround(value));
+	}
+
+	[[nodiscard]] int lerp(const int from, const int to, const float t) noexcept
+	{
+		return from + round_to_int(static_cast<float>(to - from) * t);
+	}
+} // namespace
+
+PixelRect AnnotationLayout::displayed_video_rect(const int widget_width_, const int widget_height_, const int video_width_, const int video_height_) noexcept
+{
+	if (video_width_ <= 0 || video_height_ <= 0)
+		return { 0, 0, widget_width_, widget_height_ };
+
+	// Same as QSize::scale with Qt::KeepAspectRatio
+	const std::int64_t width_if_fitting_height = std::int64_t(widget_height_) * video_width_ / video_height_;
+
+	int width = widget_width_;
+	int height = widget_height_;
+	if (width_if_fitting_height <= widget_width_)
+		width = static_cast<int>(width_if_fitting_height);
+	else
+		height = static_cast<int>(std::int64_t(widget_width_) * video_height_ / video_width_);
+
+	return { (widget_width_ - width) / 2, (widget_height_ - height) / 2, width, height };
+}
+
+bool AnnotationLayout::update(const int widget_width_, const int widget_height_, const int video_width_, const int video_height_, const MotionPaths & paths)
+{
+	if (widget_width_ == widget_width && widget_height_ == widget_height
+		&& video_width_ == video_width && video_height_ == video_height
+		&& keyframe_pixels.size() == paths.keyframe_count())
+	{
+		return false;
+	}
+
+	widget_width = widget_width_;
+	widget_height = widget_height_;
+	video_width = video_width_;
+	video_height = video_height_;
+	displayed_video = displayed_video_rect(widget_width, widget_height, video_width, video_height);
+
+	const std::vector<AnnotationRect> & keyframes = paths.keyframes();
+	keyframe_pixels.resize(keyframes.size());
+
+	const float x_scale = static_cast<float>(displayed_video.width) / 100.0f;
+	const float y_scale = static_cast<float>(displayed_video.height) / 100.0f;
+	const auto x_offset = static_cast<float>(displayed_video.x);
+	const auto y_offset = static_cast<float>(displayed_video.y);
+
+	const std::size_t keyframes_size = keyframes.size();
+	for (std::size_t i = 0; i < keyframes_size; ++i)
+	{
+		const AnnotationRect & keyframe = keyframes[i];
+		keyframe_pixels[i] = {
+			round_to_int(x_offset + keyframe.x * x_scale),
+			round_to_int(y_offset + keyframe.y * y_scale),
+			round_to_int(keyframe.width * x_scale),
+			round_to_int(keyframe.height * y_scale),
+		};
+	}
+
+	return true;
+}
+
+void AnnotationLayout::invalidate() noexcept
+{
+	widget_width = -1;
+	widget_height = -1;
+	keyframe_pixels.clear();
+}
+
+PixelRect AnnotationLayout::geometry(const MotionPaths & paths, const int annotation_index, const microseconds time) const noexcept
+{
+	assert(keyframe_pixels.size() == paths.keyframe_count());
+
+	const MotionPaths::Sample sample = paths.sample(annotation_index, time);
+
+	const PixelRect & from = keyframe_pixels[sample.from];
+	if (sample.from == sample.to)
+		return from;
+
+	const PixelRect & to = keyframe_pixels[sample.to];
+
+	return {
+		lerp(from.x, to.x, sample.t),
+		lerp(from.y, to.y, sample.t),
+		lerp(from.width, to.width, sample.t),
+		lerp(from.height, to.height, sample.t),
+	};
+}
+
+void AnnotationLayout::geometry(const MotionPaths & paths, const microseconds time, const std::vector<int> & annotation_indices, std::vector<PixelRect> & out_rects) const
+{
+	out_rects.resize(annotation_indices.size());
+
+	const std::size_t count = annotation_indices.size();
+	for (std::size_t i = 0; i < count; ++i)
+		out_rects[i] = geometry(paths, annotation_indices[i], time);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "motion_path.hh"
+
+#include <chrono>
+#include <vector>
+
+struct PixelRect
+{
+	int x;
+	int y;
+	int width;
+	int height;
+
+	[[nodiscard]] constexpr bool operator==(const PixelRect & other) const noexcept
+	{
+		return x == other.x && y == other.y && width == other.width && height == other.height;
+	}
+	[[nodiscard]] constexpr bool operator!=(const PixelRect & other) const noexcept { return !(*this == other); }
+};
+
+// Maps annotation geometry (percentage of the video) to pixels of the widget the video is shown in.
+// The pixel geometry of every keyframe is computed in a single pass when the widget or the video size
+// changes, so the geometry of a static annotation is just a lookup afterwards
+class AnnotationLayout
+{
+public:
+	using microseconds = std::chrono::microseconds;
+
+	// Part of the widget where the video is actually shown, keeping its aspect ratio (like QVideoWidget does).
+	// If the size of the video isn't known yet, the whole widget
+	[[nodiscard]] static PixelRect displayed_video_rect(int widget_width, int widget_height, int video_width, int video_height) noexcept;
+
+	// Recomputes the pixel geometry of all the keyframes. Returns false if nothing changed
+	bool update(int widget_width, int widget_height, int video_width, int video_height, const MotionPaths & paths);
+
+	// Forgets the cached geometry, e.g. when the keyframes change
+	void invalidate() noexcept;
+
+	[[nodiscard]] PixelRect geometry(const MotionPaths & paths, int annotation_index, microseconds time) const noexcept;
+
+	// out_rects[i] = geometry of annotation_indices[i] at `time`. Doesn't allocate if out_rects has enough capacity
+	void geometry(const MotionPaths & paths, microseconds time, const std::vector<int> & annotation_indices, std::vector<PixelRect> & out_rects) const;
+
+	[[nodiscard]] const PixelRect & video_rect() const noexcept { return displayed_video; }
+
+	[[nodiscard]] std::size_t memory_usage() const noexcept { return sizeof(*this) + keyframe_pixels.capacity() * sizeof(PixelRect); }
+
+private:
+	int widget_width = -1;
+	int widget_height = -1;
+	int video_width = -1;
+	int video_height = -1;
+
+	PixelRect displayed_video{ 0, 0, 0, 0 };
+	std::vector<PixelRect> keyframe_pixels; // Same order as MotionPaths::keyframes()
+};
@@ -0,0 +1,211 @@
+#include "annotation_overlay.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <utility>
+
+#include <QPainter>
+
+namespace
+{
+	// While an annotation moves, its bubble is scaled instead of rendered again for every size,
+	// unless the size changes by more than this (1/8). Text scaled further would look blurry
+	constexpr int max_scaled_size_change_divisor = 8;
+
+	[[nodiscard]] bool can_scale_bubble(const QSize & rendered, const QSize & target) noexcept
+	{
+		return std::abs(target.width() - rendered.width()) * max_scaled_size_change_divisor <= rendered.width()
+			&& std::abs(target.height() - rendered.height()) * max_scaled_size_change_divisor <= rendered.height();
+	}
+} // namespace
+
+AnnotationOverlay::AnnotationOverlay(QWidget * parent)
+	: QWidget(parent)
+{
+	// The video has to be visible through the parts without annotations
+	setAttribute(Qt::WidgetAttribute::WA_NoSystemBackground);
+	setAttribute(Qt::WidgetAttribute::WA_TranslucentBackground);
+	setAutoFillBackground(false);
+}
+
+void AnnotationOverlay::set_annotations(const std::vector<Annotation> & annotations)
+{
+	clear_annotations();
+
+	items.reserve(annotations.size());
+	for (const Annotation & annotation : annotations)
+	{
+		Item & item = items.emplace_back();
+		item.text = QString::fromUtf8(annotation.text.data(), static_cast<int>(annotation.text.size()));
+		item.text_hash = qHash(item.text);
+		item.style = annotation.style;
+	}
+}
+
+void AnnotationOverlay::clear_annotations()
+{
+	for (const int index : shown_in_paint_order)
+		update(items[static_cast<std::size_t>(index)].geometry);
+
+	items.clear();
+	shown_in_paint_order.clear();
+	hit_index.clear();
+	hit_index_dirty = false;
+	pressed_annotation.reset();
+}
+
+void AnnotationOverlay::show_annotation(const int annotation_index, const QRect & geometry, const int video_height)
+{
+	assert(annotation_index >= 0 && annotation_index < static_cast<int>(items.size()));
+	Item & item = items[static_cast<std::size_t>(annotation_index)];
+
+	if (item.shown && item.geometry == geometry && item.video_height == video_height)
+		return;
+
+	if (item.shown)
+		update(item.geometry);
+	else
+		shown_in_paint_order.push_back(annotation_index);
+
+	if (!item.shown || item.video_height != video_height || !can_scale_bubble(item.render_size, geometry.size()))
+		item.render_size = geometry.size();
+
+	item.geometry = geometry;
+	item.video_height = video_height;
+	item.shown = true;
+	hit_index_dirty = true;
+
+	update(geometry);
+}
+
+void AnnotationOverlay::hide_annotation(const int annotation_index)
+{
+	assert(annotation_index >= 0 && annotation_index < static_cast<int>(items.size()));
+	Item & item = items[static_cast<std::size_t>(annotation_index)];
+
+	if (!item.shown)
+		return;
+
+	item.shown = false;
+	hit_index_dirty = true;
+
+	const auto it = std::find(shown_in_paint_order.begin(), shown_in_paint_order.end(), annotation_index);
+	assert(it != shown_in_paint_order.end());
+	shown_in_paint_order.erase(it);
+
+	if (pressed_annotation == annotation_index)
+		pressed_annotation.reset();
+
+	update(item.geometry);
+}
+
+bool AnnotationOverlay::is_annotation_shown(const int annotation_index) const noexcept
+{
+	assert(annotation_index >= 0 && annotation_index < static_cast<int>(items.size()));
+	return items[static_cast<std::size_t>(annotation_index)].shown;
+}
+
+void AnnotationOverlay::prerender_annotations(const std::vector<QRect> & geometries, const int video_height)
+{
+	assert(geometries.size() == items.size());
+
+	std::vector<AnnotationRenderKey> keys;
+	keys.reserve(items.size());
+
+	for (std::size_t i = 0; i < items.size(); ++i)
+		keys.push_back(render_key(items[i], geometries[i].size(), video_height));
+
+	bubble_cache.prerender(std::move(keys), font());
+}
+
+void AnnotationOverlay::paintEvent(QPaintEvent * event)
+{
+	assert(event != nullptr);
+
+	if (shown_in_paint_order.empty())
+		return;
+
+	const QRegion & dirty_region = event->region();
+
+	QPainter painter(this);
+	painter.setRenderHint(QPainter::RenderHint::SmoothPixmapTransform);
+
+	for (const int index : shown_in_paint_order)
+	{
+		const Item & item = items[static_cast<std::size_t>(index)];
+		if (!dirty_region.intersects(item.geometry))
+			continue;
+
+		// Rendered once, then a blit every time it's shown
+		const QPixmap & bubble = bubble_cache.pixmap(render_key(item, item.render_size, item.video_height), font());
+		if (item.geometry.size() == item.render_size)
+			painter.drawPixmap(item.geometry.topLeft(), bubble);
+		else
+			painter.drawPixmap(item.geometry, bubble);
+	}
+}
+
+void AnnotationOverlay::mousePressEvent(QMouseEvent * event)
+{
+	assert(event != nullptr);
+
+	if (event->button() != Qt::MouseButton::LeftButton)
+	{
+		QWidget::mousePressEvent(event);
+		return;
+	}
+
+	pressed_annotation = annotation_at(event->pos());
+	if (!pressed_annotation.has_value())
+		QWidget::mousePressEvent(event);
+}
+
+void AnnotationOverlay::mouseReleaseEvent(QMouseEvent * event)
+{
+	assert(event != nullptr);
+
+	if (event->button() != Qt::MouseButton::LeftButton || !pressed_annotation.has_value())
+	{
+		QWidget::mouseReleaseEvent(event);
+		return;
+	}
+
+	// Same as a button: only a click if it is released on the annotation it was pressed on
+	const std::optional<int> pressed = std::exchange(pressed_annotation, std::nullopt);
+	if (annotation_at(event->pos()) == pressed)
+		emit annotation_clicked(*pressed);
+}
+
+AnnotationRenderKey AnnotationOverlay::render_key(const Item & item, const QSize & size, const int video_height) const
+{
+	AnnotationRenderKey key;
+	key.text = item.text;
+	key.text_hash = item.text_hash;
+	key.style = item.style;
+	key.size = size;
+	key.reference_height = video_height;
+	key.device_pixel_ratio = devicePixelRatioF();
+
+	return key;
+}
+
+std::optional<int> AnnotationOverlay::annotation_at(const QPoint & point)
+{
+	if (hit_index_dirty)
+	{
+		std::vector<UniformGridIndex::Entry> entries;
+		entries.reserve(shown_in_paint_order.size());
+
+		for (const int index : shown_in_paint_order)
+		{
+			const QRect & geometry = items[static_cast<std::size_t>(index)].geometry;
+			entries.push_back({ { geometry.x(), geometry.y(), geometry.width(), geometry.height() }, index });
+		}
+
+		hit_index.build(entries);
+		hit_index_dirty = false;
+	}
+
+	return hit_index.query(point.x(), point.y());
+}
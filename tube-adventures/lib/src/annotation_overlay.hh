@@ -0,0 +1,72 @@
+#pragma once
+
+#include "annotations.hh"
+#include "annotation_render_cache.hh"
+#include "spatial_index.hh"
+
+#include <vector>
+
+#include <QWidget>
+#include <QPaintEvent>
+#include <QMouseEvent>
+
+// Paints every visible annotation in a single widget, instead of having one
+// QPushButton per annotation. Only the regions that changed are repainted
+class AnnotationOverlay : public QWidget
+{
+	Q_OBJECT
+
+public:
+	explicit AnnotationOverlay(QWidget * parent = nullptr);
+
+	void set_annotations(const std::vector<Annotation> & annotations);
+	void clear_annotations();
+
+	// Cheap to call every frame: does nothing if the annotation is already shown with that geometry.
+	// video_height is the height of the video in the widget, without the bars. Text sizes are relative to it
+	void show_annotation(int annotation_index, const QRect & geometry, int video_height);
+	void hide_annotation(int annotation_index);
+
+	[[nodiscard]] bool is_annotation_shown(int annotation_index) const noexcept;
+
+	// Renders the bubbles in the background, so they're ready when the annotations are shown.
+	// geometries has the geometry every annotation will first be shown with
+	void prerender_annotations(const std::vector<QRect> & geometries, int video_height);
+
+	[[nodiscard]] const AnnotationRenderCache & render_cache() const noexcept { return bubble_cache; }
+
+signals:
+	void annotation_clicked(int annotation_index);
+
+private:
+	void paintEvent(QPaintEvent * event) override;
+	void mousePressEvent(QMouseEvent * event) override;
+	void mouseReleaseEvent(QMouseEvent * event) override;
+
+private:
+	[[nodiscard]] std::optional<int> annotation_at(const QPoint & point);
+
+	struct Item
+	{
+		QString text;
+		uint text_hash;
+		AnnotationStyleId style;
+
+		QRect geometry;
+		QSize render_size; // Of the bubble in the render cache. Scaled to geometry while it moves
+		int video_height = 0;
+		bool shown = false;
+	};
+
+	[[nodiscard]] AnnotationRenderKey render_key(const Item & item, const QSize & size, int video_height) const;
+
+	std::vector<Item> items;
+	std::vector<int> shown_in_paint_order; // Indices into items
+
+	UniformGridIndex hit_index;
+	bool hit_index_dirty = false;
+
+	std::optional<int> pressed_annotation;
+
+	AnnotationRenderCache bubble_cache;
+};
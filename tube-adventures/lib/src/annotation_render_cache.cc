@@ -0,0 +1,223 @@
+#include "annotation_render_cache.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <unordered_set>
+#include <utility>
+
+#include <QPainter>
+#include <QRunnable>
+
+namespace
+{
+	constexpr int text_margin = 4;
+
+	[[nodiscard]] QFont annotation_font(const QFont & base_font, const float text_size, const int reference_height)
+	{
+		// text_size is a percentage of the video height
+		QFont font = base_font;
+		font.setPixelSize(std::max(1, static_cast<int>(std::lround(text_size / 100.0f * static_cast<float>(reference_height)))));
+
+		return font;
+	}
+
+	constexpr void hash_combine(std::size_t & seed, const std::size_t value) noexcept
+	{
+		seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+
+	[[nodiscard]] std::size_t pixel_count(const QImage & image) noexcept
+	{
+		return static_cast<std::size_t>(image.width()) * static_cast<std::size_t>(image.height());
+	}
+
+	class PrerenderTask : public QRunnable
+	{
+	public:
+		using Deliver = std::function<void(std::vector<AnnotationRenderKey> keys, std::vector<QImage> images)>;
+
+		PrerenderTask(std::vector<AnnotationRenderKey> keys_, QFont base_font_,
+			std::shared_ptr<const std::atomic<std::uint64_t>> current_generation_, const std::uint64_t generation_, Deliver deliver_)
+			: keys(std::move(keys_))
+			, base_font(std::move(base_font_))
+			, current_generation(std::move(current_generation_))
+			, generation(generation_)
+			, deliver(std::move(deliver_))
+		{
+		}
+
+		void run() override
+		{
+			// Delivered in small batches so the first bubbles are available soon
+			constexpr std::size_t batch_size = 16;
+
+			std::vector<AnnotationRenderKey> batch_keys;
+			std::vector<QImage> batch_images;
+
+			for (AnnotationRenderKey & key : keys)
+			{
+				if (current_generation->load(std::memory_order_relaxed) != generation)
+					return;
+
+				batch_images.push_back(render_annotation(key, base_font));
+				batch_keys.push_back(std::move(key));
+
+				if (batch_keys.size() == batch_size)
+				{
+					deliver(std::move(batch_keys), std::move(batch_images));
+					batch_keys.clear();
+					batch_images.clear();
+				}
+			}
+
+			if (!batch_keys.empty())
+				deliver(std::move(batch_keys), std::move(batch_images));
+		}
+
+	private:
+		std::vector<AnnotationRenderKey> keys;
+		QFont base_font;
+
+		std::shared_ptr<const std::atomic<std::uint64_t>> current_generation;
+		std::uint64_t generation;
+
+		Deliver deliver;
+	};
+} // namespace
+
+std::size_t AnnotationRenderKeyHash::operator()(const AnnotationRenderKey & key) const noexcept
+{
+	std::size_t seed = key.text_hash;
+	hash_combine(seed, key.style);
+	hash_combine(seed, static_cast<std::size_t>(key.size.width()));
+	hash_combine(seed, static_cast<std::size_t>(key.size.height()));
+	hash_combine(seed, static_cast<std::size_t>(key.reference_height));
+	hash_combine(seed, std::hash<qreal>{}(key.device_pixel_ratio));
+
+	return seed;
+}
+
+QImage render_annotation(const AnnotationRenderKey & key, const QFont & base_font)
+{
+	const QSize device_size(
+		static_cast<int>(std::ceil(key.size.width() * key.device_pixel_ratio)),
+		static_cast<int>(std::ceil(key.size.height() * key.device_pixel_ratio)));
+
+	if (device_size.isEmpty())
+		return QImage();
+
+	QImage image(device_size, QImage::Format::Format_ARGB32_Premultiplied);
+	image.setDevicePixelRatio(key.device_pixel_ratio);
+	const AnnotationStyle style = annotation_style(key.style);
+	image.fill(style.background_color);
+
+	QPainter painter(&image);
+	painter.setPen(style.foreground_color);
+	painter.setFont(annotation_font(base_font, style.text_size, key.reference_height));
+
+	const QRect text_rect(text_margin, text_margin,
+		std::max(0, key.size.width() - 2 * text_margin), std::max(0, key.size.height() - text_margin));
+	painter.drawText(text_rect, Qt::AlignmentFlag::AlignLeft | Qt::AlignmentFlag::AlignTop | Qt::TextFlag::TextWordWrap, key.text);
+
+	return image;
+}
+
+AnnotationRenderCache::AnnotationRenderCache(const std::size_t pixel_budget_, QObject * parent)
+	: QObject(parent)
+	, cache(pixel_budget_)
+	, generation(std::make_shared<std::atomic<std::uint64_t>>(0))
+{
+	// One thread is enough to stay ahead of playback, and leaves the rest for decoding
+	render_pool.setMaxThreadCount(1);
+}
+
+AnnotationRenderCache::~AnnotationRenderCache()
+{
+	// The task delivers to this object, so it must be done before it's destroyed
+	generation->fetch_add(1, std::memory_order_relaxed);
+	render_pool.clear();
+	render_pool.waitForDone();
+}
+
+const QPixmap & AnnotationRenderCache::pixmap(const AnnotationRenderKey & key, const QFont & base_font)
+{
+	if (const QPixmap * const cached = cache.find(key); cached != nullptr)
+		return *cached;
+
+	const QImage image = render_annotation(key, base_font);
+	if (const QPixmap * const inserted = insert(key, image); inserted != nullptr)
+		return *inserted;
+
+	uncached = QPixmap::fromImage(image);
+	return uncached;
+}
+
+void AnnotationRenderCache::prerender(std::vector<AnnotationRenderKey> keys, const QFont & base_font)
+{
+	const std::uint64_t task_generation = generation->fetch_add(1, std::memory_order_relaxed) + 1;
+	render_pool.clear();
+
+	// Only what isn't cached yet, once
+	std::unordered_set<AnnotationRenderKey, AnnotationRenderKeyHash> pending;
+	keys.erase(std::remove_if(keys.begin(), keys.end(), [this, &pending](const AnnotationRenderKey & key)
+	{
+		return key.size.isEmpty() || cache.contains(key) || !pending.insert(key).second;
+	}), keys.end());
+
+	if (keys.empty())
+		return;
+
+	auto deliver = [this, task_generation](std::vector<AnnotationRenderKey> rendered_keys, std::vector<QImage> images)
+	{
+		// Pixmaps can only be created on the GUI thread
+		QMetaObject::invokeMethod(this, [this, task_generation, rendered_keys = std::move(rendered_keys), images = std::move(images)]()
+		{
+			insert_prerendered(task_generation, rendered_keys, images);
+		}, Qt::ConnectionType::QueuedConnection);
+	};
+
+	auto * const task = new PrerenderTask(std::move(keys), base_font, generation, task_generation, std::move(deliver));
+	task->setAutoDelete(true);
+	render_pool.start(task);
+}
+
+void AnnotationRenderCache::clear()
+{
+	generation->fetch_add(1, std::memory_order_relaxed);
+	render_pool.clear();
+
+	cache.clear();
+	uncached = QPixmap();
+}
+
+AnnotationRenderCache::Stats AnnotationRenderCache::stats() const noexcept
+{
+	const auto & cache_stats = cache.stats();
+	return { cache_stats.hits, cache_stats.misses, cache_stats.evictions, prerendered_count };
+}
+
+void AnnotationRenderCache::insert_prerendered(const std::uint64_t task_generation,
+	const std::vector<AnnotationRenderKey> & keys, const std::vector<QImage> & images)
+{
+	assert(keys.size() == images.size());
+
+	if (task_generation != generation->load(std::memory_order_relaxed))
+		return;
+
+	for (std::size_t i = 0; i < keys.size(); ++i)
+	{
+		// It may have been needed (and rendered) while it was being prerendered
+		if (cache.contains(keys[i]))
+			continue;
+
+		if (insert(keys[i], images[i]) != nullptr)
+			++prerendered_count;
+	}
+}
+
+QPixmap * AnnotationRenderCache::insert(const AnnotationRenderKey & key, const QImage & image)
+{
+	return cache.insert(key, QPixmap::fromImage(image), pixel_count(image));
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "annotations.hh"
+#include "lru_cache.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+#include <QColor>
+#include <QSize>
+#include <QFont>
+#include <QImage>
+#include <QPixmap>
+#include <QThreadPool>
+
+// Everything the look of an annotation bubble depends on
+struct AnnotationRenderKey
+{
+	QString text;
+	uint text_hash = 0; // qHash(text), computed once per annotation
+	AnnotationStyleId style = 0; // Colors and text size (a percentage of reference_height)
+	QSize size; // Device independent pixels
+	int reference_height = 0;
+	qreal device_pixel_ratio = 1.0;
+
+	[[nodiscard]] bool operator==(const AnnotationRenderKey & other) const noexcept
+	{
+		return text_hash == other.text_hash
+			&& style == other.style
+			&& size == other.size
+			&& reference_height == other.reference_height
+			&& device_pixel_ratio == other.device_pixel_ratio
+			&& text == other.text;
+	}
+};
+
+struct AnnotationRenderKeyHash
+{
+	[[nodiscard]] std::size_t operator()(const AnnotationRenderKey & key) const noexcept;
+};
+
+// Paints the whole bubble (background and text). Can be called from any thread
+[[nodiscard]] QImage render_annotation(const AnnotationRenderKey & key, const QFont & base_font);
+
+// Bubbles already rendered, so showing an annotation costs a single blit instead of shaping and
+// rasterizing its text again. Bubbles can be rendered in the background before they're needed,
+// and the least recently used ones are evicted to stay under a budget of pixels
+class AnnotationRenderCache : public QObject
+{
+	Q_OBJECT
+
+public:
+	// 64 MiB of ARGB32
+	static constexpr std::size_t default_pixel_budget = 16 * 1024 * 1024;
+
+	struct Stats
+	{
+		std::int64_t hits = 0;
+		std::int64_t misses = 0; // Rendered on the GUI thread when needed
+		std::int64_t evictions = 0;
+		std::int64_t prerendered = 0; // Rendered in the background
+	};
+
+	explicit AnnotationRenderCache(std::size_t pixel_budget = default_pixel_budget, QObject * parent = nullptr);
+	~AnnotationRenderCache() override;
+
+	// Renders it right away if it isn't cached. The reference is valid until the next call
+	[[nodiscard]] const QPixmap & pixmap(const AnnotationRenderKey & key, const QFont & base_font);
+
+	// Renders in the background the bubbles that aren't cached yet. Replaces the previous
+	// request: whatever wasn't rendered from it is dropped
+	void prerender(std::vector<AnnotationRenderKey> keys, const QFont & base_font);
+
+	void clear();
+
+	[[nodiscard]] std::size_t size() const noexcept { return cache.size(); }
+	[[nodiscard]] std::size_t pixel_usage() const noexcept { return cache.cost(); }
+	[[nodiscard]] std::size_t pixel_budget() const noexcept { return cache.budget(); }
+	[[nodiscard]] Stats stats() const noexcept;
+
+private:
+	void insert_prerendered(std::uint64_t generation, const std::vector<AnnotationRenderKey> & keys, const std::vector<QImage> & images);
+
+	QPixmap * insert(const AnnotationRenderKey & key, const QImage & image);
+
+	LruCache<AnnotationRenderKey, QPixmap, AnnotationRenderKeyHash> cache;
+	QPixmap uncached; // For bubbles bigger than the whole budget
+
+	// Background renders check it to stop as soon as they're superseded
+	std::shared_ptr<std::atomic<std::uint64_t>> generation;
+	QThreadPool render_pool;
+
+	std::int64_t prerendered_count = 0;
+};
@@ -0,0 +1,140 @@
+#include "annotation_timeline.hh"
+
+#include <algorithm>
+#include <cassert>
+
+AnnotationTimeline::AnnotationTimeline(const std::vector<Annotation> & annotations)
+	: visible(annotations.size(), 0)
+	, seek_scratch(annotations.size(), 0)
+{
+	events.reserve(annotations.size() * 2);
+
+	const auto annotations_size = static_cast<int>(annotations.size());
+	for (int i = 0; i < annotations_size; ++i)
+	{
+		const Annotation & annotation = annotations[static_cast<std::size_t>(i)];
+
+		events.push_back({ annotation.start_rect.time, i, true });
+
+		// Annotations are visible while start <= position <= end, so they are hidden right after the end
+		if (annotation.end_rect.has_value())
+			events.push_back({ microseconds(annotation.end_rect->time) + microseconds(1), i, false });
+	}
+
+	std::stable_sort(events.begin(), events.end(), [](const Event & lhs, const Event & rhs)
+	{
+		return lhs.time < rhs.time;
+	});
+}
+
+bool AnnotationTimeline::advance(const microseconds position, std::vector<Change> & out_changes)
+{
+	if (!current_position.has_value()
+		|| position < *current_position - backward_tolerance
+		|| position - *current_position > max_continuous_step)
+	{
+		seek(position, out_changes);
+		return false;
+	}
+
+	if (position <= *current_position)
+		return true;
+
+	const std::size_t events_size = events.size();
+	for (; next_event < events_size && events[next_event].time <= position; ++next_event)
+	{
+		const Event & event = events[next_event];
+		std::uint8_t & annotation_visible = visible[static_cast<std::size_t>(event.annotation_index)];
+
+		if (annotation_visible == static_cast<std::uint8_t>(event.show))
+			continue;
+
+		annotation_visible = static_cast<std::uint8_t>(event.show);
+		out_changes.push_back({ event.annotation_index, event.show, event.time });
+	}
+
+	current_position = position;
+	return true;
+}
+
+void AnnotationTimeline::seek(const microseconds position, std::vector<Change> & out_changes)
+{
+	std::fill(seek_scratch.begin(), seek_scratch.end(), std::uint8_t(0));
+
+	const std::size_t events_size = events.size();
+	next_event = 0;
+	for (; next_event < events_size && events[next_event].time <= position; ++next_event)
+	{
+		const Event & event = events[next_event];
+		seek_scratch[static_cast<std::size_t>(event.annotation_index)] = static_cast<std::uint8_t>(event.show);
+	}
+
+	const auto annotations_size = static_cast<int>(visible.size());
+	for (int i = 0; i < annotations_size; ++i)
+	{
+		const auto index = static_cast<std::size_t>(i);
+		if (visible[index] != seek_scratch[index])
+			out_changes.push_back({ i, seek_scratch[index] != 0, position });
+	}
+
+	visible.swap(seek_scratch);
+	current_position = position;
+}
+
+std::optional<AnnotationTimeline::microseconds> AnnotationTimeline::next_event_time() const noexcept
+{
+	if (next_event >= events.size())
+		return std::nullopt;
+
+	return events[next_event].time;
+}
+
+bool AnnotationTimeline::is_visible(const int annotation_index) const noexcept
+{
+	assert(annotation_index >= 0 && annotation_index < static_cast<int>(visible.size()));
+	return visible[static_cast<std::size_t>(annotation_index)] != 0;
+}
+
+void AnnotationTimeline::snap_to_frame_grid(const microseconds frame_duration) noexcept
+{
+	assert(frame_duration > microseconds(0));
+
+	// Rounding up keeps the events sorted
+	for (Event & event : events)
+		event.time = ((event.time + frame_duration - microseconds(1)) / frame_duration) * frame_duration;
+}
+
+void AnnotationTimeline::reset() noexcept
+{
+	std::fill(visible.begin(), visible.end(), std::uint8_t(0));
+	next_event = 0;
+	current_position.reset();
+}
+
+std::size_t AnnotationTimeline::memory_usage() const noexcept
+{
+	return sizeof(*this)
+		+ events.capacity() * sizeof(Event)
+		+ visible.capacity() * sizeof(std::uint8_t)
+		+ seek_scratch.capacity() * sizeof(std::uint8_t);
+}
+
+void AnnotationTimingSkew::record(const AnnotationTimeline::microseconds skew, const AnnotationTimeline::microseconds frame_duration) noexcept
+{
+	const AnnotationTimeline::microseconds absolute_skew = (skew < AnnotationTimeline::microseconds(0)) ? -skew : skew;
+
+	++events;
+	if (absolute_skew > frame_duration)
+		++events_off_by_more_than_a_frame;
+
+	max_absolute_skew = std::max(max_absolute_skew, absolute_skew);
+	total_absolute_skew += absolute_skew;
+}
+
+AnnotationTimeline::microseconds AnnotationTimingSkew::mean_absolute_skew() const noexcept
+{
+	if (events == 0)
+		return AnnotationTimeline::microseconds(0);
+
+	return total_absolute_skew / events;
+}
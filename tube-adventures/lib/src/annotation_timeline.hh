@@ -0,0 +1,83 @@
+#pragma once
+
+#include "annotations.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Sorted show/hide events of all the annotations of a video. Instead of checking
+// every annotation on each position update, only the events between the previous
+// and the current position are applied, and the time of the next event is known
+// in advance so it can be scheduled precisely
+class AnnotationTimeline
+{
+public:
+	using microseconds = std::chrono::microseconds;
+
+	struct Change
+	{
+		int annotation_index;
+		bool visible;
+		microseconds scheduled_time; // Authored time of the event that caused the change
+	};
+
+	// Backward moves smaller than this are treated as clock jitter and ignored
+	static constexpr microseconds backward_tolerance{ 100'000 };
+
+	// Forward moves bigger than this are treated as seeks
+	static constexpr microseconds max_continuous_step{ 1'000'000 };
+
+	AnnotationTimeline() = default;
+	explicit AnnotationTimeline(const std::vector<Annotation> & annotations);
+
+	// Appends to out_changes the visibility changes needed to get to `position`.
+	// Returns true if the move was continuous playback (false if it was a seek),
+	// i.e. if the scheduled times of the changes are meaningful for timing purposes
+	bool advance(microseconds position, std::vector<Change> & out_changes);
+
+	[[nodiscard]] std::optional<microseconds> next_event_time() const noexcept;
+	[[nodiscard]] bool is_visible(int annotation_index) const noexcept;
+	[[nodiscard]] std::size_t size() const noexcept { return visible.size(); }
+
+	// Moves every event to the start of the first frame at or after it, so that annotations appear
+	// and disappear with the frame they belong to instead of in the middle of the previous one.
+	// Assumes a constant frame rate
+	void snap_to_frame_grid(microseconds frame_duration) noexcept;
+
+	// Back to the state right after construction: nothing visible, next advance is a seek
+	void reset() noexcept;
+
+	[[nodiscard]] std::size_t memory_usage() const noexcept;
+
+private:
+	struct Event
+	{
+		microseconds time; // The event happens once the position is >= time
+		int annotation_index;
+		bool show;
+	};
+
+	void seek(microseconds position, std::vector<Change> & out_changes);
+
+	std::vector<Event> events; // Sorted by time
+	std::size_t next_event = 0;
+
+	std::vector<std::uint8_t> visible;
+	std::vector<std::uint8_t> seek_scratch;
+	std::optional<microseconds> current_position;
+};
+
+// How late (or early) the annotations are shown/hidden compared to their authored time
+struct AnnotationTimingSkew
+{
+	std::int64_t events = 0;
+	std::int64_t events_off_by_more_than_a_frame = 0;
+	AnnotationTimeline::microseconds max_absolute_skew{ 0 };
+	AnnotationTimeline::microseconds total_absolute_skew{ 0 };
+
+	void record(AnnotationTimeline::microseconds skew, AnnotationTimeline::microseconds frame_duration) noexcept;
+
+	[[nodiscard]] AnnotationTimeline::microseconds mean_absolute_skew() const noexcept;
+};
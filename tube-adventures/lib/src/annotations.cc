@@ -1,13 +1,19 @@
 #include "annotations.hh"
+#include "trace.hh"
 
 #include <tinyxml2/tinyxml2.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <filesystem>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <charconv>
+#include <unordered_map>
 
 namespace
 {
@@ -84,8 +90,103 @@ namespace
 	{
 		return std::from_chars(str.data(), str.data() + str.size(), out_value, base);
 	}
+
+	constexpr void hash_combine(std::size_t & seed, const std::size_t value) noexcept
+	{
+		seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+
+	struct AnnotationStyleHash
+	{
+		[[nodiscard]] std::size_t operator()(const AnnotationStyle & style) const noexcept
+		{
+			std::size_t seed = std::hash<quint64>{}(style.background_color.rgba64());
+			hash_combine(seed, std::hash<quint64>{}(style.foreground_color.rgba64()));
+			hash_combine(seed, std::hash<float>{}(style.text_size));
+			return seed;
+		}
+	};
+
+	class AnnotationStyleTable
+	{
+	public:
+		AnnotationStyleTable()
+		{
+			[[maybe_unused]] const AnnotationStyleId default_style = intern(AnnotationStyle{});
+			assert(default_style == 0);
+		}
+
+		[[nodiscard]] AnnotationStyleId intern(const AnnotationStyle & style)
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+
+			const auto [it, inserted] = ids.try_emplace(style, static_cast<AnnotationStyleId>(styles.size()));
+			if (inserted)
+				styles.push_back(style);
+
+			return it->second;
+		}
+
+		[[nodiscard]] AnnotationStyle get(const AnnotationStyleId id)
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+
+			assert(id < styles.size());
+			return styles[id];
+		}
+
+		[[nodiscard]] std::size_t size()
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			return styles.size();
+		}
+
+	private:
+		std::mutex mutex;
+		std::vector<AnnotationStyle> styles; // By ID
+		std::unordered_map<AnnotationStyle, AnnotationStyleId, AnnotationStyleHash> ids;
+	};
+
+	[[nodiscard]] AnnotationStyleTable & style_table()
+	{
+		static AnnotationStyleTable table;
+		return table;
+	}
+
+	// The video a click on the annotation plays in the same window, if it has one
+	[[nodiscard]] std::optional<std::string_view> click_url_in_current_window(const tinyxml2::XMLElement & annotation)
+	{
+		const tinyxml2::XMLElement * const action = annotation.FirstChildElement("action");
+		if (action == nullptr || !action->Attribute("type", "openUrl") || !action->Attribute("trigger", "click"))
+			return std::nullopt;
+
+		const tinyxml2::XMLElement * const url = action->FirstChildElement("url");
+		if (url == nullptr || !url->Attribute("target", "current"))
+			return std::nullopt;
+
+		const char * const value = url->Attribute("value");
+		if (value == nullptr)
+			return std::nullopt;
+
+		return std::string_view(value);
+	}
 } // namespace
 
+AnnotationStyleId intern_annotation_style(const AnnotationStyle & style)
+{
+	return style_table().intern(style);
+}
+
+AnnotationStyle annotation_style(const AnnotationStyleId id)
+{
+	return style_table().get(id);
+}
+
+std::size_t annotation_style_count()
+{
+	return style_table().size();
+}
+
 #ifdef TUBE_ADVENTURES_DEBUG
 #	include <QMessageBox>
 	void maybe_this_xml_format_should_be_handled(const QString & message)
@@ -136,6 +237,8 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 {
 	assert(xml_filename != nullptr);
 
+	const TraceSpan span("parse_annotations");
+
 	tinyxml2::XMLDocument doc;
 	if (const tinyxml2::XMLError error = doc.LoadFile(xml_filename); error != tinyxml2::XMLError::XML_SUCCESS)
 	{
@@ -180,6 +283,12 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 	}
 
 	std::vector<Annotation> result_annotations;
+	std::vector<AnnotationLink> result_highlight_links;
+	std::size_t ignored_annotations = 0;
+
+	// Nearly every annotation looks like the previous one, which is reused without looking in the style table
+	std::optional<AnnotationStyle> previous_style;
+	AnnotationStyleId previous_style_id = 0;
 
 	do
 	{
@@ -197,12 +306,29 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 		{
 			// Detect "non real" annotations
 			TUBE_ADVENTURES_GET_REQUIRED_ATTRIBUTE(annotation, type);
+			if (annotation_type_str_view == "highlight"sv)
+			{
+				// Clickable areas with no text, drawn over the choices of the video. Only where they lead is kept
+				if (const std::optional<std::string_view> click_url = click_url_in_current_window(*annotation); click_url.has_value())
+					result_highlight_links.push_back({ std::move(result_annotation.id), std::string(youtube_video_id_from_url(*click_url).value_or(""sv)) });
+				else
+					++ignored_annotations;
+
+				continue;
+			}
+
 			if (annotation_type_str_view != "text"sv)
+			{
+				++ignored_annotations;
 				continue;
+			}
 
 			TUBE_ADVENTURES_GET_REQUIRED_ATTRIBUTE(annotation, style);
 			if (annotation_style_str_view != "popup"sv)
+			{
+				++ignored_annotations;
 				continue;
+			}
 		}
 
 		const tinyxml2::XMLElement * const annotation_text = annotation->FirstChildElement("TEXT");
@@ -260,7 +386,10 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 		else
 		{
 			if (segment->NoChildren())
+			{
+				++ignored_annotations;
 				continue; // Not a real annotation
+			}
 
 			const tinyxml2::XMLElement * const moving_region = segment->FirstChildElement("movingRegion");
 			if (moving_region == nullptr)
@@ -283,16 +412,7 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 				int rect_region_index = 0;
 				do
 				{
-					if (rect_region_index > 1)
-					{
-						return { ParseAnnotationsError::invalid_format, {}, "More than 2 <rectRegion> in <movingRegion>" };
-					}
-
-					assert(rect_region_index == 0 || rect_region_index == 1);
-					Annotation::RectRegion & result_rect_region = (rect_region_index == 0)
-						? result_annotation.start_rect
-						: (*(result_annotation.end_rect = Annotation::RectRegion{}));
-					++rect_region_index;
+					Annotation::RectRegion result_rect_region;
 
 					{
 						TUBE_ADVENTURES_GET_REQUIRED_ATTRIBUTE(rect_region, x);
@@ -317,24 +437,26 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 					{
 						TUBE_ADVENTURES_GET_REQUIRED_ATTRIBUTE(rect_region, t);
 
-						unsigned hours, minutes, seconds, centiseconds;
-						const auto amount_of_correct =
-#					ifdef _MSC_VER
-							sscanf_s(
-#					else
-								std::sscanf
-#					endif
-								rect_region_t_str, "%u:%u:%u.%u", &hours, &minutes, &seconds, &centiseconds);
-
-								constexpr auto expected_amount_of_correct = 4;
-								if (amount_of_correct != expected_amount_of_correct)
-								{
-									return { ParseAnnotationsError::invalid_format, {}, "Parsing timestamp. Amount of correct parses (" + std::to_string(amount_of_correct) + ") is different from the expected (" + std::to_string(expected_amount_of_correct) + ')' };
-								}
-
-								using centiseconds_t = std::chrono::duration<std::chrono::seconds::rep, std::ratio<1, 100>>;
-								result_rect_region.time = std::chrono::hours{ hours } +std::chrono::minutes{ minutes } +std::chrono::seconds{ seconds } +centiseconds_t{ centiseconds };
+						const std::optional<std::chrono::milliseconds> time = parse_annotation_timestamp(rect_region_t_str_view);
+						if (!time.has_value())
+						{
+							return { ParseAnnotationsError::invalid_format, {}, "Invalid timestamp: \"" + std::string(rect_region_t_str_view) + '"' };
+						}
+
+						result_rect_region.time = *time;
+					}
+
+					// The last keyframe is the end rect. The ones between the first and the last (usually none) are intermediate
+					if (rect_region_index == 0)
+						result_annotation.start_rect = result_rect_region;
+					else
+					{
+						if (result_annotation.end_rect.has_value())
+							result_annotation.intermediate_rects.push_back(*result_annotation.end_rect);
+
+						result_annotation.end_rect = result_rect_region;
 					}
+					++rect_region_index;
 				} while (rect_region = rect_region->NextSiblingElement(rect_region_name));
 
 #ifdef TUBE_ADVENTURES_DEBUG
@@ -349,9 +471,17 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 				return { ParseAnnotationsError::invalid_format, {}, "<annotation> without <appearance>" };
 			}
 			
+			AnnotationStyle style;
+
 			{
 				TUBE_ADVENTURES_GET_REQUIRED_ATTRIBUTE(appearance, textSize);
-				TUBE_ADVENTURES_FROM_CHARS_REQUIRED(appearance_textSize_str_view, result_annotation.text_size);
+				TUBE_ADVENTURES_FROM_CHARS_REQUIRED(appearance_textSize_str_view, style.text_size);
+
+				// A NaN would never be equal to an interned style, and be interned again every time
+				if (!std::isfinite(style.text_size))
+				{
+					return { ParseAnnotationsError::invalid_format, {}, "Invalid text size: \"" + std::string(appearance_textSize_str_view) + '"' };
+				}
 			}
 
 			{
@@ -379,9 +509,9 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 					QRgb background_color;
 					TUBE_ADVENTURES_FROM_CHARS_REQUIRED(appearance_bgColor_str_view, background_color);
 
-					result_annotation.background_color = QColor::fromRgb(background_color);
+					style.background_color = QColor::fromRgb(background_color);
 
-					if (auto color_error = check_color_rgb(background_color, result_annotation.background_color, "Background"); !color_error.empty())
+					if (auto color_error = check_color_rgb(background_color, style.background_color, "Background"); !color_error.empty())
 						return { ParseAnnotationsError::invalid_format, {}, std::move(color_error) };
 
 
@@ -389,8 +519,8 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 					float background_alpha;
 					TUBE_ADVENTURES_FROM_CHARS_REQUIRED(appearance_bgAlpha_str_view, background_alpha);
 
-					result_annotation.background_color.setAlphaF(background_alpha);
-					if (!result_annotation.background_color.isValid())
+					style.background_color.setAlphaF(background_alpha);
+					if (!style.background_color.isValid())
 					{
 						return { ParseAnnotationsError::invalid_format, {}, "Background alpha is invalid (" + std::to_string(background_alpha) + "). The valid range is: [0.0, 1.0]" };
 					}
@@ -399,9 +529,9 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 				TUBE_ADVENTURES_GET_REQUIRED_ATTRIBUTE(appearance, fgColor);
 				QRgb foreground_color;
 				TUBE_ADVENTURES_FROM_CHARS_REQUIRED(appearance_fgColor_str_view, foreground_color);
-				result_annotation.foreground_color = QColor::fromRgb(foreground_color);
+				style.foreground_color = QColor::fromRgb(foreground_color);
 
-				if (auto color_error = check_color_rgb(foreground_color, result_annotation.foreground_color, "Foreground"); !color_error.empty())
+				if (auto color_error = check_color_rgb(foreground_color, style.foreground_color, "Foreground"); !color_error.empty())
 					return { ParseAnnotationsError::invalid_format, {}, std::move(color_error) };
 
 				{
@@ -412,12 +542,73 @@ ParseAnnotationsResult parse_annotations(const char * xml_filename)
 					}
 				}
 			}
+
+			if (!previous_style.has_value() || !(*previous_style == style))
+			{
+				previous_style = style;
+				previous_style_id = intern_annotation_style(style);
+			}
+
+			result_annotation.style = previous_style_id;
 		}
 
 		result_annotations.emplace_back(std::move(result_annotation));
 	} while (annotation = annotation->NextSiblingElement(annotation_name));
 
-	return { ParseAnnotationsError::success, std::move(result_annotations), {} };
+	return { ParseAnnotationsError::success, std::move(result_annotations), {}, std::move(result_highlight_links), ignored_annotations };
+}
+
+std::size_t memory_usage(const Annotation & annotation) noexcept
+{
+	return sizeof(Annotation)
+		+ annotation.id.capacity()
+		+ annotation.text.capacity() * sizeof(u8char)
+		+ annotation.click_url.capacity()
+		+ annotation.intermediate_rects.capacity() * sizeof(Annotation::RectRegion);
+}
+
+std::size_t memory_usage(const AnnotationLink & link) noexcept
+{
+	return sizeof(AnnotationLink) + link.id.capacity() + link.target_id.capacity();
+}
+
+std::optional<float> parse_annotation_float(const std::string_view string) noexcept
+{
+	float value;
+	if (::from_chars(string, value).ec != std::errc{})
+		return std::nullopt;
+
+	return value;
+}
+
+std::optional<std::chrono::milliseconds> parse_annotation_timestamp(const std::string_view timestamp) noexcept
+{
+	// Hours, minutes, seconds and centiseconds, with a separator before all but the first
+	unsigned values[4];
+	constexpr char separators[] = { ':', ':', '.' };
+
+	const char * it = timestamp.data();
+	const char * const end = timestamp.data() + timestamp.size();
+
+	for (std::size_t i = 0; i < std::size(values); ++i)
+	{
+		if (i > 0)
+		{
+			if (it == end || *it != separators[i - 1])
+				return std::nullopt;
+
+			++it;
+		}
+
+		const std::from_chars_result result = std::from_chars(it, end, values[i]);
+		if (result.ec != std::errc{})
+			return std::nullopt;
+
+		it = result.ptr;
+	}
+
+	using centiseconds_t = std::chrono::duration<std::chrono::milliseconds::rep, std::ratio<1, 100>>;
+	return std::chrono::hours{ values[0] } + std::chrono::minutes{ values[1] } + std::chrono::seconds{ values[2] } + centiseconds_t{ values[3] };
 }
 
 std::optional<std::string> full_youtube_url_from_id(const std::string_view video_id)
@@ -439,6 +630,8 @@ std::optional<std::string> full_youtube_url_from_id(const std::string_view video
 
 [[nodiscard]] std::optional<std::string> path_to_youtube_video_id(const std::filesystem::path & annotation_file_path, const std::filesystem::path & expected_extension)
 {
+	 const TraceSpan span("path_to_youtube_video_id");
+
 	 const auto stem = annotation_file_path.stem();
 
 	 if (stem.empty())
@@ -459,3 +652,26 @@ std::optional<std::string> full_youtube_url_from_id(const std::string_view video
 
 	 return stem_str.substr(found_index + 1);
 }
+
+std::filesystem::path find_path_with_youtube_id(const std::string_view youtube_id, const std::filesystem::path & search_directory, const std::filesystem::path & expected_extension) try
+{
+	const TraceSpan span("find_path_with_youtube_id");
+
+	const auto end_it = std::filesystem::directory_iterator{};
+	const auto path_it = std::find_if(std::filesystem::directory_iterator(search_directory), end_it, [youtube_id, &expected_extension](const std::filesystem::directory_entry & entry)
+	{
+		if (const auto id = path_to_youtube_video_id(entry.path(), expected_extension); id.has_value())
+			return *id == youtube_id;
+
+		return false;
+	});
+
+	if (path_it == end_it)
+		return {};
+
+	return path_it->path();
+}
+catch (const std::filesystem::filesystem_error &)
+{
+	return {};
+}
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <chrono>
 #include <string_view>
 #include <filesystem>
+#include <vector>
 
 #include <QColor>
 
@@ -17,6 +19,32 @@
 using u8string = std::basic_string<u8char>;
 using u8string_view = std::basic_string_view<u8char>;
 
+// The <appearance> of an annotation
+struct AnnotationStyle
+{
+	QColor background_color; // RGBA
+	QColor foreground_color; // RGB
+	float text_size = 0.0f; // Percentage of the video height
+
+	[[nodiscard]] bool operator==(const AnnotationStyle & other) const noexcept
+	{
+		return background_color == other.background_color && foreground_color == other.foreground_color && text_size == other.text_size;
+	}
+};
+
+// Index in the table of every style parsed, shared by all the annotations. Almost all of the annotations of a game
+// look the same, so they only keep this instead of the whole style. Styles are never removed from the table.
+// 0 is the default style (invalid colors and no text size), which is always in the table
+using AnnotationStyleId = std::uint32_t;
+
+// The ID of the style, adding it to the table if it isn't there. Can be called from any thread
+[[nodiscard]] AnnotationStyleId intern_annotation_style(const AnnotationStyle & style);
+
+// The ID must come from intern_annotation_style. Can be called from any thread
+[[nodiscard]] AnnotationStyle annotation_style(AnnotationStyleId id);
+
+[[nodiscard]] std::size_t annotation_style_count();
+
 struct Annotation
 {
 	std::string id;
@@ -34,10 +62,9 @@ struct Annotation
 
 	RectRegion start_rect;
 	std::optional<RectRegion> end_rect;
+	std::vector<RectRegion> intermediate_rects; // Keyframes between start_rect and end_rect (usually none)
 
-	QColor background_color; // RGBA
-	QColor foreground_color; // RGB
-	float text_size;
+	AnnotationStyleId style = 0;
 
 	std::string click_url; // optional
 	
@@ -51,6 +78,18 @@ struct Annotation
 	Type type;
 };
 
+// Where a "highlight" annotation leads. Highlights are clickable areas with no text, drawn over the choices shown
+// in the video. They aren't shown, only their click targets are parsed
+struct AnnotationLink
+{
+	std::string id;
+	std::string target_id; // Youtube ID of the video it opens. Empty if its URL has none. Its full URL isn't kept, it's mostly tracking parameters
+};
+
+// Approximate amount of memory owned by the annotation, in bytes
+[[nodiscard]] std::size_t memory_usage(const Annotation & annotation) noexcept;
+[[nodiscard]] std::size_t memory_usage(const AnnotationLink & link) noexcept;
+
 #define TUBE_ADVENTURES_PARSE_ANNOTATION_ERROR_ENUMERATORS  \
 	TUBE_ADVENTURES_PARSE_ANNOTATION_ERROR_ENUMERATOR(success)\
 	TUBE_ADVENTURES_PARSE_ANNOTATION_ERROR_ENUMERATOR(file_not_found)\
@@ -97,16 +136,27 @@ struct ParseAnnotationsResult
 	ParseAnnotationsError error;
 	std::vector<Annotation> annotations; // Empty unless error == ParseAnnotationsError::success
 	std::string error_string;
+	std::vector<AnnotationLink> highlight_links = {}; // Of the highlights that open a video in the same window
+	std::size_t ignored_annotations = 0; // Neither in annotations nor in highlight_links: highlight texts, speech bubbles, empty ones...
 };
 
 ParseAnnotationsResult parse_annotations(const char * xml_filename);
 
+// Decoders for the attributes of <rectRegion>
+// Coordinates and sizes: "12.34567"
+[[nodiscard]] std::optional<float> parse_annotation_float(std::string_view string) noexcept;
+// Time of a keyframe: "h:mm:ss.cc". The digits after the dot are taken as centiseconds
+[[nodiscard]] std::optional<std::chrono::milliseconds> parse_annotation_timestamp(std::string_view timestamp) noexcept;
+
 constexpr std::size_t youtube_video_id_length = 11;
 
 const std::filesystem::path annotation_file_extension = ".xml";
 
 [[nodiscard]] std::optional<std::string> full_youtube_url_from_id(const std::string_view video_id);
 [[nodiscard]] std::optional<std::string> path_to_youtube_video_id(const std::filesystem::path & annotation_file_path, const std::filesystem::path & expected_extension);
+
+// First file in the directory (not recursive) named after the youtube ID, with that extension. Empty if none
+[[nodiscard]] std::filesystem::path find_path_with_youtube_id(std::string_view youtube_id, const std::filesystem::path & search_directory, const std::filesystem::path & expected_extension);
 [[nodiscard]] constexpr std::optional<std::string_view> youtube_video_id_from_url(const std::string_view youtube_url) noexcept
 {
 	using namespace std::string_view_literals;
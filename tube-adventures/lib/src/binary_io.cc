@@ -0,0 +1,23 @@
+#include "binary_io.hh"
+
+#include <cstdio>
+
+std::optional<std::vector<std::uint8_t>> read_binary_file(const std::filesystem::path & path)
+{
+	std::FILE * const file = std::fopen(path.string().c_str(), "rb");
+	if (file == nullptr)
+		return std::nullopt;
+
+	std::vector<std::uint8_t> data;
+	std::uint8_t chunk[64 * 1024];
+	while (const std::size_t read = std::fread(chunk, 1, sizeof(chunk), file))
+		data.insert(data.end(), chunk, chunk + read);
+
+	const bool failed = std::ferror(file) != 0;
+	std::fclose(file);
+
+	if (failed)
+		return std::nullopt;
+
+	return data;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Building blocks of the binary formats (session recordings, binary annotations): variable length integers,
+// floats as their 4 little endian bytes and strings as their length and bytes
+
+inline void write_varint(std::vector<std::uint8_t> & out, std::uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<std::uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+
+	out.push_back(static_cast<std::uint8_t>(value));
+}
+
+// Zigzag encoded, so small negative numbers are small too
+inline void write_signed_varint(std::vector<std::uint8_t> & out, const std::int64_t value)
+{
+	write_varint(out, (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+inline void write_float(std::vector<std::uint8_t> & out, const float value)
+{
+	static_assert(sizeof(float) == sizeof(std::uint32_t));
+
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	for (int i = 0; i < 4; ++i)
+		out.push_back(static_cast<std::uint8_t>(bits >> (8 * i)));
+}
+
+template <typename Char>
+void write_string(std::vector<std::uint8_t> & out, const std::basic_string_view<Char> string)
+{
+	static_assert(sizeof(Char) == 1);
+
+	write_varint(out, string.size());
+	const auto * const bytes = reinterpret_cast<const std::uint8_t *>(string.data());
+	out.insert(out.end(), bytes, bytes + string.size());
+}
+
+// Every read returns false if there isn't enough data left
+class BinaryReader
+{
+public:
+	BinaryReader(const std::uint8_t * data_, const std::size_t size_) noexcept
+		: data(data_)
+		, size(size_)
+	{
+	}
+
+	[[nodiscard]] bool at_end() const noexcept { return offset == size; }
+
+	[[nodiscard]] bool read_byte(std::uint8_t & out) noexcept
+	{
+		if (offset == size)
+			return false;
+
+		out = data[offset++];
+		return true;
+	}
+
+	[[nodiscard]] bool read_varint(std::uint64_t & out) noexcept
+	{
+		out = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7)
+		{
+			std::uint8_t byte;
+			if (!read_byte(byte))
+				return false;
+
+			out |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	[[nodiscard]] bool read_signed_varint(std::int64_t & out) noexcept
+	{
+		std::uint64_t zigzag;
+		if (!read_varint(zigzag))
+			return false;
+
+		out = static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1);
+		return true;
+	}
+
+	[[nodiscard]] bool read_float(float & out) noexcept
+	{
+		if (size - offset < 4)
+			return false;
+
+		std::uint32_t bits = 0;
+		for (int i = 0; i < 4; ++i)
+			bits |= static_cast<std::uint32_t>(data[offset++]) << (8 * i);
+
+		std::memcpy(&out, &bits, sizeof(out));
+		return true;
+	}
+
+	template <typename String>
+	[[nodiscard]] bool read_string(const std::size_t length, String & out)
+	{
+		static_assert(sizeof(typename String::value_type) == 1);
+
+		if (size - offset < length)
+			return false;
+
+		out.assign(reinterpret_cast<const typename String::value_type *>(data + offset), length);
+		offset += length;
+		return true;
+	}
+
+	// Written by write_string
+	template <typename String>
+	[[nodiscard]] bool read_string(String & out)
+	{
+		std::uint64_t length;
+		return read_varint(length) && length <= size - offset && read_string(static_cast<std::size_t>(length), out);
+	}
+
+private:
+	const std::uint8_t * data;
+	std::size_t size;
+	std::size_t offset = 0;
+};
+
+// The whole file. Empty if it can't be read
+[[nodiscard]] std::optional<std::vector<std::uint8_t>> read_binary_file(const std::filesystem::path & path);
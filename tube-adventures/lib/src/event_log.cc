@@ -0,0 +1,391 @@
+#include "event_log.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <csignal>
+#include <memory>
+
+namespace
+{
+	// Slots are written by their thread while they may be read by another one (seqlock): the
+	// sequence is odd while the slot is being written, so readers can detect torn reads.
+	// The fields are relaxed atomics, which are plain loads and stores on common hardware
+	struct Slot
+	{
+		std::atomic<std::uint64_t> sequence{ 0 }; // 2 * event + 1 while writing, 2 * event + 2 once written
+		std::atomic<std::uint64_t> timestamp{ 0 };
+		std::atomic<std::uint64_t> format{ 0 };
+		std::atomic<std::uint64_t> meta{ 0 }; // Level, argument count and argument types
+		std::array<std::atomic<std::uint64_t>, max_log_arguments> arguments{};
+	};
+
+	struct Ring
+	{
+		explicit Ring(const std::uint32_t thread_index_) noexcept
+			: thread_index(thread_index_)
+		{
+		}
+
+		const std::uint32_t thread_index;
+		std::atomic<bool> in_use{ true };
+		std::atomic<std::uint64_t> head{ 0 }; // Events ever written
+		std::array<Slot, log_ring_capacity> slots;
+	};
+
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Ring>> rings; // Never destroyed: threads may log until the very end
+	};
+
+	[[nodiscard]] Registry & registry() noexcept
+	{
+		static Registry & instance = *new Registry;
+		return instance;
+	}
+
+	// Rings of threads that finished are reused by new threads
+	[[nodiscard]] Ring & acquire_ring()
+	{
+		Registry & reg = registry();
+		const std::lock_guard lock(reg.mutex);
+
+		for (const std::unique_ptr<Ring> & ring : reg.rings)
+		{
+			bool in_use = false;
+			if (ring->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+				return *ring;
+		}
+
+		return *reg.rings.emplace_back(std::make_unique<Ring>(static_cast<std::uint32_t>(reg.rings.size())));
+	}
+
+	class ThreadRing
+	{
+	public:
+		[[nodiscard]] Ring & get()
+		{
+			if (ring == nullptr)
+				ring = &acquire_ring();
+
+			return *ring;
+		}
+
+		~ThreadRing()
+		{
+			if (ring != nullptr)
+				ring->in_use.store(false, std::memory_order_release);
+		}
+
+	private:
+		Ring * ring = nullptr;
+	};
+
+	thread_local ThreadRing this_thread_ring;
+
+	constexpr unsigned argument_type_bits = 4;
+
+	[[nodiscard]] std::uint64_t pack_meta(const LogLevel level, const LogArgument * arguments, const std::size_t argument_count) noexcept
+	{
+		std::uint64_t meta = static_cast<std::uint64_t>(level) | (static_cast<std::uint64_t>(argument_count) << 8);
+		for (std::size_t i = 0; i < argument_count; ++i)
+			meta |= static_cast<std::uint64_t>(arguments[i].type) << (16 + i * argument_type_bits);
+
+		return meta;
+	}
+
+	void unpack_meta(const std::uint64_t meta, LogRecord & record) noexcept
+	{
+		record.level = static_cast<LogLevel>(meta & 0xff);
+		record.argument_count = static_cast<std::uint8_t>(std::min<std::uint64_t>((meta >> 8) & 0xff, max_log_arguments));
+
+		for (std::size_t i = 0; i < record.argument_count; ++i)
+			record.arguments[i].type = static_cast<LogArgument::Type>((meta >> (16 + i * argument_type_bits)) & 0xf);
+	}
+
+	// False if the event was overwritten (or is being written)
+	[[nodiscard]] bool read_event(const Ring & ring, const std::uint64_t event, LogRecord & out_record) noexcept
+	{
+		const Slot & slot = ring.slots[event % log_ring_capacity];
+
+		const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence != 2 * event + 2)
+			return false;
+
+		out_record.timestamp = std::chrono::nanoseconds(static_cast<std::int64_t>(slot.timestamp.load(std::memory_order_relaxed)));
+		out_record.format = reinterpret_cast<const char *>(static_cast<std::uintptr_t>(slot.format.load(std::memory_order_relaxed)));
+		unpack_meta(slot.meta.load(std::memory_order_relaxed), out_record);
+		for (std::size_t i = 0; i < out_record.argument_count; ++i)
+			out_record.arguments[i].value = slot.arguments[i].load(std::memory_order_relaxed);
+		out_record.thread_index = ring.thread_index;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.sequence.load(std::memory_order_relaxed) == sequence;
+	}
+
+	void sort_by_time(std::vector<LogRecord> & records, const std::size_t first)
+	{
+		std::stable_sort(records.begin() + static_cast<std::ptrdiff_t>(first), records.end(), [](const LogRecord & a, const LogRecord & b)
+		{
+			return a.timestamp < b.timestamp;
+		});
+	}
+
+	void append_argument(std::string & out, const LogArgument & argument)
+	{
+		switch (argument.type)
+		{
+			case LogArgument::Type::signed_integer:
+				out += std::to_string(static_cast<std::int64_t>(argument.value));
+				break;
+
+			case LogArgument::Type::unsigned_integer:
+				out += std::to_string(argument.value);
+				break;
+
+			case LogArgument::Type::floating_point:
+			{
+				double value;
+				std::memcpy(&value, &argument.value, sizeof(value));
+
+				char buffer[32];
+				const int length = std::snprintf(buffer, sizeof(buffer), "%g", value);
+				if (length > 0)
+					out.append(buffer, std::min(static_cast<std::size_t>(length), sizeof(buffer) - 1));
+				break;
+			}
+
+			case LogArgument::Type::string:
+			{
+				const auto * const string = reinterpret_cast<const char *>(static_cast<std::uintptr_t>(argument.value));
+				out += string != nullptr ? string : "(null)";
+				break;
+			}
+
+			case LogArgument::Type::none:
+				break;
+		}
+	}
+
+	void on_crash_signal(const int signal_number)
+	{
+		std::fprintf(stderr, "Crashed with signal %d. Last logged events:\n", signal_number);
+		dump_recent_log_records(stderr, 64);
+
+		std::signal(signal_number, SIG_DFL);
+		std::raise(signal_number);
+	}
+} // namespace
+
+void event_log_detail::write(const LogLevel level, const char * format, const LogArgument * arguments, const std::size_t argument_count) noexcept
+{
+	assert(argument_count <= max_log_arguments);
+
+	Ring & ring = this_thread_ring.get();
+	const std::uint64_t event = ring.head.load(std::memory_order_relaxed);
+	Slot & slot = ring.slots[event % log_ring_capacity];
+
+	slot.sequence.store(2 * event + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	const auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch());
+	slot.timestamp.store(static_cast<std::uint64_t>(timestamp.count()), std::memory_order_relaxed);
+	slot.format.store(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(format)), std::memory_order_relaxed);
+	slot.meta.store(pack_meta(level, arguments, argument_count), std::memory_order_relaxed);
+	for (std::size_t i = 0; i < argument_count; ++i)
+		slot.arguments[i].store(arguments[i].value, std::memory_order_relaxed);
+
+	slot.sequence.store(2 * event + 2, std::memory_order_release);
+	ring.head.store(event + 1, std::memory_order_release);
+}
+
+const char * to_string(const LogLevel level) noexcept
+{
+	switch (level)
+	{
+		case LogLevel::trace: return "trace";
+		case LogLevel::debug: return "debug";
+		case LogLevel::info: return "info";
+		case LogLevel::warning: return "warning";
+		case LogLevel::error: return "error";
+	}
+
+	return "unknown";
+}
+
+std::string format_log_record(const LogRecord & record)
+{
+	char prefix[64];
+	const int prefix_length = std::snprintf(prefix, sizeof(prefix), "[%13.6f] %-7s #%u ",
+		std::chrono::duration<double>(record.timestamp).count(), to_string(record.level), static_cast<unsigned>(record.thread_index));
+
+	std::string line;
+	if (prefix_length > 0)
+		line.assign(prefix, std::min(static_cast<std::size_t>(prefix_length), sizeof(prefix) - 1));
+
+	std::size_t next_argument = 0;
+	for (const char * c = record.format; *c != '\0'; ++c)
+	{
+		if (c[0] == '{' && c[1] == '}' && next_argument < record.argument_count)
+		{
+			append_argument(line, record.arguments[next_argument++]);
+			++c;
+		}
+		else
+			line += *c;
+	}
+
+	return line;
+}
+
+void EventLogReader::read(std::vector<LogRecord> & out_records)
+{
+	const std::size_t first = out_records.size();
+
+	{
+		Registry & reg = registry();
+		const std::lock_guard lock(reg.mutex);
+
+		cursors.resize(reg.rings.size(), 0);
+
+		for (std::size_t i = 0; i < reg.rings.size(); ++i)
+		{
+			const Ring & ring = *reg.rings[i];
+			const std::uint64_t head = ring.head.load(std::memory_order_acquire);
+			std::uint64_t & cursor = cursors[i];
+
+			if (head - cursor > log_ring_capacity)
+			{
+				lost += head - log_ring_capacity - cursor;
+				cursor = head - log_ring_capacity;
+			}
+
+			for (; cursor < head; ++cursor)
+			{
+				LogRecord record;
+				if (read_event(ring, cursor, record))
+					out_records.push_back(record);
+				else
+					++lost;
+			}
+		}
+	}
+
+	sort_by_time(out_records, first);
+}
+
+void collect_recent_log_records(const std::size_t max_records_per_thread, std::vector<LogRecord> & out_records)
+{
+	const std::size_t first = out_records.size();
+
+	{
+		Registry & reg = registry();
+
+		// Crash dumps can't wait: the lock may be held by the thread that crashed
+		std::unique_lock lock(reg.mutex, std::try_to_lock);
+		if (!lock.owns_lock())
+			return;
+
+		const std::size_t max_records = std::min(max_records_per_thread, log_ring_capacity);
+		for (const std::unique_ptr<Ring> & ring : reg.rings)
+		{
+			const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+			for (std::uint64_t event = head - std::min<std::uint64_t>(head, max_records); event < head; ++event)
+			{
+				LogRecord record;
+				if (read_event(*ring, event, record))
+					out_records.push_back(record);
+			}
+		}
+	}
+
+	sort_by_time(out_records, first);
+}
+
+void dump_recent_log_records(std::FILE * file, const std::size_t max_records_per_thread)
+{
+	assert(file != nullptr);
+
+	std::vector<LogRecord> records;
+	collect_recent_log_records(max_records_per_thread, records);
+
+	for (const LogRecord & record : records)
+	{
+		const std::string line = format_log_record(record);
+		std::fprintf(file, "%s\n", line.c_str());
+	}
+
+	std::fflush(file);
+}
+
+void install_log_crash_handler() noexcept
+{
+	for (const int signal_number : { SIGSEGV, SIGABRT, SIGFPE, SIGILL })
+		std::signal(signal_number, on_crash_signal);
+}
+
+EventLogDrain::EventLogDrain(const std::string & path, const std::chrono::milliseconds interval_)
+	: file(std::fopen(path.c_str(), "a"))
+	, interval(interval_)
+{
+	if (file != nullptr)
+		thread = std::thread(&EventLogDrain::run, this);
+}
+
+EventLogDrain::~EventLogDrain()
+{
+	if (file == nullptr)
+		return;
+
+	{
+		const std::lock_guard lock(mutex);
+		stopping = true;
+	}
+
+	stop_requested.notify_one();
+	thread.join();
+
+	std::fclose(file);
+}
+
+void EventLogDrain::run()
+{
+	std::vector<LogRecord> records;
+
+	for (;;)
+	{
+		bool stop;
+		{
+			std::unique_lock lock(mutex);
+			stop = stop_requested.wait_for(lock, interval, [this] { return stopping; });
+		}
+
+		// Whatever was logged before stopping is written too
+		drain(records);
+
+		if (stop)
+			return;
+	}
+}
+
+void EventLogDrain::drain(std::vector<LogRecord> & records)
+{
+	records.clear();
+	reader.read(records);
+
+	if (reader.lost_events() != reported_lost)
+	{
+		std::fprintf(file, "%llu events were overwritten before they could be written\n",
+			static_cast<unsigned long long>(reader.lost_events() - reported_lost));
+		reported_lost = reader.lost_events();
+	}
+
+	for (const LogRecord & record : records)
+	{
+		const std::string line = format_log_record(record);
+		std::fprintf(file, "%s\n", line.c_str());
+	}
+
+	std::fflush(file);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Structured logging for hot paths. An event is a format string literal plus up to
+// max_log_arguments raw arguments: nothing is formatted when it's logged. Every thread
+// writes to its own lock-free ring of the last events, which is formatted later by an
+// EventLogDrain (if any) or dumped on a crash.
+//
+// Levels below TUBE_ADVENTURES_LOG_LEVEL are compiled out
+
+enum class LogLevel : std::uint8_t
+{
+	trace,
+	debug,
+	info,
+	warning,
+	error,
+};
+
+#ifndef TUBE_ADVENTURES_LOG_LEVEL
+#	ifdef TUBE_ADVENTURES_DEBUG
+#		define TUBE_ADVENTURES_LOG_LEVEL 0 // trace
+#	else
+#		define TUBE_ADVENTURES_LOG_LEVEL 2 // info
+#	endif
+#endif
+
+inline constexpr LogLevel compile_time_log_level = static_cast<LogLevel>(TUBE_ADVENTURES_LOG_LEVEL);
+
+inline constexpr std::size_t max_log_arguments = 6;
+
+// Events each thread keeps. Older ones are overwritten
+inline constexpr std::size_t log_ring_capacity = 4096;
+
+struct LogArgument
+{
+	enum class Type : std::uint8_t
+	{
+		none,
+		signed_integer,
+		unsigned_integer,
+		floating_point,
+		string, // Must outlive the log, like a literal
+	};
+
+	Type type = Type::none;
+	std::uint64_t value = 0; // Raw bits
+};
+
+struct LogRecord
+{
+	std::chrono::nanoseconds timestamp{ 0 }; // steady_clock
+	LogLevel level = LogLevel::info;
+	const char * format = ""; // "{}" is replaced by the next argument
+	std::uint8_t argument_count = 0;
+	std::array<LogArgument, max_log_arguments> arguments;
+	std::uint32_t thread_index = 0; // In the order the threads first logged
+};
+
+namespace event_log_detail
+{
+	template<typename T>
+	[[nodiscard]] LogArgument make_argument(const T value) noexcept
+	{
+		if constexpr (std::is_same_v<T, bool>)
+			return { LogArgument::Type::unsigned_integer, value ? 1u : 0u };
+		else if constexpr (std::is_enum_v<T>)
+			return make_argument(static_cast<std::underlying_type_t<T>>(value));
+		else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+			return { LogArgument::Type::signed_integer, static_cast<std::uint64_t>(static_cast<std::int64_t>(value)) };
+		else if constexpr (std::is_integral_v<T>)
+			return { LogArgument::Type::unsigned_integer, static_cast<std::uint64_t>(value) };
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			const auto double_value = static_cast<double>(value);
+			std::uint64_t bits;
+			static_assert(sizeof(bits) == sizeof(double_value));
+			std::memcpy(&bits, &double_value, sizeof(bits));
+			return { LogArgument::Type::floating_point, bits };
+		}
+		else
+		{
+			static_assert(std::is_same_v<T, const char *>, "Only numbers, enums and string literals can be logged");
+			return { LogArgument::Type::string, static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(value)) };
+		}
+	}
+
+	void write(LogLevel level, const char * format, const LogArgument * arguments, std::size_t argument_count) noexcept;
+} // namespace event_log_detail
+
+// A few nanoseconds: a clock read and a copy of the arguments into the ring of the thread
+template<LogLevel level, std::size_t format_size, typename... Args>
+void log_event([[maybe_unused]] const char (&format)[format_size], [[maybe_unused]] const Args... args) noexcept
+{
+	static_assert(sizeof...(Args) <= max_log_arguments, "Too many log arguments");
+
+	if constexpr (level >= compile_time_log_level)
+	{
+		const std::array<LogArgument, sizeof...(Args)> arguments{ event_log_detail::make_argument(args)... };
+		event_log_detail::write(level, format, arguments.data(), arguments.size());
+	}
+}
+
+[[nodiscard]] const char * to_string(LogLevel level) noexcept;
+
+// "[    12.345678] info    #0 Annotation 3 shown"
+[[nodiscard]] std::string format_log_record(const LogRecord & record);
+
+// Reads the events logged since the previous read, from every thread
+class EventLogReader
+{
+public:
+	void read(std::vector<LogRecord> & out_records);
+
+	// Events overwritten before they could be read
+	[[nodiscard]] std::uint64_t lost_events() const noexcept { return lost; }
+
+private:
+	std::vector<std::uint64_t> cursors; // Per thread
+	std::uint64_t lost = 0;
+};
+
+// The last events of every thread, oldest first per thread
+void collect_recent_log_records(std::size_t max_records_per_thread, std::vector<LogRecord> & out_records);
+
+// Meant to be called when crashing: it isn't async-signal-safe, but it's the last thing the process does
+void dump_recent_log_records(std::FILE * file, std::size_t max_records_per_thread);
+
+// Dumps the last events to stderr on SIGSEGV, SIGABRT, SIGFPE and SIGILL, then crashes as it would have
+void install_log_crash_handler() noexcept;
+
+// Formats the events on its own thread and appends them to a file
+class EventLogDrain
+{
+public:
+	static constexpr std::chrono::milliseconds default_interval{ 100 };
+
+	explicit EventLogDrain(const std::string & path, std::chrono::milliseconds interval = default_interval);
+	~EventLogDrain();
+
+	EventLogDrain(const EventLogDrain &) = delete;
+	EventLogDrain & operator=(const EventLogDrain &) = delete;
+
+	[[nodiscard]] bool is_open() const noexcept { return file != nullptr; }
+
+private:
+	void run();
+	void drain(std::vector<LogRecord> & records);
+
+	std::FILE * file;
+	std::chrono::milliseconds interval;
+
+	EventLogReader reader;
+	std::uint64_t reported_lost = 0;
+
+	std::mutex mutex;
+	std::condition_variable stop_requested;
+	bool stopping = false;
+
+	std::thread thread;
+};
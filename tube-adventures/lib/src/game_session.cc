@@ -0,0 +1,367 @@
+#include "game_session.hh"
+#include "event_log.hh"
+#include "trace.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <system_error>
+#include <utility>
+
+namespace
+{
+	[[nodiscard]] std::filesystem::path absolute_path_for_errors(const std::filesystem::path & path)
+	{
+		std::error_code error;
+		auto absolute_path = std::filesystem::weakly_canonical(path, error);
+		if (error)
+			return path;
+
+		return absolute_path;
+	}
+} // namespace
+
+std::string to_utf8_string(const std::filesystem::path & path)
+{
+	const u8string path_utf8 = path.u8string();
+	return std::string(path_utf8.begin(), path_utf8.end());
+}
+
+GameSession::GameSession(MediaBackend & media_, GameView & view_, Options options_)
+	: media(media_)
+	, view(view_)
+	, options(std::move(options_))
+	, cache(options.scene_cache_budget)
+{
+	if (!options.locate_video)
+	{
+		options.locate_video = [video_directory = options.video_directory](const std::string_view youtube_id)
+		{
+			return to_utf8_string(find_path_with_youtube_id(youtube_id, video_directory, ".mp4"));
+		};
+	}
+}
+
+bool GameSession::load_scene(const std::filesystem::path & annotations_file, const clock::time_point now, const SceneTransition transition)
+{
+	if (options.recorder != nullptr)
+		options.recorder->record_load_scene(to_utf8_string(annotations_file), static_cast<std::int64_t>(transition), now);
+
+	return change_scene(annotations_file, now, transition);
+}
+
+bool GameSession::change_scene(const std::filesystem::path & annotations_file, const clock::time_point now, const SceneTransition transition)
+{
+	const TraceSpan span("GameSession::change_scene");
+
+	view.on_scene_changing();
+
+	if (!current_scene_key.empty())
+	{
+		if (transition == SceneTransition::forward)
+		{
+			if (history.size() >= max_scene_history)
+				history.erase(history.begin());
+
+			history.push_back({ current_scene_key, video_clock.position(now) });
+		}
+
+		store_current_scene();
+	}
+
+	moving_annotations_shown.clear();
+	reported_duration = microseconds(0);
+
+	std::string key = to_utf8_string(annotations_file);
+	if (std::optional<Scene> cached_scene = cache.take(key); cached_scene.has_value())
+	{
+		scene = std::move(*cached_scene);
+		scene.timeline.reset();
+	}
+	else if (!read_scene(annotations_file))
+	{
+		scene = Scene();
+		return false;
+	}
+
+	current_scene_key = std::move(key);
+
+	// Nothing is visible yet, so there is nothing to move
+	(void)scene.layout.update(viewport_width, viewport_height, scene.video_width, scene.video_height, scene.motion_paths);
+	view.on_scene_loaded();
+
+	microseconds start_position(0);
+	if (transition == SceneTransition::back && !history.empty())
+	{
+		start_position = history.back().position;
+		history.pop_back();
+	}
+
+	media.set_media(scene.video_url);
+
+	// The clock only jumps to the saved position once the player is really going there
+	video_clock.reset(microseconds(0), now);
+	if (start_position > microseconds(0) && media.seek(start_position))
+		on_seek_issued(start_position, now);
+
+	media.play();
+
+	return true;
+}
+
+bool GameSession::go_back(const clock::time_point now)
+{
+	record(SessionEvent::Type::go_back, now);
+
+	if (history.empty())
+		return false;
+
+	// Copied, the entry is removed while loading
+	const std::string previous_scene_key = history.back().scene_key;
+	return change_scene(std::filesystem::u8path(previous_scene_key), now, SceneTransition::back);
+}
+
+bool GameSession::activate_annotation(const int annotation_index, const clock::time_point now)
+{
+	assert(annotation_index >= 0 && annotation_index < static_cast<int>(scene.annotations.size()));
+	record(SessionEvent::Type::activate_annotation, now, annotation_index);
+
+	const Annotation & annotation = scene.annotations[static_cast<std::size_t>(annotation_index)];
+	if (annotation.type != Annotation::Type::gameplay)
+		return false;
+
+	const std::optional<std::string_view> youtube_id = youtube_video_id_from_url(annotation.click_url);
+	if (!youtube_id.has_value())
+	{
+		view.report_error("Failed to get video ID from annotation", "Failed to get the destintation youtube video ID from the URL (\"" + annotation.click_url + "\") of the annotation \"" + annotation.id + "\" (text = \"" + std::string(annotation.text.begin(), annotation.text.end()) + "\")");
+		return false;
+	}
+
+	const auto path = find_path_with_youtube_id(*youtube_id, options.annotations_directory, annotation_file_extension);
+	if (path.empty())
+	{
+		view.report_error("Annotation file not found", "No annotation file was found for the youtube ID \"" + std::string(*youtube_id) + "\" in directory \"" + to_utf8_string(options.annotations_directory) + '"');
+		return false;
+	}
+
+	return change_scene(path, now, SceneTransition::forward);
+}
+
+std::optional<GameSession::clock::time_point> GameSession::update(const clock::time_point now)
+{
+	record(SessionEvent::Type::update, now);
+
+	const microseconds position = video_clock.position(now);
+
+	annotation_changes.clear();
+	const bool continuous_playback = scene.timeline.advance(position, annotation_changes);
+
+	for (const AnnotationTimeline::Change & change : annotation_changes)
+	{
+		if (continuous_playback)
+		{
+			const microseconds skew = position - change.scheduled_time;
+			timing_skew.record(skew, video_clock.frame_duration());
+			if (options.annotation_skew != nullptr)
+				options.annotation_skew->record(std::chrono::abs(skew));
+		}
+
+		set_annotation_visible(change.annotation_index, change.visible, position);
+	}
+
+	// Moving annotations are only repositioned while they are visible, all of them in one pass
+	if (!moving_annotations_shown.empty())
+	{
+		scene.layout.geometry(scene.motion_paths, position, moving_annotations_shown, moving_annotation_rects);
+
+		const std::size_t moving_size = moving_annotations_shown.size();
+		for (std::size_t i = 0; i < moving_size; ++i)
+			view.show_annotation(moving_annotations_shown[i], moving_annotation_rects[i]);
+	}
+
+	// Right when the next annotation has to be shown/hidden. While something is moving, also once per frame
+	std::optional<microseconds> next_update_time = scene.timeline.next_event_time();
+	if (!moving_annotations_shown.empty())
+	{
+		const microseconds next_frame_time = position + video_clock.frame_duration();
+		if (!next_update_time.has_value() || next_frame_time < *next_update_time)
+			next_update_time = next_frame_time;
+	}
+
+	if (!video_clock.is_playing() || !next_update_time.has_value())
+		return std::nullopt;
+
+	return now + std::max(*next_update_time - position, microseconds(0));
+}
+
+void GameSession::set_viewport_size(const int width, const int height, const clock::time_point now)
+{
+	record(SessionEvent::Type::viewport_size, now, width, height);
+
+	viewport_width = width;
+	viewport_height = height;
+	update_layout(now);
+}
+
+void GameSession::set_video_resolution(const int width, const int height, const clock::time_point now)
+{
+	record(SessionEvent::Type::video_resolution, now, width, height);
+
+	scene.video_width = width;
+	scene.video_height = height;
+	update_layout(now);
+}
+
+void GameSession::on_frame(const microseconds presentation_time, const clock::time_point now)
+{
+	record(SessionEvent::Type::frame, now, presentation_time.count());
+	video_clock.on_frame(presentation_time, now);
+}
+
+void GameSession::on_position_reported(const microseconds position, const clock::time_point now)
+{
+	record(SessionEvent::Type::position, now, position.count());
+	video_clock.on_position_reported(position, now);
+}
+
+void GameSession::on_playing_changed(const bool playing, const clock::time_point now)
+{
+	record(SessionEvent::Type::playing, now, playing ? 1 : 0);
+	video_clock.set_playing(playing, now);
+}
+
+void GameSession::on_duration_reported(const microseconds duration, const clock::time_point now)
+{
+	record(SessionEvent::Type::duration, now, duration.count());
+	reported_duration = duration;
+}
+
+void GameSession::on_seek_issued(const microseconds position, const clock::time_point now)
+{
+	record(SessionEvent::Type::seek_issued, now, position.count());
+	video_clock.reset(position, now);
+}
+
+void GameSession::on_end_of_media(const clock::time_point now)
+{
+	record(SessionEvent::Type::end_of_media, now);
+
+	const microseconds end = (duration() > microseconds(0)) ? duration() : video_clock.position(now);
+	const microseconds loop_start = std::max(microseconds(0), end - loop_length);
+
+	media.loop_to(loop_start);
+
+	// Backwards jump: the timeline recomputes which annotations are visible, and the ones visible
+	// both at the end and at the loop point stay as they are
+	video_clock.reset(loop_start, now);
+	video_clock.set_playing(true, now);
+}
+
+PixelRect GameSession::annotation_geometry(const int annotation_index, const microseconds time) const noexcept
+{
+	return scene.layout.geometry(scene.motion_paths, annotation_index, time);
+}
+
+GameSession::microseconds GameSession::duration() const noexcept
+{
+	return (scene.video_info.duration > microseconds(0)) ? scene.video_info.duration : reported_duration;
+}
+
+bool GameSession::read_scene(const std::filesystem::path & annotations_file)
+{
+	scene = Scene();
+
+	const std::string annotations_file_utf8 = to_utf8_string(annotations_file);
+
+	const auto parse_start = std::chrono::steady_clock::now();
+	ParseAnnotationsResult parse_result = parse_annotations(annotations_file_utf8.c_str());
+	if (options.annotation_parse_time != nullptr)
+		options.annotation_parse_time->record(std::chrono::duration_cast<microseconds>(std::chrono::steady_clock::now() - parse_start));
+
+	if (parse_result.error != ParseAnnotationsError::success)
+	{
+		view.report_error("Failed to parse annotations", "Error when parsing annotation file \"" + annotations_file_utf8 + "\".\n\nError: " + parse_result.error_string);
+		return false;
+	}
+
+	scene.annotations = std::move(parse_result.annotations);
+	scene.timeline = AnnotationTimeline(scene.annotations);
+	scene.motion_paths = MotionPaths(scene.annotations);
+
+	const std::optional<std::string> youtube_id = path_to_youtube_video_id(annotations_file, annotation_file_extension);
+	if (!youtube_id.has_value())
+	{
+		view.report_error("Invalid annotations filename", "Failed to extract youtube video ID from the annotations file: \"" + to_utf8_string(absolute_path_for_errors(annotations_file)) + '"');
+		return false;
+	}
+
+	scene.video_url = options.locate_video(*youtube_id);
+	if (scene.video_url.empty())
+	{
+		view.report_error("URL/path for video not found", "Cannot find URL/path of video for the annotations file: \"" + to_utf8_string(absolute_path_for_errors(annotations_file)) + "\".\n\nYoutube video ID: " + *youtube_id);
+		return false;
+	}
+
+	// Known before the media backend opens the file
+	const std::filesystem::path video_path = std::filesystem::u8path(scene.video_url);
+	if (std::error_code error; std::filesystem::is_regular_file(video_path, error))
+	{
+		if (Mp4ParseResult mp4_result = read_mp4_file(video_path); mp4_result.error == Mp4Error::success)
+			scene.video_info = std::move(mp4_result.info);
+		else
+			log_event<LogLevel::warning>("Failed to read the MP4 boxes of the video. Error: {}", mp4_result.error);
+	}
+
+	if (scene.video_info.frame_duration > microseconds(0))
+		scene.timeline.snap_to_frame_grid(scene.video_info.frame_duration);
+
+	return true;
+}
+
+void GameSession::record(const SessionEvent::Type type, const clock::time_point now, const std::int64_t value, const std::int64_t second_value)
+{
+	if (options.recorder != nullptr)
+		options.recorder->record(type, now, value, second_value);
+}
+
+void GameSession::store_current_scene()
+{
+	cache.insert(current_scene_key, std::move(scene));
+	scene = Scene();
+	current_scene_key.clear();
+}
+
+void GameSession::set_annotation_visible(const int annotation_index, const bool visible, const microseconds position)
+{
+	assert(annotation_index >= 0 && annotation_index < static_cast<int>(scene.annotations.size()));
+
+	if (scene.motion_paths.is_moving(annotation_index))
+	{
+		const auto moving_it = std::find(moving_annotations_shown.begin(), moving_annotations_shown.end(), annotation_index);
+		if (visible && moving_it == moving_annotations_shown.end())
+			moving_annotations_shown.push_back(annotation_index);
+		else if (!visible && moving_it != moving_annotations_shown.end())
+			moving_annotations_shown.erase(moving_it);
+	}
+
+	if (visible)
+		view.show_annotation(annotation_index, annotation_geometry(annotation_index, position));
+	else
+		view.hide_annotation(annotation_index);
+}
+
+void GameSession::update_layout(const clock::time_point now)
+{
+	if (!scene.layout.update(viewport_width, viewport_height, scene.video_width, scene.video_height, scene.motion_paths))
+		return;
+
+	// Only the annotations already on screen have to be moved, the rest get their geometry when shown
+	const microseconds position = video_clock.position(now);
+	const auto annotations_size = static_cast<int>(scene.timeline.size());
+	for (int i = 0; i < annotations_size; ++i)
+	{
+		if (scene.timeline.is_visible(i))
+			view.show_annotation(i, annotation_geometry(i, position));
+	}
+
+	view.on_layout_changed();
+}
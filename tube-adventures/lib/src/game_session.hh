@@ -0,0 +1,198 @@
+#pragma once
+
+#include "annotations.hh"
+#include "annotation_layout.hh"
+#include "annotation_timeline.hh"
+#include "metrics.hh"
+#include "motion_path.hh"
+#include "mp4_index.hh"
+#include "scene_cache.hh"
+#include "session_recording.hh"
+#include "video_clock.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Like the scene keys and the paths given to the media backend
+[[nodiscard]] std::string to_utf8_string(const std::filesystem::path & path);
+
+// Plays the videos of the game. QMediaPlayer in the window, something that only keeps the state in headless runs
+class MediaBackend
+{
+public:
+	virtual ~MediaBackend() = default;
+
+	// Local path or URL, UTF-8
+	virtual void set_media(const std::string & location) = 0;
+	virtual void play() = 0;
+
+	// Returns false if the media isn't loaded yet. Then it seeks once it is, and tells
+	// GameSession::on_seek_issued
+	[[nodiscard]] virtual bool seek(VideoClock::microseconds position) = 0;
+
+	// The end of the video was reached and it has to keep playing from `position`
+	virtual void loop_to(VideoClock::microseconds position) = 0;
+};
+
+// Shows the annotations of the game and its errors
+class GameView
+{
+public:
+	virtual ~GameView() = default;
+
+	// Before loading another scene. The annotations of the previous one are all gone
+	virtual void on_scene_changing() = 0;
+
+	// Before the media of the scene starts playing
+	virtual void on_scene_loaded() = 0;
+
+	// Also used to move annotations that are already shown
+	virtual void show_annotation(int annotation_index, const PixelRect & geometry) = 0;
+	virtual void hide_annotation(int annotation_index) = 0;
+
+	// The geometry of all the annotations changed
+	virtual void on_layout_changed() = 0;
+
+	// The game can't go on
+	virtual void report_error(std::string_view title, std::string_view message) = 0;
+};
+
+// Where the files of the game are and what is recorded while playing
+struct GameSessionOptions
+{
+	std::filesystem::path annotations_directory = "../../../data/TUBE-ADVENTURES";
+	std::filesystem::path video_directory = "../../../data/TUBE-ADVENTURES/video";
+
+	// Returns the location of the video with that youtube ID, empty if there is none. By default the
+	// .mp4 file with that ID in video_directory
+	std::function<std::string(std::string_view youtube_id)> locate_video;
+
+	std::size_t scene_cache_budget = SceneCache::default_memory_budget;
+
+	// Recorded if not null
+	LatencyHistogram * annotation_parse_time = nullptr;
+	LatencyHistogram * annotation_skew = nullptr;
+
+	// Everything the session is told is recorded, if not null. Enough to replay it without the window
+	SessionRecorder * recorder = nullptr;
+};
+
+// The rules of the game, without any widget or player: which annotations are visible and where, which scene
+// an annotation leads to, going back to the previous scene and looping the end of the videos.
+// Time is always passed in, so it can run with a virtual clock (faster than real time)
+class GameSession
+{
+public:
+	using clock = VideoClock::clock;
+	using microseconds = VideoClock::microseconds;
+
+	enum class SceneTransition
+	{
+		forward, // The current scene is added to the history
+		back, // Resumes from where the scene was left
+	};
+
+	// Older entries are forgotten
+	static constexpr std::size_t max_scene_history = 256;
+
+	// How much of the end of a video is repeated while waiting for the player to choose
+	static constexpr microseconds loop_length{ 3'000'000 };
+
+	using Options = GameSessionOptions;
+
+	GameSession(MediaBackend & media, GameView & view, Options options = {});
+
+	GameSession(const GameSession &) = delete;
+	GameSession & operator=(const GameSession &) = delete;
+
+	// Returns false if it failed (the error is reported to the view)
+	bool load_scene(const std::filesystem::path & annotations_file, clock::time_point now, SceneTransition transition = SceneTransition::forward);
+
+	// Returns false if there is no previous scene or it failed to load
+	bool go_back(clock::time_point now);
+
+	// Returns true if the annotation leads to another scene, and it was loaded
+	bool activate_annotation(int annotation_index, clock::time_point now);
+
+	// Shows, hides and moves the annotations for the current position.
+	// Returns when it has to be called again, if nothing else happens before
+	std::optional<clock::time_point> update(clock::time_point now);
+
+	void set_viewport_size(int width, int height, clock::time_point now);
+	void set_video_resolution(int width, int height, clock::time_point now);
+
+	// Reported by the media backend
+	void on_frame(microseconds presentation_time, clock::time_point now);
+	void on_position_reported(microseconds position, clock::time_point now);
+	void on_playing_changed(bool playing, clock::time_point now);
+	void on_duration_reported(microseconds duration, clock::time_point now);
+	void on_end_of_media(clock::time_point now);
+
+	// A seek the session asked for was done. Told by the media backend if it had to wait for the media to load
+	void on_seek_issued(microseconds position, clock::time_point now);
+
+	[[nodiscard]] const std::vector<Annotation> & annotations() const noexcept { return scene.annotations; }
+	[[nodiscard]] PixelRect annotation_geometry(int annotation_index, microseconds time) const noexcept;
+	[[nodiscard]] bool is_annotation_visible(int annotation_index) const noexcept { return scene.timeline.is_visible(annotation_index); }
+
+	[[nodiscard]] microseconds position(clock::time_point now) const noexcept { return video_clock.position(now); }
+	[[nodiscard]] bool is_playing() const noexcept { return video_clock.is_playing(); }
+
+	// 0 if unknown
+	[[nodiscard]] microseconds duration() const noexcept;
+	[[nodiscard]] const Mp4VideoInfo & video_info() const noexcept { return scene.video_info; }
+	[[nodiscard]] int video_width() const noexcept { return scene.video_width; }
+	[[nodiscard]] int video_height() const noexcept { return scene.video_height; }
+
+	// Where the video is shown in the viewport, without the bars around it
+	[[nodiscard]] const PixelRect & video_rect() const noexcept { return scene.layout.video_rect(); }
+
+	// Empty if nothing is being played
+	[[nodiscard]] const std::string & scene_key() const noexcept { return current_scene_key; }
+	[[nodiscard]] const std::string & video_location() const noexcept { return scene.video_url; }
+	[[nodiscard]] std::size_t history_size() const noexcept { return history.size(); }
+
+	[[nodiscard]] const SceneCache & scene_cache() const noexcept { return cache; }
+	[[nodiscard]] const AnnotationTimingSkew & annotation_timing_skew() const noexcept { return timing_skew; }
+
+private:
+	struct HistoryEntry
+	{
+		std::string scene_key; // UTF-8 path of the annotations file
+		microseconds position;
+	};
+
+	bool change_scene(const std::filesystem::path & annotations_file, clock::time_point now, SceneTransition transition);
+	[[nodiscard]] bool read_scene(const std::filesystem::path & annotations_file);
+	void record(SessionEvent::Type type, clock::time_point now, std::int64_t value = 0, std::int64_t second_value = 0);
+	void store_current_scene();
+	void set_annotation_visible(int annotation_index, bool visible, microseconds position);
+	void update_layout(clock::time_point now);
+
+	MediaBackend & media;
+	GameView & view;
+	Options options;
+
+	Scene scene; // The one being played
+	std::string current_scene_key;
+	std::vector<HistoryEntry> history; // Most recent last
+	SceneCache cache;
+
+	VideoClock video_clock;
+	microseconds reported_duration{ 0 };
+
+	std::vector<AnnotationTimeline::Change> annotation_changes; // Reused between updates
+	AnnotationTimingSkew timing_skew;
+
+	std::vector<int> moving_annotations_shown; // Visible annotations whose geometry changes over time
+	std::vector<PixelRect> moving_annotation_rects; // Reused between updates
+
+	int viewport_width = 0;
+	int viewport_height = 0;
+};
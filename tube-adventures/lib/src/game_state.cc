@@ -0,0 +1,654 @@
+#include "game_state.hh"
+#include "trace.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <utility>
+
+namespace
+{
+	using Variable = GameState::Variable;
+
+	constexpr unsigned widths[GameState::variable_count] = { 3, 4, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 };
+	constexpr unsigned max_values[GameState::variable_count] = { 7, 10, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2 };
+
+	[[nodiscard]] constexpr unsigned shift(const std::size_t variable) noexcept
+	{
+		unsigned result = 0;
+		for (std::size_t i = 0; i < variable; ++i)
+			result += widths[i];
+
+		return result;
+	}
+
+	static_assert(shift(GameState::variable_count) <= 32, "The state doesn't fit in 32 bits");
+
+	[[nodiscard]] constexpr std::size_t index(const Variable variable) noexcept
+	{
+		return static_cast<std::size_t>(variable);
+	}
+
+	[[nodiscard]] constexpr char to_upper(const char c) noexcept
+	{
+		return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+	}
+
+	// The tag is in upper case
+	[[nodiscard]] bool is(const std::string_view word, const std::string_view tag) noexcept
+	{
+		return word.size() == tag.size() && std::equal(word.begin(), word.end(), tag.begin(), [](const char lhs, const char rhs) { return to_upper(lhs) == rhs; });
+	}
+
+	[[nodiscard]] bool starts_with(const std::string_view word, const std::string_view prefix) noexcept
+	{
+		return word.size() >= prefix.size() && is(word.substr(0, prefix.size()), prefix);
+	}
+
+	// The flags that can also be written with "NO" in front ("NOALC", "NO_ALC")
+	struct Flag
+	{
+		std::string_view name;
+		Variable variable;
+	};
+
+	constexpr Flag flags[] = {
+		{ "LECHE", Variable::leche },
+		{ "ALC", Variable::alc },
+		{ "G+", Variable::g_plus },
+		{ "PIC", Variable::pic },
+		{ "FURIA", Variable::fury },
+		{ "IRA", Variable::fury },
+		{ "FURY", Variable::fury },
+	};
+
+	[[nodiscard]] std::optional<Variable> flag(const std::string_view word) noexcept
+	{
+		for (const Flag & candidate : flags)
+		{
+			if (is(word, candidate.name))
+				return candidate.variable;
+		}
+
+		return std::nullopt;
+	}
+
+	constexpr std::string_view key_values[] = { "0", "3", "E", "EA", "ES", "ENT" };
+
+	// Fills the state, and the next one once a variable is repeated
+	class TagParser
+	{
+	public:
+		// False if any of the words isn't a tag
+		[[nodiscard]] bool parse(const std::vector<std::string_view> & words)
+		{
+			for (std::size_t i = 0; i < words.size(); ++i)
+			{
+				if (!parse_word(words, i))
+					return false;
+			}
+
+			return true;
+		}
+
+		void finish(SceneVariant & variant) const
+		{
+			variant.state = state;
+			if (in_next_state)
+				variant.next_state = next_state;
+		}
+
+	private:
+		void set(const Variable variable, const unsigned value) noexcept
+		{
+			if (!in_next_state && state.has(variable))
+				in_next_state = true;
+
+			(in_next_state ? next_state : state).set(variable, value);
+		}
+
+		[[nodiscard]] static const std::string_view * next(const std::vector<std::string_view> & words, const std::size_t i) noexcept
+		{
+			return i + 1 < words.size() ? &words[i + 1] : nullptr;
+		}
+
+		// Can consume the words after it (increasing i)
+		[[nodiscard]] bool parse_word(const std::vector<std::string_view> & words, std::size_t & i)
+		{
+			const std::string_view word = words[i];
+			const std::string_view * const following = next(words, i);
+
+			if (starts_with(word, "K="))
+				return parse_keys(word.substr(2));
+
+			if ((starts_with(word, "P=") || starts_with(word, "F=")) && word.size() == 3 && word[2] >= '0' && word[2] <= '3')
+			{
+				const unsigned level = static_cast<unsigned>(word[2] - '0');
+				if (to_upper(word[0]) == 'P')
+				{
+					if (level == 0)
+						return false;
+
+					set(Variable::level, GameState::level_p1 + level - 1);
+				}
+				else
+				{
+					set(Variable::level, GameState::level_f0 + level);
+				}
+
+				return true;
+			}
+
+			if (is(word, "P") || is(word, "F"))
+			{
+				set(Variable::level, is(word, "P") ? GameState::level_p : GameState::level_f);
+				return true;
+			}
+
+			// "F=0 a F=1", from one state to the next
+			if (is(word, "A"))
+			{
+				if (in_next_state || state.packed() == 0)
+					return false;
+
+				in_next_state = true;
+				return true;
+			}
+
+			if (is(word, "NONE"))
+			{
+				set(Variable::level, GameState::level_none);
+				return true;
+			}
+
+			if (is(word, "NOKEYS"))
+			{
+				set(Variable::keys, GameState::no_keys);
+				return true;
+			}
+
+			if (is(word, "SW=0") || is(word, "SW=1"))
+			{
+				set(Variable::switch_on, word[3] == '1' ? GameState::yes : GameState::no);
+				return true;
+			}
+
+			if (is(word, "ALC=ON") || is(word, "ALC=OFF"))
+			{
+				set(Variable::alc, is(word, "ALC=ON") ? GameState::yes : GameState::no);
+				return true;
+			}
+
+			if (is(word, "OK") || is(word, "FAIL"))
+			{
+				set(Variable::outcome, is(word, "OK") ? GameState::yes : GameState::no);
+				return true;
+			}
+
+			if (is(word, "NOITEM") || is(word, "NOITEMS"))
+			{
+				set(Variable::items, GameState::no_items);
+				return true;
+			}
+
+			if (is(word, "ITEM") || is(word, "ITEMS"))
+			{
+				set(Variable::items, GameState::some_items);
+				return true;
+			}
+
+			if (is(word, "ALLITEM") || is(word, "ALLITEMS") || is(word, "ALL"))
+			{
+				if (is(word, "ALL") && following != nullptr && (is(*following, "ITEM") || is(*following, "ITEMS")))
+					++i;
+
+				set(Variable::items, GameState::all_items);
+				return true;
+			}
+
+			// "Paco visited", "Mel no visited"
+			if (is(word, "PACO") || is(word, "MEL"))
+			{
+				const bool visited = following != nullptr && is(*following, "VISITED");
+				const bool not_visited = following != nullptr && is(*following, "NO") && i + 2 < words.size() && is(words[i + 2], "VISITED");
+				if (!visited && !not_visited)
+					return false;
+
+				set(is(word, "PACO") ? Variable::paco_visited : Variable::mel_visited, visited ? GameState::yes : GameState::no);
+				i += visited ? 1 : 2;
+				return true;
+			}
+
+			// "NO ITEMS", "NO ALC"
+			if (is(word, "NO") && following != nullptr)
+			{
+				if (is(*following, "ITEM") || is(*following, "ITEMS"))
+				{
+					set(Variable::items, GameState::no_items);
+					++i;
+					return true;
+				}
+
+				if (const std::optional<Variable> variable = flag(*following); variable.has_value())
+				{
+					set(*variable, GameState::no);
+					++i;
+					return true;
+				}
+
+				return false;
+			}
+
+			if (starts_with(word, "NO"))
+			{
+				if (const std::optional<Variable> variable = flag(word.substr(2)); variable.has_value())
+				{
+					set(*variable, GameState::no);
+					return true;
+				}
+			}
+
+			if (const std::optional<Variable> variable = flag(word); variable.has_value())
+			{
+				set(*variable, GameState::yes);
+
+				// "ALC ON"
+				if (*variable == Variable::alc && following != nullptr && is(*following, "ON"))
+					++i;
+
+				return true;
+			}
+
+			// "LECHE+ALC"
+			if (const std::size_t plus = word.find('+'); plus != std::string_view::npos && plus > 0 && plus + 1 < word.size())
+			{
+				const std::optional<Variable> first = flag(word.substr(0, plus));
+				const std::optional<Variable> second = flag(word.substr(plus + 1));
+				if (!first.has_value() || !second.has_value())
+					return false;
+
+				set(*first, GameState::yes);
+				set(*second, GameState::yes);
+				return true;
+			}
+
+			return false;
+		}
+
+		// "EA", "ENT,ALC"
+		[[nodiscard]] bool parse_keys(std::string_view value)
+		{
+			bool alc = false;
+			if (const std::size_t comma = value.find(','); comma != std::string_view::npos)
+			{
+				if (!is(value.substr(comma + 1), "ALC"))
+					return false;
+
+				alc = true;
+				value = value.substr(0, comma);
+			}
+
+			const auto found = std::find_if(std::begin(key_values), std::end(key_values), [value](const std::string_view key_value) { return is(value, key_value); });
+			if (found == std::end(key_values))
+				return false;
+
+			set(Variable::keys, GameState::keys_0 + static_cast<unsigned>(found - std::begin(key_values)));
+			if (alc)
+				set(Variable::alc, GameState::yes);
+
+			return true;
+		}
+
+		GameState state;
+		GameState next_state;
+		bool in_next_state = false;
+	};
+
+	// Words of the name, with the ones in parentheses together
+	struct Token
+	{
+		std::string_view text; // With the parentheses
+		bool parenthesized;
+
+		[[nodiscard]] std::string_view content() const noexcept { return parenthesized ? text.substr(1, text.size() - 2) : text; }
+	};
+
+	[[nodiscard]] std::vector<Token> tokenize(const std::string_view name)
+	{
+		std::vector<Token> tokens;
+
+		std::size_t i = 0;
+		while (i < name.size())
+		{
+			if (name[i] == ' ')
+			{
+				++i;
+				continue;
+			}
+
+			std::size_t end = name.find(' ', i);
+			if (name[i] == '(')
+			{
+				const std::size_t closing = name.find(')', i);
+				if (closing != std::string_view::npos && (closing + 1 == name.size() || name[closing + 1] == ' '))
+				{
+					tokens.push_back({ name.substr(i, closing + 1 - i), true });
+					i = closing + 1;
+					continue;
+				}
+			}
+
+			if (end == std::string_view::npos)
+				end = name.size();
+
+			tokens.push_back({ name.substr(i, end - i), false });
+			i = end;
+		}
+
+		return tokens;
+	}
+
+	// Split on spaces and underscores
+	void append_words(std::vector<std::string_view> & words, const std::string_view text)
+	{
+		std::size_t start = 0;
+		for (std::size_t i = 0; i <= text.size(); ++i)
+		{
+			if (i == text.size() || text[i] == ' ' || text[i] == '_')
+			{
+				if (i > start)
+					words.push_back(text.substr(start, i - start));
+
+				start = i + 1;
+			}
+		}
+	}
+
+	[[nodiscard]] bool parses(const std::string_view text)
+	{
+		std::vector<std::string_view> words;
+		append_words(words, text);
+
+		TagParser parser;
+		return !words.empty() && parser.parse(words);
+	}
+
+	[[nodiscard]] std::string utf8_stem(const std::filesystem::path & path)
+	{
+		const u8string stem = path.stem().u8string();
+		return std::string(stem.begin(), stem.end());
+	}
+
+	// Lower case words that happen to be tags ("final furia", "cap final ira") are part of the name, unless there are
+	// upper case tags before them
+	[[nodiscard]] bool can_start_tags(const Token & token) noexcept
+	{
+		return token.parenthesized || token.text.find('=') != std::string_view::npos
+			|| std::none_of(token.text.begin(), token.text.end(), [](const char c) { return c >= 'a' && c <= 'z'; });
+	}
+
+	// Single words in parentheses that aren't tags, like "(D)" or "(promo)". Dropped at the end of the name
+	[[nodiscard]] bool is_note(const Token & token) noexcept
+	{
+		return token.parenthesized && token.content().find_first_of(" =") == std::string_view::npos;
+	}
+} // namespace
+
+unsigned GameState::max_value(const Variable variable) noexcept
+{
+	return max_values[index(variable)];
+}
+
+unsigned GameState::get(const Variable variable) const noexcept
+{
+	return (bits >> shift(index(variable))) & ((1u << widths[index(variable)]) - 1);
+}
+
+void GameState::set(const Variable variable, const unsigned value) noexcept
+{
+	assert(value <= max_value(variable));
+	bits = (bits & ~mask(variable)) | (value << shift(index(variable)));
+}
+
+GameState GameState::from_packed(const std::uint32_t packed) noexcept
+{
+	GameState state;
+	state.bits = packed;
+	return state;
+}
+
+std::uint32_t GameState::mask() const noexcept
+{
+	std::uint32_t result = 0;
+	for (std::size_t i = 0; i < variable_count; ++i)
+	{
+		if (has(static_cast<Variable>(i)))
+			result |= mask(static_cast<Variable>(i));
+	}
+
+	return result;
+}
+
+std::uint32_t GameState::mask(const Variable variable) noexcept
+{
+	return ((1u << widths[index(variable)]) - 1) << shift(index(variable));
+}
+
+std::string GameState::to_string() const
+{
+	static constexpr std::string_view keys[] = { "NOKEYS", "K=0", "K=3", "K=E", "K=EA", "K=ES", "K=ENT" };
+	static constexpr std::string_view levels[] = { "NONE", "P", "P=1", "P=2", "P=3", "F", "F=0", "F=1", "F=2", "F=3" };
+	static constexpr std::string_view items[] = { "NOITEM", "ITEM", "ALLITEMS" };
+
+	// The "no" and "yes" names of the rest, in order
+	static constexpr std::string_view flag_names[][2] = {
+		{ "NOLECHE", "LECHE" },
+		{ "NOALC", "ALC" },
+		{ "NOG+", "G+" },
+		{ "NOPIC", "PIC" },
+		{ "NOFURY", "FURIA" },
+		{ "SW=0", "SW=1" },
+		{ "FAIL", "OK" },
+		{ "(Paco no visited)", "(Paco visited)" },
+		{ "(Mel no visited)", "(Mel visited)" },
+	};
+
+	std::string text;
+	const auto append = [&text](const std::string_view name)
+	{
+		if (!text.empty())
+			text += ' ';
+		text += name;
+	};
+
+	if (has(Variable::keys))
+		append(keys[get(Variable::keys) - 1]);
+	if (has(Variable::level))
+		append(levels[get(Variable::level) - 1]);
+	if (has(Variable::items))
+		append(items[get(Variable::items) - 1]);
+
+	for (std::size_t i = index(Variable::leche); i < variable_count; ++i)
+	{
+		if (const unsigned value = get(static_cast<Variable>(i)); value != 0)
+			append(flag_names[i - index(Variable::leche)][value - 1]);
+	}
+
+	return text;
+}
+
+SceneVariant parse_scene_variant(std::string_view name)
+{
+	// Some were uploaded with the extension of the video in the title
+	if (name.size() > 4 && is(name.substr(name.size() - 4), ".MP4"))
+		name.remove_suffix(4);
+
+	const std::vector<Token> tokens = tokenize(name);
+
+	// The tags at the end: the longest run of tokens that are all tags (or notes), leaving at least one for the scene
+	std::size_t tags_start = tokens.size();
+	for (std::size_t start = 1; start < tokens.size(); ++start)
+	{
+		if (!can_start_tags(tokens[start]))
+			continue;
+
+		std::vector<std::string_view> words;
+		for (std::size_t i = start; i < tokens.size(); ++i)
+		{
+			if (!is_note(tokens[i]) || parses(tokens[i].content()))
+				append_words(words, tokens[i].content());
+		}
+
+		TagParser parser;
+		if (parser.parse(words))
+		{
+			tags_start = start;
+			break;
+		}
+	}
+
+	// Tags in parentheses before them, in order, then the ones at the end
+	std::vector<std::string_view> words;
+	std::string scene;
+	for (std::size_t i = 0; i < tags_start; ++i)
+	{
+		if (tokens[i].parenthesized && parses(tokens[i].content()))
+		{
+			append_words(words, tokens[i].content());
+			continue;
+		}
+
+		if (!scene.empty())
+			scene += ' ';
+		scene += tokens[i].text;
+	}
+
+	for (std::size_t i = tags_start; i < tokens.size(); ++i)
+	{
+		if (!is_note(tokens[i]) || parses(tokens[i].content()))
+			append_words(words, tokens[i].content());
+	}
+
+	SceneVariant variant;
+	variant.scene = std::move(scene);
+
+	TagParser parser;
+	[[maybe_unused]] const bool parsed = parser.parse(words);
+	assert(parsed);
+	parser.finish(variant);
+
+	return variant;
+}
+
+std::optional<SceneVariant> scene_variant_from_path(const std::filesystem::path & annotations_path)
+{
+	if (!path_to_youtube_video_id(annotations_path, annotations_path.extension()).has_value())
+		return std::nullopt;
+
+	// "<name> <youtube ID>"
+	const std::string stem = utf8_stem(annotations_path);
+	return parse_scene_variant(std::string_view(stem).substr(0, stem.size() - youtube_video_id_length - 1));
+}
+
+std::size_t SceneStateIndex::KeyHash::operator()(const Key & key) const noexcept
+{
+	const std::size_t hash = std::hash<std::string_view>()(key.scene);
+	return hash ^ (std::hash<std::uint32_t>()(key.state) + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+}
+
+SceneStateIndex::SceneStateIndex(const std::vector<GameScene> & scenes)
+{
+	const TraceSpan span("SceneStateIndex");
+
+	variants.reserve(scenes.size());
+	for (const GameScene & scene : scenes)
+	{
+		std::optional<SceneVariant> variant = scene_variant_from_path(scene.annotations_path);
+		variants.push_back(variant.has_value() ? std::move(*variant) : SceneVariant{ utf8_stem(scene.annotations_path), {}, std::nullopt });
+	}
+
+	for (const SceneVariant & variant : variants)
+		masks_by_scene[variant.scene] |= variant.state.mask();
+
+	// The variants that say more first, so they are found before the ones that match any value of what they don't say
+	std::vector<std::size_t> order(variants.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+
+	const auto variable_count = [this](const std::size_t i)
+	{
+		std::size_t count = 0;
+		for (std::size_t variable = 0; variable < GameState::variable_count; ++variable)
+		{
+			if (variants[i].state.has(static_cast<GameState::Variable>(variable)))
+				++count;
+		}
+
+		return count;
+	};
+
+	std::stable_sort(order.begin(), order.end(), [&variable_count](const std::size_t lhs, const std::size_t rhs) { return variable_count(lhs) > variable_count(rhs); });
+
+	std::vector<GameState::Variable> unsaid;
+	for (const std::size_t i : order)
+	{
+		const SceneVariant & variant = variants[i];
+		const std::uint32_t scene_mask = masks_by_scene[variant.scene];
+
+		const auto [existing, inserted] = scenes_by_state.emplace(Key{ variant.scene, variant.state.packed() }, i);
+		if (!inserted && variants[existing->second].state == variant.state)
+		{
+			duplicate_variants.push_back(i);
+			continue;
+		}
+
+		// Every value of the variables the other variants of the scene say and this one doesn't
+		unsaid.clear();
+		for (std::size_t variable = 0; variable < GameState::variable_count; ++variable)
+		{
+			const auto as_variable = static_cast<GameState::Variable>(variable);
+			if ((scene_mask & GameState::mask(as_variable)) != 0 && !variant.state.has(as_variable))
+				unsaid.push_back(as_variable);
+		}
+
+		std::vector<unsigned> values(unsaid.size(), 0);
+		while (true)
+		{
+			std::size_t carry = 0;
+			while (carry < unsaid.size() && values[carry] == GameState::max_value(unsaid[carry]))
+				values[carry++] = 0;
+
+			if (carry == unsaid.size())
+				break;
+
+			++values[carry];
+
+			GameState state = variant.state;
+			for (std::size_t j = 0; j < unsaid.size(); ++j)
+				state.set(unsaid[j], values[j]);
+
+			scenes_by_state.emplace(Key{ variant.scene, state.packed() }, i);
+		}
+	}
+
+	std::sort(duplicate_variants.begin(), duplicate_variants.end());
+}
+
+std::optional<std::size_t> SceneStateIndex::find(const std::string_view scene, const GameState state) const noexcept
+{
+	const auto mask = masks_by_scene.find(scene);
+	if (mask == masks_by_scene.end())
+		return std::nullopt;
+
+	const auto found = scenes_by_state.find(Key{ scene, state.packed() & mask->second });
+	if (found == scenes_by_state.end())
+		return std::nullopt;
+
+	return found->second;
+}
+
+std::uint32_t SceneStateIndex::scene_mask(const std::string_view scene) const noexcept
+{
+	const auto mask = masks_by_scene.find(scene);
+	return mask != masks_by_scene.end() ? mask->second : 0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "story_graph.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The state of the game a video is for, as TUBE-ADVENTURES 3 writes it in the names of its files, before the
+// youtube ID: "Chipriota (azul) y esperar K=EA P=1 LECHE", "Patio NONE_NO_ITEMS", "Cruce Paco entran F=0 (Paco visited)"...
+// Packed in 32 bits, a few for each variable. Zero means the name doesn't say
+class GameState
+{
+public:
+	enum class Variable : std::uint8_t
+	{
+		keys, // K=0, K=3, K=E, K=EA, K=ES, K=ENT, NOKEYS
+		level, // P=<n> or F=<n>, or NONE for neither. Just "P" or "F" if the name has no number
+		items, // NOITEM, ITEM, ALL ITEMS...
+		leche,
+		alc, // ALC, NOALC, ALC=ON, ALC=OFF...
+		g_plus, // G+
+		pic,
+		fury, // FURIA, IRA, NOFURY
+		switch_on, // SW=0, SW=1
+		outcome, // OK, FAIL
+		paco_visited, // "Paco visited", "Paco no visited"
+		mel_visited,
+	};
+
+	static constexpr std::size_t variable_count = static_cast<std::size_t>(Variable::mel_visited) + 1;
+
+	enum Keys : unsigned { no_keys = 1, keys_0, keys_3, keys_e, keys_ea, keys_es, keys_ent };
+	enum Level : unsigned { level_none = 1, level_p, level_p1, level_p2, level_p3, level_f, level_f0, level_f1, level_f2, level_f3 };
+	enum Items : unsigned { no_items = 1, some_items, all_items };
+
+	// The values of the other variables
+	static constexpr unsigned no = 1;
+	static constexpr unsigned yes = 2;
+
+	// The highest value of the variable
+	[[nodiscard]] static unsigned max_value(Variable variable) noexcept;
+
+	// Zero if the name doesn't say
+	[[nodiscard]] unsigned get(Variable variable) const noexcept;
+	void set(Variable variable, unsigned value) noexcept;
+	[[nodiscard]] bool has(Variable variable) const noexcept { return get(variable) != 0; }
+
+	[[nodiscard]] std::uint32_t packed() const noexcept { return bits; }
+	[[nodiscard]] static GameState from_packed(std::uint32_t packed) noexcept;
+
+	// All the bits of the variables that are set
+	[[nodiscard]] std::uint32_t mask() const noexcept;
+	[[nodiscard]] static std::uint32_t mask(Variable variable) noexcept;
+
+	// Every variable set in this state has the same value in the other one
+	[[nodiscard]] bool matches(GameState other) const noexcept { return (other.bits & mask()) == bits; }
+
+	// Some variable is set in both states with different values
+	[[nodiscard]] bool contradicts(GameState other) const noexcept { return ((bits ^ other.bits) & mask() & other.mask()) != 0; }
+
+	// This state with the variables set in the changes changed to their values
+	[[nodiscard]] GameState updated(GameState changes) const noexcept { return from_packed((bits & ~changes.mask()) | changes.bits); }
+
+	// Like in the names, in a fixed order: "K=EA P=1 LECHE NOALC". Empty if nothing is set
+	[[nodiscard]] std::string to_string() const;
+
+	[[nodiscard]] friend bool operator==(const GameState lhs, const GameState rhs) noexcept { return lhs.bits == rhs.bits; }
+	[[nodiscard]] friend bool operator!=(const GameState lhs, const GameState rhs) noexcept { return lhs.bits != rhs.bits; }
+
+private:
+	std::uint32_t bits = 0;
+};
+
+// The name of an annotation file split in the scene and the state its video is for
+struct SceneVariant
+{
+	std::string scene; // The name without the tags, the same for every variant of the scene
+	GameState state;
+
+	// The state the scene leaves the game in, for the names that have both: "Atrapan a Bufon K=EA NONE _ K=3 NONE",
+	// "Melisa opcion furia F=0 a F=1". Only what the name says after the change, the rest stays as it was
+	std::optional<GameState> next_state;
+};
+
+// The name is the filename without the youtube ID and the extension. The tags are read from the end of the name, from
+// parentheses anywhere in it and from its start, so "(LECHE) Entrada Old Town Norte PIC NOITEM" is the scene "Entrada
+// Old Town Norte". Other words in parentheses at the end ("(D)", "(promo)") are dropped. Case is ignored
+[[nodiscard]] SceneVariant parse_scene_variant(std::string_view name);
+
+// Empty if the file isn't named after a youtube ID
+[[nodiscard]] std::optional<SceneVariant> scene_variant_from_path(const std::filesystem::path & annotations_path);
+
+// The scene to load for a scene and a state, built once when the game is loaded so routing by state is a hash lookup
+// instead of matching filenames. Each scene only compares the variables its variants are named after, and a variant
+// that doesn't say a variable matches any value of it, unless a variant that says it matches too
+class SceneStateIndex
+{
+public:
+	SceneStateIndex() = default;
+	explicit SceneStateIndex(const std::vector<GameScene> & scenes);
+
+	// The keys refer to the names of the variants, which don't move with the index but would be copied
+	SceneStateIndex(const SceneStateIndex &) = delete;
+	SceneStateIndex & operator=(const SceneStateIndex &) = delete;
+	SceneStateIndex(SceneStateIndex &&) = default;
+	SceneStateIndex & operator=(SceneStateIndex &&) = default;
+
+	// Index in the scenes. Doesn't allocate
+	[[nodiscard]] std::optional<std::size_t> find(std::string_view scene, GameState state) const noexcept;
+
+	// Of the scene with that index
+	[[nodiscard]] const SceneVariant & variant(std::size_t scene_index) const noexcept { return variants[scene_index]; }
+
+	// Scenes, not variants
+	[[nodiscard]] std::size_t scene_count() const noexcept { return masks_by_scene.size(); }
+
+	// The bits of the variables the variants of the scene are named after. Zero if there is no such scene
+	[[nodiscard]] std::uint32_t scene_mask(std::string_view scene) const noexcept;
+
+	// Scene indices of the variants with the same scene and state as an earlier one, which are never found
+	[[nodiscard]] const std::vector<std::size_t> & duplicates() const noexcept { return duplicate_variants; }
+
+private:
+	struct Key
+	{
+		std::string_view scene;
+		std::uint32_t state;
+
+		[[nodiscard]] friend bool operator==(const Key & lhs, const Key & rhs) noexcept { return lhs.state == rhs.state && lhs.scene == rhs.scene; }
+	};
+
+	struct KeyHash
+	{
+		[[nodiscard]] std::size_t operator()(const Key & key) const noexcept;
+	};
+
+	std::vector<SceneVariant> variants; // One per scene, so the names outlive the keys
+	std::unordered_map<std::string_view, std::uint32_t> masks_by_scene;
+	std::unordered_map<Key, std::size_t, KeyHash> scenes_by_state;
+	std::vector<std::size_t> duplicate_variants;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "game_session.hh"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Plays nothing: it only keeps where the session asked the video to be. For the replays, tests and
+// benchmarks that run a GameSession without a window
+class HeadlessMedia : public MediaBackend
+{
+public:
+	void set_media(const std::string &) override
+	{
+		++media_set;
+		media_changed = true;
+		position = VideoClock::microseconds(0);
+	}
+
+	void play() override {}
+
+	bool seek(const VideoClock::microseconds position_) override
+	{
+		position = position_;
+		return loaded;
+	}
+
+	void loop_to(const VideoClock::microseconds position_) override { position = position_; }
+
+	VideoClock::microseconds position{ 0 };
+	std::uint64_t media_set = 0;
+	bool media_changed = false; // Since it was last cleared by the user
+	bool loaded = true; // If not, seeks wait for GameSession::on_seek_issued
+};
+
+// Shows nothing: it only counts what the session asks. Doesn't allocate, unless there's an on_error
+class HeadlessView : public GameView
+{
+public:
+	void on_scene_changing() override {}
+	void on_scene_loaded() override { ++scenes_loaded; }
+	void show_annotation(int, const PixelRect &) override { ++annotations_shown; }
+	void hide_annotation(int) override { ++annotations_hidden; }
+	void on_layout_changed() override {}
+
+	void report_error(const std::string_view title, const std::string_view message) override
+	{
+		++error_count;
+		if (on_error)
+			on_error(title, message);
+	}
+
+	std::function<void(std::string_view title, std::string_view message)> on_error;
+
+	std::uint64_t scenes_loaded = 0;
+	std::uint64_t annotations_shown = 0;
+	std::uint64_t annotations_hidden = 0;
+	std::uint64_t error_count = 0;
+};
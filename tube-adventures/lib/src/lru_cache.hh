@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+// Least recently used cache where every value has a cost (bytes, pixels...) and the total cost is
+// kept under a budget by evicting the least recently used values
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache
+{
+public:
+	struct Stats
+	{
+		std::int64_t hits = 0;
+		std::int64_t misses = 0;
+		std::int64_t evictions = 0;
+	};
+
+	explicit LruCache(const std::size_t budget_) noexcept
+		: cost_budget(budget_)
+	{
+	}
+
+	// Marks the value as the most recently used. The pointer is valid until the next insert, take or clear
+	[[nodiscard]] Value * find(const Key & key)
+	{
+		const auto it = entries_by_key.find(key);
+		if (it == entries_by_key.end())
+		{
+			++cache_stats.misses;
+			return nullptr;
+		}
+
+		++cache_stats.hits;
+		entries.splice(entries.begin(), entries, it->second);
+
+		return &it->second->value;
+	}
+
+	// Removes the value from the cache and returns it, if it's there
+	[[nodiscard]] std::optional<Value> take(const Key & key)
+	{
+		const auto it = entries_by_key.find(key);
+		if (it == entries_by_key.end())
+		{
+			++cache_stats.misses;
+			return std::nullopt;
+		}
+
+		++cache_stats.hits;
+
+		std::optional<Value> value = std::move(it->second->value);
+		erase(it->second);
+
+		return value;
+	}
+
+	// Replaces the value if the key is already there. Values that cost more than the whole budget aren't kept.
+	// Returns the inserted value, or nullptr if it wasn't kept
+	Value * insert(const Key & key, Value value, const std::size_t cost)
+	{
+		if (const auto it = entries_by_key.find(key); it != entries_by_key.end())
+			erase(it->second);
+
+		if (cost > cost_budget)
+			return nullptr;
+
+		while (used_cost + cost > cost_budget)
+		{
+			assert(!entries.empty());
+			erase(std::prev(entries.end()));
+			++cache_stats.evictions;
+		}
+
+		entries.push_front({ key, std::move(value), cost });
+		entries_by_key.emplace(key, entries.begin());
+		used_cost += cost;
+
+		return &entries.front().value;
+	}
+
+	[[nodiscard]] bool contains(const Key & key) const
+	{
+		return entries_by_key.find(key) != entries_by_key.end();
+	}
+
+	void clear() noexcept
+	{
+		entries.clear();
+		entries_by_key.clear();
+		used_cost = 0;
+	}
+
+	[[nodiscard]] std::size_t size() const noexcept { return entries.size(); }
+	[[nodiscard]] std::size_t cost() const noexcept { return used_cost; }
+	[[nodiscard]] std::size_t budget() const noexcept { return cost_budget; }
+	[[nodiscard]] const Stats & stats() const noexcept { return cache_stats; }
+
+private:
+	struct Entry
+	{
+		Key key;
+		Value value;
+		std::size_t cost;
+	};
+
+	using EntryList = std::list<Entry>;
+
+	void erase(const typename EntryList::iterator entry)
+	{
+		assert(used_cost >= entry->cost);
+		used_cost -= entry->cost;
+
+		entries_by_key.erase(entry->key);
+		entries.erase(entry);
+	}
+
+	EntryList entries; // Most recently used first
+	std::unordered_map<Key, typename EntryList::iterator, Hash> entries_by_key;
+
+	std::size_t cost_budget;
+	std::size_t used_cost = 0;
+	Stats cache_stats;
+};
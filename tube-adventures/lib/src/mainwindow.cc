@@ -1,12 +1,18 @@
 #include "ui_mainwindow.h"
 
 #include "mainwindow.hh"
+#include "event_log.hh"
+#include "trace.hh"
 
 #include <map>
 #include <cassert>
 
+#include <QDir>
 #include <QGuiApplication>
+#include <QScreen>
+#include <QWindow>
 #include <QMessageBox>
+#include <QMediaMetaData>
 
 using namespace std::chrono_literals;
 
@@ -14,6 +20,12 @@ namespace
 {
 	using video_position = std::chrono::duration<qint64, std::milli>;
 
+	// Used if frame timestamps are not available
+	constexpr int fallback_position_notify_interval = 40; // ms
+
+	// How often the UI activity (update passes, wakeups and CPU usage) is logged
+	constexpr std::chrono::seconds ui_activity_report_interval = 10s;
+
 	[[nodiscard]] video_position get_video_position(const QMediaPlayer & player)
 	{
 		return video_position(player.position());
@@ -23,7 +35,7 @@ namespace
 	{
 		if (!player.isSeekable())
 		{
-			qDebug() << "Can't change video position because the player is not seekable";
+			log_event<LogLevel::warning>("Can't change video position because the player is not seekable");
 		}
 
 		const auto max_position = video_position(player.duration());
@@ -32,9 +44,19 @@ namespace
 		player.setPosition(final_position.count());
 	}
 
-	void change_video_position(QMediaPlayer & player, const video_position position_change)
+	// Some backends drop a seek issued before this
+	[[nodiscard]] bool is_media_loaded(const QMediaPlayer::MediaStatus status) noexcept
 	{
-		set_video_position(player, get_video_position(player) + position_change);
+		switch (status)
+		{
+		case QMediaPlayer::MediaStatus::LoadedMedia:
+		case QMediaPlayer::MediaStatus::BufferingMedia:
+		case QMediaPlayer::MediaStatus::BufferedMedia:
+		case QMediaPlayer::MediaStatus::EndOfMedia:
+			return true;
+		default:
+			return false;
+		}
 	}
 
 	[[nodiscard]] video_position video_seek_duration()
@@ -63,27 +85,6 @@ namespace
 		std::abort();
 	}
 
-	// Returns empty path if not found
-	[[nodiscard]] std::filesystem::path find_path_with_youtube_id(const std::string_view youtube_id, const std::filesystem::path & search_directory, const std::filesystem::path & expected_extension) try
-	{
-		const auto end_it = std::filesystem::directory_iterator{};
-		const auto path_it = std::find_if(std::filesystem::directory_iterator(search_directory), end_it, [youtube_id, &expected_extension](const std::filesystem::directory_entry & entry)
-		{
-			if (const auto id = path_to_youtube_video_id(entry.path(), expected_extension); id.has_value())
-				return *id == youtube_id;
-
-			return false;
-		});
-
-		if (path_it == end_it)
-			return {};
-
-		return path_it->path();
-	}
-	catch (const std::filesystem::filesystem_error &)
-	{
-		return {};
-	}
 	
 
 	// Returns empty url if failed
@@ -169,51 +170,108 @@ namespace
 		return QUrl(QString::fromUtf8(video_url_it->second.data(), static_cast<int>(video_url_it->second.size())));
 	}
 
-	// Returns empty url if failed
-	[[nodiscard]] QUrl video_path_from_youtube_id(const std::string_view youtube_id)
+	[[nodiscard]] QRect to_qrect(const PixelRect & rect)
 	{
-		constexpr std::string_view search_directory = "../../../data/TUBE-ADVENTURES/video";
-		const auto path = find_path_with_youtube_id(youtube_id, search_directory, ".mp4");
+		return QRect(rect.x, rect.y, rect.width, rect.height);
+	}
 
-		if (path.empty())
-			return QUrl();
+	[[nodiscard]] QString to_qstring(const std::string_view utf8)
+	{
+		return QString::fromUtf8(utf8.data(), static_cast<int>(utf8.size()));
+	}
 
-		const auto path_utf8 = path.u8string();
-		return QUrl::fromLocalFile(QString::fromUtf8(path_utf8.data(), static_cast<int>(path_utf8.size())));
+	[[nodiscard]] GameSession::Options game_session_options(const MainWindowOptions & options, LatencyHistogram & annotation_parse_time, LatencyHistogram & annotation_skew, SessionRecorder * const recorder)
+	{
+		GameSession::Options session_options;
+		session_options.scene_cache_budget = options.scene_cache_budget;
+		session_options.annotation_parse_time = &annotation_parse_time;
+		session_options.annotation_skew = &annotation_skew;
+		session_options.recorder = recorder;
+		session_options.annotations_directory = options.first_scene.parent_path();
+		session_options.video_directory = options.video_directory.empty() ? session_options.annotations_directory / "video" : options.video_directory;
+
+#if false
+		// Online videos (local videos by default)
+		session_options.locate_video = [](const std::string_view youtube_id) { return video_url_from_youtube_id(youtube_id).toString().toStdString(); };
+#endif
+
+		return session_options;
 	}
 } // namespace
 
-MainWindow::MainWindow(QWidget * parent)
+MainWindow::MainWindow(const MainWindowOptions & options_, QWidget * parent)
 	: QMainWindow(parent)
 	//, ui(std::make_unique<Ui::MainWindow>())
 	, ui(new Ui::MainWindow)
+	, options(options_)
+	, seek_controller([this](const SeekController::milliseconds position) { set_video_position(*player, position); })
+	, load_to_first_frame_latency(metrics.histogram("tube_adventures_load_to_first_frame_seconds", "Time from loading a scene (usually by clicking an annotation) to its first video frame"))
+	, annotation_parse_time(metrics.histogram("tube_adventures_annotation_parse_seconds", "Time spent parsing annotation files"))
+	, annotation_skew(metrics.histogram("tube_adventures_annotation_skew_seconds", "How early or late annotations were shown or hidden"))
+	, session_recorder(options_.session_recording.empty() ? nullptr : std::make_unique<SessionRecorder>(options_.session_recording))
+	, session(*this, *this, game_session_options(options_, annotation_parse_time, annotation_skew, session_recorder.get()))
 {
 	ui->setupUi(this);
 
-	player = new QMediaPlayer;
-	video = new QVideoWidget(ui->video_parent);
+	if (session_recorder != nullptr && !session_recorder->is_open())
+		log_event<LogLevel::warning>("Can't open the file to record the session. It won't be recorded");
+
+	register_metric_collectors();
+
+	create_player(player, video, video_probe);
+	if (options.seamless_loop)
+	{
+		create_player(standby_player, standby_video, standby_video_probe);
+		standby_player->setMuted(true);
+		standby_video->hide();
+	}
+
+	annotation_timer = new QTimer(this);
+	annotation_timer->setSingleShot(true);
+	annotation_timer->setTimerType(Qt::TimerType::PreciseTimer);
+	connect(annotation_timer, &QTimer::timeout, this, &MainWindow::on_annotation_timer);
 
-	player->setVideoOutput(video);
+	ui_update_timer = new QTimer(this);
+	ui_update_timer->setSingleShot(true);
+	ui_update_timer->setTimerType(Qt::TimerType::PreciseTimer);
+	connect(ui_update_timer, &QTimer::timeout, this, &MainWindow::on_ui_update_timer);
+
+	last_activity_report = UpdatePacer::clock::now();
+	last_activity_report_cpu_time = process_cpu_time();
+
+	seek_timer = new QTimer(this);
+	seek_timer->setSingleShot(true);
+	connect(seek_timer, &QTimer::timeout, this, &MainWindow::on_seek_timer);
 
 	const QRect geom = ui->central_widget->geometry();
 	video->setGeometry(geom);
+	if (standby_video != nullptr)
+		standby_video->setGeometry(geom);
+
+	if (options.annotation_overlay)
+	{
+		annotation_overlay = new AnnotationOverlay(ui->central_widget);
+		annotation_overlay->setGeometry(ui->central_widget->rect());
+		annotation_overlay->raise();
+		annotation_overlay->show();
+
+		connect(annotation_overlay, &AnnotationOverlay::annotation_clicked, this, &MainWindow::on_overlay_annotation_clicked);
+	}
 
 	//constexpr char video_filename[] = "C:\\Users\\Andoni\\Downloads\\TEMP BIDEUEK\\Kimi no Suizou wo Tabetai.mp4";
 	//constexpr char video_filename[] = "C:\\Users\\Andoni\\Videos\\Renderizados\\donete.mp4";
 	//constexpr char video_filename[] = "C:\\Users\\Andoni\\Downloads\\JDownloader\\TUBE-ADVENTURES (aventura interactiva)\\TUBE-ADVENTURES (aventura interactiva) (288p_30fps_H264-96kbit_AAC).mp4";
 	//constexpr char video_filename[] = "C:\\Users\\Andoni\\AppData\\Roaming\\Telegram Desktop\\tdata\\tdld\\video_2018-12-03_20-57-13.mp4";
 
-	constexpr char annotations_filename[] = "../../..//data/TUBE-ADVENTURES/TUBE-ADVENTURES (aventura interactiva) BckqqsJiDUI.xml";
-	
-	play_video(annotations_filename);
+	update_viewport_size();
+	session.load_scene(options.first_scene, VideoClock::clock::now());
 	video->show();
 
-	ui->progress_bar->setRange(0, static_cast<int>(player->duration() / 1000));
 	ui->progress_bar->setValue(0);
 
-	connect(player, &QMediaPlayer::mediaStatusChanged, this, &MainWindow::on_video_media_status_changed);
-	connect(player, &QMediaPlayer::positionChanged, this, &MainWindow::on_video_position_changed);
-	connect(player, &QMediaPlayer::durationChanged, this, &MainWindow::on_video_duration_changed);
+	connect_player(player);
+	if (standby_player != nullptr)
+		connect_player(standby_player);
 }
 
 MainWindow::~MainWindow()
@@ -221,62 +279,190 @@ MainWindow::~MainWindow()
 	delete ui;
 }
 
-void MainWindow::play_video(const std::filesystem::path & annotations_filename)
+void MainWindow::set_media(const std::string & location)
 {
-	const u8string annotations_filename_utf8 = annotations_filename.u8string();
+	current_video_url = QUrl::fromUserInput(to_qstring(location), QDir::currentPath(), QUrl::UserInputResolutionOption::AssumeLocalFile);
 
-	annotations.clear();
-	annotation_buttons.clear();
+	seek_controller.reset();
+	seek_timer->stop();
+	pending_seek.reset();
 
-	if (ParseAnnotationsResult parse_result = parse_annotations(annotations_filename_utf8.c_str()); parse_result.error != ParseAnnotationsError::success)
 	{
-		QMessageBox::critical(nullptr, "Failed to parse annotations", "Error when parsing annotation file \"" + QString::fromStdString(annotations_filename_utf8) + "\".\n\nError: " + QString::fromStdString(parse_result.error_string), QMessageBox::StandardButton::Ok, QMessageBox::StandardButton::NoButton);
-		this->close(); // FIXME: This doesn't close the window if running from the constructor. How do I close the window?
+		const TraceSpan set_media_span("QMediaPlayer::setMedia");
+		player->setMedia(current_video_url);
+	}
+	scene_load_timings.media_set = VideoClock::clock::now();
+
+	if (standby_player != nullptr)
+	{
+		standby_player_ready = false;
+		standby_loop_position.reset();
+		standby_player->setMedia(current_video_url); // Prepared when it's loaded
+	}
+}
+
+void MainWindow::play()
+{
+	player->play();
+	log_event<LogLevel::debug>("Player state after loading the video: {}", player->state());
+}
+
+bool MainWindow::seek(const VideoClock::microseconds position)
+{
+	// Done when the media is loaded
+	if (!is_media_loaded(player->mediaStatus()))
+	{
+		pending_seek = position;
+		return false;
+	}
+
+	player->setPosition(std::chrono::duration_cast<std::chrono::milliseconds>(position).count());
+	return true;
+}
+
+void MainWindow::loop_to(const VideoClock::microseconds position)
+{
+	if (standby_player_ready)
+	{
+		loop_seamlessly();
 		return;
 	}
+
+	seek_controller.seek_to(std::chrono::duration_cast<SeekController::milliseconds>(position), false, SeekController::clock::now());
+	schedule_seek_timer();
+	player->play();
+}
+
+void MainWindow::on_scene_changing()
+{
+	// Ends when the first frame of the video is shown
+	++scenes_loaded;
+	awaiting_first_frame = true;
+	scene_load_timings = {};
+	scene_load_timings.start = VideoClock::clock::now();
+	trace_async_begin("Load to first frame", scenes_loaded);
+
+	if (const AnnotationTimingSkew & timing_skew = session.annotation_timing_skew(); timing_skew.events > 0)
+	{
+		log_event<LogLevel::debug>("Annotation timing skew: {} events, {} off by more than a frame. Max: {} us. Mean: {} us",
+			timing_skew.events, timing_skew.events_off_by_more_than_a_frame, timing_skew.max_absolute_skew.count(), timing_skew.mean_absolute_skew().count());
+	}
+
+	if (const SeekController::Stats & seek_stats = seek_controller.stats(); seek_stats.requests > 0)
+	{
+		log_event<LogLevel::debug>("Seeking: {} requests, {} seeks issued, {} coalesced, {} snapped to a keyframe",
+			seek_stats.requests, seek_stats.seeks_issued, seek_stats.requests_coalesced, seek_stats.seeks_snapped_to_keyframe);
+	}
+
+	annotation_buttons.clear();
+	if (annotation_overlay != nullptr)
+		annotation_overlay->clear_annotations();
+}
+
+void MainWindow::on_scene_loaded()
+{
+	scene_load_timings.scene_loaded = VideoClock::clock::now();
+
+	const SceneCache & scene_cache = session.scene_cache();
+	const SceneCache::Stats & cache_stats = scene_cache.stats();
+	log_event<LogLevel::debug>("Scene cache: {} scenes, {} of {} bytes. Hits: {} Misses: {} Evictions: {}",
+		scene_cache.size(), scene_cache.memory_usage(), scene_cache.memory_budget(), cache_stats.hits, cache_stats.misses, cache_stats.evictions);
+
+	const std::vector<Annotation> & annotations = session.annotations();
+	if (annotation_overlay != nullptr)
+	{
+		const AnnotationRenderCache & render_cache = annotation_overlay->render_cache();
+		const AnnotationRenderCache::Stats render_stats = render_cache.stats();
+		log_event<LogLevel::debug>("Annotation render cache: {} bubbles, {} of {} pixels",
+			render_cache.size(), render_cache.pixel_usage(), render_cache.pixel_budget());
+		log_event<LogLevel::debug>("Annotation render cache: Hits: {} Misses: {} Evictions: {} Prerendered: {}",
+			render_stats.hits, render_stats.misses, render_stats.evictions, render_stats.prerendered);
+
+		annotation_overlay->set_annotations(annotations);
+	}
 	else
 	{
-		annotations = std::move(parse_result.annotations);
 		annotation_buttons.reserve(annotations.size());
 		std::fill_n(std::back_inserter(annotation_buttons), annotations.size(), nullptr);
 	}
 
-	const std::optional<std::string> youtube_id = path_to_youtube_video_id(annotations_filename, annotation_file_extension);
+	prerender_annotations();
+
+	const Mp4VideoInfo & video_info = session.video_info();
+	const auto video_duration = std::chrono::duration_cast<std::chrono::milliseconds>(video_info.duration);
+	ui->progress_bar->setRange(0, static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(video_duration).count()));
+	progress_bar_seconds = -1;
+	seek_controller.set_duration(video_duration);
+
+	std::vector<SeekController::milliseconds> keyframes;
+	keyframes.reserve(video_info.keyframe_times.size());
+	for (const VideoClock::microseconds keyframe_time : video_info.keyframe_times)
+		keyframes.push_back(std::chrono::duration_cast<SeekController::milliseconds>(keyframe_time));
+	seek_controller.set_keyframes(std::move(keyframes));
+}
+
+void MainWindow::show_annotation(const int annotation_index, const PixelRect & rect)
+{
+	const QRect geometry = to_qrect(rect);
 
-	const auto annotations_absolute_path = [&annotations_filename]()
+	if (annotation_overlay != nullptr)
 	{
-		std::error_code error;
-		auto absolute_path = std::filesystem::weakly_canonical(annotations_filename, error);
-		if (error)
-			return annotations_filename;
+		annotation_overlay->show_annotation(annotation_index, geometry, session.video_rect().height);
+		return;
+	}
 
-		return absolute_path;
-	};
+	std::unique_ptr<QPushButton> & button = annotation_buttons[static_cast<std::size_t>(annotation_index)];
 
-	if (!youtube_id.has_value())
+	if (button != nullptr)
 	{
-		QMessageBox::critical(nullptr, "Invalid annotations filename", QString::fromStdString("Failed to extract youtube video ID from the annotations file: \"" + annotations_absolute_path().u8string() + '"'), QMessageBox::StandardButton::Ok, QMessageBox::StandardButton::NoButton);
-		this->close();
+		if (button->geometry() != geometry)
+			button->setGeometry(geometry);
+
 		return;
 	}
 
-#if false
-	const QUrl video_url = video_url_from_youtube_id(*youtube_id); // Online videos
-#else
-	const QUrl video_url = video_path_from_youtube_id(*youtube_id); // Local videos
-#endif
-	if (video_url.isEmpty())
+	log_event<LogLevel::debug>("Button for annotation {} created", annotation_index);
+
+	const Annotation & annotation = session.annotations()[static_cast<std::size_t>(annotation_index)];
+
+	button = std::make_unique<QPushButton>(ui->central_widget);
+	button->setText(QString::fromUtf8(annotation.text.data(), static_cast<int>(annotation.text.size())));
+	button->setGeometry(geometry);
+
+	assert(!annotation.id.empty());
+	button->setObjectName(QString::fromStdString(annotation.id));
+	button->show();
+
+	connect(button.get(), &QPushButton::clicked, this, &MainWindow::on_annotation_clicked);
+}
+
+void MainWindow::hide_annotation(const int annotation_index)
+{
+	if (annotation_overlay != nullptr)
 	{
-		QMessageBox::critical(nullptr, "URL/path for video not found", QString::fromStdString("Cannot find URL/path of video for the annotations file: \"" + annotations_absolute_path().u8string() + "\".\n\nYoutube video ID: " + *youtube_id), QMessageBox::StandardButton::Ok, QMessageBox::StandardButton::NoButton);
-		this->close();
+		annotation_overlay->hide_annotation(annotation_index);
 		return;
 	}
 
-	player->setMedia(QUrl(video_url));
+	std::unique_ptr<QPushButton> & button = annotation_buttons[static_cast<std::size_t>(annotation_index)];
+	if (button == nullptr)
+		return;
 
-	player->play();
+	log_event<LogLevel::debug>("Button for annotation {} deleted", annotation_index);
 
-	qDebug() << player->state();
+	button.reset(); // Is this the way to do it??
+}
+
+void MainWindow::on_layout_changed()
+{
+	// The bubbles have a different size now
+	prerender_annotations();
+}
+
+void MainWindow::report_error(const std::string_view title, const std::string_view message)
+{
+	QMessageBox::critical(nullptr, to_qstring(title), to_qstring(message), QMessageBox::StandardButton::Ok, QMessageBox::StandardButton::NoButton);
+	this->close(); // FIXME: This doesn't close the window if running from the constructor. How do I close the window?
 }
 
 void MainWindow::resizeEvent([[maybe_unused]] QResizeEvent * event)
@@ -289,6 +475,47 @@ void MainWindow::resizeEvent([[maybe_unused]] QResizeEvent * event)
 	assert(event != nullptr);
 	const QRect geom = ui->central_widget->geometry();
 	video->setGeometry(geom);
+	if (standby_video != nullptr)
+		standby_video->setGeometry(geom);
+
+	if (annotation_overlay != nullptr)
+		annotation_overlay->setGeometry(ui->central_widget->rect());
+
+	update_viewport_size();
+}
+
+void MainWindow::changeEvent(QEvent * event)
+{
+	QMainWindow::changeEvent(event);
+
+	assert(event != nullptr);
+	if (event->type() == QEvent::Type::WindowStateChange && ui_update_timer != nullptr)
+		update_window_visibility();
+}
+
+void MainWindow::showEvent(QShowEvent * event)
+{
+	QMainWindow::showEvent(event);
+
+	if (const QScreen * const screen = QGuiApplication::primaryScreen(); screen != nullptr && screen->refreshRate() > 0)
+		ui_update_pacer.set_refresh_interval(std::chrono::microseconds(static_cast<std::int64_t>(1'000'000 / screen->refreshRate())));
+
+	update_window_visibility();
+}
+
+void MainWindow::hideEvent(QHideEvent * event)
+{
+	QMainWindow::hideEvent(event);
+	update_window_visibility();
+}
+
+void MainWindow::paintEvent(QPaintEvent * event)
+{
+	QMainWindow::paintEvent(event);
+
+	// Being painted after being occluded is the only notice of being visible again
+	if (!ui_update_pacer.is_visible())
+		update_window_visibility();
 }
 
 void MainWindow::keyPressEvent([[maybe_unused]] QKeyEvent * event)
@@ -304,14 +531,17 @@ void MainWindow::keyPressEvent([[maybe_unused]] QKeyEvent * event)
 	{
 	case Qt::Key::Key_Right:
 	{
-		assert(player != nullptr);
-		change_video_position(*player, video_seek_duration());
+		seek_by(video_seek_duration(), video_seek_duration() >= 1min);
 		break;
 	}
 	case Qt::Key::Key_Left:
 	{
-		assert(player != nullptr);
-		change_video_position(*player, -video_seek_duration());
+		seek_by(-video_seek_duration(), video_seek_duration() >= 1min);
+		break;
+	}
+	case Qt::Key::Key_Backspace:
+	{
+		session.go_back(VideoClock::clock::now());
 		break;
 	}
 	case Qt::Key::Key_Space:
@@ -326,7 +556,7 @@ void MainWindow::keyPressEvent([[maybe_unused]] QKeyEvent * event)
 			player->play();
 			break;
 		case QMediaPlayer::State::StoppedState:
-			qDebug() << "QMediaPlayer::State::StoppedState in video. Case unhandled\n";
+			log_event<LogLevel::warning>("QMediaPlayer::State::StoppedState in video. Case unhandled");
 			break;
 		default:
 			unreachable("Invalid QMediaPlayer::State");
@@ -340,98 +570,449 @@ void MainWindow::on_video_media_status_changed(const QMediaPlayer::MediaStatus n
 {
 	assert(player != nullptr);
 
+	if (sender() == standby_player && standby_player != nullptr)
+	{
+		if (new_status == QMediaPlayer::MediaStatus::LoadedMedia && !standby_player_ready)
+			prepare_standby_player();
+
+		return;
+	}
+
+	if (awaiting_first_frame && !scene_load_timings.media_loaded.has_value()
+		&& (new_status == QMediaPlayer::MediaStatus::LoadedMedia || new_status == QMediaPlayer::MediaStatus::BufferedMedia))
+	{
+		scene_load_timings.media_loaded = VideoClock::clock::now();
+	}
+
+	if (pending_seek.has_value() && is_media_loaded(new_status))
+	{
+		player->setPosition(std::chrono::duration_cast<std::chrono::milliseconds>(*pending_seek).count());
+		session.on_seek_issued(*pending_seek, VideoClock::clock::now());
+		pending_seek.reset();
+		request_ui_update();
+	}
+
+	// Without video probing the resolution is only known from the metadata
+	if (session.video_width() <= 0 && (new_status == QMediaPlayer::MediaStatus::LoadedMedia || new_status == QMediaPlayer::MediaStatus::BufferedMedia))
+		set_video_resolution(player->metaData(QMediaMetaData::Resolution).toSize());
+
 	if (new_status == QMediaPlayer::MediaStatus::EndOfMedia)
 	{
-		change_video_position(*player, -3s);
-		player->play();
+		session.on_end_of_media(VideoClock::clock::now());
+		request_ui_update();
 	}
 }
 
 void MainWindow::on_video_duration_changed(const qint64 duration_changed)
 {
+	if (sender() == standby_player && standby_player != nullptr)
+	{
+		// The loop point wasn't known without the duration
+		if (!standby_player_ready)
+			prepare_standby_player();
+
+		return;
+	}
+
+	session.on_duration_reported(std::chrono::milliseconds(duration_changed), VideoClock::clock::now());
 	ui->progress_bar->setMaximum(static_cast<int>(duration_changed / 1000));
+	seek_controller.set_duration(SeekController::milliseconds(duration_changed));
 }
 
 void MainWindow::on_video_position_changed(const qint64 new_position)
 {
-	ui->progress_bar->setValue(static_cast<int>(new_position / 1000));
+	if (sender() == standby_player && standby_player != nullptr)
+	{
+		if (!standby_player_ready)
+			check_standby_position(new_position);
 
-	const auto annotations_size = static_cast<int>(annotations.size());
-	for (int i = 0; i < annotations_size; ++i)
+		return;
+	}
+
+	if (sender() != player)
+		return;
+
+	ui_update_pacer.record_wakeup();
+	session.on_position_reported(video_position(new_position), VideoClock::clock::now());
+
+	// Without video probing, a position update is the first sign that a seek finished
+	if (video_probe == nullptr || !video_probe->isActive())
 	{
-		const Annotation & annotation = annotations[i];
-		std::unique_ptr<QPushButton> & button = annotation_buttons[i];
+		on_frame_shown();
+		on_seek_completed();
+	}
 
-		const auto pos = video_position(new_position);
+	request_ui_update();
+}
 
-		const bool annotation_showing = pos >= annotation.start_rect.time && (!annotation.end_rect.has_value() || pos <= annotation.end_rect->time);
-		if (annotation_showing && button == nullptr/* && annotation.type == Annotation::Type::gameplay*/)
-		{
-			qDebug() << "Button with text" << QString::fromUtf8(annotation.text.data(), static_cast<int>(annotation.text.size())) << "created";
-
-			button = std::make_unique<QPushButton>(ui->central_widget);
-			button->setText(QString::fromUtf8(annotation.text.data(), static_cast<int>(annotation.text.size())));
-			constexpr float pos_scale = 2.0f;
-			constexpr float size_scale = 3.0f;
-			button->setGeometry(annotation.start_rect.x * pos_scale, annotation.start_rect.y * pos_scale, annotation.start_rect.width * size_scale, annotation.start_rect.height * size_scale);
-			
-			assert(!annotation.id.empty());
-			button->setObjectName(QString::fromStdString(annotation.id));
-			button->show();
-
-			connect(button.get(), &QPushButton::clicked, this, &MainWindow::on_annotation_clicked);
-		}
+void MainWindow::on_video_state_changed(const QMediaPlayer::State new_state)
+{
+	if (sender() != player)
+		return;
 
-		else if (!annotation_showing && button != nullptr)
-		{
-			qDebug() << "Deleting button with text" << button->text();
-			
-			button.reset(); // Is this the way to do it??
-		}
+	session.on_playing_changed(new_state == QMediaPlayer::State::PlayingState, VideoClock::clock::now());
+	request_ui_update();
+}
+
+void MainWindow::on_video_frame_probed(const QVideoFrame & frame)
+{
+	if (sender() != video_probe)
+		return;
+
+	ui_update_pacer.record_wakeup();
+
+	// startTime() is the presentation timestamp of the frame, in microseconds (-1 if unknown)
+	session.on_frame(VideoClock::microseconds(frame.startTime()), VideoClock::clock::now());
+
+	if (frame.size() != QSize(session.video_width(), session.video_height()))
+		set_video_resolution(frame.size());
+
+	on_frame_shown();
+	on_seek_completed();
+
+	request_ui_update();
+}
+
+void MainWindow::request_ui_update()
+{
+	schedule_ui_update(ui_update_pacer.request(UpdatePacer::clock::now()));
+}
+
+void MainWindow::schedule_ui_update(const std::optional<UpdatePacer::clock::time_point> pass_time)
+{
+	if (!pass_time.has_value())
+		return;
+
+	const auto delay = std::chrono::ceil<std::chrono::milliseconds>(*pass_time - UpdatePacer::clock::now());
+	ui_update_timer->start(static_cast<int>(std::max(delay, std::chrono::milliseconds(0)).count()));
+}
+
+void MainWindow::on_ui_update_timer()
+{
+	ui_update_pacer.record_wakeup();
+	ui_update_pacer.on_pass(UpdatePacer::clock::now());
+
+	update_window_visibility();
+	if (!ui_update_pacer.is_visible())
+		return;
+
+	update_ui();
+}
+
+void MainWindow::on_annotation_timer()
+{
+	ui_update_pacer.record_wakeup();
+	request_ui_update();
+}
+
+void MainWindow::update_ui()
+{
+	const auto now = UpdatePacer::clock::now();
+
+	const auto position_seconds = static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(session.position(now)).count());
+	if (position_seconds != progress_bar_seconds)
+	{
+		progress_bar_seconds = position_seconds;
+		ui->progress_bar->setValue(position_seconds);
 	}
+	else
+		ui_update_pacer.record_redundant_set_skipped();
+
+	update_annotations();
+
+	if (now - last_activity_report >= ui_activity_report_interval)
+		report_ui_activity(now);
 }
 
-void MainWindow::on_annotation_clicked(const bool /*checked*/)
+void MainWindow::update_window_visibility()
 {
-	const auto * const button = qobject_cast<QPushButton *>(sender());
-	assert(button != nullptr);
+	const QWindow * const window = windowHandle();
+	const bool visible = isVisible() && !isMinimized() && (window == nullptr || window->isExposed());
 
-	const auto buttons_begin = annotation_buttons.begin();
-	const auto buttons_end = annotation_buttons.end();
-	const auto button_it = std::find_if(buttons_begin, buttons_end, [button](const std::unique_ptr<QPushButton> & button_in_container)
+	schedule_ui_update(ui_update_pacer.set_visible(visible, UpdatePacer::clock::now()));
+
+	// Nothing is woken up while nothing can be seen
+	if (!visible)
 	{
-		return button_in_container.get() == button;
+		ui_update_timer->stop();
+		annotation_timer->stop();
+	}
+}
+
+void MainWindow::report_ui_activity(const UpdatePacer::clock::time_point now)
+{
+	const std::chrono::microseconds cpu_time = process_cpu_time();
+	const auto wall_time = std::chrono::duration_cast<std::chrono::microseconds>(now - last_activity_report);
+	const UpdatePacer::Stats & stats = ui_update_pacer.stats();
+
+	log_event<LogLevel::debug>("UI activity in the last {} ms: {} update passes, {} wakeups, {} redundant sets skipped. CPU: {}%",
+		std::chrono::duration_cast<std::chrono::milliseconds>(wall_time).count(),
+		stats.passes - last_activity_report_stats.passes,
+		stats.wakeups - last_activity_report_stats.wakeups,
+		stats.redundant_sets_skipped - last_activity_report_stats.redundant_sets_skipped,
+		(wall_time.count() > 0) ? (cpu_time - last_activity_report_cpu_time).count() * 100 / wall_time.count() : 0);
+
+	last_activity_report = now;
+	last_activity_report_cpu_time = cpu_time;
+	last_activity_report_stats = stats;
+}
+
+void MainWindow::update_annotations()
+{
+	const TraceSpan span("update_annotations");
+
+	// Wakes up right when the next annotation has to be shown/hidden (or moved), instead of waiting for the next position update
+	const auto now = VideoClock::clock::now();
+	const std::optional<VideoClock::clock::time_point> next_update = session.update(now);
+	if (!next_update.has_value())
+	{
+		annotation_timer->stop();
+		return;
+	}
+
+	const auto delay = std::chrono::ceil<std::chrono::milliseconds>(*next_update - now);
+	annotation_timer->start(static_cast<int>(std::max(delay, std::chrono::milliseconds(1)).count()));
+}
+
+void MainWindow::on_frame_shown()
+{
+	if (!awaiting_first_frame)
+		return;
+
+	awaiting_first_frame = false;
+	trace_instant("First frame");
+	trace_async_end("Load to first frame", scenes_loaded);
+	scene_load_timings.first_frame = VideoClock::clock::now();
+	load_to_first_frame_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(scene_load_timings.first_frame - scene_load_timings.start));
+
+	if (options.on_first_frame)
+		options.on_first_frame(scene_load_timings);
+}
+
+void MainWindow::register_metric_collectors()
+{
+	Counter & scenes_loaded_total = metrics.counter("tube_adventures_scenes_loaded_total", "Scenes loaded (annotations and video)");
+	Counter & scene_cache_hits = metrics.counter("tube_adventures_scene_cache_hits_total", "Scenes loaded from the scene cache");
+	Counter & scene_cache_misses = metrics.counter("tube_adventures_scene_cache_misses_total", "Scenes that had to be parsed and laid out");
+	Counter & render_cache_hits = metrics.counter("tube_adventures_annotation_render_cache_hits_total", "Annotation bubbles painted from the render cache");
+	Counter & render_cache_misses = metrics.counter("tube_adventures_annotation_render_cache_misses_total", "Annotation bubbles rendered when they had to be painted");
+	Gauge & annotation_widgets = metrics.gauge("tube_adventures_annotation_widgets", "Widgets used to show the annotations");
+	Gauge & resident_memory = metrics.gauge("tube_adventures_resident_memory_bytes", "Physical memory used by the process");
+	Gauge & open_handles = metrics.gauge("tube_adventures_open_handles", "Files, sockets and other handles the process has open");
+
+	// Sampled when exported, on the GUI thread
+	metrics.add_collector([this, &scenes_loaded_total, &scene_cache_hits, &scene_cache_misses, &render_cache_hits, &render_cache_misses, &annotation_widgets, &resident_memory, &open_handles]()
+	{
+		scenes_loaded_total.set(scenes_loaded);
+
+		const SceneCache::Stats & scene_stats = session.scene_cache().stats();
+		scene_cache_hits.set(static_cast<std::uint64_t>(scene_stats.hits));
+		scene_cache_misses.set(static_cast<std::uint64_t>(scene_stats.misses));
+
+		if (annotation_overlay != nullptr)
+		{
+			const AnnotationRenderCache::Stats render_stats = annotation_overlay->render_cache().stats();
+			render_cache_hits.set(static_cast<std::uint64_t>(render_stats.hits));
+			render_cache_misses.set(static_cast<std::uint64_t>(render_stats.misses));
+			annotation_widgets.set(1.0);
+		}
+		else
+		{
+			const auto button_count = std::count_if(annotation_buttons.begin(), annotation_buttons.end(), [](const std::unique_ptr<QPushButton> & button) { return button != nullptr; });
+			annotation_widgets.set(static_cast<double>(button_count));
+		}
+
+		if (const std::optional<std::size_t> rss = resident_set_size(); rss.has_value())
+			resident_memory.set(static_cast<double>(*rss));
+
+		if (const std::optional<std::size_t> handles = open_handle_count(); handles.has_value())
+			open_handles.set(static_cast<double>(*handles));
 	});
+}
 
-	assert(button_it != buttons_end);
+void MainWindow::seek_to(const SeekController::milliseconds position)
+{
+	const auto now = SeekController::clock::now();
+	seek_controller.seek_to(position, false, now);
+	schedule_seek_timer();
 
-	const auto button_index = static_cast<int>(button_it - buttons_begin);
-	assert(button_index >= 0 && button_index < annotations.size() && annotations.size() == annotation_buttons.size());
+	if (session_recorder != nullptr)
+		session_recorder->record(SessionEvent::Type::seek, now, std::chrono::duration_cast<VideoClock::microseconds>(position).count());
+}
+
+void MainWindow::seek_by(const SeekController::milliseconds offset, const bool coarse)
+{
+	assert(player != nullptr);
 
-	const Annotation & annotation = annotations[button_index];
+	const auto now = SeekController::clock::now();
+	seek_controller.seek_by(offset, get_video_position(*player), coarse, now);
+	schedule_seek_timer();
 
-	if (annotation.type != Annotation::Type::gameplay)
+	if (const std::optional<SeekController::milliseconds> target = seek_controller.current_target(); session_recorder != nullptr && target.has_value())
+		session_recorder->record(SessionEvent::Type::seek, now, std::chrono::duration_cast<VideoClock::microseconds>(*target).count());
+}
+
+void MainWindow::on_seek_completed()
+{
+	if (!seek_controller.has_seek_in_flight())
 		return;
 
-	const std::optional<std::string_view> youtube_id = youtube_video_id_from_url(annotation.click_url);
+	seek_controller.on_seek_completed(SeekController::clock::now());
+	schedule_seek_timer();
+}
 
-	if (!youtube_id.has_value())
+void MainWindow::on_seek_timer()
+{
+	seek_controller.on_timeout(SeekController::clock::now());
+	schedule_seek_timer();
+}
+
+void MainWindow::schedule_seek_timer()
+{
+	const std::optional<SeekController::clock::time_point> deadline = seek_controller.next_deadline();
+	if (!deadline.has_value())
 	{
-		QMessageBox::critical(nullptr, "Failed to get video ID from annotation", QString::fromStdString("Failed to get the destintation youtube video ID from the URL (\"" + annotation.click_url + "\") of the annotation \"" + annotation.id + "\" (text = \"" + annotation.text + "\")"), QMessageBox::StandardButton::Ok, QMessageBox::StandardButton::NoButton);
-		this->close();
+		seek_timer->stop();
 		return;
 	}
 
-	constexpr std::string_view search_directory = "../../../data/TUBE-ADVENTURES";
-	const auto path = find_path_with_youtube_id(*youtube_id, search_directory, ".xml");
+	const auto delay = std::chrono::ceil<std::chrono::milliseconds>(*deadline - SeekController::clock::now());
+	seek_timer->start(static_cast<int>(std::max(delay, std::chrono::milliseconds(0)).count()));
+}
+
+void MainWindow::create_player(QMediaPlayer *& out_player, QVideoWidget *& out_video, QVideoProbe *& out_video_probe)
+{
+	out_player = new QMediaPlayer(this);
+	out_video = new QVideoWidget(ui->video_parent);
 
-	if (path.empty())
+	out_player->setVideoOutput(out_video);
+
+	// Frame timestamps give a much more precise position than positionChanged
+	out_video_probe = new QVideoProbe(this);
+	if (out_video_probe->setSource(out_player))
+		connect(out_video_probe, &QVideoProbe::videoFrameProbed, this, &MainWindow::on_video_frame_probed);
+	else
 	{
-		QMessageBox::critical(nullptr, "Annotation file not found", QString::fromStdString("No annotation file was found for the youtube ID \"" + std::string(*youtube_id) + "\" in directory \"" + std::string(search_directory) + '"'), QMessageBox::StandardButton::Ok, QMessageBox::StandardButton::NoButton);
-		this->close();
+		log_event<LogLevel::warning>("Video probing is not supported by the media backend. Falling back to position updates");
+		out_player->setNotifyInterval(fallback_position_notify_interval);
+	}
+}
+
+void MainWindow::connect_player(QMediaPlayer * const media_player)
+{
+	connect(media_player, &QMediaPlayer::mediaStatusChanged, this, &MainWindow::on_video_media_status_changed);
+	connect(media_player, &QMediaPlayer::positionChanged, this, &MainWindow::on_video_position_changed);
+	connect(media_player, &QMediaPlayer::durationChanged, this, &MainWindow::on_video_duration_changed);
+	connect(media_player, &QMediaPlayer::stateChanged, this, &MainWindow::on_video_state_changed);
+}
+
+void MainWindow::prepare_standby_player()
+{
+	assert(standby_player != nullptr);
+
+	// Retried when the media is loaded
+	if (!is_media_loaded(standby_player->mediaStatus()))
 		return;
+
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(session.duration());
+	if (duration <= 0ms)
+		duration = std::chrono::milliseconds(standby_player->duration());
+	if (duration <= 0ms)
+		return; // Retried when the duration is known
+
+	// Paused right at the loop point, so the frame is already decoded when it's needed. Only ready once the player
+	// says it's there, which may be now or in a later position update
+	standby_loop_position = std::max(0ms, duration - std::chrono::duration_cast<std::chrono::milliseconds>(GameSession::loop_length));
+	standby_player->setPosition(standby_loop_position->count());
+	standby_player->pause();
+	check_standby_position(standby_player->position());
+}
+
+void MainWindow::check_standby_position(const qint64 position)
+{
+	// A frame or two off is still seamless
+	constexpr auto tolerance = 100ms;
+
+	if (standby_loop_position.has_value() && std::chrono::abs(std::chrono::milliseconds(position) - *standby_loop_position) <= tolerance)
+		standby_player_ready = true;
+}
+
+void MainWindow::loop_seamlessly()
+{
+	assert(standby_player != nullptr && standby_player_ready);
+
+	std::swap(player, standby_player);
+	std::swap(video, standby_video);
+	std::swap(video_probe, standby_video_probe);
+
+	player->setMuted(false);
+	player->play();
+	video->show();
+	standby_video->hide();
+
+	// The one that just ended is the standby for the next loop
+	standby_player->setMuted(true);
+	standby_player_ready = false;
+	standby_loop_position.reset();
+	prepare_standby_player();
+}
+
+void MainWindow::set_video_resolution(const QSize & resolution)
+{
+	// 0 while unknown
+	const int width = resolution.isValid() ? resolution.width() : 0;
+	const int height = resolution.isValid() ? resolution.height() : 0;
+	session.set_video_resolution(width, height, VideoClock::clock::now());
+}
+
+void MainWindow::update_viewport_size()
+{
+	const QSize widget_size = ui->central_widget->size();
+	session.set_viewport_size(widget_size.width(), widget_size.height(), VideoClock::clock::now());
+}
+
+void MainWindow::prerender_annotations()
+{
+	if (annotation_overlay == nullptr)
+		return;
+
+	const std::vector<Annotation> & annotations = session.annotations();
+
+	std::vector<QRect> geometries;
+	geometries.reserve(annotations.size());
+
+	// Moving annotations may change size later on, those bubbles are rendered when needed
+	const auto annotations_size = static_cast<int>(annotations.size());
+	for (int i = 0; i < annotations_size; ++i)
+	{
+		const VideoClock::microseconds start_time = annotations[static_cast<std::size_t>(i)].start_rect.time;
+		geometries.push_back(to_qrect(session.annotation_geometry(i, start_time)));
 	}
 
-	play_video(path);
+	annotation_overlay->prerender_annotations(geometries, session.video_rect().height);
+}
+
+void MainWindow::on_annotation_clicked(const bool /*checked*/)
+{
+	const auto * const button = qobject_cast<QPushButton *>(sender());
+	assert(button != nullptr);
+
+	const auto buttons_begin = annotation_buttons.begin();
+	const auto buttons_end = annotation_buttons.end();
+	const auto button_it = std::find_if(buttons_begin, buttons_end, [button](const std::unique_ptr<QPushButton> & button_in_container)
+	{
+		return button_in_container.get() == button;
+	});
+
+	assert(button_it != buttons_end);
+
+	const auto button_index = static_cast<int>(button_it - buttons_begin);
+	assert(button_index >= 0 && button_index < session.annotations().size() && session.annotations().size() == annotation_buttons.size());
+
+	session.activate_annotation(button_index, VideoClock::clock::now());
 }
 
+void MainWindow::on_overlay_annotation_clicked(const int annotation_index)
+{
+	session.activate_annotation(annotation_index, VideoClock::clock::now());
+}
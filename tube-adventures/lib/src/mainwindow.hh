@@ -1,12 +1,27 @@
 #pragma once
 
 #include "annotations.hh"
+#include "annotation_overlay.hh"
+#include "game_session.hh"
+#include "metrics.hh"
+#include "seek_controller.hh"
+#include "update_pacer.hh"
+#include "video_clock.hh"
 
 #include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
 
 #include <QMainWindow>
 #include <QVideoWidget>
 #include <QMediaPlayer>
+#include <QVideoProbe>
+#include <QVideoFrame>
+#include <QTimer>
 
 #include <QResizeEvent>
 #include <QKeyEvent>
@@ -17,12 +32,47 @@ namespace Ui
 	class MainWindow;
 }
 
-class MainWindow : public QMainWindow
+// When each stage of loading a scene ended, from the click (or whatever loaded it) to its first frame
+struct SceneLoadTimings
+{
+	VideoClock::clock::time_point start; // The scene started changing
+	VideoClock::clock::time_point scene_loaded; // Annotations parsed (or taken from the scene cache) and laid out
+	VideoClock::clock::time_point media_set; // The player was given the video
+	std::optional<VideoClock::clock::time_point> media_loaded; // Empty if the player didn't report it before the first frame
+	VideoClock::clock::time_point first_frame;
+};
+
+struct MainWindowOptions
+{
+	// Paint all annotations in a single widget instead of creating one button per annotation
+	bool annotation_overlay = false;
+
+	// Memory that videos visited recently can take, so going back to them is instant
+	std::size_t scene_cache_budget = SceneCache::default_memory_budget;
+
+	// Keep a second player paused at the loop point, to swap to it at the end of the video
+	// instead of seeking back (which stutters). Off by default, as it decodes every video twice
+	bool seamless_loop = false;
+
+	// Record the session to this file, to replay it without the window. Not recorded if empty
+	std::string session_recording;
+
+	// The scene the game starts in. The other scenes are looked for in the same directory
+	std::filesystem::path first_scene = "../../../data/TUBE-ADVENTURES/TUBE-ADVENTURES (aventura interactiva) BckqqsJiDUI.xml";
+
+	// Where the videos are. The "video" directory next to the annotations if empty
+	std::filesystem::path video_directory;
+
+	// Called when the first frame of each scene is shown
+	std::function<void(const SceneLoadTimings &)> on_first_frame;
+};
+
+class MainWindow : public QMainWindow, private MediaBackend, private GameView
 {
 	Q_OBJECT
 
 public:
-	explicit MainWindow(QWidget * parent = nullptr);
+	explicit MainWindow(const MainWindowOptions & options = {}, QWidget * parent = nullptr);
 	~MainWindow();
 
 	MainWindow(const MainWindow &) = delete;
@@ -32,26 +82,123 @@ public:
 
 	Ui::MainWindow * ui = nullptr;
 
+	[[nodiscard]] const AnnotationTimingSkew & get_annotation_timing_skew() const noexcept { return session.annotation_timing_skew(); }
+	[[nodiscard]] const SceneCache & get_scene_cache() const noexcept { return session.scene_cache(); }
+	[[nodiscard]] const GameSession & get_session() const noexcept { return session; }
+	[[nodiscard]] MetricsRegistry & get_metrics() noexcept { return metrics; }
+
+	// Like the seek keys, but to an absolute position
+	void seek_to(const SeekController::milliseconds position);
+
 private slots:
 
 private:
 	void resizeEvent(QResizeEvent * event) override;
 	void keyPressEvent(QKeyEvent *event) override;
+	void changeEvent(QEvent * event) override;
+	void showEvent(QShowEvent * event) override;
+	void hideEvent(QHideEvent * event) override;
+	void paintEvent(QPaintEvent * event) override;
 
 private:
 	void on_video_media_status_changed(const QMediaPlayer::MediaStatus new_status);
 	void on_video_position_changed(const qint64 new_position);
 	void on_video_duration_changed(const qint64 duration_changed);
+	void on_video_state_changed(const QMediaPlayer::State new_state);
+	void on_video_frame_probed(const QVideoFrame & frame);
 
 	void on_annotation_clicked(const bool /*checked*/);
+	void on_overlay_annotation_clicked(const int annotation_index);
 
 private:
-	void play_video(const std::filesystem::path & annotations_file);
+	// MediaBackend
+	void set_media(const std::string & location) override;
+	void play() override;
+	bool seek(VideoClock::microseconds position) override;
+	void loop_to(VideoClock::microseconds position) override;
+
+	// GameView
+	void on_scene_changing() override;
+	void on_scene_loaded() override;
+	void show_annotation(int annotation_index, const PixelRect & geometry) override;
+	void hide_annotation(int annotation_index) override;
+	void on_layout_changed() override;
+	void report_error(std::string_view title, std::string_view message) override;
 
 private:
-	std::vector<Annotation> annotations;
-	std::vector<std::unique_ptr<QPushButton>> annotation_buttons;
+	// All the UI changes are made in update passes, at most one per display refresh
+	void request_ui_update();
+	void schedule_ui_update(const std::optional<UpdatePacer::clock::time_point> pass_time);
+	void on_ui_update_timer();
+	void on_annotation_timer();
+	void update_ui();
+	void update_window_visibility();
+	void report_ui_activity(const UpdatePacer::clock::time_point now);
+
+	void update_annotations();
+	void on_frame_shown();
+	void register_metric_collectors();
+
+	void seek_by(const SeekController::milliseconds offset, const bool coarse);
+	void on_seek_completed();
+	void on_seek_timer();
+	void schedule_seek_timer();
+
+	void create_player(QMediaPlayer *& out_player, QVideoWidget *& out_video, QVideoProbe *& out_video_probe);
+	void connect_player(QMediaPlayer * media_player);
+	void prepare_standby_player();
+	void check_standby_position(qint64 position);
+	void loop_seamlessly();
+
+	void set_video_resolution(const QSize & resolution);
+	void update_viewport_size();
+	void prerender_annotations();
+
+private:
+	MainWindowOptions options;
+
+	std::vector<std::unique_ptr<QPushButton>> annotation_buttons; // Unused if options.annotation_overlay
+	AnnotationOverlay * annotation_overlay = nullptr; // Only if options.annotation_overlay
+	QTimer * annotation_timer = nullptr;
+
+	QUrl current_video_url;
+	std::uint64_t scenes_loaded = 0; // Identifies the load in the trace
+	bool awaiting_first_frame = false;
+
+	UpdatePacer ui_update_pacer;
+	QTimer * ui_update_timer = nullptr;
+	int progress_bar_seconds = -1;
+
+	UpdatePacer::clock::time_point last_activity_report;
+	std::chrono::microseconds last_activity_report_cpu_time{ 0 };
+	UpdatePacer::Stats last_activity_report_stats;
+
+	SeekController seek_controller;
+	QTimer * seek_timer = nullptr;
+
+	QVideoProbe * video_probe = nullptr;
 
 	QMediaPlayer * player = nullptr;
 	QVideoWidget * video = nullptr;
+
+	// Same media as `player`, paused and muted at the loop point. Only if options.seamless_loop
+	QMediaPlayer * standby_player = nullptr;
+	QVideoWidget * standby_video = nullptr;
+	QVideoProbe * standby_video_probe = nullptr;
+	bool standby_player_ready = false; // Loaded and at the loop point
+	std::optional<std::chrono::milliseconds> standby_loop_position; // Where it was asked to be
+
+	// Asked by the session before the media was loaded
+	std::optional<VideoClock::microseconds> pending_seek;
+
+	MetricsRegistry metrics;
+	LatencyHistogram & load_to_first_frame_latency;
+	LatencyHistogram & annotation_parse_time;
+	LatencyHistogram & annotation_skew;
+	SceneLoadTimings scene_load_timings;
+
+	std::unique_ptr<SessionRecorder> session_recorder; // Only if options.session_recording
+
+	// The game itself. Shown by this window and played by its QMediaPlayer
+	GameSession session;
 };
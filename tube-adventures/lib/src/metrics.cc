@@ -0,0 +1,311 @@
+#include "metrics.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+#if defined(_WIN32)
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#	include <psapi.h>
+#elif defined(__linux__)
+#	include <dirent.h>
+#	include <unistd.h>
+#endif
+
+namespace
+{
+	[[nodiscard]] unsigned floor_log2(std::uint64_t value) noexcept
+	{
+		assert(value > 0);
+
+		unsigned exponent = 0;
+		while (value >>= 1)
+			++exponent;
+
+		return exponent;
+	}
+
+	[[nodiscard]] std::string format_number(const double value)
+	{
+		char buffer[32];
+		const int length = std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+		if (length <= 0)
+			return "0";
+
+		return std::string(buffer, std::min(static_cast<std::size_t>(length), sizeof(buffer) - 1));
+	}
+
+	[[nodiscard]] double to_seconds(const std::chrono::microseconds time) noexcept
+	{
+		return std::chrono::duration<double>(time).count();
+	}
+
+	// Exported histogram buckets: every power of two from 64 us to ~67 s
+	constexpr unsigned first_exported_exponent = 6;
+	constexpr unsigned last_exported_exponent = 26;
+} // namespace
+
+void LatencyHistogram::record(const microseconds latency) noexcept
+{
+	const auto value = static_cast<std::uint64_t>(std::max(latency.count(), microseconds::rep(0)));
+
+	buckets[bucket_index(value != 0 ? value - 1 : 0)].fetch_add(1, std::memory_order_relaxed);
+	total_microseconds.fetch_add(value, std::memory_order_relaxed);
+	total_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencyHistogram::microseconds LatencyHistogram::sum() const noexcept
+{
+	return microseconds(static_cast<microseconds::rep>(total_microseconds.load(std::memory_order_relaxed)));
+}
+
+LatencyHistogram::microseconds LatencyHistogram::quantile(const double q) const noexcept
+{
+	const std::uint64_t total = count();
+	if (total == 0)
+		return microseconds(0);
+
+	const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(total))));
+
+	std::uint64_t cumulative = 0;
+	for (std::size_t i = 0; i < bucket_count; ++i)
+	{
+		cumulative += buckets[i].load(std::memory_order_relaxed);
+		if (cumulative >= rank)
+		{
+			const std::uint64_t upper_bound = i + 1 < bucket_count ? bucket_lower_bound(i + 1) : bucket_lower_bound(i);
+			return microseconds(static_cast<microseconds::rep>(upper_bound));
+		}
+	}
+
+	// Recorded while iterating
+	return microseconds(static_cast<microseconds::rep>(bucket_lower_bound(bucket_count - 1)));
+}
+
+std::uint64_t LatencyHistogram::count_at_most(const microseconds limit) const noexcept
+{
+	if (limit <= microseconds(0))
+		return 0;
+
+	const std::size_t last = bucket_index(static_cast<std::uint64_t>(limit.count()) - 1);
+
+	std::uint64_t at_most = 0;
+	for (std::size_t i = 0; i <= last; ++i)
+		at_most += buckets[i].load(std::memory_order_relaxed);
+
+	return at_most;
+}
+
+std::size_t LatencyHistogram::bucket_index(const std::uint64_t value) noexcept
+{
+	if (value < sub_bucket_count)
+		return static_cast<std::size_t>(value);
+
+	const unsigned exponent = floor_log2(value);
+	if (exponent > max_exponent)
+		return bucket_count - 1;
+
+	const std::uint64_t sub_bucket = (value >> (exponent - sub_bucket_bits)) & (sub_bucket_count - 1);
+	return sub_bucket_count + (exponent - sub_bucket_bits) * sub_bucket_count + static_cast<std::size_t>(sub_bucket);
+}
+
+std::uint64_t LatencyHistogram::bucket_lower_bound(const std::size_t index) noexcept
+{
+	assert(index < bucket_count);
+
+	if (index < sub_bucket_count)
+		return index;
+
+	const std::size_t exponent = (index - sub_bucket_count) / sub_bucket_count + sub_bucket_bits;
+	const std::size_t sub_bucket = (index - sub_bucket_count) % sub_bucket_count;
+
+	return static_cast<std::uint64_t>(sub_bucket_count + sub_bucket) << (exponent - sub_bucket_bits);
+}
+
+Counter & MetricsRegistry::counter(std::string name, std::string help)
+{
+	const std::lock_guard lock(mutex);
+
+	Metric & metric = metrics.emplace_back();
+	metric.name = std::move(name);
+	metric.help = std::move(help);
+	metric.type = Type::counter;
+	metric.counter = std::make_unique<Counter>();
+
+	return *metric.counter;
+}
+
+Gauge & MetricsRegistry::gauge(std::string name, std::string help)
+{
+	const std::lock_guard lock(mutex);
+
+	Metric & metric = metrics.emplace_back();
+	metric.name = std::move(name);
+	metric.help = std::move(help);
+	metric.type = Type::gauge;
+	metric.gauge = std::make_unique<Gauge>();
+
+	return *metric.gauge;
+}
+
+LatencyHistogram & MetricsRegistry::histogram(std::string name, std::string help)
+{
+	const std::lock_guard lock(mutex);
+
+	Metric & metric = metrics.emplace_back();
+	metric.name = std::move(name);
+	metric.help = std::move(help);
+	metric.type = Type::histogram;
+	metric.histogram = std::make_unique<LatencyHistogram>();
+
+	return *metric.histogram;
+}
+
+void MetricsRegistry::add_collector(std::function<void()> collector)
+{
+	const std::lock_guard lock(mutex);
+	collectors.push_back(std::move(collector));
+}
+
+std::string MetricsRegistry::to_prometheus_text()
+{
+	const std::lock_guard lock(mutex);
+
+	for (const std::function<void()> & collector : collectors)
+		collector();
+
+	std::string text;
+	for (const Metric & metric : metrics)
+	{
+		text += "# HELP " + metric.name + ' ' + metric.help + '\n';
+
+		switch (metric.type)
+		{
+			case Type::counter:
+				text += "# TYPE " + metric.name + " counter\n";
+				text += metric.name + ' ' + std::to_string(metric.counter->value()) + '\n';
+				break;
+
+			case Type::gauge:
+				text += "# TYPE " + metric.name + " gauge\n";
+				text += metric.name + ' ' + format_number(metric.gauge->value()) + '\n';
+				break;
+
+			case Type::histogram:
+			{
+				const LatencyHistogram & histogram = *metric.histogram;
+				const std::uint64_t count = histogram.count();
+
+				text += "# TYPE " + metric.name + " histogram\n";
+				for (unsigned exponent = first_exported_exponent; exponent <= last_exported_exponent; ++exponent)
+				{
+					const std::chrono::microseconds limit(std::int64_t(1) << exponent);
+					text += metric.name + "_bucket{le=\"" + format_number(to_seconds(limit)) + "\"} " + std::to_string(histogram.count_at_most(limit)) + '\n';
+				}
+				text += metric.name + "_bucket{le=\"+Inf\"} " + std::to_string(count) + '\n';
+				text += metric.name + "_sum " + format_number(to_seconds(histogram.sum())) + '\n';
+				text += metric.name + "_count " + std::to_string(count) + '\n';
+				break;
+			}
+		}
+	}
+
+	return text;
+}
+
+std::optional<std::size_t> resident_set_size() noexcept
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return std::nullopt;
+
+	return static_cast<std::size_t>(counters.WorkingSetSize);
+#elif defined(__linux__)
+	// Total program size and resident set size, in pages
+	std::FILE * const statm = std::fopen("/proc/self/statm", "r");
+	if (statm == nullptr)
+		return std::nullopt;
+
+	unsigned long long size_pages = 0;
+	unsigned long long resident_pages = 0;
+	const int read = std::fscanf(statm, "%llu %llu", &size_pages, &resident_pages);
+	std::fclose(statm);
+
+	const long page_size = sysconf(_SC_PAGESIZE);
+	if (read != 2 || page_size <= 0)
+		return std::nullopt;
+
+	return static_cast<std::size_t>(resident_pages * static_cast<unsigned long long>(page_size));
+#else
+	return std::nullopt;
+#endif
+}
+
+std::optional<std::size_t> peak_resident_set_size() noexcept
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return std::nullopt;
+
+	return static_cast<std::size_t>(counters.PeakWorkingSetSize);
+#elif defined(__linux__)
+	std::FILE * const status = std::fopen("/proc/self/status", "r");
+	if (status == nullptr)
+		return std::nullopt;
+
+	// "VmHWM:     1234 kB", the high water mark of the resident set size
+	std::optional<std::size_t> peak;
+	char line[256];
+	while (std::fgets(line, sizeof(line), status) != nullptr)
+	{
+		unsigned long long kilobytes = 0;
+		if (std::sscanf(line, "VmHWM: %llu kB", &kilobytes) == 1)
+		{
+			peak = static_cast<std::size_t>(kilobytes * 1024);
+			break;
+		}
+	}
+
+	std::fclose(status);
+	return peak;
+#else
+	return std::nullopt;
+#endif
+}
+
+std::optional<std::size_t> open_handle_count() noexcept
+{
+#if defined(_WIN32)
+	DWORD count = 0;
+	if (!GetProcessHandleCount(GetCurrentProcess(), &count))
+		return std::nullopt;
+
+	return static_cast<std::size_t>(count);
+#elif defined(__linux__)
+	// One entry per file descriptor
+	DIR * const directory = opendir("/proc/self/fd");
+	if (directory == nullptr)
+		return std::nullopt;
+
+	std::size_t count = 0;
+	while (const dirent * const entry = readdir(directory))
+	{
+		if (entry->d_name[0] != '.')
+			++count;
+	}
+
+	closedir(directory);
+
+	// Without the one used to read the directory
+	return count > 0 ? count - 1 : 0;
+#else
+	return std::nullopt;
+#endif
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Metrics recorded while the app runs and exported in the Prometheus text format.
+// Recording is lock-free and can be done from any thread
+
+class Counter
+{
+public:
+	void add(const std::uint64_t amount = 1) noexcept { total.fetch_add(amount, std::memory_order_relaxed); }
+
+	// For totals that are counted somewhere else
+	void set(const std::uint64_t total_) noexcept { total.store(total_, std::memory_order_relaxed); }
+
+	[[nodiscard]] std::uint64_t value() const noexcept { return total.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<std::uint64_t> total{ 0 };
+};
+
+class Gauge
+{
+public:
+	void set(const double value_) noexcept { current.store(value_, std::memory_order_relaxed); }
+	[[nodiscard]] double value() const noexcept { return current.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<double> current{ 0.0 };
+};
+
+// Log-linear buckets (like HdrHistogram): every power of two is split in 8 buckets,
+// so any latency from 1 us to days is kept with 12.5% precision in a fixed amount of memory.
+// A latency is recorded in the bucket it's the upper bound of, as the "le" buckets of Prometheus include it
+class LatencyHistogram
+{
+public:
+	using microseconds = std::chrono::microseconds;
+
+	static constexpr unsigned sub_bucket_bits = 3;
+	static constexpr std::size_t sub_bucket_count = std::size_t(1) << sub_bucket_bits;
+	static constexpr unsigned max_exponent = 40; // ~12 days
+	static constexpr std::size_t bucket_count = sub_bucket_count + (max_exponent - sub_bucket_bits + 1) * sub_bucket_count;
+
+	void record(microseconds latency) noexcept;
+
+	[[nodiscard]] std::uint64_t count() const noexcept { return total_count.load(std::memory_order_relaxed); }
+	[[nodiscard]] microseconds sum() const noexcept;
+
+	// Upper bound of the bucket the quantile is in. Zero if empty
+	[[nodiscard]] microseconds quantile(double q) const noexcept;
+
+	// Number of recorded latencies up to the limit, included. Exact for powers of two
+	[[nodiscard]] std::uint64_t count_at_most(microseconds limit) const noexcept;
+
+	[[nodiscard]] static std::size_t bucket_index(std::uint64_t value) noexcept;
+	[[nodiscard]] static std::uint64_t bucket_lower_bound(std::size_t index) noexcept;
+
+private:
+	std::array<std::atomic<std::uint64_t>, bucket_count> buckets{};
+	std::atomic<std::uint64_t> total_count{ 0 };
+	std::atomic<std::uint64_t> total_microseconds{ 0 };
+};
+
+class MetricsRegistry
+{
+public:
+	// The returned metrics live as long as the registry. Names follow the Prometheus conventions
+	[[nodiscard]] Counter & counter(std::string name, std::string help);
+	[[nodiscard]] Gauge & gauge(std::string name, std::string help);
+	[[nodiscard]] LatencyHistogram & histogram(std::string name, std::string help); // Exported in seconds
+
+	// Called before every export, to update the metrics that are sampled instead of recorded
+	void add_collector(std::function<void()> collector);
+
+	// Runs the collectors
+	[[nodiscard]] std::string to_prometheus_text();
+
+private:
+	enum class Type
+	{
+		counter,
+		gauge,
+		histogram,
+	};
+
+	struct Metric
+	{
+		std::string name;
+		std::string help;
+		Type type;
+
+		std::unique_ptr<Counter> counter;
+		std::unique_ptr<Gauge> gauge;
+		std::unique_ptr<LatencyHistogram> histogram;
+	};
+
+	std::mutex mutex;
+	std::vector<Metric> metrics;
+	std::vector<std::function<void()>> collectors;
+};
+
+// Physical memory used by the process, if the platform can tell
+[[nodiscard]] std::optional<std::size_t> resident_set_size() noexcept;
+
+// The most physical memory the process has used so far, if the platform can tell
+[[nodiscard]] std::optional<std::size_t> peak_resident_set_size() noexcept;
+
+// Files, sockets and other kernel objects the process has open, if the platform can tell
+[[nodiscard]] std::optional<std::size_t> open_handle_count() noexcept;
@@ -0,0 +1,107 @@
+#include "metrics_exporter.hh"
+
+#include <cassert>
+
+#include <QSaveFile>
+
+namespace
+{
+	// Nothing a scraper sends comes close
+	constexpr qint64 max_request_size = 16 * 1024;
+} // namespace
+
+MetricsExporter::MetricsExporter(MetricsRegistry & registry_, QObject * parent)
+	: QObject(parent)
+	, registry(registry_)
+{
+}
+
+MetricsExporter::~MetricsExporter()
+{
+	if (dump_timer != nullptr)
+		(void)dump();
+}
+
+bool MetricsExporter::listen(const quint16 port, const QHostAddress & address)
+{
+	if (server == nullptr)
+	{
+		server = new QTcpServer(this);
+		connect(server, &QTcpServer::newConnection, this, &MetricsExporter::on_new_connection);
+	}
+
+	return server->listen(address, port);
+}
+
+QString MetricsExporter::error_string() const
+{
+	return server != nullptr ? server->errorString() : QString();
+}
+
+void MetricsExporter::dump_periodically(const QString & path, const std::chrono::milliseconds interval)
+{
+	dump_path = path;
+
+	if (dump_timer == nullptr)
+	{
+		dump_timer = new QTimer(this);
+		connect(dump_timer, &QTimer::timeout, this, [this] { (void)dump(); });
+	}
+
+	dump_timer->start(static_cast<int>(interval.count()));
+}
+
+bool MetricsExporter::dump()
+{
+	if (dump_path.isEmpty())
+		return false;
+
+	const std::string text = registry.to_prometheus_text();
+
+	QSaveFile file(dump_path);
+	if (!file.open(QIODevice::OpenModeFlag::WriteOnly))
+		return false;
+
+	file.write(text.data(), static_cast<qint64>(text.size()));
+	return file.commit();
+}
+
+void MetricsExporter::on_new_connection()
+{
+	assert(server != nullptr);
+
+	while (QTcpSocket * const socket = server->nextPendingConnection())
+	{
+		connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+		connect(socket, &QTcpSocket::readyRead, this, [this, socket] { on_request_data(socket); });
+	}
+}
+
+void MetricsExporter::on_request_data(QTcpSocket * const socket)
+{
+	assert(socket != nullptr);
+
+	// The request itself doesn't matter, only that it's complete (headers end with an empty line)
+	if (socket->bytesAvailable() > max_request_size)
+	{
+		socket->abort();
+		return;
+	}
+
+	if (!socket->peek(max_request_size).contains("\r\n\r\n"))
+		return;
+
+	socket->readAll();
+	disconnect(socket, &QTcpSocket::readyRead, this, nullptr);
+
+	const std::string body = registry.to_prometheus_text();
+	const QByteArray header = "HTTP/1.1 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+		"Content-Length: " + QByteArray::number(static_cast<qulonglong>(body.size())) + "\r\n"
+		"Connection: close\r\n"
+		"\r\n";
+
+	socket->write(header);
+	socket->write(body.data(), static_cast<qint64>(body.size()));
+	socket->disconnectFromHost();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "metrics.hh"
+
+#include <chrono>
+
+#include <QHostAddress>
+#include <QObject>
+#include <QString>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+// Serves the metrics of a registry over HTTP (Prometheus text format) and/or dumps them to a file periodically
+class MetricsExporter : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit MetricsExporter(MetricsRegistry & registry, QObject * parent = nullptr);
+	~MetricsExporter() override;
+
+	// Only reachable from this machine by default. Any path is answered with the metrics
+	[[nodiscard]] bool listen(quint16 port, const QHostAddress & address = QHostAddress::LocalHost);
+	[[nodiscard]] QString error_string() const;
+
+	// The file is replaced atomically every time
+	void dump_periodically(const QString & path, std::chrono::milliseconds interval);
+
+	// Also done when destroyed, if dumping periodically
+	[[nodiscard]] bool dump();
+
+private:
+	void on_new_connection();
+	void on_request_data(QTcpSocket * socket);
+
+	MetricsRegistry & registry;
+
+	QTcpServer * server = nullptr;
+
+	QTimer * dump_timer = nullptr;
+	QString dump_path;
+};
@@ -0,0 +1,139 @@
+#include "motion_path.hh"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	[[nodiscard]] constexpr AnnotationRect to_annotation_rect(const Annotation::RectRegion & region) noexcept
+	{
+		return { region.x, region.y, region.width, region.height };
+	}
+
+	[[nodiscard]] constexpr bool same_geometry(const Annotation::RectRegion & lhs, const Annotation::RectRegion & rhs) noexcept
+	{
+		return lhs.x == rhs.x && lhs.y == rhs.y && lhs.width == rhs.width && lhs.height == rhs.height;
+	}
+
+	[[nodiscard]] constexpr float lerp(const float from, const float to, const float t) noexcept
+	{
+		return from + (to - from) * t;
+	}
+} // namespace
+
+MotionPaths::MotionPaths(const std::vector<Annotation> & annotations)
+{
+	first_keyframe.reserve(annotations.size() + 1);
+	keyframe_times.reserve(annotations.size());
+	keyframe_rects.reserve(annotations.size());
+
+	std::vector<const Annotation::RectRegion *> keyframes;
+
+	for (const Annotation & annotation : annotations)
+	{
+		first_keyframe.push_back(static_cast<std::uint32_t>(keyframe_times.size()));
+
+		keyframes.clear();
+		keyframes.push_back(&annotation.start_rect);
+		for (const Annotation::RectRegion & region : annotation.intermediate_rects)
+			keyframes.push_back(&region);
+		if (annotation.end_rect.has_value())
+			keyframes.push_back(&*annotation.end_rect);
+
+		const bool moving = std::any_of(keyframes.begin() + 1, keyframes.end(), [&annotation](const Annotation::RectRegion * region)
+		{
+			return !same_geometry(*region, annotation.start_rect);
+		});
+
+		if (!moving)
+		{
+			keyframe_times.push_back(static_cast<std::int32_t>(annotation.start_rect.time.count()));
+			keyframe_rects.push_back(to_annotation_rect(annotation.start_rect));
+			continue;
+		}
+
+		std::stable_sort(keyframes.begin(), keyframes.end(), [](const Annotation::RectRegion * lhs, const Annotation::RectRegion * rhs)
+		{
+			return lhs->time < rhs->time;
+		});
+
+		for (const Annotation::RectRegion * region : keyframes)
+		{
+			keyframe_times.push_back(static_cast<std::int32_t>(region->time.count()));
+			keyframe_rects.push_back(to_annotation_rect(*region));
+		}
+	}
+
+	first_keyframe.push_back(static_cast<std::uint32_t>(keyframe_times.size()));
+}
+
+bool MotionPaths::is_moving(const int annotation_index) const noexcept
+{
+	assert(annotation_index >= 0 && static_cast<std::size_t>(annotation_index) < size());
+	const auto index = static_cast<std::size_t>(annotation_index);
+
+	return first_keyframe[index + 1] - first_keyframe[index] > 1;
+}
+
+MotionPaths::Sample MotionPaths::sample(const int annotation_index, const microseconds time) const noexcept
+{
+	assert(annotation_index >= 0 && static_cast<std::size_t>(annotation_index) < size());
+	const auto index = static_cast<std::size_t>(annotation_index);
+
+	const std::uint32_t begin = first_keyframe[index];
+	const std::uint32_t end = first_keyframe[index + 1];
+	assert(end > begin);
+
+	const auto times_begin = keyframe_times.begin() + begin;
+	const auto times_end = keyframe_times.begin() + end;
+
+	const auto time_ms = static_cast<std::int32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(time).count());
+
+	// First keyframe after `time`
+	const auto next = std::upper_bound(times_begin, times_end, time_ms);
+	if (next == times_begin)
+		return { begin, begin, 0.0f };
+	if (next == times_end)
+		return { end - 1, end - 1, 0.0f };
+
+	const auto next_index = static_cast<std::uint32_t>(next - keyframe_times.begin());
+	const auto previous_index = next_index - 1;
+
+	const auto segment_start = microseconds(std::chrono::milliseconds(keyframe_times[previous_index]));
+	const auto segment_end = microseconds(std::chrono::milliseconds(keyframe_times[next_index]));
+	const float t = static_cast<float>((time - segment_start).count()) / static_cast<float>((segment_end - segment_start).count());
+
+	return { previous_index, next_index, t };
+}
+
+AnnotationRect MotionPaths::evaluate(const int annotation_index, const microseconds time) const noexcept
+{
+	const Sample geometry_sample = sample(annotation_index, time);
+
+	const AnnotationRect & from = keyframe_rects[geometry_sample.from];
+	const AnnotationRect & to = keyframe_rects[geometry_sample.to];
+
+	return {
+		lerp(from.x, to.x, geometry_sample.t),
+		lerp(from.y, to.y, geometry_sample.t),
+		lerp(from.width, to.width, geometry_sample.t),
+		lerp(from.height, to.height, geometry_sample.t),
+	};
+}
+
+std::size_t MotionPaths::memory_usage() const noexcept
+{
+	return sizeof(*this)
+		+ first_keyframe.capacity() * sizeof(std::uint32_t)
+		+ keyframe_times.capacity() * sizeof(std::int32_t)
+		+ keyframe_rects.capacity() * sizeof(AnnotationRect);
+}
+
+void MotionPaths::evaluate(const microseconds time, const std::vector<int> & annotation_indices, std::vector<AnnotationRect> & out_rects) const
+{
+	out_rects.resize(annotation_indices.size());
+
+	const std::size_t count = annotation_indices.size();
+	for (std::size_t i = 0; i < count; ++i)
+		out_rects[i] = evaluate(annotation_indices[i], time);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "annotations.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Geometry of an annotation, in percentage of the video size
+struct AnnotationRect
+{
+	float x;
+	float y;
+	float width;
+	float height;
+};
+
+// Keyframed geometry of all the annotations of a video, stored in flat arrays.
+// Annotations that don't move (all of them in the current data) take a single keyframe.
+// Between keyframes the geometry is linearly interpolated
+class MotionPaths
+{
+public:
+	using microseconds = std::chrono::microseconds;
+
+	// Geometry at some time = lerp(keyframes()[from], keyframes()[to], t)
+	struct Sample
+	{
+		std::uint32_t from;
+		std::uint32_t to;
+		float t;
+	};
+
+	MotionPaths() = default;
+	explicit MotionPaths(const std::vector<Annotation> & annotations);
+
+	[[nodiscard]] bool is_moving(int annotation_index) const noexcept;
+	[[nodiscard]] Sample sample(int annotation_index, microseconds time) const noexcept;
+	[[nodiscard]] AnnotationRect evaluate(int annotation_index, microseconds time) const noexcept;
+
+	// out_rects[i] = geometry of annotation_indices[i] at `time`. Doesn't allocate if out_rects has enough capacity
+	void evaluate(microseconds time, const std::vector<int> & annotation_indices, std::vector<AnnotationRect> & out_rects) const;
+
+	[[nodiscard]] std::size_t size() const noexcept { return first_keyframe.empty() ? 0 : first_keyframe.size() - 1; }
+	[[nodiscard]] std::size_t keyframe_count() const noexcept { return keyframe_times.size(); }
+	[[nodiscard]] const std::vector<AnnotationRect> & keyframes() const noexcept { return keyframe_rects; }
+
+	[[nodiscard]] std::size_t memory_usage() const noexcept;
+
+private:
+	// The keyframes of annotation i are [first_keyframe[i], first_keyframe[i + 1])
+	std::vector<std::uint32_t> first_keyframe;
+	std::vector<std::int32_t> keyframe_times; // In milliseconds
+	std::vector<AnnotationRect> keyframe_rects;
+};
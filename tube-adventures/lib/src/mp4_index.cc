@@ -0,0 +1,310 @@
+#include "mp4_index.hh"
+
+#include <optional>
+
+#include <QFile>
+
+namespace
+{
+	struct Bytes
+	{
+		const std::uint8_t * data;
+		std::size_t size;
+	};
+
+	[[nodiscard]] constexpr std::uint32_t fourcc(const char (&name)[5]) noexcept
+	{
+		return (std::uint32_t(std::uint8_t(name[0])) << 24)
+			| (std::uint32_t(std::uint8_t(name[1])) << 16)
+			| (std::uint32_t(std::uint8_t(name[2])) << 8)
+			| std::uint32_t(std::uint8_t(name[3]));
+	}
+
+	// Big endian
+	[[nodiscard]] std::uint32_t read_u32(const std::uint8_t * const data) noexcept
+	{
+		return (std::uint32_t(data[0]) << 24) | (std::uint32_t(data[1]) << 16) | (std::uint32_t(data[2]) << 8) | std::uint32_t(data[3]);
+	}
+
+	[[nodiscard]] std::uint64_t read_u64(const std::uint8_t * const data) noexcept
+	{
+		return (std::uint64_t(read_u32(data)) << 32) | std::uint64_t(read_u32(data + 4));
+	}
+
+	[[nodiscard]] std::chrono::microseconds to_microseconds(const std::uint64_t value, const std::uint32_t timescale) noexcept
+	{
+		const std::uint64_t seconds = value / timescale;
+		const std::uint64_t remainder = value % timescale;
+
+		return std::chrono::microseconds(static_cast<std::int64_t>(seconds * 1'000'000 + remainder * 1'000'000 / timescale));
+	}
+
+	// Calls on_box(type, payload) for each of the boxes in `bytes` until it returns false
+	template<typename OnBox>
+	[[nodiscard]] Mp4Error for_each_box(const Bytes bytes, OnBox && on_box)
+	{
+		std::size_t offset = 0;
+		while (offset < bytes.size)
+		{
+			const std::size_t remaining = bytes.size - offset;
+			if (remaining < 8)
+				return Mp4Error::truncated;
+
+			const std::uint8_t * const box = bytes.data + offset;
+			std::uint64_t box_size = read_u32(box);
+			const std::uint32_t type = read_u32(box + 4);
+			std::size_t header_size = 8;
+
+			if (box_size == 1) // 64 bit size after the type
+			{
+				if (remaining < 16)
+					return Mp4Error::truncated;
+
+				box_size = read_u64(box + 8);
+				header_size = 16;
+			}
+			else if (box_size == 0) // Until the end of the file
+				box_size = remaining;
+
+			if (box_size < header_size)
+				return Mp4Error::invalid_format;
+			if (box_size > remaining)
+				return Mp4Error::truncated;
+
+			if (!on_box(type, Bytes{ box + header_size, static_cast<std::size_t>(box_size) - header_size }))
+				return Mp4Error::success;
+
+			offset += static_cast<std::size_t>(box_size);
+		}
+
+		return Mp4Error::success;
+	}
+
+	[[nodiscard]] Mp4Error find_box(const Bytes bytes, const std::uint32_t type, std::optional<Bytes> & out_box)
+	{
+		out_box.reset();
+
+		return for_each_box(bytes, [type, &out_box](const std::uint32_t box_type, const Bytes payload)
+		{
+			if (box_type != type)
+				return true;
+
+			out_box = payload;
+			return false;
+		});
+	}
+
+	struct TimescaleAndDuration
+	{
+		std::uint32_t timescale;
+		std::uint64_t duration;
+	};
+
+	// mvhd and mdhd start the same way
+	[[nodiscard]] std::optional<TimescaleAndDuration> read_header_box(const Bytes box) noexcept
+	{
+		if (box.size < 4)
+			return std::nullopt;
+
+		const std::uint8_t version = box.data[0];
+		if (version == 1)
+		{
+			if (box.size < 32)
+				return std::nullopt;
+
+			return TimescaleAndDuration{ read_u32(box.data + 20), read_u64(box.data + 24) };
+		}
+
+		if (box.size < 20)
+			return std::nullopt;
+
+		return TimescaleAndDuration{ read_u32(box.data + 12), read_u32(box.data + 16) };
+	}
+
+	struct SampleTables
+	{
+		Bytes stts;
+		std::optional<Bytes> stss; // All the samples are sync samples if missing
+	};
+
+	// Fills `info` with the data of the sample tables of a track
+	[[nodiscard]] Mp4Error read_sample_tables(const SampleTables & tables, const std::uint32_t timescale, Mp4VideoInfo & info)
+	{
+		if (tables.stts.size < 8)
+			return Mp4Error::invalid_format;
+
+		const std::uint32_t time_to_sample_count = read_u32(tables.stts.data + 4);
+		if ((tables.stts.size - 8) / 8 < time_to_sample_count)
+			return Mp4Error::truncated;
+
+		const std::uint8_t * const time_to_sample = tables.stts.data + 8;
+
+		std::uint64_t sample_count = 0;
+		std::uint64_t media_duration = 0;
+		for (std::uint32_t i = 0; i < time_to_sample_count; ++i)
+		{
+			const std::uint32_t count = read_u32(time_to_sample + i * 8);
+			const std::uint32_t delta = read_u32(time_to_sample + i * 8 + 4);
+
+			sample_count += count;
+			media_duration += std::uint64_t(count) * delta;
+		}
+
+		info.frame_count = static_cast<std::uint32_t>(sample_count);
+		if (sample_count > 0 && media_duration > 0)
+		{
+			info.frame_duration = to_microseconds(media_duration / sample_count, timescale);
+			info.frame_rate = static_cast<float>(sample_count) * static_cast<float>(timescale) / static_cast<float>(media_duration);
+		}
+
+		if (!tables.stss.has_value())
+			return Mp4Error::success;
+
+		if (tables.stss->size < 8)
+			return Mp4Error::invalid_format;
+
+		const std::uint32_t sync_sample_count = read_u32(tables.stss->data + 4);
+		if ((tables.stss->size - 8) / 4 < sync_sample_count)
+			return Mp4Error::truncated;
+
+		info.keyframe_times.reserve(sync_sample_count);
+
+		// Both tables are sorted by sample number, so they are walked at the same time
+		std::uint32_t run = 0;
+		std::uint64_t run_first_sample = 1; // Sample numbers start at 1
+		std::uint64_t run_start_time = 0;
+		for (std::uint32_t i = 0; i < sync_sample_count; ++i)
+		{
+			const std::uint32_t sample_number = read_u32(tables.stss->data + 8 + i * 4);
+
+			for (; run < time_to_sample_count; ++run)
+			{
+				const std::uint32_t count = read_u32(time_to_sample + run * 8);
+				if (sample_number < run_first_sample + count)
+					break;
+
+				run_first_sample += count;
+				run_start_time += std::uint64_t(count) * read_u32(time_to_sample + run * 8 + 4);
+			}
+
+			if (run == time_to_sample_count || sample_number < run_first_sample)
+				return Mp4Error::invalid_format;
+
+			const std::uint32_t delta = read_u32(time_to_sample + run * 8 + 4);
+			info.keyframe_times.push_back(to_microseconds(run_start_time + (sample_number - run_first_sample) * delta, timescale));
+		}
+
+		return Mp4Error::success;
+	}
+
+	// Returns success and leaves `info` untouched if the track isn't a video track
+	[[nodiscard]] Mp4Error read_track(const Bytes trak, bool & out_is_video, Mp4VideoInfo & info)
+	{
+		out_is_video = false;
+
+		std::optional<Bytes> mdia, hdlr, mdhd, minf, stbl, stts, stss;
+
+		if (const Mp4Error error = find_box(trak, fourcc("mdia"), mdia); error != Mp4Error::success || !mdia.has_value())
+			return error;
+
+		if (const Mp4Error error = find_box(*mdia, fourcc("hdlr"), hdlr); error != Mp4Error::success || !hdlr.has_value())
+			return error;
+
+		if (hdlr->size < 12)
+			return Mp4Error::invalid_format;
+		if (read_u32(hdlr->data + 8) != fourcc("vide"))
+			return Mp4Error::success;
+
+		out_is_video = true;
+
+		if (const Mp4Error error = find_box(*mdia, fourcc("mdhd"), mdhd); error != Mp4Error::success)
+			return error;
+		if (const Mp4Error error = find_box(*mdia, fourcc("minf"), minf); error != Mp4Error::success)
+			return error;
+		if (!mdhd.has_value() || !minf.has_value())
+			return Mp4Error::invalid_format;
+
+		if (const Mp4Error error = find_box(*minf, fourcc("stbl"), stbl); error != Mp4Error::success)
+			return error;
+		if (!stbl.has_value())
+			return Mp4Error::invalid_format;
+
+		if (const Mp4Error error = find_box(*stbl, fourcc("stts"), stts); error != Mp4Error::success)
+			return error;
+		if (const Mp4Error error = find_box(*stbl, fourcc("stss"), stss); error != Mp4Error::success)
+			return error;
+		if (!stts.has_value())
+			return Mp4Error::invalid_format;
+
+		const std::optional<TimescaleAndDuration> media_header = read_header_box(*mdhd);
+		if (!media_header.has_value() || media_header->timescale == 0)
+			return Mp4Error::invalid_format;
+
+		info.duration = to_microseconds(media_header->duration, media_header->timescale);
+
+		return read_sample_tables({ *stts, stss }, media_header->timescale, info);
+	}
+} // namespace
+
+Mp4ParseResult parse_mp4(const std::uint8_t * const data, const std::size_t size)
+{
+	// The moov box can be anywhere at the top level. The media data before it is skipped without reading it
+	std::optional<Bytes> moov;
+	if (const Mp4Error error = find_box(Bytes{ data, size }, fourcc("moov"), moov); !moov.has_value())
+		return { (error == Mp4Error::success) ? Mp4Error::no_moov : error, {} };
+
+	Mp4ParseResult result{ Mp4Error::no_video_track, {} };
+
+	const Mp4Error moov_error = for_each_box(*moov, [&result](const std::uint32_t type, const Bytes payload)
+	{
+		if (type != fourcc("trak"))
+			return true;
+
+		bool is_video = false;
+		result.error = read_track(payload, is_video, result.info);
+		if (result.error == Mp4Error::success && !is_video)
+			result.error = Mp4Error::no_video_track;
+
+		return !is_video && (result.error == Mp4Error::success || result.error == Mp4Error::no_video_track);
+	});
+
+	if (moov_error != Mp4Error::success)
+		return { moov_error, {} };
+	if (result.error != Mp4Error::success)
+		return { result.error, {} };
+
+	// The duration of the presentation can be different (e.g. longer audio track)
+	std::optional<Bytes> mvhd;
+	if (const Mp4Error error = find_box(*moov, fourcc("mvhd"), mvhd); error != Mp4Error::success)
+		return { error, {} };
+
+	if (mvhd.has_value())
+	{
+		if (const std::optional<TimescaleAndDuration> movie_header = read_header_box(*mvhd); movie_header.has_value() && movie_header->timescale != 0)
+			result.info.duration = to_microseconds(movie_header->duration, movie_header->timescale);
+	}
+
+	return result;
+}
+
+Mp4ParseResult read_mp4_file(const std::filesystem::path & filename)
+{
+	const auto filename_utf8 = filename.u8string();
+	QFile file(QString::fromUtf8(reinterpret_cast<const char *>(filename_utf8.data()), static_cast<int>(filename_utf8.size())));
+
+	if (!file.open(QIODevice::ReadOnly))
+		return { Mp4Error::cannot_open_file, {} };
+
+	const qint64 file_size = file.size();
+	if (file_size <= 0)
+		return { Mp4Error::no_moov, {} };
+
+	const uchar * const mapped = file.map(0, file_size);
+	if (mapped == nullptr)
+		return { Mp4Error::cannot_open_file, {} };
+
+	Mp4ParseResult result = parse_mp4(mapped, static_cast<std::size_t>(file_size));
+
+	file.unmap(const_cast<uchar *>(mapped));
+	return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// What can be known about the video track of an MP4 (ISO base media) file without decoding it
+struct Mp4VideoInfo
+{
+	std::chrono::microseconds duration{ 0 };
+	std::chrono::microseconds frame_duration{ 0 }; // Average. 0 if the track has no samples
+	float frame_rate = 0.0f;
+	std::uint32_t frame_count = 0;
+
+	std::vector<std::chrono::microseconds> keyframe_times; // Decode times of the sync samples, sorted
+};
+
+enum class Mp4Error
+{
+	success,
+	cannot_open_file,
+	truncated, // A box claims to be bigger than its parent
+	no_moov,
+	no_video_track,
+	invalid_format,
+};
+
+struct Mp4ParseResult
+{
+	Mp4Error error;
+	Mp4VideoInfo info;
+};
+
+// Reads the `moov` box of the file (which can be after the media data), from `mvhd` and the first
+// video track's `mdhd`, `hdlr`, `stts` and `stss`. Edit lists and composition offsets are ignored
+[[nodiscard]] Mp4ParseResult parse_mp4(const std::uint8_t * data, std::size_t size);
+
+// Memory maps the file, so only the pages of the boxes that are actually read are loaded
+[[nodiscard]] Mp4ParseResult read_mp4_file(const std::filesystem::path & filename);
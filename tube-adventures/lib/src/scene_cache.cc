@@ -0,0 +1,40 @@
+#include "scene_cache.hh"
+
+#include <utility>
+
+std::size_t memory_usage(const Scene & scene) noexcept
+{
+	std::size_t usage = sizeof(Scene)
+		+ (scene.annotations.capacity() - scene.annotations.size()) * sizeof(Annotation)
+		+ scene.timeline.memory_usage()
+		+ scene.motion_paths.memory_usage()
+		+ scene.layout.memory_usage()
+		+ scene.video_url.capacity()
+		+ scene.video_info.keyframe_times.capacity() * sizeof(std::chrono::microseconds);
+
+	for (const Annotation & annotation : scene.annotations)
+		usage += memory_usage(annotation);
+
+	return usage;
+}
+
+SceneCache::SceneCache(const std::size_t memory_budget_) noexcept
+	: cache(memory_budget_)
+{
+}
+
+std::optional<Scene> SceneCache::take(const std::string & key)
+{
+	return cache.take(key);
+}
+
+void SceneCache::insert(const std::string & key, Scene scene)
+{
+	const std::size_t scene_memory_usage = ::memory_usage(scene);
+	cache.insert(key, std::move(scene), scene_memory_usage);
+}
+
+void SceneCache::clear() noexcept
+{
+	cache.clear();
+}
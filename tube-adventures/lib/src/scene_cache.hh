@@ -0,0 +1,58 @@
+#pragma once
+
+#include "annotations.hh"
+#include "annotation_layout.hh"
+#include "annotation_timeline.hh"
+#include "lru_cache.hh"
+#include "motion_path.hh"
+#include "mp4_index.hh"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// Everything needed to play a video again without reparsing or relaying out anything
+struct Scene
+{
+	std::vector<Annotation> annotations;
+	AnnotationTimeline timeline;
+	MotionPaths motion_paths;
+	AnnotationLayout layout;
+
+	std::string video_url; // UTF-8
+	int video_width = 0; // 0 if unknown
+	int video_height = 0;
+
+	Mp4VideoInfo video_info;
+};
+
+// Approximate amount of memory owned by the scene, in bytes
+[[nodiscard]] std::size_t memory_usage(const Scene & scene) noexcept;
+
+// Least recently used cache of the scenes that aren't being played, with a memory budget.
+// Scenes are moved in and out of the cache, so the scene being played is never in it
+class SceneCache
+{
+public:
+	static constexpr std::size_t default_memory_budget = 32 * 1024 * 1024;
+
+	using Stats = LruCache<std::string, Scene>::Stats;
+
+	explicit SceneCache(std::size_t memory_budget = default_memory_budget) noexcept;
+
+	// Removes the scene from the cache and returns it, if it's there
+	[[nodiscard]] std::optional<Scene> take(const std::string & key);
+
+	// Evicts the least recently used scenes until it fits. Scenes bigger than the whole budget aren't kept
+	void insert(const std::string & key, Scene scene);
+
+	void clear() noexcept;
+
+	[[nodiscard]] std::size_t size() const noexcept { return cache.size(); }
+	[[nodiscard]] std::size_t memory_usage() const noexcept { return cache.cost(); }
+	[[nodiscard]] std::size_t memory_budget() const noexcept { return cache.budget(); }
+	[[nodiscard]] const Stats & stats() const noexcept { return cache.stats(); }
+
+private:
+	LruCache<std::string, Scene> cache;
+};
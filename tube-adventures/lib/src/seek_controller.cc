@@ -0,0 +1,152 @@
+#include "seek_controller.hh"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std::chrono_literals;
+
+SeekController::SeekController(SeekFunction seek_)
+	: seek(std::move(seek_))
+{
+	assert(seek);
+}
+
+void SeekController::set_duration(const milliseconds duration_) noexcept
+{
+	duration = duration_;
+}
+
+void SeekController::set_keyframes(std::vector<milliseconds> keyframes_)
+{
+	assert(std::is_sorted(keyframes_.begin(), keyframes_.end()));
+	keyframes = std::move(keyframes_);
+}
+
+void SeekController::reset() noexcept
+{
+	duration = 0ms;
+	keyframes.clear();
+
+	target.reset();
+	pending.reset();
+	last_issued.reset();
+	in_flight_since.reset();
+}
+
+void SeekController::seek_to(const milliseconds requested_target, const bool coarse, const clock::time_point now)
+{
+	++seek_stats.requests;
+	last_request_time = now;
+
+	const milliseconds exact_target = clamp(requested_target);
+	target = exact_target;
+
+	milliseconds destination = exact_target;
+	if (coarse && !keyframes.empty())
+	{
+		destination = clamp(closest_keyframe(exact_target));
+		if (destination != exact_target)
+			++seek_stats.seeks_snapped_to_keyframe;
+	}
+
+	if (has_seek_in_flight())
+	{
+		if (pending.has_value())
+			++seek_stats.requests_coalesced;
+
+		pending = destination;
+		return;
+	}
+
+	issue(destination, now);
+}
+
+void SeekController::seek_by(const milliseconds offset, const milliseconds current_position, const bool coarse, const clock::time_point now)
+{
+	seek_to(target.value_or(current_position) + offset, coarse, now);
+}
+
+void SeekController::on_seek_completed(const clock::time_point now)
+{
+	if (!has_seek_in_flight())
+		return;
+
+	in_flight_since.reset();
+
+	if (pending.has_value())
+	{
+		issue_pending(now);
+		return;
+	}
+
+	// The exact target was reached. Otherwise it's sought once the requests settle
+	if (target.has_value() && last_issued == target)
+		target.reset();
+}
+
+void SeekController::on_timeout(const clock::time_point now)
+{
+	if (has_seek_in_flight() && now - *in_flight_since >= in_flight_timeout)
+		on_seek_completed(now);
+
+	if (has_seek_in_flight() || !target.has_value() || now - last_request_time < settle_time)
+		return;
+
+	if (last_issued != target)
+		issue(*target, now);
+	else
+		target.reset();
+}
+
+std::optional<SeekController::clock::time_point> SeekController::next_deadline() const noexcept
+{
+	if (has_seek_in_flight())
+		return *in_flight_since + in_flight_timeout;
+
+	if (target.has_value())
+		return last_request_time + settle_time;
+
+	return std::nullopt;
+}
+
+SeekController::milliseconds SeekController::closest_keyframe(const milliseconds position) const noexcept
+{
+	if (keyframes.empty())
+		return position;
+
+	const auto next = std::lower_bound(keyframes.begin(), keyframes.end(), position);
+	if (next == keyframes.begin())
+		return *next;
+	if (next == keyframes.end())
+		return keyframes.back();
+
+	const milliseconds previous = *std::prev(next);
+	return (position - previous <= *next - position) ? previous : *next;
+}
+
+SeekController::milliseconds SeekController::clamp(const milliseconds position) const noexcept
+{
+	if (duration <= 0ms)
+		return std::max(position, 0ms);
+
+	return std::clamp(position, 0ms, std::max(0ms, duration - 1s));
+}
+
+void SeekController::issue(const milliseconds position, const clock::time_point now)
+{
+	++seek_stats.seeks_issued;
+	last_issued = position;
+	in_flight_since = now;
+
+	seek(position);
+}
+
+void SeekController::issue_pending(const clock::time_point now)
+{
+	assert(pending.has_value());
+
+	const milliseconds position = *pending;
+	pending.reset();
+
+	issue(position, now);
+}
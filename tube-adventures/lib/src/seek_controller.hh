@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+// Sits between the seek requests (e.g. auto-repeated arrow keys) and the media backend.
+// Requests made while a seek is in flight are coalesced into the latest target, so at most
+// one seek is in flight at any time. Coarse seeks are snapped to the closest keyframe (if they
+// are known), which is much faster to decode, and the exact target is only sought once the
+// requests stop
+class SeekController
+{
+public:
+	using milliseconds = std::chrono::milliseconds;
+	using clock = std::chrono::steady_clock;
+
+	using SeekFunction = std::function<void(milliseconds position)>;
+
+	// Time without requests after which the exact target is sought
+	static constexpr milliseconds settle_time{ 250 };
+
+	// If the backend doesn't report the seek as completed in this time, it's assumed it was
+	static constexpr milliseconds in_flight_timeout{ 500 };
+
+	struct Stats
+	{
+		std::int64_t requests = 0;
+		std::int64_t seeks_issued = 0;
+		std::int64_t requests_coalesced = 0; // Superseded by a later request before being issued
+		std::int64_t seeks_snapped_to_keyframe = 0;
+	};
+
+	explicit SeekController(SeekFunction seek);
+
+	// Seeks are clamped to [0, duration - 1s]. Unknown (no clamping to the end) if <= 0
+	void set_duration(milliseconds duration) noexcept;
+
+	// Presentation times of the keyframes of the video, sorted. Empty if not known
+	void set_keyframes(std::vector<milliseconds> keyframes);
+
+	// Forgets everything about the current video, e.g. when another one is loaded
+	void reset() noexcept;
+
+	void seek_to(milliseconds target, bool coarse, clock::time_point now);
+
+	// Relative to the latest target if there is a seek in progress, or else to `current_position`,
+	// so repeated requests accumulate even if the backend hasn't caught up yet
+	void seek_by(milliseconds offset, milliseconds current_position, bool coarse, clock::time_point now);
+
+	// Has to be called when the backend shows the result of the last issued seek (e.g. a new frame)
+	void on_seek_completed(clock::time_point now);
+
+	// Has to be called at next_deadline()
+	void on_timeout(clock::time_point now);
+
+	// When on_timeout has to be called next, if at all
+	[[nodiscard]] std::optional<clock::time_point> next_deadline() const noexcept;
+
+	[[nodiscard]] bool is_seeking() const noexcept { return target.has_value(); }
+	[[nodiscard]] bool has_seek_in_flight() const noexcept { return in_flight_since.has_value(); }
+	[[nodiscard]] std::optional<milliseconds> current_target() const noexcept { return target; }
+	[[nodiscard]] const Stats & stats() const noexcept { return seek_stats; }
+
+	// Keyframe closest to `position`, or `position` if no keyframes are known
+	[[nodiscard]] milliseconds closest_keyframe(milliseconds position) const noexcept;
+
+private:
+	[[nodiscard]] milliseconds clamp(milliseconds position) const noexcept;
+	void issue(milliseconds position, clock::time_point now);
+	void issue_pending(clock::time_point now);
+
+	SeekFunction seek;
+	milliseconds duration{ 0 };
+	std::vector<milliseconds> keyframes;
+
+	std::optional<milliseconds> target; // Exact position requested last, until it's reached
+	std::optional<milliseconds> pending; // To be issued when the in flight seek completes
+	std::optional<milliseconds> last_issued;
+	std::optional<clock::time_point> in_flight_since;
+	clock::time_point last_request_time{};
+
+	Stats seek_stats;
+};
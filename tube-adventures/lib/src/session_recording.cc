@@ -0,0 +1,201 @@
+#include "session_recording.hh"
+#include "binary_io.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+	constexpr char magic[4] = { 'T', 'A', 'S', 'R' };
+	constexpr std::uint8_t format_version = 1;
+
+	constexpr std::size_t flush_threshold = 64 * 1024;
+
+	// How many of value and second_value are stored
+	[[nodiscard]] constexpr int value_count(const SessionEvent::Type type) noexcept
+	{
+		switch (type)
+		{
+			case SessionEvent::Type::go_back:
+			case SessionEvent::Type::update:
+			case SessionEvent::Type::end_of_media:
+				return 0;
+
+			case SessionEvent::Type::load_scene:
+			case SessionEvent::Type::activate_annotation:
+			case SessionEvent::Type::frame:
+			case SessionEvent::Type::position:
+			case SessionEvent::Type::playing:
+			case SessionEvent::Type::duration:
+			case SessionEvent::Type::seek:
+			case SessionEvent::Type::seek_issued:
+				return 1;
+
+			case SessionEvent::Type::viewport_size:
+			case SessionEvent::Type::video_resolution:
+				return 2;
+		}
+
+		return 0;
+	}
+} // namespace
+
+const char * to_string(const SessionEvent::Type type) noexcept
+{
+	switch (type)
+	{
+		case SessionEvent::Type::load_scene: return "load_scene";
+		case SessionEvent::Type::activate_annotation: return "activate_annotation";
+		case SessionEvent::Type::go_back: return "go_back";
+		case SessionEvent::Type::update: return "update";
+		case SessionEvent::Type::frame: return "frame";
+		case SessionEvent::Type::position: return "position";
+		case SessionEvent::Type::playing: return "playing";
+		case SessionEvent::Type::duration: return "duration";
+		case SessionEvent::Type::end_of_media: return "end_of_media";
+		case SessionEvent::Type::viewport_size: return "viewport_size";
+		case SessionEvent::Type::video_resolution: return "video_resolution";
+		case SessionEvent::Type::seek: return "seek";
+		case SessionEvent::Type::seek_issued: return "seek_issued";
+	}
+
+	return "unknown";
+}
+
+SessionRecorder::SessionRecorder(const std::string & path)
+	: file(std::fopen(path.c_str(), "wb"))
+{
+	if (file == nullptr)
+		return;
+
+	buffer.reserve(flush_threshold + 256);
+	buffer.insert(buffer.end(), std::begin(magic), std::end(magic));
+	buffer.push_back(format_version);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	if (file == nullptr)
+		return;
+
+	flush();
+	std::fclose(file);
+}
+
+void SessionRecorder::record(const SessionEvent::Type type, const clock::time_point now, const std::int64_t value, const std::int64_t second_value)
+{
+	if (file == nullptr)
+		return;
+
+	write_header(type, now);
+
+	const int values = value_count(type);
+	if (values >= 1)
+		write_signed_varint(buffer, value);
+	if (values >= 2)
+		write_signed_varint(buffer, second_value);
+
+	if (buffer.size() >= flush_threshold)
+		flush();
+}
+
+void SessionRecorder::record_load_scene(const std::string & path_utf8, const std::int64_t transition, const clock::time_point now)
+{
+	if (file == nullptr)
+		return;
+
+	write_header(SessionEvent::Type::load_scene, now);
+	write_signed_varint(buffer, transition);
+	write_string(buffer, std::string_view(path_utf8));
+
+	if (buffer.size() >= flush_threshold)
+		flush();
+}
+
+void SessionRecorder::flush()
+{
+	if (file == nullptr || buffer.empty())
+		return;
+
+	std::fwrite(buffer.data(), 1, buffer.size(), file);
+	std::fflush(file);
+	buffer.clear();
+}
+
+void SessionRecorder::write_header(const SessionEvent::Type type, const clock::time_point now)
+{
+	if (!start_time.has_value())
+		start_time = now;
+
+	// Events recorded from different places may not be exactly in order
+	const auto time = std::max(std::chrono::duration_cast<std::chrono::microseconds>(now - *start_time), last_event_time);
+
+	buffer.push_back(static_cast<std::uint8_t>(type));
+	write_varint(buffer, static_cast<std::uint64_t>((time - last_event_time).count()));
+
+	last_event_time = time;
+	++event_count;
+}
+
+SessionRecordingReadResult parse_session_recording(const std::uint8_t * const data, const std::size_t size)
+{
+	SessionRecordingReadResult result{ SessionRecordingError::success, {} };
+
+	if (size < sizeof(magic) + 1 || std::memcmp(data, magic, sizeof(magic)) != 0 || data[sizeof(magic)] != format_version)
+	{
+		result.error = SessionRecordingError::invalid_header;
+		return result;
+	}
+
+	BinaryReader reader(data + sizeof(magic) + 1, size - sizeof(magic) - 1);
+	std::chrono::microseconds time(0);
+
+	while (!reader.at_end())
+	{
+		std::uint8_t type;
+		std::uint64_t delta;
+		if (!reader.read_byte(type) || !reader.read_varint(delta))
+		{
+			result.error = SessionRecordingError::truncated;
+			return result;
+		}
+
+		if (type >= SessionEvent::type_count)
+		{
+			result.error = SessionRecordingError::invalid_event;
+			return result;
+		}
+
+		SessionEvent event;
+		event.type = static_cast<SessionEvent::Type>(type);
+		time += std::chrono::microseconds(static_cast<std::chrono::microseconds::rep>(delta));
+		event.time = time;
+
+		const int values = value_count(event.type);
+		bool read = (values < 1 || reader.read_signed_varint(event.value)) && (values < 2 || reader.read_signed_varint(event.second_value));
+
+		if (read && event.type == SessionEvent::Type::load_scene)
+			read = reader.read_string(event.path);
+
+		if (!read)
+		{
+			result.error = SessionRecordingError::truncated;
+			return result;
+		}
+
+		result.events.push_back(std::move(event));
+	}
+
+	return result;
+}
+
+SessionRecordingReadResult read_session_recording(const std::string & path)
+{
+	const std::optional<std::vector<std::uint8_t>> data = read_binary_file(path);
+	if (!data.has_value())
+		return { SessionRecordingError::cannot_read_file, {} };
+
+	return parse_session_recording(data->data(), data->size());
+}
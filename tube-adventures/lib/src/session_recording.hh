@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Something that happened to a game session, as recorded
+struct SessionEvent
+{
+	enum class Type : std::uint8_t
+	{
+		load_scene, // path, value = GameSession::SceneTransition
+		activate_annotation, // value = annotation index
+		go_back,
+		update,
+		frame, // value = presentation time (us)
+		position, // value = reported position (us)
+		playing, // value = 1 if playing, 0 if not
+		duration, // value = reported duration (us)
+		end_of_media,
+		viewport_size, // value = width, second_value = height
+		video_resolution, // value = width, second_value = height
+		seek, // value = target position (us). Requested by the player, the position reports that follow show it
+		seek_issued, // value = position (us). A seek of the session that waited for the media to load
+	};
+
+	static constexpr std::size_t type_count = static_cast<std::size_t>(Type::seek_issued) + 1;
+
+	Type type;
+	std::chrono::microseconds time{ 0 }; // Since the recording started
+	std::int64_t value = 0;
+	std::int64_t second_value = 0;
+	std::string path; // UTF-8
+};
+
+[[nodiscard]] const char * to_string(SessionEvent::Type type) noexcept;
+
+// Writes the events of a session to a compact binary file as they happen: a header, then for each event
+// its type, the time since the previous one and its values, as variable length integers
+class SessionRecorder
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	explicit SessionRecorder(const std::string & path);
+	~SessionRecorder();
+
+	SessionRecorder(const SessionRecorder &) = delete;
+	SessionRecorder & operator=(const SessionRecorder &) = delete;
+
+	[[nodiscard]] bool is_open() const noexcept { return file != nullptr; }
+
+	// The first event recorded is at time 0
+	void record(SessionEvent::Type type, clock::time_point now, std::int64_t value = 0, std::int64_t second_value = 0);
+	void record_load_scene(const std::string & path_utf8, std::int64_t transition, clock::time_point now);
+
+	// Also done when the buffer is full and when destroyed
+	void flush();
+
+	[[nodiscard]] std::uint64_t events_recorded() const noexcept { return event_count; }
+
+private:
+	void write_header(SessionEvent::Type type, clock::time_point now);
+
+	std::FILE * file = nullptr;
+	std::vector<std::uint8_t> buffer;
+
+	std::optional<clock::time_point> start_time;
+	std::chrono::microseconds last_event_time{ 0 };
+	std::uint64_t event_count = 0;
+};
+
+enum class SessionRecordingError
+{
+	success,
+	cannot_read_file,
+	invalid_header,
+	truncated,
+	invalid_event,
+};
+
+struct SessionRecordingReadResult
+{
+	SessionRecordingError error;
+	std::vector<SessionEvent> events; // Everything before the error, if any
+};
+
+[[nodiscard]] SessionRecordingReadResult parse_session_recording(const std::uint8_t * data, std::size_t size);
+[[nodiscard]] SessionRecordingReadResult read_session_recording(const std::string & path);
@@ -0,0 +1,226 @@
+#include "session_replay.hh"
+#include "allocation_counter.hh"
+#include "headless_session.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+namespace
+{
+	[[nodiscard]] std::string locate_video_or_youtube_url(const std::filesystem::path & video_directory, const std::string_view youtube_id)
+	{
+		const std::filesystem::path path = find_path_with_youtube_id(youtube_id, video_directory, ".mp4");
+		if (!path.empty())
+			return to_utf8_string(path);
+
+		return full_youtube_url_from_id(youtube_id).value_or(std::string());
+	}
+
+	// Returns false if the event couldn't be replayed
+	bool apply(GameSession & session, const SessionEvent & event, const GameSession::clock::time_point now)
+	{
+		switch (event.type)
+		{
+			case SessionEvent::Type::load_scene:
+				session.load_scene(std::filesystem::u8path(event.path), now, static_cast<GameSession::SceneTransition>(event.value));
+				return true;
+
+			case SessionEvent::Type::activate_annotation:
+				if (event.value < 0 || event.value >= static_cast<std::int64_t>(session.annotations().size()))
+					return false;
+
+				session.activate_annotation(static_cast<int>(event.value), now);
+				return true;
+
+			case SessionEvent::Type::go_back:
+				session.go_back(now);
+				return true;
+
+			case SessionEvent::Type::update:
+				(void)session.update(now);
+				return true;
+
+			case SessionEvent::Type::frame:
+				session.on_frame(GameSession::microseconds(event.value), now);
+				return true;
+
+			case SessionEvent::Type::position:
+				session.on_position_reported(GameSession::microseconds(event.value), now);
+				return true;
+
+			case SessionEvent::Type::playing:
+				session.on_playing_changed(event.value != 0, now);
+				return true;
+
+			case SessionEvent::Type::duration:
+				session.on_duration_reported(GameSession::microseconds(event.value), now);
+				return true;
+
+			case SessionEvent::Type::end_of_media:
+				session.on_end_of_media(now);
+				return true;
+
+			case SessionEvent::Type::viewport_size:
+				session.set_viewport_size(static_cast<int>(event.value), static_cast<int>(event.second_value), now);
+				return true;
+
+			case SessionEvent::Type::video_resolution:
+				session.set_video_resolution(static_cast<int>(event.value), static_cast<int>(event.second_value), now);
+				return true;
+
+			case SessionEvent::Type::seek:
+				// Done by the player. The session finds out through the position reports that follow
+				return true;
+
+			case SessionEvent::Type::seek_issued:
+				session.on_seek_issued(GameSession::microseconds(event.value), now);
+				return true;
+		}
+
+		return false;
+	}
+
+	[[nodiscard]] double to_microseconds(const std::chrono::nanoseconds time) noexcept
+	{
+		return std::chrono::duration<double, std::micro>(time).count();
+	}
+} // namespace
+
+ReplayReport replay_session(const std::vector<SessionEvent> & events, GameSessionOptions options, const std::size_t slowest_step_count)
+{
+	ReplayReport report;
+
+	options.recorder = nullptr;
+	if (!options.locate_video)
+	{
+		options.locate_video = [video_directory = options.video_directory](const std::string_view youtube_id)
+		{
+			return locate_video_or_youtube_url(video_directory, youtube_id);
+		};
+	}
+
+	HeadlessMedia media;
+	media.loaded = false; // Like the player, which never is right after set_media. The seek_issued events say when it was
+
+	HeadlessView view;
+	view.on_error = [&report](const std::string_view title, const std::string_view message)
+	{
+		report.errors.push_back(std::string(title) + ": " + std::string(message));
+	};
+
+	GameSession session(media, view, std::move(options));
+
+	std::vector<ReplayStep> steps;
+	steps.reserve(events.size());
+
+	const AllocationCounts allocations_before_replay = allocation_counts();
+	const auto replay_start = std::chrono::steady_clock::now();
+
+	for (std::size_t i = 0; i < events.size(); ++i)
+	{
+		const SessionEvent & event = events[i];
+		const GameSession::clock::time_point now = GameSession::clock::time_point() + event.time;
+
+		const AllocationCounts allocations_before = allocation_counts();
+		const auto step_start = std::chrono::steady_clock::now();
+
+		const bool applied = apply(session, event, now);
+
+		const auto step_time = std::chrono::steady_clock::now() - step_start;
+		const std::uint64_t step_allocations = (allocation_counts() - allocations_before).allocations;
+
+		if (!applied)
+			report.errors.push_back("Event " + std::to_string(i) + " (" + to_string(event.type) + ") can't be replayed");
+
+		ReplayStepStats & stats = report.steps[static_cast<std::size_t>(event.type)];
+		++stats.count;
+		stats.total_time += step_time;
+		stats.max_time = std::max<std::chrono::nanoseconds>(stats.max_time, step_time);
+		stats.allocations += step_allocations;
+		stats.max_allocations = std::max(stats.max_allocations, step_allocations);
+
+		steps.push_back({ i, event.type, event.time, step_time, step_allocations });
+	}
+
+	report.wall_time = std::chrono::steady_clock::now() - replay_start;
+	report.allocations = (allocation_counts() - allocations_before_replay).allocations;
+	report.scenes_loaded = view.scenes_loaded;
+	report.annotations_shown = view.annotations_shown;
+	if (!events.empty())
+		report.session_time = events.back().time;
+
+	const std::size_t slowest_count = std::min(slowest_step_count, steps.size());
+	std::partial_sort(steps.begin(), steps.begin() + static_cast<std::ptrdiff_t>(slowest_count), steps.end(), [](const ReplayStep & lhs, const ReplayStep & rhs)
+	{
+		return lhs.time > rhs.time;
+	});
+	steps.resize(slowest_count);
+	report.slowest_steps = std::move(steps);
+
+	return report;
+}
+
+GameSessionOptions recorded_session_options(const std::vector<SessionEvent> & events)
+{
+	GameSessionOptions options;
+
+	const auto first_scene = std::find_if(events.begin(), events.end(), [](const SessionEvent & event)
+	{
+		return event.type == SessionEvent::Type::load_scene;
+	});
+
+	if (first_scene != events.end())
+	{
+		options.annotations_directory = std::filesystem::u8path(first_scene->path).parent_path();
+		options.video_directory = options.annotations_directory / "video";
+	}
+
+	return options;
+}
+
+std::string format_replay_report(const ReplayReport & report)
+{
+	std::string text;
+	char line[256];
+
+	const double speedup = report.wall_time.count() > 0
+		? std::chrono::duration<double>(report.session_time).count() / std::chrono::duration<double>(report.wall_time).count()
+		: 0.0;
+
+	std::snprintf(line, sizeof(line), "Replayed %.3f s of session in %.3f ms (%.0fx real time). %llu scenes loaded, %llu annotations shown, %llu allocations\n",
+		std::chrono::duration<double>(report.session_time).count(), to_microseconds(report.wall_time) / 1000.0, speedup,
+		static_cast<unsigned long long>(report.scenes_loaded), static_cast<unsigned long long>(report.annotations_shown), static_cast<unsigned long long>(report.allocations));
+	text += line;
+
+	std::snprintf(line, sizeof(line), "%-20s %10s %12s %12s %12s %12s\n", "event", "count", "mean (us)", "max (us)", "allocs/step", "max allocs");
+	text += line;
+
+	for (std::size_t i = 0; i < report.steps.size(); ++i)
+	{
+		const ReplayStepStats & stats = report.steps[i];
+		if (stats.count == 0)
+			continue;
+
+		const auto count = static_cast<double>(stats.count);
+		std::snprintf(line, sizeof(line), "%-20s %10llu %12.3f %12.3f %12.2f %12llu\n", to_string(static_cast<SessionEvent::Type>(i)),
+			static_cast<unsigned long long>(stats.count), to_microseconds(stats.total_time) / count, to_microseconds(stats.max_time),
+			static_cast<double>(stats.allocations) / count, static_cast<unsigned long long>(stats.max_allocations));
+		text += line;
+	}
+
+	if (!report.slowest_steps.empty())
+		text += "Slowest steps:\n";
+
+	for (const ReplayStep & step : report.slowest_steps)
+	{
+		std::snprintf(line, sizeof(line), "  #%zu %-20s at %.3f s: %.3f us, %llu allocations\n", step.event_index, to_string(step.type),
+			std::chrono::duration<double>(step.session_time).count(), to_microseconds(step.time), static_cast<unsigned long long>(step.allocations));
+		text += line;
+	}
+
+	for (const std::string & error : report.errors)
+		text += "Error: " + error + '\n';
+
+	return text;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "game_session.hh"
+#include "session_recording.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cost of replaying all the events of a type
+struct ReplayStepStats
+{
+	std::uint64_t count = 0;
+	std::chrono::nanoseconds total_time{ 0 };
+	std::chrono::nanoseconds max_time{ 0 };
+	std::uint64_t allocations = 0; // Only if allocations are counted, see allocation_counter.hh
+	std::uint64_t max_allocations = 0;
+};
+
+struct ReplayStep
+{
+	std::size_t event_index;
+	SessionEvent::Type type;
+	std::chrono::microseconds session_time; // When it happened in the recording
+	std::chrono::nanoseconds time;
+	std::uint64_t allocations;
+};
+
+struct ReplayReport
+{
+	std::array<ReplayStepStats, SessionEvent::type_count> steps{};
+	std::vector<ReplayStep> slowest_steps; // Slowest first
+
+	std::chrono::nanoseconds wall_time{ 0 };
+	std::chrono::microseconds session_time{ 0 }; // Covered by the recording
+	std::uint64_t allocations = 0;
+
+	std::uint64_t scenes_loaded = 0;
+	std::uint64_t annotations_shown = 0;
+	std::vector<std::string> errors; // Reported by the session, or events that couldn't be replayed
+};
+
+// Feeds the events to a GameSession as fast as possible. Time is virtual: each event happens at the time
+// it was recorded. The media backend and the view do nothing but count.
+// Videos that aren't found locally are given their youtube URL, only the annotations are needed
+[[nodiscard]] ReplayReport replay_session(const std::vector<SessionEvent> & events, GameSessionOptions options = {}, std::size_t slowest_step_count = 10);
+
+// The directories the game was run with, as far as the recording tells: the annotations are where the first
+// scene loaded is, like in the window, and the videos in "video" next to them. The defaults if no scene was loaded
+[[nodiscard]] GameSessionOptions recorded_session_options(const std::vector<SessionEvent> & events);
+
+// Human readable, one line per type of event
+[[nodiscard]] std::string format_replay_report(const ReplayReport & report);
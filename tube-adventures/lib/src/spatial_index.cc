@@ -0,0 +1,134 @@
+#include "spatial_index.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace
+{
+	[[nodiscard]] constexpr int divide_rounding_up(const int numerator, const int denominator) noexcept
+	{
+		assert(numerator >= 0 && denominator > 0);
+		return (numerator + denominator - 1) / denominator;
+	}
+
+	[[nodiscard]] constexpr bool contains(const UniformGridIndex::Rect & rect, const int x, const int y) noexcept
+	{
+		return x >= rect.x && x < rect.x + rect.width
+			&& y >= rect.y && y < rect.y + rect.height;
+	}
+} // namespace
+
+void UniformGridIndex::build(const std::vector<Entry> & new_entries, const int cell_size)
+{
+	assert(cell_size > 0);
+
+	clear();
+
+	for (const Entry & entry : new_entries)
+	{
+		if (entry.rect.width > 0 && entry.rect.height > 0)
+			entries.push_back(entry);
+	}
+
+	if (entries.empty())
+		return;
+
+	int min_x = std::numeric_limits<int>::max();
+	int min_y = std::numeric_limits<int>::max();
+	int max_x = std::numeric_limits<int>::min();
+	int max_y = std::numeric_limits<int>::min();
+
+	for (const Entry & entry : entries)
+	{
+		min_x = std::min(min_x, entry.rect.x);
+		min_y = std::min(min_y, entry.rect.y);
+		max_x = std::max(max_x, entry.rect.x + entry.rect.width);
+		max_y = std::max(max_y, entry.rect.y + entry.rect.height);
+	}
+
+	origin_x = min_x;
+	origin_y = min_y;
+
+	const int bounds_width = max_x - min_x;
+	const int bounds_height = max_y - min_y;
+
+	// Grow the cells instead of the grid if the rects are spread very far apart
+	cell_width = std::max(cell_size, divide_rounding_up(bounds_width, max_cells_per_axis));
+	cell_height = std::max(cell_size, divide_rounding_up(bounds_height, max_cells_per_axis));
+	columns = divide_rounding_up(bounds_width, cell_width);
+	rows = divide_rounding_up(bounds_height, cell_height);
+
+	const auto cell_count = static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows);
+
+	const auto for_each_cell = [this](const Rect & rect, auto && function)
+	{
+		const int first_column = (rect.x - origin_x) / cell_width;
+		const int first_row = (rect.y - origin_y) / cell_height;
+		const int last_column = (rect.x + rect.width - 1 - origin_x) / cell_width;
+		const int last_row = (rect.y + rect.height - 1 - origin_y) / cell_height;
+
+		for (int row = first_row; row <= last_row; ++row)
+		{
+			for (int column = first_column; column <= last_column; ++column)
+				function(static_cast<std::size_t>(row * columns + column));
+		}
+	};
+
+	// Counting pass, then fill. Keeps the entries of each cell contiguous and in insertion order
+	std::vector<int> cell_counts(cell_count, 0);
+	for (const Entry & entry : entries)
+		for_each_cell(entry.rect, [&cell_counts](const std::size_t cell) { ++cell_counts[cell]; });
+
+	cell_begin.resize(cell_count + 1);
+	cell_begin[0] = 0;
+	for (std::size_t cell = 0; cell < cell_count; ++cell)
+		cell_begin[cell + 1] = cell_begin[cell] + cell_counts[cell];
+
+	cell_entries.resize(static_cast<std::size_t>(cell_begin.back()));
+
+	std::fill(cell_counts.begin(), cell_counts.end(), 0);
+	const auto entries_size = static_cast<int>(entries.size());
+	for (int entry_index = 0; entry_index < entries_size; ++entry_index)
+	{
+		for_each_cell(entries[static_cast<std::size_t>(entry_index)].rect, [&](const std::size_t cell)
+		{
+			const auto position = static_cast<std::size_t>(cell_begin[cell] + cell_counts[cell]++);
+			cell_entries[position] = entry_index;
+		});
+	}
+}
+
+void UniformGridIndex::clear() noexcept
+{
+	entries.clear();
+	cell_begin.clear();
+	cell_entries.clear();
+	columns = 0;
+	rows = 0;
+}
+
+std::optional<int> UniformGridIndex::query(const int x, const int y) const noexcept
+{
+	if (entries.empty() || x < origin_x || y < origin_y)
+		return std::nullopt;
+
+	const int column = (x - origin_x) / cell_width;
+	const int row = (y - origin_y) / cell_height;
+	if (column >= columns || row >= rows)
+		return std::nullopt;
+
+	const auto cell = static_cast<std::size_t>(row * columns + column);
+	const int begin = cell_begin[cell];
+	const int end = cell_begin[cell + 1];
+
+	// Later entries are on top
+	for (int i = end - 1; i >= begin; --i)
+	{
+		const Entry & entry = entries[static_cast<std::size_t>(cell_entries[static_cast<std::size_t>(i)])];
+		if (contains(entry.rect, x, y))
+			return entry.id;
+	}
+
+	return std::nullopt;
+}
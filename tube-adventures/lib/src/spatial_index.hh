@@ -0,0 +1,50 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+// Uniform grid over a (small) set of axis-aligned rectangles. Used to find which
+// annotation is under the mouse without testing every visible rectangle
+class UniformGridIndex
+{
+public:
+	struct Rect
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+	struct Entry
+	{
+		Rect rect;
+		int id; // Whatever the caller uses to identify the rect (e.g. an annotation index)
+	};
+
+	static constexpr int default_cell_size = 64;
+	static constexpr int max_cells_per_axis = 64;
+
+	// Entries that come later in `entries` are considered to be on top of the previous ones
+	void build(const std::vector<Entry> & entries, int cell_size = default_cell_size);
+	void clear() noexcept;
+
+	// Returns the id of the top-most entry containing the point, if any
+	[[nodiscard]] std::optional<int> query(int x, int y) const noexcept;
+
+	[[nodiscard]] bool empty() const noexcept { return entries.empty(); }
+
+private:
+	std::vector<Entry> entries;
+
+	// Compressed layout: the entries of cell `c` are cell_entries[cell_begin[c] .. cell_begin[c + 1])
+	std::vector<int> cell_begin;
+	std::vector<int> cell_entries;
+
+	int origin_x = 0;
+	int origin_y = 0;
+	int cell_width = default_cell_size;
+	int cell_height = default_cell_size;
+	int columns = 0;
+	int rows = 0;
+};
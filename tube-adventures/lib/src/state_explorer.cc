@@ -0,0 +1,274 @@
+#include "state_explorer.hh"
+#include "trace.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+
+namespace
+{
+	// A scene index and a packed state
+	using Node = std::uint64_t;
+
+	[[nodiscard]] Node make_node(const std::size_t scene, const GameState state) noexcept
+	{
+		return (static_cast<Node>(scene) << 32) | state.packed();
+	}
+
+	[[nodiscard]] std::size_t node_scene(const Node node) noexcept
+	{
+		return static_cast<std::size_t>(node >> 32);
+	}
+
+	[[nodiscard]] GameState node_state(const Node node) noexcept
+	{
+		return GameState::from_packed(static_cast<std::uint32_t>(node));
+	}
+
+	// The visited nodes, split by hash so the threads rarely wait for each other
+	class VisitedNodes
+	{
+	public:
+		explicit VisitedNodes(const std::size_t max_nodes_)
+			: max_nodes(max_nodes_)
+		{}
+
+		// False if it was visited already or there is no room for more
+		[[nodiscard]] bool insert(const Node node)
+		{
+			Shard & shard = shards[shard_index(node)];
+			const std::lock_guard<std::mutex> lock(shard.mutex);
+
+			if (shard.nodes.count(node) != 0)
+				return false;
+
+			if (count.fetch_add(1, std::memory_order_relaxed) >= max_nodes)
+			{
+				full.store(true, std::memory_order_relaxed);
+				return false;
+			}
+
+			shard.nodes.insert(node);
+			return true;
+		}
+
+		[[nodiscard]] bool is_full() const noexcept { return full.load(std::memory_order_relaxed); }
+
+		// Not while inserting
+		template <typename Function>
+		void for_each(Function && function) const
+		{
+			for (const Shard & shard : shards)
+			{
+				for (const Node node : shard.nodes)
+					function(node);
+			}
+		}
+
+	private:
+		static constexpr std::size_t shard_count = 64;
+
+		struct alignas(64) Shard
+		{
+			std::mutex mutex;
+			std::unordered_set<Node> nodes;
+		};
+
+		[[nodiscard]] static std::size_t shard_index(Node node) noexcept
+		{
+			// The low bits are the state, which few variables change, so mix the scene in
+			node ^= node >> 33;
+			node *= 0xff51afd7ed558ccdull;
+			node ^= node >> 33;
+			return static_cast<std::size_t>(node % shard_count);
+		}
+
+		Shard shards[shard_count];
+		const std::size_t max_nodes;
+		std::atomic<std::size_t> count{ 0 };
+		std::atomic<bool> full{ false };
+	};
+
+	// What a thread finds in a step, merged when the step ends
+	struct StepFindings
+	{
+		std::vector<Node> next;
+		std::vector<MissingStateCombination> missing_combinations;
+		std::vector<StateContradiction> contradictions;
+	};
+
+	class Explorer
+	{
+	public:
+		Explorer(const StoryGraph & graph_, const SceneStateIndex & index_, const std::vector<std::size_t> & start_scenes, const std::size_t max_states)
+			: graph(graph_)
+			, index(index_)
+			, starts(graph_.links.size(), false)
+			, visited(max_states)
+		{
+			for (const std::size_t scene : start_scenes)
+			{
+				if (scene < starts.size())
+					starts[scene] = true;
+			}
+		}
+
+		// The state the game is in after entering the scene. Going back to where the game starts (the menu most
+		// scenes link to) starts it again
+		[[nodiscard]] GameState enter(const std::size_t scene, const GameState state) const noexcept
+		{
+			const SceneVariant & variant = index.variant(scene);
+			const GameState entered = (starts[scene] ? GameState{} : state).updated(variant.state);
+			return variant.next_state.has_value() ? entered.updated(*variant.next_state) : entered;
+		}
+
+		[[nodiscard]] bool visit(const Node node) { return visited.insert(node); }
+		[[nodiscard]] const VisitedNodes & visited_nodes() const noexcept { return visited; }
+
+		void explore(const Node node, StepFindings & findings)
+		{
+			const std::size_t scene = node_scene(node);
+			const GameState state = node_state(node);
+
+			for (const StoryLink & link : graph.links[scene])
+			{
+				if (!link.target_scene.has_value())
+					continue;
+
+				const std::size_t target = *link.target_scene;
+				const SceneVariant & variant = index.variant(target);
+
+				// Only when the game knows every variable the scene depends on can it tell which variant to play
+				const std::uint32_t scene_mask = index.scene_mask(variant.scene);
+				const bool known = (state.mask() & scene_mask) == scene_mask;
+				const std::optional<std::size_t> expected = known ? index.find(variant.scene, state) : std::nullopt;
+
+				if (known && !expected.has_value())
+					findings.missing_combinations.push_back({ variant.scene, GameState::from_packed(state.packed() & scene_mask), scene, link.annotation_index, link.highlight });
+
+				if (variant.state.contradicts(state))
+					findings.contradictions.push_back({ scene, link.annotation_index, link.highlight, target, state, expected });
+
+				const Node next = make_node(target, enter(target, state));
+				if (visit(next))
+					findings.next.push_back(next);
+			}
+		}
+
+	private:
+		const StoryGraph & graph;
+		const SceneStateIndex & index;
+		std::vector<bool> starts; // By scene
+		VisitedNodes visited;
+	};
+
+	[[nodiscard]] unsigned thread_count(const StateExplorerOptions & options) noexcept
+	{
+		if (options.threads != 0)
+			return options.threads;
+
+		return std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	// Each finding once, the same whatever order the threads found them in
+	void sort_findings(StateExploration & exploration)
+	{
+		const auto combination_key = [](const MissingStateCombination & combination) {
+			return std::make_tuple(combination.scene, combination.state.packed(), combination.from_scene, combination.highlight, combination.annotation_index);
+		};
+
+		std::sort(exploration.missing_combinations.begin(), exploration.missing_combinations.end(), [&](const MissingStateCombination & lhs, const MissingStateCombination & rhs) {
+			return combination_key(lhs) < combination_key(rhs);
+		});
+
+		exploration.missing_combinations.erase(std::unique(exploration.missing_combinations.begin(), exploration.missing_combinations.end(), [](const MissingStateCombination & lhs, const MissingStateCombination & rhs) {
+			return lhs.scene == rhs.scene && lhs.state == rhs.state;
+		}), exploration.missing_combinations.end());
+
+		const auto contradiction_key = [](const StateContradiction & contradiction) {
+			return std::make_tuple(contradiction.from_scene, contradiction.highlight, contradiction.annotation_index, contradiction.state.packed());
+		};
+
+		std::sort(exploration.contradictions.begin(), exploration.contradictions.end(), [&](const StateContradiction & lhs, const StateContradiction & rhs) {
+			return contradiction_key(lhs) < contradiction_key(rhs);
+		});
+
+		exploration.contradictions.erase(std::unique(exploration.contradictions.begin(), exploration.contradictions.end(), [](const StateContradiction & lhs, const StateContradiction & rhs) {
+			return lhs.from_scene == rhs.from_scene && lhs.highlight == rhs.highlight && lhs.annotation_index == rhs.annotation_index;
+		}), exploration.contradictions.end());
+	}
+} // namespace
+
+StateExploration explore_game_states(const std::vector<GameScene> & scenes, const StoryGraph & graph, const SceneStateIndex & index, const StateExplorerOptions & options)
+{
+	const TraceSpan span("explore_game_states");
+
+	Explorer explorer(graph, index, options.start_scenes, options.max_states);
+	StateExploration exploration;
+
+	std::vector<Node> frontier;
+	for (const std::size_t scene : options.start_scenes)
+	{
+		if (scene >= scenes.size())
+			continue;
+
+		const Node start = make_node(scene, explorer.enter(scene, GameState{}));
+		if (explorer.visit(start))
+			frontier.push_back(start);
+	}
+
+	const unsigned threads = thread_count(options);
+
+	// Small steps aren't worth starting threads for
+	constexpr std::size_t nodes_per_task = 64;
+
+	while (!frontier.empty())
+	{
+		const std::size_t tasks = (frontier.size() + nodes_per_task - 1) / nodes_per_task;
+		std::vector<StepFindings> findings(std::min<std::size_t>(threads, tasks));
+		std::atomic<std::size_t> next_task{ 0 };
+
+		const auto work = [&](StepFindings & thread_findings) {
+			for (std::size_t task = next_task++; task < tasks; task = next_task++)
+			{
+				const std::size_t end = std::min(frontier.size(), (task + 1) * nodes_per_task);
+				for (std::size_t i = task * nodes_per_task; i < end; ++i)
+					explorer.explore(frontier[i], thread_findings);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		workers.reserve(findings.size() - 1);
+		for (std::size_t i = 1; i < findings.size(); ++i)
+			workers.emplace_back(work, std::ref(findings[i]));
+
+		work(findings[0]);
+
+		for (std::thread & worker : workers)
+			worker.join();
+
+		frontier.clear();
+		for (StepFindings & thread_findings : findings)
+		{
+			frontier.insert(frontier.end(), thread_findings.next.begin(), thread_findings.next.end());
+			exploration.missing_combinations.insert(exploration.missing_combinations.end(), thread_findings.missing_combinations.begin(), thread_findings.missing_combinations.end());
+			exploration.contradictions.insert(exploration.contradictions.end(), thread_findings.contradictions.begin(), thread_findings.contradictions.end());
+		}
+	}
+
+	exploration.states_per_scene.resize(scenes.size(), 0);
+	explorer.visited_nodes().for_each([&](const Node node) {
+		++exploration.states_per_scene[node_scene(node)];
+		++exploration.reachable_states;
+	});
+
+	exploration.truncated = explorer.visited_nodes().is_full();
+	sort_findings(exploration);
+
+	return exploration;
+}
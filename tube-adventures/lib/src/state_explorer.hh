@@ -0,0 +1,55 @@
+#pragma once
+
+#include "game_state.hh"
+#include "story_graph.hh"
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Walks every path of a game whose scenes are variants for game states (TUBE-ADVENTURES 3), keeping the state the
+// names of the scenes played so far leave the game in. Each scene sets the variables its name says, and then its
+// next state if it has one. The scenes and states reached tell which videos can't be reached at all, which links
+// play a video for another state than the one the game is in, and which states the game can be in when it enters a
+// scene without a video for them
+struct StateExplorerOptions
+{
+	std::vector<std::size_t> start_scenes; // Indices in the scenes. The game starts there in no state, and again when it goes back to one
+	unsigned threads = 0; // As many as the hardware runs at once if zero
+	std::size_t max_states = 10'000'000; // Pairs of scene and state, stops after that many
+};
+
+// Entering a scene in a state none of its variants is for, with every variable its variants are named after known
+struct MissingStateCombination
+{
+	std::string_view scene; // Name without the tags, refers to the state index
+	GameState state; // Only the variables the variants of the scene are named after
+	std::size_t from_scene; // One of the scenes with a link there, and its gameplay annotation or highlight
+	int annotation_index;
+	bool highlight;
+};
+
+// A link to a variant for a state that the state of the game contradicts
+struct StateContradiction
+{
+	std::size_t from_scene;
+	int annotation_index; // Of the annotations of from_scene, or of its highlight links
+	bool highlight;
+	std::size_t target_scene;
+	GameState state; // One of the states the game is in when the link is clicked
+	std::optional<std::size_t> expected_scene; // The variant for that state, if there is one and the state is known enough to tell
+};
+
+struct StateExploration
+{
+	std::size_t reachable_states = 0; // Pairs of scene and state
+	std::vector<std::size_t> states_per_scene; // By scene index. Zero for the scenes that can't be reached
+	std::vector<MissingStateCombination> missing_combinations; // Sorted by scene and state, one per combination
+	std::vector<StateContradiction> contradictions; // Sorted by scene and link, one per link
+	bool truncated = false; // Stopped at the most states of the options
+};
+
+// The visited states are shared between the threads, which take the states reached in one step and find the ones
+// reached in the next. Unless it stops at the most states, the result doesn't depend on how many threads there are
+[[nodiscard]] StateExploration explore_game_states(const std::vector<GameScene> & scenes, const StoryGraph & graph, const SceneStateIndex & index, const StateExplorerOptions & options);
@@ -0,0 +1,233 @@
+#include "story_graph.hh"
+#include "trace.hh"
+
+#include <algorithm>
+#include <functional>
+#include <system_error>
+#include <unordered_set>
+#include <utility>
+
+namespace
+{
+	constexpr void hash_combine(std::size_t & seed, const std::size_t value) noexcept
+	{
+		seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+
+	void hash_rect(std::size_t & seed, const Annotation::RectRegion & rect) noexcept
+	{
+		hash_combine(seed, std::hash<float>{}(rect.x));
+		hash_combine(seed, std::hash<float>{}(rect.y));
+		hash_combine(seed, std::hash<float>{}(rect.width));
+		hash_combine(seed, std::hash<float>{}(rect.height));
+		hash_combine(seed, std::hash<std::chrono::milliseconds::rep>{}(rect.time.count()));
+	}
+
+	[[nodiscard]] bool same_rect(const Annotation::RectRegion & lhs, const Annotation::RectRegion & rhs) noexcept
+	{
+		return lhs.x == rhs.x && lhs.y == rhs.y && lhs.width == rhs.width && lhs.height == rhs.height && lhs.time == rhs.time;
+	}
+
+	// The URLs of the same video differ in their tracking parameters
+	[[nodiscard]] std::string_view click_target(const std::string_view click_url) noexcept
+	{
+		return youtube_video_id_from_url(click_url).value_or(click_url);
+	}
+
+	// Of everything but the ID, which only names the buttons of a scene
+	struct AnnotationContentHash
+	{
+		[[nodiscard]] std::size_t operator()(const Annotation * const annotation) const noexcept
+		{
+			std::size_t seed = std::hash<u8string_view>{}(annotation->text);
+			hash_combine(seed, std::hash<std::string_view>{}(click_target(annotation->click_url)));
+			hash_combine(seed, static_cast<std::size_t>(annotation->type));
+
+			hash_rect(seed, annotation->start_rect);
+			for (const Annotation::RectRegion & rect : annotation->intermediate_rects)
+				hash_rect(seed, rect);
+			if (annotation->end_rect.has_value())
+				hash_rect(seed, *annotation->end_rect);
+
+			hash_combine(seed, annotation->style);
+
+			return seed;
+		}
+	};
+
+	struct AnnotationContentEqual
+	{
+		[[nodiscard]] bool operator()(const Annotation * const lhs, const Annotation * const rhs) const noexcept
+		{
+			return lhs->type == rhs->type
+				&& lhs->text == rhs->text
+				&& click_target(lhs->click_url) == click_target(rhs->click_url)
+				&& same_rect(lhs->start_rect, rhs->start_rect)
+				&& lhs->end_rect.has_value() == rhs->end_rect.has_value() && (!lhs->end_rect.has_value() || same_rect(*lhs->end_rect, *rhs->end_rect))
+				&& std::equal(lhs->intermediate_rects.begin(), lhs->intermediate_rects.end(), rhs->intermediate_rects.begin(), rhs->intermediate_rects.end(), same_rect)
+				&& lhs->style == rhs->style;
+		}
+	};
+} // namespace
+
+GameDirectory load_game_directory(const std::filesystem::path & directory)
+{
+	const TraceSpan span("load_game_directory");
+
+	GameDirectory game;
+
+	std::vector<std::filesystem::path> paths;
+	std::error_code error;
+	for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+	{
+		if (it->path().extension() == annotation_file_extension)
+			paths.push_back(it->path());
+	}
+
+	if (error)
+		game.errors.push_back(directory.u8string() + ": " + error.message());
+
+	std::sort(paths.begin(), paths.end());
+
+	for (std::filesystem::path & path : paths)
+	{
+		std::optional<std::string> youtube_id = path_to_youtube_video_id(path, annotation_file_extension);
+		if (!youtube_id.has_value())
+		{
+			++game.files_without_id;
+			continue;
+		}
+
+		ParseAnnotationsResult result = parse_annotations(path.u8string().c_str());
+		if (result.error != ParseAnnotationsError::success)
+		{
+			game.errors.push_back(path.u8string() + ": " + result.error_string);
+			continue;
+		}
+
+		game.scenes.push_back({ std::move(path), std::move(*youtube_id), std::move(result.annotations), std::move(result.highlight_links), result.ignored_annotations });
+	}
+
+	return game;
+}
+
+AnnotationDedupStats annotation_dedup_stats(const std::vector<GameScene> & scenes)
+{
+	AnnotationDedupStats stats;
+	for (const GameScene & scene : scenes)
+	{
+		stats.annotations += scene.annotations.size();
+		stats.highlight_links += scene.highlight_links.size();
+		stats.ignored += scene.ignored_annotations;
+	}
+
+	std::unordered_set<const Annotation *, AnnotationContentHash, AnnotationContentEqual> unique;
+	unique.reserve(stats.annotations);
+
+	// The IDs of the highlights only name them, like those of the annotations
+	std::unordered_set<std::string_view> unique_targets;
+	unique_targets.reserve(stats.highlight_links);
+
+	for (const GameScene & scene : scenes)
+	{
+		for (const Annotation & annotation : scene.annotations)
+		{
+			const std::size_t usage = memory_usage(annotation);
+			stats.memory_usage += usage;
+
+			if (unique.insert(&annotation).second)
+				stats.unique_memory_usage += usage;
+		}
+
+		for (const AnnotationLink & link : scene.highlight_links)
+		{
+			const std::size_t usage = memory_usage(link);
+			stats.memory_usage += usage;
+
+			if (unique_targets.insert(link.target_id).second)
+				stats.unique_memory_usage += usage;
+		}
+	}
+
+	stats.unique = unique.size();
+	stats.unique_highlight_links = unique_targets.size();
+	return stats;
+}
+
+SceneIdIndex::SceneIdIndex(const std::vector<GameScene> & scenes)
+{
+	scenes_by_id.reserve(scenes.size());
+
+	for (std::size_t i = 0; i < scenes.size(); ++i)
+		scenes_by_id.emplace(scenes[i].youtube_id, i);
+}
+
+std::optional<std::size_t> SceneIdIndex::find(const std::string_view youtube_id) const noexcept
+{
+	const auto it = scenes_by_id.find(youtube_id);
+	if (it == scenes_by_id.end())
+		return std::nullopt;
+
+	return it->second;
+}
+
+std::size_t StoryGraph::link_count() const noexcept
+{
+	std::size_t count = 0;
+	for (const std::vector<StoryLink> & scene_links : links)
+		count += scene_links.size();
+
+	return count;
+}
+
+std::size_t StoryGraph::broken_link_count() const noexcept
+{
+	std::size_t count = 0;
+	for (const std::vector<StoryLink> & scene_links : links)
+	{
+		count += static_cast<std::size_t>(std::count_if(scene_links.begin(), scene_links.end(), [](const StoryLink & link)
+		{
+			return !link.target_scene.has_value();
+		}));
+	}
+
+	return count;
+}
+
+StoryGraph build_story_graph(const std::vector<GameScene> & scenes, const SceneIdIndex & index)
+{
+	const TraceSpan span("build_story_graph");
+
+	StoryGraph graph;
+	graph.links.resize(scenes.size());
+
+	const auto find_target = [&index](const std::string & click_url) -> std::optional<std::size_t>
+	{
+		if (const std::optional<std::string_view> target_id = youtube_video_id_from_url(click_url); target_id.has_value())
+			return index.find(*target_id);
+
+		return std::nullopt;
+	};
+
+	for (std::size_t scene = 0; scene < scenes.size(); ++scene)
+	{
+		const std::vector<Annotation> & annotations = scenes[scene].annotations;
+
+		for (std::size_t i = 0; i < annotations.size(); ++i)
+		{
+			if (annotations[i].type != Annotation::Type::gameplay)
+				continue;
+
+			graph.links[scene].push_back({ static_cast<int>(i), find_target(annotations[i].click_url) });
+		}
+
+		const std::vector<AnnotationLink> & highlight_links = scenes[scene].highlight_links;
+		for (std::size_t i = 0; i < highlight_links.size(); ++i)
+		{
+			const std::string & target_id = highlight_links[i].target_id;
+			graph.links[scene].push_back({ static_cast<int>(i), target_id.empty() ? std::nullopt : index.find(target_id), true });
+		}
+	}
+
+	return graph;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "annotations.hh"
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// An annotation file of a game, parsed
+struct GameScene
+{
+	std::filesystem::path annotations_path;
+	std::string youtube_id;
+	std::vector<Annotation> annotations;
+	std::vector<AnnotationLink> highlight_links; // Most of the choices of TUBE-ADVENTURES 2 and 3 are highlights
+	std::size_t ignored_annotations = 0; // In the file, but not kept
+};
+
+struct GameDirectory
+{
+	std::vector<GameScene> scenes; // Sorted by path
+	std::vector<std::string> errors; // Files that couldn't be parsed, and why
+	std::size_t files_without_id = 0; // Annotation files not named after a youtube ID. Nothing can link to them
+};
+
+// Parses all the annotation files in the directory (not recursive)
+[[nodiscard]] GameDirectory load_game_directory(const std::filesystem::path & directory);
+
+// What storing the annotations with the same content (all but the ID) once would save in a loaded game.
+// Click URLs are compared by the video they open, and highlight links only by that
+struct AnnotationDedupStats
+{
+	std::size_t annotations = 0;
+	std::size_t unique = 0;
+	std::size_t highlight_links = 0;
+	std::size_t unique_highlight_links = 0;
+	std::size_t ignored = 0; // Not loaded, so they take no memory
+
+	// Approximate, in bytes
+	std::size_t memory_usage = 0; // Of every annotation and highlight link
+	std::size_t unique_memory_usage = 0; // Of one of each
+
+	// How many annotations each unique one stands for
+	[[nodiscard]] double dedup_ratio() const noexcept { return unique != 0 ? static_cast<double>(annotations) / static_cast<double>(unique) : 1.0; }
+};
+
+[[nodiscard]] AnnotationDedupStats annotation_dedup_stats(const std::vector<GameScene> & scenes);
+
+// Youtube ID to scene. It refers to the IDs of the scenes, so they must outlive it and not change.
+// Lookups don't allocate
+class SceneIdIndex
+{
+public:
+	SceneIdIndex() = default;
+	explicit SceneIdIndex(const std::vector<GameScene> & scenes);
+
+	// Index in the scenes. If several scenes have the same ID, the first one
+	[[nodiscard]] std::optional<std::size_t> find(std::string_view youtube_id) const noexcept;
+
+	[[nodiscard]] std::size_t size() const noexcept { return scenes_by_id.size(); }
+
+private:
+	std::unordered_map<std::string_view, std::size_t> scenes_by_id;
+};
+
+// Where each gameplay annotation or highlight leads
+struct StoryLink
+{
+	int annotation_index; // In the annotations of the scene it's in, or in its highlight links
+	std::optional<std::size_t> target_scene; // Empty if the target isn't in the game (or the URL has no ID)
+	bool highlight = false; // Can't be clicked in the annotation overlay
+};
+
+struct StoryGraph
+{
+	std::vector<std::vector<StoryLink>> links; // For each scene, the gameplay annotations in order and then the highlights
+
+	[[nodiscard]] std::size_t link_count() const noexcept;
+	[[nodiscard]] std::size_t broken_link_count() const noexcept;
+};
+
+[[nodiscard]] StoryGraph build_story_graph(const std::vector<GameScene> & scenes, const SceneIdIndex & index);
@@ -0,0 +1,149 @@
+#include "trace.hh"
+
+#include <cstdio>
+#include <mutex>
+#include <utility>
+
+std::atomic<bool> trace_detail::enabled{ false };
+
+namespace
+{
+	struct Recorder
+	{
+		std::mutex mutex;
+		std::vector<TraceEvent> events;
+		std::uint64_t dropped = 0;
+	};
+
+	[[nodiscard]] Recorder & recorder() noexcept
+	{
+		static Recorder & instance = *new Recorder; // Threads may trace until the very end
+		return instance;
+	}
+
+	[[nodiscard]] std::uint32_t this_thread_index() noexcept
+	{
+		static std::atomic<std::uint32_t> thread_count{ 0 };
+		thread_local const std::uint32_t index = thread_count.fetch_add(1, std::memory_order_relaxed);
+
+		return index;
+	}
+
+	void append_json_string(std::string & out, const char * string)
+	{
+		out += '"';
+		for (const char * c = string; *c != '\0'; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+				out += '\\';
+
+			if (static_cast<unsigned char>(*c) < 0x20)
+				out += ' ';
+			else
+				out += *c;
+		}
+		out += '"';
+	}
+} // namespace
+
+std::chrono::microseconds trace_detail::now() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch());
+}
+
+void trace_detail::record(const char * name, const TraceEvent::Phase phase, const std::chrono::microseconds timestamp,
+	const std::chrono::microseconds duration, const std::uint64_t id) noexcept
+{
+	const std::uint32_t thread_index = this_thread_index();
+
+	Recorder & rec = recorder();
+	const std::lock_guard lock(rec.mutex);
+
+	// It may have been stopped while the span was open
+	if (!enabled.load(std::memory_order_relaxed))
+		return;
+
+	if (rec.events.size() >= max_trace_events)
+	{
+		++rec.dropped;
+		return;
+	}
+
+	rec.events.push_back({ name, phase, timestamp, duration, id, thread_index });
+}
+
+void start_tracing()
+{
+	Recorder & rec = recorder();
+	const std::lock_guard lock(rec.mutex);
+
+	rec.events.clear();
+	rec.dropped = 0;
+	trace_detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+std::vector<TraceEvent> stop_tracing()
+{
+	Recorder & rec = recorder();
+	const std::lock_guard lock(rec.mutex);
+
+	trace_detail::enabled.store(false, std::memory_order_relaxed);
+
+	if (rec.dropped > 0)
+		std::fprintf(stderr, "%llu trace events were dropped\n", static_cast<unsigned long long>(rec.dropped));
+
+	return std::exchange(rec.events, {});
+}
+
+std::string to_chrome_trace_json(const std::vector<TraceEvent> & events)
+{
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+	for (const TraceEvent & event : events)
+	{
+		if (!first)
+			json += ',';
+		first = false;
+
+		json += "\n{\"name\":";
+		append_json_string(json, event.name);
+		json += ",\"ph\":\"";
+		json += static_cast<char>(event.phase);
+		json += "\",\"ts\":" + std::to_string(event.timestamp.count());
+		json += ",\"pid\":1,\"tid\":" + std::to_string(event.thread_index);
+
+		switch (event.phase)
+		{
+			case TraceEvent::Phase::complete:
+				json += ",\"dur\":" + std::to_string(event.duration.count());
+				break;
+
+			case TraceEvent::Phase::instant:
+				json += ",\"s\":\"t\"";
+				break;
+
+			case TraceEvent::Phase::async_begin:
+			case TraceEvent::Phase::async_end:
+				json += ",\"cat\":\"async\",\"id\":" + std::to_string(event.id);
+				break;
+		}
+
+		json += '}';
+	}
+
+	json += "\n]}\n";
+	return json;
+}
+
+bool write_chrome_trace(const std::string & path, const std::vector<TraceEvent> & events)
+{
+	std::FILE * const file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	const std::string json = to_chrome_trace_json(events);
+	const bool written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+
+	return std::fclose(file) == 0 && written;
+}
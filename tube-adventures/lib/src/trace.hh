@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Trace events in the Chrome trace event format, which chrome://tracing and Perfetto can load.
+// Recording is enabled at runtime; while it's disabled a span costs a relaxed atomic load
+
+struct TraceEvent
+{
+	enum class Phase : char
+	{
+		complete = 'X',
+		instant = 'i',
+		async_begin = 'b',
+		async_end = 'e',
+	};
+
+	const char * name; // Must outlive the trace, like a literal
+	Phase phase;
+	std::chrono::microseconds timestamp; // steady_clock
+	std::chrono::microseconds duration{ 0 }; // Only for complete events
+	std::uint64_t id = 0; // Only for async events: pairs a begin with its end
+	std::uint32_t thread_index = 0;
+};
+
+// Events recorded after this many are dropped
+inline constexpr std::size_t max_trace_events = 1'000'000;
+
+namespace trace_detail
+{
+	extern std::atomic<bool> enabled;
+
+	[[nodiscard]] std::chrono::microseconds now() noexcept;
+	void record(const char * name, TraceEvent::Phase phase, std::chrono::microseconds timestamp, std::chrono::microseconds duration, std::uint64_t id) noexcept;
+} // namespace trace_detail
+
+[[nodiscard]] inline bool is_tracing() noexcept
+{
+	return trace_detail::enabled.load(std::memory_order_relaxed);
+}
+
+// Discards the events of the previous trace, if any
+void start_tracing();
+
+// Returns the events recorded since start_tracing
+[[nodiscard]] std::vector<TraceEvent> stop_tracing();
+
+[[nodiscard]] std::string to_chrome_trace_json(const std::vector<TraceEvent> & events);
+[[nodiscard]] bool write_chrome_trace(const std::string & path, const std::vector<TraceEvent> & events);
+
+// Records how long the scope took
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char * name_) noexcept
+		: name(name_)
+		, start(is_tracing() ? trace_detail::now() : not_tracing)
+	{
+	}
+
+	~TraceSpan()
+	{
+		if (start != not_tracing)
+			trace_detail::record(name, TraceEvent::Phase::complete, start, trace_detail::now() - start, 0);
+	}
+
+	TraceSpan(const TraceSpan &) = delete;
+	TraceSpan & operator=(const TraceSpan &) = delete;
+
+private:
+	static constexpr std::chrono::microseconds not_tracing{ -1 };
+
+	const char * name;
+	std::chrono::microseconds start;
+};
+
+inline void trace_instant(const char * name) noexcept
+{
+	if (is_tracing())
+		trace_detail::record(name, TraceEvent::Phase::instant, trace_detail::now(), std::chrono::microseconds(0), 0);
+}
+
+// Async spans can begin and end in different scopes (or threads)
+inline void trace_async_begin(const char * name, const std::uint64_t id) noexcept
+{
+	if (is_tracing())
+		trace_detail::record(name, TraceEvent::Phase::async_begin, trace_detail::now(), std::chrono::microseconds(0), id);
+}
+
+inline void trace_async_end(const char * name, const std::uint64_t id) noexcept
+{
+	if (is_tracing())
+		trace_detail::record(name, TraceEvent::Phase::async_end, trace_detail::now(), std::chrono::microseconds(0), id);
+}
@@ -0,0 +1,95 @@
+#include "update_pacer.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <ctime>
+
+#if defined(_WIN32)
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <time.h>
+#endif
+
+void UpdatePacer::set_refresh_interval(const microseconds interval_) noexcept
+{
+	assert(interval_ > microseconds(0));
+	interval = interval_;
+}
+
+std::optional<UpdatePacer::clock::time_point> UpdatePacer::request(const clock::time_point now) noexcept
+{
+	++pacer_stats.requests;
+
+	if (!visible || pass_scheduled)
+		return std::nullopt;
+
+	pass_scheduled = true;
+	return next_pass_time(now);
+}
+
+void UpdatePacer::on_pass(const clock::time_point now) noexcept
+{
+	++pacer_stats.passes;
+
+	pass_scheduled = false;
+	last_pass = now;
+}
+
+std::optional<UpdatePacer::clock::time_point> UpdatePacer::set_visible(const bool visible_, const clock::time_point now) noexcept
+{
+	if (visible_ == visible)
+		return std::nullopt;
+
+	visible = visible_;
+
+	if (!visible)
+	{
+		// The scheduled pass (if any) is cancelled
+		pass_scheduled = false;
+		return std::nullopt;
+	}
+
+	pass_scheduled = true;
+	return now;
+}
+
+UpdatePacer::clock::time_point UpdatePacer::next_pass_time(const clock::time_point now) const noexcept
+{
+	if (!last_pass.has_value())
+		return now;
+
+	return std::max(now, *last_pass + interval);
+}
+
+std::chrono::microseconds process_cpu_time() noexcept
+{
+#if defined(_WIN32)
+	// MSVC's std::clock() is the wall time since the process started, not CPU time
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+		return std::chrono::microseconds(0);
+
+	// In units of 100 ns
+	const auto to_100ns = [](const FILETIME & time) {
+		return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	};
+
+	return std::chrono::microseconds(static_cast<std::int64_t>((to_100ns(kernel_time) + to_100ns(user_time)) / 10));
+#elif defined(CLOCK_PROCESS_CPUTIME_ID)
+	timespec cpu_time;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_time) != 0)
+		return std::chrono::microseconds(0);
+
+	return std::chrono::seconds(cpu_time.tv_sec) + std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(cpu_time.tv_nsec));
+#else
+	const std::clock_t cpu_time = std::clock();
+	if (cpu_time == static_cast<std::clock_t>(-1))
+		return std::chrono::microseconds(0);
+
+	return std::chrono::microseconds(static_cast<std::int64_t>(cpu_time) * 1'000'000 / CLOCKS_PER_SEC);
+#endif
+}
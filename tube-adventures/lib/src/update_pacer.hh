@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+// Decides when the UI is updated. Any number of update requests (new frames, position updates,
+// annotation events, state changes...) are batched into at most one update pass per display refresh.
+// While the window can't be seen no passes are scheduled at all, and one is made when it's visible again
+class UpdatePacer
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using microseconds = std::chrono::microseconds;
+
+	struct Stats
+	{
+		std::int64_t requests = 0;
+		std::int64_t passes = 0;
+		std::int64_t wakeups = 0; // Timers and media notifications that woke up the UI thread
+		std::int64_t redundant_sets_skipped = 0; // Property changes avoided because the value was the same
+	};
+
+	// 60 Hz until told otherwise
+	static constexpr microseconds default_refresh_interval{ 16'667 };
+
+	void set_refresh_interval(microseconds interval) noexcept;
+	[[nodiscard]] microseconds refresh_interval() const noexcept { return interval; }
+
+	// Returns when the update pass has to be made, or nothing if one is already scheduled or if the window isn't visible
+	[[nodiscard]] std::optional<clock::time_point> request(clock::time_point now) noexcept;
+
+	// Has to be called when the scheduled pass is made
+	void on_pass(clock::time_point now) noexcept;
+
+	// Returns when the update pass has to be made if the window became visible: playback may have
+	// continued while it was hidden
+	[[nodiscard]] std::optional<clock::time_point> set_visible(bool visible, clock::time_point now) noexcept;
+	[[nodiscard]] bool is_visible() const noexcept { return visible; }
+
+	void record_wakeup() noexcept { ++pacer_stats.wakeups; }
+	void record_redundant_set_skipped() noexcept { ++pacer_stats.redundant_sets_skipped; }
+
+	[[nodiscard]] const Stats & stats() const noexcept { return pacer_stats; }
+
+private:
+	[[nodiscard]] clock::time_point next_pass_time(clock::time_point now) const noexcept;
+
+	microseconds interval = default_refresh_interval;
+	std::optional<clock::time_point> last_pass;
+	bool pass_scheduled = false;
+	bool visible = true;
+
+	Stats pacer_stats;
+};
+
+// CPU time used by the whole process so far
+[[nodiscard]] std::chrono::microseconds process_cpu_time() noexcept;
@@ -0,0 +1,89 @@
+#include "video_clock.hh"
+
+#include <algorithm>
+
+namespace
+{
+	// Don't extrapolate too far past the last anchor: if frames stop arriving
+	// (e.g. buffering) the estimation would run ahead of the video
+	constexpr int max_extrapolated_frames = 2;
+	constexpr std::chrono::microseconds max_extrapolation_without_frames{ 1'000'000 }; // QMediaPlayer's default notify interval
+
+	constexpr std::chrono::microseconds max_frame_duration{ 200'000 };
+} // namespace
+
+void VideoClock::on_frame(const microseconds presentation_time, const clock::time_point now) noexcept
+{
+	if (presentation_time < microseconds(0)) // Unknown timestamp
+		return;
+
+	if (frames_seen)
+	{
+		const microseconds delta = presentation_time - last_frame_presentation_time;
+		if (delta > microseconds(0) && delta <= max_frame_duration)
+			estimated_frame_duration = delta;
+	}
+
+	frames_seen = true;
+	last_frame_presentation_time = presentation_time;
+	last_frame_time = now;
+
+	anchor(presentation_time, now);
+	anchored_on_frame = true;
+}
+
+void VideoClock::on_position_reported(const microseconds position, const clock::time_point now) noexcept
+{
+	if (has_recent_frames(now))
+	{
+		// Frames are more precise. Only take the report into account if the position jumped
+		const microseconds difference = position - this->position(now);
+		if (difference < discontinuity_threshold && difference > -discontinuity_threshold)
+			return;
+	}
+
+	anchor(position, now);
+	anchored_on_frame = false;
+}
+
+void VideoClock::set_playing(const bool is_playing, const clock::time_point now) noexcept
+{
+	if (is_playing == playing)
+		return;
+
+	// Freeze (or resume from) the current estimation
+	anchor(position(now), now);
+	playing = is_playing;
+}
+
+void VideoClock::reset(const microseconds position, const clock::time_point now) noexcept
+{
+	const bool was_playing = playing;
+	*this = VideoClock();
+	anchor(position, now);
+	playing = was_playing;
+}
+
+VideoClock::microseconds VideoClock::position(const clock::time_point now) const noexcept
+{
+	if (!playing)
+		return anchor_position;
+
+	const auto elapsed = std::chrono::duration_cast<microseconds>(now - anchor_time);
+	const microseconds max_extrapolation = anchored_on_frame
+		? estimated_frame_duration * max_extrapolated_frames
+		: max_extrapolation_without_frames;
+
+	return anchor_position + std::clamp(elapsed, microseconds(0), max_extrapolation);
+}
+
+bool VideoClock::has_recent_frames(const clock::time_point now) const noexcept
+{
+	return frames_seen && now - last_frame_time < frame_timeout;
+}
+
+void VideoClock::anchor(const microseconds position, const clock::time_point now) noexcept
+{
+	anchor_position = position;
+	anchor_time = now;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+
+// Estimates the current playback position with sub-frame resolution.
+// It is anchored on the presentation timestamps of the decoded frames (or on
+// the coarse positions reported by the player, until frames arrive) and
+// interpolated between anchors with a high-resolution clock
+class VideoClock
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using microseconds = std::chrono::microseconds;
+
+	static constexpr microseconds default_frame_duration{ 1'000'000 / 30 };
+
+	// Position reports further than this from the estimation are considered seeks
+	static constexpr microseconds discontinuity_threshold{ 500'000 };
+
+	// If no frame has arrived in this time, fall back to the positions reported by the player
+	static constexpr microseconds frame_timeout{ 500'000 };
+
+	void on_frame(microseconds presentation_time, clock::time_point now) noexcept;
+	void on_position_reported(microseconds position, clock::time_point now) noexcept;
+	void set_playing(bool is_playing, clock::time_point now) noexcept;
+	void reset(microseconds position, clock::time_point now) noexcept;
+
+	[[nodiscard]] microseconds position(clock::time_point now) const noexcept;
+	[[nodiscard]] microseconds frame_duration() const noexcept { return estimated_frame_duration; }
+	[[nodiscard]] bool is_playing() const noexcept { return playing; }
+	[[nodiscard]] bool has_recent_frames(clock::time_point now) const noexcept;
+
+private:
+	void anchor(microseconds position, clock::time_point now) noexcept;
+
+	microseconds anchor_position{ 0 };
+	clock::time_point anchor_time{};
+	bool anchored_on_frame = false;
+	bool playing = false;
+
+	bool frames_seen = false;
+	microseconds last_frame_presentation_time{ 0 };
+	clock::time_point last_frame_time{};
+	microseconds estimated_frame_duration = default_frame_duration;
+};
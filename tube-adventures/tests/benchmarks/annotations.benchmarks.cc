@@ -0,0 +1,162 @@
+#include <catch2/catch.hpp>
+
+#include "annotation_binary.hh"
+#include "annotations.hh"
+#include "benchmark_counters.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::string_view_literals;
+
+namespace
+{
+	const std::filesystem::path annotations_dir = "../../../data";
+	const std::filesystem::path tube_adventures_1_dir = annotations_dir / "TUBE-ADVENTURES";
+	const std::filesystem::path tube_adventures_3_dir = annotations_dir / "TUBE-ADVENTURES 3";
+
+	struct CorpusFile
+	{
+		std::string filename; // UTF-8
+		std::uint64_t size;
+	};
+
+	// Annotation files of all the games that parse, smallest first
+	[[nodiscard]] std::vector<CorpusFile> valid_corpus_files()
+	{
+		std::vector<CorpusFile> files;
+
+		for (const auto & entry : std::filesystem::recursive_directory_iterator(annotations_dir))
+		{
+			if (!entry.is_regular_file() || entry.path().extension() != annotation_file_extension)
+				continue;
+
+			std::string filename = entry.path().u8string();
+			if (parse_annotations(filename.c_str()).error != ParseAnnotationsError::success)
+				continue;
+
+			files.push_back({ std::move(filename), static_cast<std::uint64_t>(entry.file_size()) });
+		}
+
+		std::sort(files.begin(), files.end(), [](const CorpusFile & lhs, const CorpusFile & rhs)
+		{
+			return lhs.size < rhs.size;
+		});
+
+		return files;
+	}
+} // namespace
+
+TEST_CASE("parse_annotations", "[parse_annotations]")
+{
+	const std::vector<CorpusFile> files = valid_corpus_files();
+	REQUIRE_FALSE(files.empty());
+
+	const std::pair<const char *, const CorpusFile &> benchmarked_files[] = {
+		{ "smallest", files.front() },
+		{ "median", files[files.size() / 2] },
+		{ "largest", files.back() },
+	};
+
+	for (const auto & [label, file] : benchmarked_files)
+	{
+		const char * const filename = file.filename.c_str();
+
+		set_benchmark_counters("parse_annotations " + std::string(label), { file.size, count_allocations([filename] { return parse_annotations(filename); }) });
+
+		BENCHMARK("parse_annotations " + std::string(label))
+		{
+			return parse_annotations(filename);
+		};
+	}
+}
+
+// The same files as parse_annotations, already parsed and serialized
+TEST_CASE("parse_binary_annotations", "[parse_binary_annotations]")
+{
+	const std::vector<CorpusFile> files = valid_corpus_files();
+	REQUIRE_FALSE(files.empty());
+
+	const std::pair<const char *, const CorpusFile &> benchmarked_files[] = {
+		{ "smallest", files.front() },
+		{ "median", files[files.size() / 2] },
+		{ "largest", files.back() },
+	};
+
+	for (const auto & [label, file] : benchmarked_files)
+	{
+		const std::vector<std::uint8_t> data = serialize_annotations(parse_annotations(file.filename.c_str()).annotations);
+		const auto parse = [&data] { return parse_binary_annotations(data.data(), data.size()); };
+
+		set_benchmark_counters("parse_binary_annotations " + std::string(label), { data.size(), count_allocations(parse) });
+
+		BENCHMARK("parse_binary_annotations " + std::string(label))
+		{
+			return parse();
+		};
+	}
+}
+
+TEST_CASE("Youtube IDs", "[youtube_id]")
+{
+	const std::filesystem::path annotation_path = tube_adventures_1_dir / "TUBE-ADVENTURES (aventura interactiva) BckqqsJiDUI.xml";
+	set_benchmark_counters("path_to_youtube_video_id", { annotation_path.native().size(), count_allocations([&annotation_path] { return path_to_youtube_video_id(annotation_path, annotation_file_extension); }) });
+	BENCHMARK("path_to_youtube_video_id")
+	{
+		return path_to_youtube_video_id(annotation_path, annotation_file_extension);
+	};
+
+	constexpr std::string_view url = "https://www.youtube.com/watch?annotation_id=annotation_953980&ei=hKMCXMeuJIG5Va7bkYAJ&feature=iv&src_vid=BckqqsJiDUI&v=5AkWHfJV8RQ"sv;
+	set_benchmark_counters("youtube_video_id_from_url", { url.size(), count_allocations([url] { return youtube_video_id_from_url(url); }) });
+	BENCHMARK("youtube_video_id_from_url")
+	{
+		return youtube_video_id_from_url(url);
+	};
+
+	constexpr std::string_view id = "BckqqsJiDUI"sv;
+	set_benchmark_counters("full_youtube_url_from_id", { id.size(), count_allocations([id] { return full_youtube_url_from_id(id); }) });
+	BENCHMARK("full_youtube_url_from_id")
+	{
+		return full_youtube_url_from_id(id);
+	};
+}
+
+TEST_CASE("Rect region decoders", "[decoders]")
+{
+	constexpr std::string_view number = "51.56250"sv;
+	set_benchmark_counters("parse_annotation_float", { number.size(), count_allocations([number] { return parse_annotation_float(number); }) });
+	BENCHMARK("parse_annotation_float")
+	{
+		return parse_annotation_float(number);
+	};
+
+	constexpr std::string_view timestamp = "0:01:59.04"sv;
+	set_benchmark_counters("parse_annotation_timestamp", { timestamp.size(), count_allocations([timestamp] { return parse_annotation_timestamp(timestamp); }) });
+	BENCHMARK("parse_annotation_timestamp")
+	{
+		return parse_annotation_timestamp(timestamp);
+	};
+}
+
+TEST_CASE("find_path_with_youtube_id", "[find_path_with_youtube_id]")
+{
+	// The last one the directory is listed in, so all of them are looked at
+	std::string last_id;
+	for (const auto & entry : std::filesystem::directory_iterator(tube_adventures_3_dir))
+	{
+		if (const std::optional<std::string> id = path_to_youtube_video_id(entry.path(), annotation_file_extension); id.has_value())
+			last_id = *id;
+	}
+	REQUIRE_FALSE(last_id.empty());
+
+	set_benchmark_counters("find_path_with_youtube_id", { 0, count_allocations([&last_id] { return find_path_with_youtube_id(last_id, tube_adventures_3_dir, annotation_file_extension); }) });
+	BENCHMARK("find_path_with_youtube_id")
+	{
+		return find_path_with_youtube_id(last_id, tube_adventures_3_dir, annotation_file_extension);
+	};
+}
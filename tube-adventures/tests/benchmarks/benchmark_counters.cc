@@ -0,0 +1,75 @@
+#include "benchmark_counters.hh"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+
+TUBE_ADVENTURES_COUNT_ALLOCATIONS()
+
+namespace
+{
+	[[nodiscard]] std::map<std::string, BenchmarkCounters> & counters_by_name()
+	{
+		static std::map<std::string, BenchmarkCounters> counters;
+		return counters;
+	}
+
+	struct BenchmarkResult
+	{
+		std::string name;
+		double nanoseconds_per_run;
+	};
+
+	// Catch only reports the time per run. Prints it again with the bytes per second and the allocations
+	class BenchmarkCountersListener : public Catch::TestEventListenerBase
+	{
+	public:
+		using TestEventListenerBase::TestEventListenerBase;
+
+		void benchmarkEnded(const Catch::BenchmarkStats<> & stats) override
+		{
+			const std::chrono::duration<double, std::nano> mean = stats.mean.point;
+			results.push_back({ stats.info.name, mean.count() });
+		}
+
+		void testRunEnded(const Catch::TestRunStats & stats) override
+		{
+			if (!results.empty())
+			{
+				std::printf("\n%-48s %14s %14s %14s %14s\n", "benchmark", "ns/run", "MB/s", "allocs/run", "alloc bytes");
+
+				for (const BenchmarkResult & result : results)
+				{
+					const auto counters = counters_by_name().find(result.name);
+					const BenchmarkCounters found = counters != counters_by_name().end() ? counters->second : BenchmarkCounters{};
+
+					const double megabytes_per_second = found.bytes > 0 && result.nanoseconds_per_run > 0.0
+						? static_cast<double>(found.bytes) / result.nanoseconds_per_run * 1'000.0
+						: 0.0;
+
+					std::printf("%-48s %14.1f %14.2f %14llu %14llu\n", result.name.c_str(), result.nanoseconds_per_run, megabytes_per_second,
+						static_cast<unsigned long long>(found.allocations.allocations), static_cast<unsigned long long>(found.allocations.bytes));
+				}
+
+				if (!counting_allocations())
+					std::printf("Allocations are not being counted\n");
+			}
+
+			TestEventListenerBase::testRunEnded(stats);
+		}
+
+	private:
+		std::vector<BenchmarkResult> results;
+	};
+} // namespace
+
+CATCH_REGISTER_LISTENER(BenchmarkCountersListener)
+
+void set_benchmark_counters(std::string benchmark_name, const BenchmarkCounters counters)
+{
+	counters_by_name()[std::move(benchmark_name)] = counters;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "allocation_counter.hh"
+
+#include <cstdint>
+#include <string>
+
+// What one run of a benchmark processes and allocates. Printed next to its time per run when all the
+// benchmarks are done, matched by name
+struct BenchmarkCounters
+{
+	std::uint64_t bytes = 0; // Input processed, 0 if it doesn't make sense for the benchmark
+	AllocationCounts allocations;
+};
+
+void set_benchmark_counters(std::string benchmark_name, BenchmarkCounters counters);
+
+// Runs it once and counts what it allocates
+template <typename Function>
+[[nodiscard]] AllocationCounts count_allocations(Function && function)
+{
+	const AllocationCounts before = allocation_counts();
+	(void)function();
+
+	return allocation_counts() - before;
+}
@@ -0,0 +1,428 @@
+#include "annotations.hh"
+#include "mainwindow.hh"
+#include "mp4_index.hh"
+#include "story_graph.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QKeyEvent>
+#include <QPushButton>
+#include <QTemporaryDir>
+#include <QTimer>
+
+// Opens a game in a MainWindow on the offscreen platform, with the same small test video for every scene, and clicks
+// gameplay annotations like a player would. Reports the percentiles of the time from the click to the first frame of
+// the next scene, by stage
+namespace
+{
+	using clock = VideoClock::clock;
+	using namespace std::chrono_literals;
+
+	constexpr auto poll_interval = 5ms;
+
+	struct Transition
+	{
+		clock::time_point click;
+		SceneLoadTimings timings;
+	};
+
+	struct Stage
+	{
+		const char * name;
+		const char * description;
+		clock::duration (*duration)(const Transition &);
+	};
+
+	[[nodiscard]] clock::time_point media_loaded(const SceneLoadTimings & timings)
+	{
+		// If the player didn't report it, everything until the first frame counts as loading
+		return timings.media_loaded.value_or(timings.first_frame);
+	}
+
+	constexpr Stage stages[] = {
+		{ "input", "click to the scene changing", [](const Transition & transition) { return transition.timings.start - transition.click; } },
+		{ "scene", "annotations parsed and laid out", [](const Transition & transition) { return transition.timings.scene_loaded - transition.timings.start; } },
+		{ "set_media", "video given to the player", [](const Transition & transition) { return transition.timings.media_set - transition.timings.scene_loaded; } },
+		{ "media_load", "player loaded the video", [](const Transition & transition) { return media_loaded(transition.timings) - transition.timings.media_set; } },
+		{ "first_frame", "first frame shown", [](const Transition & transition) { return transition.timings.first_frame - media_loaded(transition.timings); } },
+		{ "total", "click to the first frame", [](const Transition & transition) { return transition.timings.first_frame - transition.click; } },
+	};
+
+	struct Percentiles
+	{
+		double mean = 0.0;
+		double p50 = 0.0;
+		double p90 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	// In milliseconds. Nearest rank
+	[[nodiscard]] Percentiles percentiles(std::vector<clock::duration> durations)
+	{
+		Percentiles result;
+		if (durations.empty())
+			return result;
+
+		std::sort(durations.begin(), durations.end());
+
+		const auto to_milliseconds = [](const clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+		const auto at = [&](const double fraction)
+		{
+			const auto rank = static_cast<std::size_t>(fraction * static_cast<double>(durations.size() - 1) + 0.5);
+			return to_milliseconds(durations[rank]);
+		};
+
+		clock::duration sum{ 0 };
+		for (const clock::duration duration : durations)
+			sum += duration;
+
+		result.mean = to_milliseconds(sum) / static_cast<double>(durations.size());
+		result.p50 = at(0.5);
+		result.p90 = at(0.9);
+		result.p99 = at(0.99);
+		result.max = to_milliseconds(durations.back());
+		return result;
+	}
+
+	[[nodiscard]] Percentiles stage_percentiles(const Stage & stage, const std::vector<Transition> & transitions)
+	{
+		std::vector<clock::duration> durations;
+		durations.reserve(transitions.size());
+		for (const Transition & transition : transitions)
+			durations.push_back(stage.duration(transition));
+
+		return percentiles(std::move(durations));
+	}
+
+	// One file per scene, so the game finds a video for every youtube ID. Hard links if possible
+	[[nodiscard]] bool prepare_video_directory(const std::filesystem::path & directory, const std::filesystem::path & video, const std::vector<GameScene> & scenes)
+	{
+		std::error_code error;
+		for (const GameScene & scene : scenes)
+		{
+			const std::filesystem::path scene_video = directory / std::filesystem::u8path("scene " + scene.youtube_id + ".mp4");
+
+			std::filesystem::create_hard_link(video, scene_video, error);
+			if (error && !std::filesystem::copy_file(video, scene_video, error))
+				return false;
+		}
+
+		return true;
+	}
+
+	// Clicks a gameplay annotation as soon as the first frame of a scene is shown, and waits for the first frame
+	// of the scene it leads to. Goes back at dead ends
+	class ClickDriver
+	{
+	public:
+		ClickDriver(const SceneIdIndex & index_, const std::chrono::microseconds video_duration_, const std::size_t transition_count_, const clock::duration timeout_)
+			: index(index_)
+			, video_duration(video_duration_)
+			, transition_count(transition_count_)
+			, timeout(timeout_)
+		{
+			transitions.reserve(transition_count);
+		}
+
+		void start(MainWindow & window_)
+		{
+			window = &window_;
+			waiting_since = clock::now();
+
+			poll_timer.setInterval(static_cast<int>(poll_interval.count()));
+			QObject::connect(&poll_timer, &QTimer::timeout, [this]() { poll(); });
+			poll_timer.start();
+		}
+
+		void on_first_frame(const SceneLoadTimings & timings)
+		{
+			if (state != State::loading)
+				return;
+
+			if (click_time.has_value())
+			{
+				transitions.push_back({ *click_time, timings });
+				click_time.reset();
+
+				if (transitions.size() >= transition_count)
+				{
+					finish(nullptr);
+					return;
+				}
+			}
+
+			choose_annotation();
+		}
+
+		[[nodiscard]] const std::vector<Transition> & get_transitions() const noexcept { return transitions; }
+		[[nodiscard]] std::size_t get_missed_annotations() const noexcept { return missed_annotations; }
+		[[nodiscard]] std::size_t get_dead_ends() const noexcept { return dead_ends; }
+		[[nodiscard]] const char * get_error() const noexcept { return error; }
+
+	private:
+		enum class State
+		{
+			loading, // Waiting for the first frame of a scene
+			waiting_for_annotation, // Waiting for the chosen annotation to be shown
+			done,
+		};
+
+		void choose_annotation()
+		{
+			const GameSession & session = window->get_session();
+			const std::vector<Annotation> & annotations = session.annotations();
+
+			// The ones that lead to another scene of the game and are shown before the test video ends
+			std::vector<int> candidates;
+			for (std::size_t i = 0; i < annotations.size(); ++i)
+			{
+				const Annotation & annotation = annotations[i];
+				if (annotation.type != Annotation::Type::gameplay || annotation.start_rect.time + 1s >= video_duration)
+					continue;
+
+				if (const std::optional<std::string_view> target = youtube_video_id_from_url(annotation.click_url); target.has_value() && index.find(*target).has_value())
+					candidates.push_back(static_cast<int>(i));
+			}
+
+			if (candidates.empty())
+			{
+				go_back();
+				return;
+			}
+
+			chosen_annotation = candidates[choices_made % candidates.size()];
+			++choices_made;
+
+			// Past the start, so it's shown even if the seek lands slightly early
+			const Annotation & annotation = annotations[static_cast<std::size_t>(chosen_annotation)];
+			window->seek_to(annotation.start_rect.time + 100ms);
+
+			state = State::waiting_for_annotation;
+			waiting_since = clock::now();
+		}
+
+		void go_back()
+		{
+			++dead_ends;
+
+			if (window->get_session().history_size() == 0)
+			{
+				finish("Dead end with nowhere to go back to");
+				return;
+			}
+
+			state = State::loading;
+			waiting_since = clock::now();
+
+			QKeyEvent key_press(QEvent::Type::KeyPress, Qt::Key::Key_Backspace, Qt::KeyboardModifier::NoModifier);
+			QCoreApplication::sendEvent(window, &key_press);
+		}
+
+		void poll()
+		{
+			const auto now = clock::now();
+
+			switch (state)
+			{
+			case State::loading:
+			{
+				if (now - waiting_since > timeout)
+					finish("The first frame of a scene wasn't shown in time");
+
+				break;
+			}
+			case State::waiting_for_annotation:
+			{
+				const Annotation & annotation = window->get_session().annotations()[static_cast<std::size_t>(chosen_annotation)];
+				auto * const button = window->findChild<QPushButton *>(QString::fromStdString(annotation.id));
+
+				if (button != nullptr && button->isVisible())
+				{
+					state = State::loading;
+					waiting_since = now;
+					click_time = clock::now();
+					button->click();
+				}
+				else if (now - waiting_since > timeout)
+				{
+					// Try another one
+					++missed_annotations;
+					if (missed_annotations > transition_count)
+						finish("The annotations aren't being shown");
+					else
+						choose_annotation();
+				}
+
+				break;
+			}
+			case State::done:
+				break;
+			}
+		}
+
+		void finish(const char * const error_)
+		{
+			state = State::done;
+			error = error_;
+			poll_timer.stop();
+			QCoreApplication::exit(error != nullptr ? 1 : 0);
+		}
+
+		const SceneIdIndex & index;
+		const std::chrono::microseconds video_duration;
+		const std::size_t transition_count;
+		const clock::duration timeout;
+
+		MainWindow * window = nullptr;
+		QTimer poll_timer;
+
+		State state = State::loading;
+		clock::time_point waiting_since;
+		int chosen_annotation = -1;
+		std::size_t choices_made = 0;
+		std::optional<clock::time_point> click_time;
+
+		std::vector<Transition> transitions;
+		std::size_t missed_annotations = 0;
+		std::size_t dead_ends = 0;
+		const char * error = nullptr;
+	};
+
+	[[nodiscard]] bool write_report(const std::filesystem::path & path, const std::vector<Transition> & transitions)
+	{
+		std::FILE * const file = std::fopen(path.string().c_str(), "wb");
+		if (file == nullptr)
+			return false;
+
+		std::fprintf(file, "{\n\t\"transitions\": %zu", transitions.size());
+
+		for (const Stage & stage : stages)
+		{
+			const Percentiles result = stage_percentiles(stage, transitions);
+			std::fprintf(file, ",\n\t\"%s_mean_ms\": %.3f,\n\t\"%s_p50_ms\": %.3f,\n\t\"%s_p90_ms\": %.3f,\n\t\"%s_p99_ms\": %.3f,\n\t\"%s_max_ms\": %.3f",
+				stage.name, result.mean, stage.name, result.p50, stage.name, result.p90, stage.name, result.p99, stage.name, result.max);
+		}
+
+		std::fputs("\n}\n", file);
+		return std::fclose(file) == 0;
+	}
+
+	void print_report(const std::vector<Transition> & transitions)
+	{
+		std::printf("%zu transitions\n\n%-12s %-32s %10s %10s %10s %10s %10s\n", transitions.size(), "stage (ms)", "", "mean", "p50", "p90", "p99", "max");
+
+		for (const Stage & stage : stages)
+		{
+			const Percentiles result = stage_percentiles(stage, transitions);
+			std::printf("%-12s %-32s %10.2f %10.2f %10.2f %10.2f %10.2f\n", stage.name, stage.description, result.mean, result.p50, result.p90, result.p99, result.max);
+		}
+	}
+} // namespace
+
+int main(int argc, char * argv[])
+{
+	// No window system needed. Set QT_QPA_PLATFORM to watch it
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+
+	QApplication app(argc, argv);
+
+	QCommandLineParser command_line_parser;
+	command_line_parser.setApplicationDescription("Clicks gameplay annotations in an offscreen window and reports the time from the click to the first frame of the next scene");
+	command_line_parser.addHelpOption();
+
+	const QCommandLineOption video_option("video", "Test video (.mp4) played in every scene", "file");
+	command_line_parser.addOption(video_option);
+
+	const QCommandLineOption first_scene_option("first-scene", "Annotation file of the scene to start in. The rest of the game is in its directory", "file",
+		"../../../data/TUBE-ADVENTURES/TUBE-ADVENTURES (aventura interactiva) BckqqsJiDUI.xml");
+	command_line_parser.addOption(first_scene_option);
+
+	const QCommandLineOption transitions_option("transitions", "Annotations clicked (200 by default)", "count", "200");
+	command_line_parser.addOption(transitions_option);
+
+	const QCommandLineOption timeout_option("timeout", "How long to wait for an annotation or a first frame, in milliseconds (10000 by default)", "milliseconds", "10000");
+	command_line_parser.addOption(timeout_option);
+
+	const QCommandLineOption report_option("report", "Write the percentiles as JSON to the file", "file");
+	command_line_parser.addOption(report_option);
+
+	command_line_parser.process(app);
+
+	if (!command_line_parser.isSet(video_option))
+	{
+		std::fputs("A test video is needed (--video)\n", stderr);
+		return 1;
+	}
+
+	const std::filesystem::path video = std::filesystem::u8path(command_line_parser.value(video_option).toStdString());
+	const Mp4ParseResult video_info = read_mp4_file(video);
+	if (video_info.error != Mp4Error::success)
+	{
+		std::fprintf(stderr, "Can't read the test video \"%s\"\n", video.u8string().c_str());
+		return 1;
+	}
+
+	const std::filesystem::path first_scene = std::filesystem::u8path(command_line_parser.value(first_scene_option).toStdString());
+	const GameDirectory game = load_game_directory(first_scene.parent_path());
+	if (game.scenes.empty())
+	{
+		std::fprintf(stderr, "No scenes in \"%s\"\n", first_scene.parent_path().u8string().c_str());
+		return 1;
+	}
+	const SceneIdIndex index(game.scenes);
+
+	// A new one each run, so that runs at the same time don't share it. Removed when destroyed
+	QTemporaryDir temporary_directory(QDir::tempPath() + "/tube-adventures-click-latency-XXXXXX");
+	const std::filesystem::path video_directory = std::filesystem::u8path(temporary_directory.path().toStdString());
+	if (!temporary_directory.isValid() || !prepare_video_directory(video_directory, video, game.scenes))
+	{
+		std::fprintf(stderr, "Can't prepare the videos in \"%s\"\n", video_directory.u8string().c_str());
+		return 1;
+	}
+
+	ClickDriver driver(index, video_info.info.duration, command_line_parser.value(transitions_option).toULongLong(),
+		std::chrono::milliseconds(command_line_parser.value(timeout_option).toLongLong()));
+
+	MainWindowOptions options;
+	options.first_scene = first_scene;
+	options.video_directory = video_directory;
+	options.on_first_frame = [&driver](const SceneLoadTimings & timings) { driver.on_first_frame(timings); };
+
+	int exit_code = 0;
+	{
+		MainWindow window(options);
+		window.show();
+
+		driver.start(window);
+		exit_code = app.exec();
+	}
+
+	(void)temporary_directory.remove();
+
+	print_report(driver.get_transitions());
+	std::printf("\n%zu annotations not shown in time, %zu dead ends\n", driver.get_missed_annotations(), driver.get_dead_ends());
+
+	if (driver.get_error() != nullptr)
+		std::fprintf(stderr, "%s\n", driver.get_error());
+
+	if (command_line_parser.isSet(report_option) && !write_report(std::filesystem::u8path(command_line_parser.value(report_option).toStdString()), driver.get_transitions()))
+	{
+		std::fputs("Can't write the report\n", stderr);
+		return 1;
+	}
+
+	return exit_code != 0 || driver.get_transitions().empty() ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+#include "state_explorer.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+// Explores every scene and game state a game whose scenes are variants for states (TUBE-ADVENTURES 3) can get to, for
+// content QA: which videos can't be reached, which links play a video for another state than the one the game is in,
+// and which states the game can enter a scene in without a video for them
+namespace
+{
+	using clock = std::chrono::steady_clock;
+
+	[[nodiscard]] std::string filename(const GameScene & scene)
+	{
+		return scene.annotations_path.filename().u8string();
+	}
+
+	[[nodiscard]] const char * link_kind(const bool highlight) noexcept
+	{
+		return highlight ? "highlight" : "annotation";
+	}
+
+	// The scenes nothing links to, where the game can start. If they all have links to them, the one the most scenes
+	// link to, which is the menu the game goes back to (TUBE-ADVENTURES 3 links to it from almost every scene)
+	[[nodiscard]] std::vector<std::size_t> start_scenes(const StoryGraph & graph)
+	{
+		std::vector<std::size_t> linking_scenes(graph.links.size(), 0);
+		for (std::size_t scene = 0; scene < graph.links.size(); ++scene)
+		{
+			std::vector<std::size_t> targets;
+			for (const StoryLink & link : graph.links[scene])
+			{
+				if (link.target_scene.has_value() && *link.target_scene != scene)
+					targets.push_back(*link.target_scene);
+			}
+
+			std::sort(targets.begin(), targets.end());
+			targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+			for (const std::size_t target : targets)
+				++linking_scenes[target];
+		}
+
+		std::vector<std::size_t> scenes;
+		for (std::size_t i = 0; i < linking_scenes.size(); ++i)
+		{
+			if (linking_scenes[i] == 0)
+				scenes.push_back(i);
+		}
+
+		if (scenes.empty() && !linking_scenes.empty())
+			scenes.push_back(static_cast<std::size_t>(std::max_element(linking_scenes.begin(), linking_scenes.end()) - linking_scenes.begin()));
+
+		return scenes;
+	}
+} // namespace
+
+int main(int argc, char * argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser command_line_parser;
+	command_line_parser.setApplicationDescription("Explores every scene and game state a game can get to, and lists the videos that can't be reached, "
+		"the links to videos for another state and the states without a video");
+	command_line_parser.addHelpOption();
+
+	const QCommandLineOption game_option("game", "Directory with the annotations of the game", "directory", "../../../data/TUBE-ADVENTURES 3");
+	command_line_parser.addOption(game_option);
+
+	const QCommandLineOption start_option("start", "Youtube ID of the scene the game starts in, and starts again when it goes back to it "
+		"(every scene nothing links to by default, or the one the most scenes link to)", "id");
+	command_line_parser.addOption(start_option);
+
+	const QCommandLineOption threads_option("threads", "Threads to explore with (as many as the hardware runs at once by default)", "count", "0");
+	command_line_parser.addOption(threads_option);
+
+	const QCommandLineOption max_states_option("max-states", "Most pairs of scene and state to explore (10000000 by default)", "count", "10000000");
+	command_line_parser.addOption(max_states_option);
+
+	const QCommandLineOption strict_option("strict", "Fail if something is found");
+	command_line_parser.addOption(strict_option);
+
+	command_line_parser.process(app);
+
+	const auto start = clock::now();
+
+	const GameDirectory game = load_game_directory(std::filesystem::u8path(command_line_parser.value(game_option).toStdString()));
+	if (game.scenes.empty())
+	{
+		std::fputs("The game has no scenes\n", stderr);
+		return 1;
+	}
+
+	const SceneIdIndex ids(game.scenes);
+	const StoryGraph graph = build_story_graph(game.scenes, ids);
+	const SceneStateIndex index(game.scenes);
+
+	StateExplorerOptions options;
+	options.threads = static_cast<unsigned>(command_line_parser.value(threads_option).toULongLong());
+	options.max_states = std::max<std::size_t>(command_line_parser.value(max_states_option).toULongLong(), 1);
+
+	if (command_line_parser.isSet(start_option))
+	{
+		const std::string start_id = command_line_parser.value(start_option).toStdString();
+		const std::optional<std::size_t> start_scene = ids.find(start_id);
+		if (!start_scene.has_value())
+		{
+			std::fprintf(stderr, "The game has no scene with ID \"%s\"\n", start_id.c_str());
+			return 1;
+		}
+
+		options.start_scenes.push_back(*start_scene);
+	}
+	else
+		options.start_scenes = start_scenes(graph);
+
+	const auto loaded = clock::now();
+	const StateExploration exploration = explore_game_states(game.scenes, graph, index, options);
+	const auto explored = clock::now();
+
+	std::printf("%zu variants of %zu scenes, %zu links. Starting from %zu\n", game.scenes.size(), index.scene_count(), graph.link_count(), options.start_scenes.size());
+
+	const AnnotationDedupStats dedup = annotation_dedup_stats(game.scenes);
+	std::printf("%zu annotations, %zu different. %zu highlight links to %zu videos. %zu not loaded (%.1f KB, %.1f KB storing each one once)\n",
+		dedup.annotations, dedup.unique, dedup.highlight_links, dedup.unique_highlight_links, dedup.ignored,
+		static_cast<double>(dedup.memory_usage) / 1e3, static_cast<double>(dedup.unique_memory_usage) / 1e3);
+
+	std::size_t unreachable = 0;
+	for (std::size_t scene = 0; scene < game.scenes.size(); ++scene)
+	{
+		if (exploration.states_per_scene[scene] != 0)
+			continue;
+
+		if (unreachable++ == 0)
+			std::puts("\nVariants that can't be reached:");
+		std::printf("  %s\n", filename(game.scenes[scene]).c_str());
+	}
+
+	if (!exploration.contradictions.empty())
+		std::puts("\nLinks to a variant for another state than the game is in:");
+	for (const StateContradiction & contradiction : exploration.contradictions)
+	{
+		std::printf("  %s, %s %d -> %s in %s", filename(game.scenes[contradiction.from_scene]).c_str(), link_kind(contradiction.highlight), contradiction.annotation_index,
+			filename(game.scenes[contradiction.target_scene]).c_str(), contradiction.state.to_string().c_str());
+		if (contradiction.expected_scene.has_value())
+			std::printf(", instead of %s", filename(game.scenes[*contradiction.expected_scene]).c_str());
+		std::putchar('\n');
+	}
+
+	if (!exploration.missing_combinations.empty())
+		std::puts("\nStates a scene can be entered in without a variant for them:");
+	for (const MissingStateCombination & combination : exploration.missing_combinations)
+	{
+		std::printf("  %s %s, from %s, %s %d\n", std::string(combination.scene).c_str(), combination.state.to_string().c_str(),
+			filename(game.scenes[combination.from_scene]).c_str(), link_kind(combination.highlight), combination.annotation_index);
+	}
+
+	std::printf("\n%zu pairs of scene and state reached. %zu variants can't be reached, %zu links go to a variant for another state, %zu states have no variant\n",
+		exploration.reachable_states, unreachable, exploration.contradictions.size(), exploration.missing_combinations.size());
+	std::printf("Loaded in %.2f s, explored in %.3f s\n", std::chrono::duration<double>(loaded - start).count(), std::chrono::duration<double>(explored - loaded).count());
+
+	if (exploration.truncated)
+	{
+		std::fputs("Stopped before exploring everything (see --max-states)\n", stderr);
+		return 1;
+	}
+
+	const bool found_something = unreachable != 0 || !exploration.contradictions.empty() || !exploration.missing_combinations.empty();
+	return command_line_parser.isSet(strict_option) && found_something ? 1 : 0;
+}
@@ -0,0 +1,448 @@
+#include "allocation_counter.hh"
+#include "game_session.hh"
+#include "headless_session.hh"
+#include "metrics.hh"
+#include "story_graph.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+TUBE_ADVENTURES_COUNT_ALLOCATIONS()
+
+// Loads every game in data/, indexes it, builds its story graph and plays it headlessly following a fixed
+// script. The costs are written as JSON and compared with a baseline, failing if they got worse. Only what
+// doesn't depend on the machine is compared: times are just reported
+namespace
+{
+	using clock = std::chrono::steady_clock;
+	using namespace std::chrono_literals;
+
+	constexpr const char * game_directory_names[] = {
+		"TUBE-ADVENTURES",
+		"TUBE-ADVENTURES 2",
+		"TUBE-ADVENTURES 3",
+		"RAPSODA Y LA JOSE",
+		"Tube Adventures salva la Navidad 1",
+		"Tube Adventures salva la Navidad 2",
+		"Tube Adventures salva la Navidad 3",
+	};
+
+	// The index refers to the scenes, which don't move once loaded
+	struct Game
+	{
+		std::filesystem::path directory;
+		GameDirectory content;
+		SceneIdIndex index;
+		StoryGraph graph;
+	};
+
+	enum class Gate
+	{
+		none, // Only reported
+		no_worse, // Can't grow more than the tolerance
+		same, // What was played. If it changes, so do the other measurements
+	};
+
+	struct Measurement
+	{
+		const char * name;
+		double value;
+		Gate gate; // How it's compared with the baseline
+	};
+
+	struct Totals
+	{
+		clock::duration load{ 0 };
+		clock::duration index{ 0 };
+		clock::duration graph{ 0 };
+		clock::duration startup{ 0 }; // Loading the first scene of each game
+		clock::duration transitions{ 0 };
+		clock::duration playback{ 0 };
+
+		std::uint64_t transition_count = 0;
+		std::uint64_t scene_count = 0;
+		std::uint64_t link_count = 0;
+		std::uint64_t broken_link_count = 0;
+		std::uint64_t parse_error_count = 0;
+		std::uint64_t session_error_count = 0;
+	};
+
+	[[nodiscard]] double to_milliseconds(const clock::duration duration) noexcept
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	// The session can only click the annotations it shows, not the highlights
+	[[nodiscard]] bool clickable(const StoryLink & link) noexcept
+	{
+		return !link.highlight && link.target_scene.has_value();
+	}
+
+	[[nodiscard]] bool leads_somewhere(const std::vector<StoryLink> & scene_links) noexcept
+	{
+		return std::any_of(scene_links.begin(), scene_links.end(), clickable);
+	}
+
+	// The first scene nothing links to that leads somewhere, where the game most likely starts
+	[[nodiscard]] std::size_t start_scene(const Game & game)
+	{
+		std::vector<bool> linked(game.content.scenes.size(), false);
+		for (const std::vector<StoryLink> & scene_links : game.graph.links)
+		{
+			for (const StoryLink & link : scene_links)
+			{
+				if (clickable(link))
+					linked[*link.target_scene] = true;
+			}
+		}
+
+		std::optional<std::size_t> first_leading_somewhere;
+		for (std::size_t i = 0; i < game.graph.links.size(); ++i)
+		{
+			if (!leads_somewhere(game.graph.links[i]))
+				continue;
+
+			if (!linked[i])
+				return i;
+
+			if (!first_leading_somewhere.has_value())
+				first_leading_somewhere = i;
+		}
+
+		return first_leading_somewhere.value_or(0);
+	}
+
+	// Watches a few seconds of each scene, then mostly follows the links that lead somewhere in the game,
+	// going back now and then. From dead ends, and in games without links, it loads the next scene by
+	// filename. The same choices every time
+	void play_game(const Game & game, const std::uint64_t transitions, Totals & totals)
+	{
+		if (game.content.scenes.empty())
+			return;
+
+		std::unordered_map<std::string, std::size_t> scenes_by_key;
+		for (std::size_t i = 0; i < game.content.scenes.size(); ++i)
+			scenes_by_key.emplace(to_utf8_string(game.content.scenes[i].annotations_path), i);
+
+		GameSessionOptions options;
+		options.annotations_directory = game.directory;
+		options.locate_video = [](const std::string_view youtube_id) { return "video/" + std::string(youtube_id) + ".mp4"; };
+
+		HeadlessMedia media;
+		HeadlessView view;
+		view.on_error = [](const std::string_view title, const std::string_view message)
+		{
+			std::fprintf(stderr, "%.*s: %.*s\n", static_cast<int>(title.size()), title.data(), static_cast<int>(message.size()), message.data());
+		};
+
+		GameSession session(media, view, std::move(options));
+
+		const std::size_t first_scene = start_scene(game);
+		clock::time_point now{};
+
+		session.set_viewport_size(1280, 720, now);
+
+		auto start = clock::now();
+		(void)session.load_scene(game.content.scenes[first_scene].annotations_path, now);
+		totals.startup += clock::now() - start;
+
+		for (std::uint64_t step = 0; step < transitions; ++step)
+		{
+			start = clock::now();
+			const clock::time_point scene_start = now;
+			for (int update = 0; update < 20; ++update, now += 250ms)
+			{
+				session.on_position_reported(std::chrono::duration_cast<GameSession::microseconds>(now - scene_start), now);
+				(void)session.update(now);
+			}
+			totals.playback += clock::now() - start;
+
+			const auto current = scenes_by_key.find(session.scene_key());
+			const std::size_t current_scene = current != scenes_by_key.end() ? current->second : first_scene;
+
+			std::vector<int> choices;
+			for (const StoryLink & link : game.graph.links[current_scene])
+			{
+				if (clickable(link))
+					choices.push_back(link.annotation_index);
+			}
+
+			start = clock::now();
+			if (step % 5 == 4 && session.history_size() > 0)
+				(void)session.go_back(now);
+			else if (!choices.empty())
+				(void)session.activate_annotation(choices[step % choices.size()], now);
+			else
+				(void)session.load_scene(game.content.scenes[(current_scene + 1) % game.content.scenes.size()].annotations_path, now);
+			totals.transitions += clock::now() - start;
+
+			++totals.transition_count;
+		}
+
+		totals.session_error_count += view.error_count;
+	}
+
+	[[nodiscard]] Totals run(const std::filesystem::path & data_directory, const std::uint64_t transitions_per_game)
+	{
+		Totals totals;
+		std::vector<Game> games;
+
+		auto start = clock::now();
+		for (const char * const name : game_directory_names)
+		{
+			Game & game = games.emplace_back();
+			game.directory = data_directory / std::filesystem::u8path(name);
+			game.content = load_game_directory(game.directory);
+
+			totals.scene_count += game.content.scenes.size();
+			totals.parse_error_count += game.content.errors.size();
+		}
+		totals.load = clock::now() - start;
+
+		start = clock::now();
+		for (Game & game : games)
+			game.index = SceneIdIndex(game.content.scenes);
+		totals.index = clock::now() - start;
+
+		start = clock::now();
+		for (Game & game : games)
+		{
+			game.graph = build_story_graph(game.content.scenes, game.index);
+			totals.link_count += game.graph.link_count();
+			totals.broken_link_count += game.graph.broken_link_count();
+		}
+		totals.graph = clock::now() - start;
+
+		for (const Game & game : games)
+			play_game(game, transitions_per_game, totals);
+
+		return totals;
+	}
+
+	// The fastest time of each phase over all the runs, so noise only makes it look better
+	void keep_fastest(Totals & fastest, const Totals & totals)
+	{
+		fastest.load = std::min(fastest.load, totals.load);
+		fastest.index = std::min(fastest.index, totals.index);
+		fastest.graph = std::min(fastest.graph, totals.graph);
+		fastest.startup = std::min(fastest.startup, totals.startup);
+		fastest.transitions = std::min(fastest.transitions, totals.transitions);
+		fastest.playback = std::min(fastest.playback, totals.playback);
+	}
+
+	[[nodiscard]] std::string to_json(const std::vector<Measurement> & measurements)
+	{
+		std::string json = "{\n";
+
+		for (std::size_t i = 0; i < measurements.size(); ++i)
+		{
+			char line[128];
+			std::snprintf(line, sizeof(line), "\t\"%s\": %.3f%s\n", measurements[i].name, measurements[i].value, i + 1 < measurements.size() ? "," : "");
+			json += line;
+		}
+
+		json += "}\n";
+		return json;
+	}
+
+	[[nodiscard]] std::optional<std::string> read_file(const std::filesystem::path & path)
+	{
+		std::FILE * const file = std::fopen(path.string().c_str(), "rb");
+		if (file == nullptr)
+			return std::nullopt;
+
+		std::string text;
+		char chunk[4096];
+		while (const std::size_t read = std::fread(chunk, 1, sizeof(chunk), file))
+			text.append(chunk, read);
+
+		std::fclose(file);
+		return text;
+	}
+
+	[[nodiscard]] bool write_file(const std::filesystem::path & path, const std::string & text)
+	{
+		std::FILE * const file = std::fopen(path.string().c_str(), "wb");
+		if (file == nullptr)
+			return false;
+
+		const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+		return std::fclose(file) == 0 && written;
+	}
+
+	// Only for the flat objects of numbers written by to_json
+	[[nodiscard]] std::optional<double> find_json_number(const std::string & json, const std::string_view name)
+	{
+		const std::string quoted_name = '"' + std::string(name) + '"';
+		std::size_t position = json.find(quoted_name);
+		if (position == std::string::npos)
+			return std::nullopt;
+
+		position = json.find(':', position + quoted_name.size());
+		if (position == std::string::npos)
+			return std::nullopt;
+
+		const char * const begin = json.c_str() + position + 1;
+		char * end = nullptr;
+		const double value = std::strtod(begin, &end);
+		if (end == begin)
+			return std::nullopt;
+
+		return value;
+	}
+
+	// Returns false if any gated measurement is worse than the baseline by more than the tolerance, or changed
+	[[nodiscard]] bool compare_with_baseline(const std::vector<Measurement> & measurements, const std::string & baseline, const double tolerance)
+	{
+		bool passed = true;
+
+		std::printf("%-28s %14s %14s %9s\n", "gated measurement", "baseline", "current", "change");
+		for (const Measurement & measurement : measurements)
+		{
+			if (measurement.gate == Gate::none)
+				continue;
+
+			const std::optional<double> expected = find_json_number(baseline, measurement.name);
+			if (!expected.has_value())
+			{
+				// Otherwise a baseline without it would let anything pass
+				std::printf("%-28s %14s %14.3f %9s  MISSING, update the baseline\n", measurement.name, "-", measurement.value, "");
+				passed = false;
+				continue;
+			}
+
+			const double change = *expected > 0.0 ? measurement.value / *expected - 1.0 : 0.0;
+			const bool changed = measurement.gate == Gate::same && measurement.value != *expected;
+			const bool regressed = measurement.gate == Gate::no_worse && measurement.value > *expected * (1.0 + tolerance);
+			passed = passed && !changed && !regressed;
+
+			const char * const verdict = changed ? "  CHANGED, update the baseline"
+				: regressed ? "  REGRESSED"
+				: change < -tolerance ? "  improved, consider updating the baseline"
+				: "";
+
+			std::printf("%-28s %14.3f %14.3f %+8.1f%%%s\n", measurement.name, *expected, measurement.value, change * 100.0, verdict);
+		}
+
+		return passed;
+	}
+} // namespace
+
+int main(int argc, char * argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser command_line_parser;
+	command_line_parser.setApplicationDescription("Loads, indexes and plays all the games headlessly, and compares the cost with a baseline");
+	command_line_parser.addHelpOption();
+
+	const QCommandLineOption data_option("data", "Directory with the annotations of all the games", "directory", "../../../data");
+	command_line_parser.addOption(data_option);
+
+	const QCommandLineOption baseline_option("baseline", "JSON report to compare with", "file");
+	command_line_parser.addOption(baseline_option);
+
+	const QCommandLineOption write_baseline_option("write-baseline", "Write the report to the baseline file instead of comparing with it");
+	command_line_parser.addOption(write_baseline_option);
+
+	const QCommandLineOption tolerance_option("tolerance", "How much more than the baseline it can allocate, as a fraction (0.25 by default)", "fraction", "0.25");
+	command_line_parser.addOption(tolerance_option);
+
+	const QCommandLineOption report_option("report", "Write the JSON report to the file", "file");
+	command_line_parser.addOption(report_option);
+
+	const QCommandLineOption transitions_option("transitions", "Scene transitions per game (100 by default)", "count", "100");
+	command_line_parser.addOption(transitions_option);
+
+	const QCommandLineOption repetitions_option("repetitions", "Times everything is run. The fastest time of each phase is kept (3 by default)", "count", "3");
+	command_line_parser.addOption(repetitions_option);
+
+	command_line_parser.process(app);
+
+	const std::filesystem::path data_directory = std::filesystem::u8path(command_line_parser.value(data_option).toStdString());
+	const std::uint64_t transitions_per_game = command_line_parser.value(transitions_option).toULongLong();
+	const std::uint64_t repetitions = std::max<std::uint64_t>(command_line_parser.value(repetitions_option).toULongLong(), 1);
+
+	// Only what the games take, not the libraries already loaded
+	const std::size_t initial_resident_set_size = resident_set_size().value_or(0);
+
+	const auto wall_start = clock::now();
+
+	// The allocations of the first run. Later runs are the same work
+	const AllocationCounts allocations_before = allocation_counts();
+	Totals totals = run(data_directory, transitions_per_game);
+	const AllocationCounts allocations = allocation_counts() - allocations_before;
+
+	for (std::uint64_t i = 1; i < repetitions; ++i)
+		keep_fastest(totals, run(data_directory, transitions_per_game));
+
+	const double wall_time_ms = to_milliseconds(clock::now() - wall_start);
+
+	const double transitions = static_cast<double>(std::max<std::uint64_t>(totals.transition_count, 1));
+	const std::vector<Measurement> measurements = {
+		{ "allocations", static_cast<double>(allocations.allocations), Gate::no_worse },
+		{ "allocated_bytes", static_cast<double>(allocations.bytes), Gate::no_worse },
+		{ "scenes", static_cast<double>(totals.scene_count), Gate::same },
+		{ "links", static_cast<double>(totals.link_count), Gate::same },
+		{ "broken_links", static_cast<double>(totals.broken_link_count), Gate::same },
+		{ "transitions", static_cast<double>(totals.transition_count), Gate::same },
+		{ "parse_errors", static_cast<double>(totals.parse_error_count), Gate::same },
+		{ "session_errors", static_cast<double>(totals.session_error_count), Gate::none },
+		// Depend on the machine, the build and what else is running
+		{ "startup_ms", to_milliseconds(totals.load + totals.index + totals.graph + totals.startup), Gate::none },
+		{ "transition_mean_us", to_milliseconds(totals.transitions) * 1000.0 / transitions, Gate::none },
+		{ "peak_rss_growth_bytes", static_cast<double>(std::max(peak_resident_set_size().value_or(0), initial_resident_set_size) - initial_resident_set_size), Gate::none },
+		{ "wall_time_ms", wall_time_ms, Gate::none },
+		{ "load_ms", to_milliseconds(totals.load), Gate::none },
+		{ "index_ms", to_milliseconds(totals.index), Gate::none },
+		{ "graph_ms", to_milliseconds(totals.graph), Gate::none },
+		{ "first_scenes_ms", to_milliseconds(totals.startup), Gate::none },
+		{ "transitions_ms", to_milliseconds(totals.transitions), Gate::none },
+		{ "playback_ms", to_milliseconds(totals.playback), Gate::none },
+	};
+
+	const std::string report = to_json(measurements);
+	std::fputs(report.c_str(), stdout);
+
+	if (!counting_allocations())
+		std::fputs("Allocations are not being counted\n", stderr);
+
+	if (command_line_parser.isSet(report_option) && !write_file(std::filesystem::u8path(command_line_parser.value(report_option).toStdString()), report))
+	{
+		std::fputs("Can't write the report\n", stderr);
+		return 1;
+	}
+
+	if (totals.scene_count == 0 || totals.session_error_count > 0)
+	{
+		std::fputs("The games couldn't be played\n", stderr);
+		return 1;
+	}
+
+	if (!command_line_parser.isSet(baseline_option))
+		return 0;
+
+	const std::filesystem::path baseline_path = std::filesystem::u8path(command_line_parser.value(baseline_option).toStdString());
+	if (command_line_parser.isSet(write_baseline_option))
+		return write_file(baseline_path, report) ? 0 : 1;
+
+	const std::optional<std::string> baseline = read_file(baseline_path);
+	if (!baseline.has_value())
+	{
+		std::fprintf(stderr, "Can't read the baseline \"%s\"\n", baseline_path.u8string().c_str());
+		return 1;
+	}
+
+	return compare_with_baseline(measurements, *baseline, command_line_parser.value(tolerance_option).toDouble()) ? 0 : 1;
+}
@@ -0,0 +1,477 @@
+#include "allocation_counter.hh"
+#include "game_session.hh"
+#include "headless_session.hh"
+#include "metrics.hh"
+#include "story_graph.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+TUBE_ADVENTURES_COUNT_ALLOCATIONS()
+
+// Plays a game headlessly for hours of virtual time, like a kiosk nobody restarts: it follows random visible links,
+// seeks, goes back and now and then jumps to any scene. Every sample reports the memory, the open handles, the live
+// allocations and the latency percentiles since the previous one, so slow leaks and fragmentation show up as drift.
+// Fails if they grew more than allowed after the warm-up
+namespace
+{
+	using clock = GameSession::clock;
+	using microseconds = GameSession::microseconds;
+	using namespace std::chrono_literals;
+
+	// How often the player reports the position, as Qt's media player does
+	constexpr auto tick = 40ms;
+
+	// Shown after the last annotation, as the end of the videos usually is
+	constexpr microseconds video_tail = 10s;
+
+	struct SoakOptions
+	{
+		clock::duration length;
+		clock::duration sample_interval;
+		clock::duration warmup;
+		clock::duration longest_dwell; // In a scene before doing something
+		std::uint64_t seed;
+	};
+
+	struct Sample
+	{
+		double hours;
+		std::uint64_t transitions;
+		std::size_t resident_set_size;
+		std::size_t peak_resident_set_size;
+		std::size_t open_handles;
+		AllocationCounts live;
+		std::size_t scene_cache_bytes;
+		double transition_p50; // Milliseconds
+		double transition_p99;
+		double transition_max;
+		double tick_p99; // Microseconds
+	};
+
+	// There are no videos, so every scene lasts until a while after its last annotation
+	[[nodiscard]] microseconds scene_duration(const std::vector<Annotation> & annotations)
+	{
+		std::chrono::milliseconds last{ 0 };
+		for (const Annotation & annotation : annotations)
+			last = std::max(last, annotation.end_rect.has_value() ? annotation.end_rect->time : annotation.start_rect.time);
+
+		return std::chrono::duration_cast<microseconds>(last) + video_tail;
+	}
+
+	// The session can only click the annotations it shows, not the highlights
+	[[nodiscard]] bool clickable(const StoryLink & link) noexcept
+	{
+		return !link.highlight && link.target_scene.has_value();
+	}
+
+	// The first scene nothing links to that leads somewhere, where the game most likely starts
+	[[nodiscard]] std::size_t start_scene(const StoryGraph & graph)
+	{
+		std::vector<bool> linked(graph.links.size(), false);
+		for (const std::vector<StoryLink> & scene_links : graph.links)
+		{
+			for (const StoryLink & link : scene_links)
+			{
+				if (clickable(link))
+					linked[*link.target_scene] = true;
+			}
+		}
+
+		for (std::size_t i = 0; i < graph.links.size(); ++i)
+		{
+			const bool leads_somewhere = std::any_of(graph.links[i].begin(), graph.links[i].end(), clickable);
+			if (leads_somewhere && !linked[i])
+				return i;
+		}
+
+		return 0;
+	}
+
+	// Nearest rank. Sorts the durations
+	[[nodiscard]] clock::duration percentile(std::vector<clock::duration> & durations, const double fraction)
+	{
+		if (durations.empty())
+			return clock::duration(0);
+
+		std::sort(durations.begin(), durations.end());
+		const auto rank = static_cast<std::size_t>(fraction * static_cast<double>(durations.size()) + 0.999999);
+		return durations[std::clamp<std::size_t>(rank, 1, durations.size()) - 1];
+	}
+
+	[[nodiscard]] double to_milliseconds(const clock::duration duration) noexcept
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	[[nodiscard]] double to_megabytes(const double bytes) noexcept
+	{
+		return bytes / 1e6;
+	}
+
+	class Soak
+	{
+	public:
+		Soak(const std::filesystem::path & game_directory, const SoakOptions & options_)
+			: options(options_)
+			, game(load_game_directory(game_directory))
+			, index(game.scenes)
+			, graph(build_story_graph(game.scenes, index))
+			, random(options.seed)
+		{
+			for (std::size_t i = 0; i < game.scenes.size(); ++i)
+				scenes_by_key.emplace(to_utf8_string(game.scenes[i].annotations_path), i);
+
+			session_options.annotations_directory = game_directory;
+			session_options.locate_video = [](const std::string_view youtube_id) { return "soak/" + std::string(youtube_id) + ".mp4"; };
+		}
+
+		[[nodiscard]] bool empty() const noexcept { return game.scenes.empty(); }
+		[[nodiscard]] std::size_t scene_count() const noexcept { return game.scenes.size(); }
+		[[nodiscard]] std::size_t link_count() const noexcept { return graph.link_count(); }
+
+		// Calls on_sample after every sample interval
+		template <typename OnSample>
+		void run(OnSample on_sample)
+		{
+			GameSession session(media, view, session_options);
+
+			ticks.reserve(static_cast<std::size_t>(options.sample_interval / tick) + 1);
+			transitions.reserve(static_cast<std::size_t>(options.sample_interval / 1s) + 1);
+
+			clock::time_point now{};
+			const clock::time_point end = now + options.length;
+			clock::time_point next_sample = now + options.sample_interval;
+
+			session.set_viewport_size(1280, 720, now);
+			transition([&] { return session.load_scene(game.scenes[start_scene(graph)].annotations_path, now); });
+			clock::time_point next_action = now + dwell();
+
+			for (; now <= end; now += tick)
+			{
+				const auto tick_start = clock::now();
+				if (media.media_changed)
+				{
+					media.media_changed = false;
+					duration = scene_duration(session.annotations());
+					session.on_duration_reported(duration, now);
+					session.on_playing_changed(true, now);
+				}
+
+				media.position += tick;
+				if (media.position >= duration)
+					session.on_end_of_media(now);
+				else
+					session.on_position_reported(media.position, now);
+
+				(void)session.update(now);
+				ticks.push_back(clock::now() - tick_start);
+
+				if (now >= next_action)
+					next_action = now + (act(session, now) ? dwell() : 1s);
+
+				if (now >= next_sample)
+				{
+					on_sample(sample(session, now));
+					next_sample += options.sample_interval;
+				}
+			}
+		}
+
+		[[nodiscard]] std::uint64_t session_error_count() const noexcept { return view.error_count; }
+		[[nodiscard]] std::uint64_t seeks() const noexcept { return seek_count; }
+
+	private:
+		// Times it, failed or not
+		template <typename Load>
+		void transition(Load load)
+		{
+			const auto start = clock::now();
+			(void)load();
+			transitions.push_back(clock::now() - start);
+			++transition_count;
+		}
+
+		[[nodiscard]] clock::duration dwell()
+		{
+			const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(options.longest_dwell).count();
+			return std::chrono::seconds(std::uniform_int_distribution<long long>(1, std::max<long long>(seconds, 1))(random));
+		}
+
+		// Returns false if there was nothing to do yet (no link is visible), to try again a bit later
+		[[nodiscard]] bool act(GameSession & session, const clock::time_point now)
+		{
+			const auto current = scenes_by_key.find(session.scene_key());
+			const std::size_t current_scene = current != scenes_by_key.end() ? current->second : 0;
+
+			choices.clear();
+			bool dead_end = true;
+			for (const StoryLink & link : graph.links[current_scene])
+			{
+				if (!clickable(link))
+					continue;
+
+				dead_end = false;
+				if (session.is_annotation_visible(link.annotation_index))
+					choices.push_back(link.annotation_index);
+			}
+
+			const int roll = std::uniform_int_distribution<int>(0, 99)(random);
+			if (roll < 10 && session.history_size() > 0)
+			{
+				transition([&] { return session.go_back(now); });
+			}
+			else if (roll < 25)
+			{
+				// Like the arrow keys: the player seeks and then reports the new position
+				const auto position = microseconds(std::uniform_int_distribution<long long>(0, duration.count())(random));
+				(void)media.seek(position);
+				session.on_position_reported(position, now);
+				++seek_count;
+			}
+			else if (roll < 30 || (dead_end && session.history_size() == 0))
+			{
+				const std::size_t scene = std::uniform_int_distribution<std::size_t>(0, game.scenes.size() - 1)(random);
+				transition([&] { return session.load_scene(game.scenes[scene].annotations_path, now); });
+			}
+			else if (dead_end)
+			{
+				transition([&] { return session.go_back(now); });
+			}
+			else if (!choices.empty())
+			{
+				const int choice = choices[std::uniform_int_distribution<std::size_t>(0, choices.size() - 1)(random)];
+				transition([&] { return session.activate_annotation(choice, now); });
+			}
+			else
+			{
+				return false;
+			}
+
+			return true;
+		}
+
+		[[nodiscard]] Sample sample(const GameSession & session, const clock::time_point now)
+		{
+			Sample result;
+			result.hours = std::chrono::duration<double, std::ratio<3600>>(now.time_since_epoch()).count();
+			result.transitions = transition_count;
+			result.resident_set_size = resident_set_size().value_or(0);
+			result.peak_resident_set_size = peak_resident_set_size().value_or(0);
+			result.open_handles = open_handle_count().value_or(0);
+			result.live = live_allocations();
+			result.scene_cache_bytes = session.scene_cache().memory_usage();
+			result.transition_max = to_milliseconds(percentile(transitions, 1.0));
+			result.transition_p50 = to_milliseconds(percentile(transitions, 0.5));
+			result.transition_p99 = to_milliseconds(percentile(transitions, 0.99));
+			result.tick_p99 = to_milliseconds(percentile(ticks, 0.99)) * 1000.0;
+
+			// Cleared, not freed, so sampling doesn't allocate
+			transitions.clear();
+			ticks.clear();
+
+			return result;
+		}
+
+		SoakOptions options;
+
+		GameDirectory game;
+		SceneIdIndex index;
+		StoryGraph graph;
+		std::unordered_map<std::string, std::size_t> scenes_by_key;
+
+		GameSessionOptions session_options;
+		HeadlessMedia media; // Plays as the session asks, without decoding anything
+		HeadlessView view;
+		microseconds duration{ video_tail };
+
+		std::mt19937_64 random;
+		std::vector<int> choices; // Reused between actions
+
+		std::vector<clock::duration> transitions; // Since the last sample
+		std::vector<clock::duration> ticks;
+		std::uint64_t transition_count = 0;
+		std::uint64_t seek_count = 0;
+	};
+
+	void print(const Sample & sample)
+	{
+		std::printf("%7.2f h %8llu transitions | RSS %7.1f MB | live %8llu allocations %7.1f MB | %4zu handles | transitions p50 %.3f p99 %.3f max %.3f ms | ticks p99 %.1f us\n",
+			sample.hours, static_cast<unsigned long long>(sample.transitions), to_megabytes(static_cast<double>(sample.resident_set_size)),
+			static_cast<unsigned long long>(sample.live.allocations), to_megabytes(static_cast<double>(sample.live.bytes)), sample.open_handles,
+			sample.transition_p50, sample.transition_p99, sample.transition_max, sample.tick_p99);
+		std::fflush(stdout);
+	}
+
+	[[nodiscard]] std::string to_csv(const std::vector<Sample> & samples)
+	{
+		std::string csv = "hours,transitions,rss_bytes,peak_rss_bytes,open_handles,live_allocations,live_bytes,scene_cache_bytes,"
+			"transition_p50_ms,transition_p99_ms,transition_max_ms,tick_p99_us\n";
+
+		for (const Sample & sample : samples)
+		{
+			char line[512];
+			std::snprintf(line, sizeof(line), "%.4f,%llu,%zu,%zu,%zu,%llu,%llu,%zu,%.4f,%.4f,%.4f,%.3f\n",
+				sample.hours, static_cast<unsigned long long>(sample.transitions), sample.resident_set_size, sample.peak_resident_set_size, sample.open_handles,
+				static_cast<unsigned long long>(sample.live.allocations), static_cast<unsigned long long>(sample.live.bytes), sample.scene_cache_bytes,
+				sample.transition_p50, sample.transition_p99, sample.transition_max, sample.tick_p99);
+			csv += line;
+		}
+
+		return csv;
+	}
+
+	[[nodiscard]] bool write_file(const std::filesystem::path & path, const std::string & text)
+	{
+		std::FILE * const file = std::fopen(path.string().c_str(), "wb");
+		if (file == nullptr)
+			return false;
+
+		const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+		return std::fclose(file) == 0 && written;
+	}
+
+	// Signed, so shrinking shows as negative
+	[[nodiscard]] double growth(const std::size_t from, const std::size_t to) noexcept
+	{
+		return static_cast<double>(to) - static_cast<double>(from);
+	}
+} // namespace
+
+int main(int argc, char * argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser command_line_parser;
+	command_line_parser.setApplicationDescription("Plays a game headlessly for hours of virtual time with random choices, and fails if memory or handles keep growing");
+	command_line_parser.addHelpOption();
+
+	const QCommandLineOption game_option("game", "Directory with the annotations of the game", "directory", "../../../data/TUBE-ADVENTURES");
+	command_line_parser.addOption(game_option);
+
+	const QCommandLineOption hours_option("hours", "Virtual time played (168, a week, by default)", "hours", "168");
+	command_line_parser.addOption(hours_option);
+
+	const QCommandLineOption sample_interval_option("sample-interval", "Virtual time between samples (10 by default)", "minutes", "10");
+	command_line_parser.addOption(sample_interval_option);
+
+	const QCommandLineOption warmup_option("warmup", "Virtual time before the growth is measured, while the caches fill (1 by default)", "hours", "1");
+	command_line_parser.addOption(warmup_option);
+
+	const QCommandLineOption dwell_option("dwell", "Longest virtual time in a scene before doing something (60 by default)", "seconds", "60");
+	command_line_parser.addOption(dwell_option);
+
+	const QCommandLineOption seed_option("seed", "Seed of the random choices. The same seed plays the same game (1 by default)", "number", "1");
+	command_line_parser.addOption(seed_option);
+
+	const QCommandLineOption max_live_growth_option("max-live-growth", "Most the live allocations can grow after the warm-up (1 by default)", "megabytes", "1");
+	command_line_parser.addOption(max_live_growth_option);
+
+	const QCommandLineOption max_rss_growth_option("max-rss-growth", "Most the resident set size can grow after the warm-up (16 by default)", "megabytes", "16");
+	command_line_parser.addOption(max_rss_growth_option);
+
+	const QCommandLineOption max_handle_growth_option("max-handle-growth", "Most the open handles can grow after the warm-up (0 by default)", "count", "0");
+	command_line_parser.addOption(max_handle_growth_option);
+
+	const QCommandLineOption report_option("report", "Write every sample as CSV to the file", "file");
+	command_line_parser.addOption(report_option);
+
+	command_line_parser.process(app);
+
+	const auto hours_to_duration = [](const double hours) { return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::ratio<3600>>(hours)); };
+
+	SoakOptions options;
+	options.length = hours_to_duration(command_line_parser.value(hours_option).toDouble());
+	options.sample_interval = std::max<clock::duration>(std::chrono::minutes(command_line_parser.value(sample_interval_option).toULongLong()), 1min);
+	options.warmup = hours_to_duration(command_line_parser.value(warmup_option).toDouble());
+	options.longest_dwell = std::chrono::seconds(command_line_parser.value(dwell_option).toULongLong());
+	options.seed = command_line_parser.value(seed_option).toULongLong();
+
+	const double max_live_growth = command_line_parser.value(max_live_growth_option).toDouble() * 1e6;
+	const double max_rss_growth = command_line_parser.value(max_rss_growth_option).toDouble() * 1e6;
+	const double max_handle_growth = command_line_parser.value(max_handle_growth_option).toDouble();
+
+	Soak soak(std::filesystem::u8path(command_line_parser.value(game_option).toStdString()), options);
+	if (soak.empty())
+	{
+		std::fputs("The game has no scenes\n", stderr);
+		return 1;
+	}
+
+	std::printf("%zu scenes, %zu links. Playing %.1f hours\n", soak.scene_count(), soak.link_count(), command_line_parser.value(hours_option).toDouble());
+
+	std::vector<Sample> samples;
+	samples.reserve(static_cast<std::size_t>(options.length / options.sample_interval) + 1);
+
+	const auto start = clock::now();
+	soak.run([&samples](const Sample & sample)
+	{
+		print(sample);
+		samples.push_back(sample);
+	});
+	const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+	std::printf("Played in %.1f s with %llu seeks. %llu errors reported by the session\n", seconds, static_cast<unsigned long long>(soak.seeks()),
+		static_cast<unsigned long long>(soak.session_error_count()));
+
+	if (command_line_parser.isSet(report_option) && !write_file(std::filesystem::u8path(command_line_parser.value(report_option).toStdString()), to_csv(samples)))
+	{
+		std::fputs("Can't write the report\n", stderr);
+		return 1;
+	}
+
+	// Compared with the first sample after the warm-up. Fragmentation shows as RSS growing while the live allocations don't
+	const double warmup_hours = std::chrono::duration<double, std::ratio<3600>>(options.warmup).count();
+	const auto first_after_warmup = std::find_if(samples.begin(), samples.end(), [warmup_hours](const Sample & sample) { return sample.hours >= warmup_hours; });
+	if (first_after_warmup == samples.end() || first_after_warmup == samples.end() - 1)
+	{
+		std::fputs("Too short to measure the growth after the warm-up (see --hours, --warmup and --sample-interval)\n", stderr);
+		return 1;
+	}
+
+	const Sample & from = *first_after_warmup;
+	const Sample & to = samples.back();
+	const double hours = to.hours - from.hours;
+
+	struct Growth
+	{
+		const char * name;
+		double value;
+		double limit;
+		const char * unit;
+		double scale;
+	};
+
+	const Growth growths[] = {
+		{ "Live allocations", growth(static_cast<std::size_t>(from.live.bytes), static_cast<std::size_t>(to.live.bytes)), max_live_growth, " MB", 1e6 },
+		{ "Resident set size", growth(from.resident_set_size, to.resident_set_size), max_rss_growth, " MB", 1e6 },
+		{ "Open handles", growth(from.open_handles, to.open_handles), max_handle_growth, "", 1.0 },
+	};
+
+	int exit_code = 0;
+	for (const Growth & measured : growths)
+	{
+		const bool too_much = measured.value > measured.limit;
+		std::printf("%s grew %.3f%s in %.1f hours (%.3f%s per hour, at most %.3f%s allowed)%s\n",
+			measured.name, measured.value / measured.scale, measured.unit, hours, measured.value / measured.scale / hours, measured.unit,
+			measured.limit / measured.scale, measured.unit, too_much ? " TOO MUCH" : "");
+
+		if (too_much)
+			exit_code = 1;
+	}
+
+	std::printf("Transition p99 went from %.3f ms to %.3f ms\n", from.transition_p99, to.transition_p99);
+
+	return exit_code;
+}
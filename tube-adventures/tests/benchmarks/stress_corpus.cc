@@ -0,0 +1,283 @@
+#include "annotation_binary.hh"
+#include "annotations.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+// Writes a synthetic game much bigger than the real ones, to test and benchmark at scale: every file is
+// a scene with thousands of annotations, long texts and overlapping time windows. Each scene links to the
+// next one (so the graph is as deep as there are files) and to random others (so it's wide too).
+// Every file is parsed back after writing it, and its binary form is written from what was parsed
+namespace
+{
+	using clock = std::chrono::steady_clock;
+	using namespace std::string_view_literals;
+
+	struct CorpusOptions
+	{
+		std::size_t files;
+		std::size_t annotations; // Per file
+		std::size_t links; // Gameplay annotations per file
+		std::size_t text_length; // Longest
+		std::size_t keyframes; // Most per annotation, at least 2
+		int duration; // Of every scene, in seconds
+	};
+
+	constexpr std::string_view words[] = {
+		"tube"sv, "adventures"sv, "choose"sv, "wisely"sv, "the"sv, "door"sv, "left"sv, "right"sv, "run"sv, "jump"sv,
+		"help"sv, "me"sv, "country"sv, "DETERMINATION"sv, "<wait>"sv, "\"quoted\""sv, "R&D"sv,
+		"\xC3\xB1" "and\xC3\xBA"sv, "\xC2\xBF" "qu\xC3\xA9?"sv, "\xE2\x86\x92"sv, // Spanish and arrows, in UTF-8
+	};
+
+	// 11 characters, like a youtube ID, different for every index
+	[[nodiscard]] std::string scene_id(std::size_t index)
+	{
+		constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+		std::string id(youtube_video_id_length, 'S');
+		for (std::size_t i = youtube_video_id_length; i-- > 1;)
+		{
+			id[i] = alphabet[index % 64];
+			index /= 64;
+		}
+
+		return id;
+	}
+
+	void append_escaped(std::string & xml, const std::string_view text)
+	{
+		for (const char c : text)
+		{
+			switch (c)
+			{
+			case '&': xml += "&amp;"; break;
+			case '<': xml += "&lt;"; break;
+			case '>': xml += "&gt;"; break;
+			case '"': xml += "&quot;"; break;
+			default: xml += c; break;
+			}
+		}
+	}
+
+	// As in the real files: "h:mm:ss.cc"
+	void append_timestamp(std::string & xml, const int centiseconds)
+	{
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "%d:%02d:%02d.%02d", centiseconds / 360'000, centiseconds / 6'000 % 60, centiseconds / 100 % 60, centiseconds % 100);
+		xml += buffer;
+	}
+
+	void append_annotation(std::string & xml, std::mt19937_64 & random, const CorpusOptions & options, const std::size_t index, const std::string_view source_id, const std::string * const target_id)
+	{
+		const auto uniform = [&random](const int min, const int max) { return std::uniform_int_distribution<int>(min, max)(random); };
+
+		char buffer[256];
+		std::snprintf(buffer, sizeof(buffer), "<annotation id=\"annotation_%zu\" type=\"text\" style=\"popup\">\n  <TEXT>", index);
+		xml += buffer;
+
+		const std::size_t text_length = static_cast<std::size_t>(uniform(1, static_cast<int>(options.text_length)));
+		std::string text;
+		while (text.size() < text_length)
+		{
+			if (!text.empty())
+				text += ' ';
+			text += words[static_cast<std::size_t>(uniform(0, static_cast<int>(std::size(words)) - 1))];
+		}
+		append_escaped(xml, text);
+
+		xml += "</TEXT>\n  <segment>\n    <movingRegion type=\"rect\">\n";
+
+		// Up to 30 seconds each, so thousands of them overlap a lot
+		const int scene_centiseconds = options.duration * 100;
+		const int start = uniform(0, std::max(scene_centiseconds - 100, 0));
+		const int length = uniform(100, 3'000);
+		const int keyframes = uniform(2, static_cast<int>(options.keyframes));
+
+		for (int keyframe = 0; keyframe < keyframes; ++keyframe)
+		{
+			// Coordinates in thousandths of a percentage, so they are exactly the same once parsed
+			const int width = uniform(5'000, 40'000);
+			const int height = uniform(5'000, 20'000);
+			std::snprintf(buffer, sizeof(buffer), "      <rectRegion x=\"%.5f\" y=\"%.5f\" w=\"%.5f\" h=\"%.5f\" t=\"",
+				uniform(0, 100'000 - width) / 1000.0, uniform(0, 100'000 - height) / 1000.0, width / 1000.0, height / 1000.0);
+			xml += buffer;
+			append_timestamp(xml, start + length * keyframe / (keyframes - 1));
+			xml += "\"/>\n";
+		}
+
+		// A few hundred styles at most, as styles are interned for as long as the program runs
+		constexpr unsigned colors[] = { 16777215, 1710618, 0, 16711680, 65280 };
+		constexpr const char * alphas[] = { "0.8", "1.0", "0.6", "0.0" };
+		constexpr const char * text_sizes[] = { "3.6107", "2.5000", "4.5000", "6.0000" };
+		std::snprintf(buffer, sizeof(buffer), "    </movingRegion>\n  </segment>\n  <appearance bgAlpha=\"%s\" bgColor=\"%u\" fgColor=\"%u\" textSize=\"%s\" effects=\"\"/>\n",
+			alphas[uniform(0, 3)], colors[uniform(0, 4)], colors[uniform(0, 4)], text_sizes[uniform(0, 3)]);
+		xml += buffer;
+
+		if (target_id != nullptr)
+		{
+			xml += "  <action type=\"openUrl\" trigger=\"click\">\n    <url target=\"current\" value=\"https://www.youtube.com/watch?feature=iv&amp;src_vid=";
+			xml += source_id;
+			xml += "&amp;v=";
+			xml += *target_id;
+			xml += "\" link_class=\"1\"/>\n  </action>\n";
+		}
+		else if (uniform(0, 19) == 0)
+			xml += "  <action type=\"openUrl\" trigger=\"click\">\n    <url type=\"hyperlink\" target=\"new\" value=\"https://www.youtube.com/user/pinofas\"/>\n  </action>\n";
+
+		xml += "</annotation>\n";
+	}
+
+	[[nodiscard]] std::string scene_xml(std::mt19937_64 & random, const CorpusOptions & options, const std::vector<std::string> & ids, const std::size_t scene)
+	{
+		std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\" ?><document><annotations>\n";
+
+		// The gameplay annotations are spread among the others
+		const std::size_t links = std::min(options.links, options.annotations);
+		const std::size_t link_spacing = links > 0 ? options.annotations / links : 0;
+
+		for (std::size_t i = 0; i < options.annotations; ++i)
+		{
+			const std::string * target = nullptr;
+			if (link_spacing > 0 && i % link_spacing == 0 && i / link_spacing < links)
+			{
+				// The first one goes to the next scene, the rest anywhere
+				const std::size_t link = i / link_spacing;
+				const std::size_t target_scene = link == 0 ? (scene + 1) % ids.size() : std::uniform_int_distribution<std::size_t>(0, ids.size() - 1)(random);
+				target = &ids[target_scene];
+			}
+
+			append_annotation(xml, random, options, i, ids[scene], target);
+		}
+
+		xml += "</annotations></document>\n";
+		return xml;
+	}
+
+	[[nodiscard]] bool write_text_file(const std::filesystem::path & path, const std::string & text)
+	{
+		std::FILE * const file = std::fopen(path.string().c_str(), "wb");
+		if (file == nullptr)
+			return false;
+
+		const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+		return std::fclose(file) == 0 && written;
+	}
+} // namespace
+
+int main(int argc, char * argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser command_line_parser;
+	command_line_parser.setApplicationDescription("Writes a synthetic game, as XML annotation files and their binary form, to test and benchmark at scale");
+	command_line_parser.addHelpOption();
+
+	const QCommandLineOption output_option("output", "Directory to write the game to. Created if needed", "directory");
+	command_line_parser.addOption(output_option);
+
+	const QCommandLineOption files_option("files", "Scenes (1000 by default)", "count", "1000");
+	command_line_parser.addOption(files_option);
+
+	const QCommandLineOption annotations_option("annotations", "Annotations per scene (1000 by default)", "count", "1000");
+	command_line_parser.addOption(annotations_option);
+
+	const QCommandLineOption links_option("links", "Gameplay annotations per scene, leading to other scenes (8 by default)", "count", "8");
+	command_line_parser.addOption(links_option);
+
+	const QCommandLineOption text_length_option("text-length", "Longest annotation text, in bytes (400 by default)", "bytes", "400");
+	command_line_parser.addOption(text_length_option);
+
+	const QCommandLineOption keyframes_option("keyframes", "Most keyframes per annotation (4 by default)", "count", "4");
+	command_line_parser.addOption(keyframes_option);
+
+	const QCommandLineOption duration_option("duration", "Length of every scene, in seconds (600 by default)", "seconds", "600");
+	command_line_parser.addOption(duration_option);
+
+	const QCommandLineOption seed_option("seed", "Seed of the random choices. The same seed writes the same game (1 by default)", "number", "1");
+	command_line_parser.addOption(seed_option);
+
+	command_line_parser.process(app);
+
+	if (!command_line_parser.isSet(output_option))
+	{
+		std::fputs("An output directory is needed (--output)\n", stderr);
+		return 1;
+	}
+
+	const std::filesystem::path output = std::filesystem::u8path(command_line_parser.value(output_option).toStdString());
+
+	CorpusOptions options;
+	options.files = std::max<std::size_t>(command_line_parser.value(files_option).toULongLong(), 1);
+	options.annotations = std::max<std::size_t>(command_line_parser.value(annotations_option).toULongLong(), 1);
+	options.links = command_line_parser.value(links_option).toULongLong();
+	options.text_length = std::max<std::size_t>(command_line_parser.value(text_length_option).toULongLong(), 1);
+	options.keyframes = std::max<std::size_t>(command_line_parser.value(keyframes_option).toULongLong(), 2);
+	options.duration = std::max(static_cast<int>(command_line_parser.value(duration_option).toULongLong()), 2);
+
+	std::error_code error;
+	std::filesystem::create_directories(output, error);
+	if (error)
+	{
+		std::fprintf(stderr, "Can't create \"%s\": %s\n", output.u8string().c_str(), error.message().c_str());
+		return 1;
+	}
+
+	std::vector<std::string> ids(options.files);
+	for (std::size_t i = 0; i < ids.size(); ++i)
+		ids[i] = scene_id(i);
+
+	std::mt19937_64 random(command_line_parser.value(seed_option).toULongLong());
+
+	const auto start = clock::now();
+	std::uintmax_t xml_bytes = 0;
+	std::uintmax_t binary_bytes = 0;
+	std::size_t annotations = 0;
+
+	for (std::size_t scene = 0; scene < options.files; ++scene)
+	{
+		const std::string stem = "stress " + ids[scene];
+		const std::filesystem::path xml_path = output / std::filesystem::u8path(stem + annotation_file_extension.string());
+		const std::filesystem::path binary_path = output / std::filesystem::u8path(stem + binary_annotation_file_extension.string());
+
+		const std::string xml = scene_xml(random, options, ids, scene);
+		if (!write_text_file(xml_path, xml))
+		{
+			std::fprintf(stderr, "Can't write \"%s\"\n", xml_path.u8string().c_str());
+			return 1;
+		}
+
+		const ParseAnnotationsResult parsed = parse_annotations(xml_path.u8string().c_str());
+		if (parsed.error != ParseAnnotationsError::success || parsed.annotations.size() != options.annotations)
+		{
+			std::fprintf(stderr, "The generated \"%s\" doesn't parse: %s\n", xml_path.u8string().c_str(), parsed.error_string.c_str());
+			return 1;
+		}
+
+		if (!write_binary_annotations(binary_path, parsed.annotations))
+		{
+			std::fprintf(stderr, "Can't write \"%s\"\n", binary_path.u8string().c_str());
+			return 1;
+		}
+
+		xml_bytes += xml.size();
+		if (const std::uintmax_t size = std::filesystem::file_size(binary_path, error); !error)
+			binary_bytes += size;
+		annotations += parsed.annotations.size();
+	}
+
+	const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+	std::printf("%zu scenes, %zu annotations. XML: %.1f MB, binary: %.1f MB. Written in %.1f s\n",
+		options.files, annotations, static_cast<double>(xml_bytes) / 1e6, static_cast<double>(binary_bytes) / 1e6, seconds);
+
+	return 0;
+}
@@ -0,0 +1,199 @@
+#include <catch2/catch.hpp>
+
+#include "allocation_counter.hh"
+#include "annotations.hh"
+#include "game_session.hh"
+#include "game_state.hh"
+#include "headless_session.hh"
+#include "story_graph.hh"
+#include "update_pacer.hh"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Replaces the global operator new of the whole test executable. The budgets are a bit over what the code
+// allocates today: if one fails, either the change is worth the allocations and the budget is raised, or it isn't
+TUBE_ADVENTURES_COUNT_ALLOCATIONS()
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	// MSVC's checked iterators allocate a proxy for every container, so there the counts mean nothing
+#if defined(_ITERATOR_DEBUG_LEVEL) && _ITERATOR_DEBUG_LEVEL > 0
+	constexpr bool budgets_apply = false;
+#else
+	constexpr bool budgets_apply = true;
+#endif
+
+	const std::filesystem::path tube_adventures_1_dir = "../../../data/TUBE-ADVENTURES";
+	const std::filesystem::path first_scene = tube_adventures_1_dir / "TUBE-ADVENTURES (aventura interactiva) BckqqsJiDUI.xml";
+	const std::filesystem::path ta61 = tube_adventures_1_dir / "TA61 F87N3uM33p0.xml";
+
+	[[nodiscard]] GameSession::Options headless_options()
+	{
+		GameSession::Options options;
+		options.annotations_directory = tube_adventures_1_dir;
+		options.locate_video = [](const std::string_view youtube_id) { return "video/" + std::string(youtube_id) + ".mp4"; };
+
+		return options;
+	}
+} // namespace
+
+TEST_CASE("Allocations are counted in the tests")
+{
+	REQUIRE(counting_allocations());
+
+	// Volatile, so the compiler can't leave the allocation out
+	static int * volatile allocated = nullptr;
+
+	const AllocationScope scope;
+	allocated = new int(1);
+	delete allocated;
+	const AllocationCounts counts = scope.counts();
+
+	CHECK(counts.allocations == 1);
+	CHECK(counts.bytes == sizeof(int));
+}
+
+TEST_CASE("Deleted allocations aren't live anymore")
+{
+	static int * volatile allocated = nullptr;
+
+	const AllocationCounts before = live_allocations();
+	allocated = new int(1);
+	const AllocationCounts during = live_allocations();
+	delete allocated;
+	const AllocationCounts after = live_allocations();
+
+	CHECK(during.allocations == before.allocations + 1);
+	CHECK(after.allocations == before.allocations);
+	CHECK(after.bytes == before.bytes);
+#if defined(_WIN32) || defined(__GLIBC__) || defined(__APPLE__)
+	CHECK(during.bytes >= before.bytes + sizeof(int));
+#endif
+}
+
+TEST_CASE("Parsing an annotation file stays within its allocation budget")
+{
+	const std::string filename = ta61.u8string();
+
+	const AllocationScope scope;
+	const ParseAnnotationsResult result = parse_annotations(filename.c_str());
+	const AllocationCounts counts = scope.counts();
+
+	REQUIRE(result.error == ParseAnnotationsError::success);
+	REQUIRE(result.annotations.size() == 23);
+
+	// Most of the bytes are the XML document
+	if constexpr (budgets_apply)
+	{
+		CHECK(counts.allocations <= 100);
+		CHECK(counts.bytes <= 140'000);
+	}
+}
+
+TEST_CASE("Looking up youtube IDs doesn't allocate")
+{
+	const GameDirectory game = load_game_directory(tube_adventures_1_dir);
+	const SceneIdIndex index(game.scenes);
+	REQUIRE(index.size() == 68);
+
+	const std::string url = "https://www.youtube.com/watch?v=F87N3uM33p0";
+	std::size_t found = 0;
+
+	const AllocationScope scope;
+	for (const GameScene & scene : game.scenes)
+	{
+		for (const Annotation & annotation : scene.annotations)
+		{
+			if (const std::optional<std::string_view> target = youtube_video_id_from_url(annotation.click_url); target.has_value() && index.find(*target).has_value())
+				++found;
+		}
+	}
+	const bool url_found = youtube_video_id_from_url(url).has_value() && index.find(*youtube_video_id_from_url(url)).has_value();
+	const AllocationCounts counts = scope.counts();
+
+	CHECK(found == 201);
+	CHECK(url_found);
+
+	if constexpr (budgets_apply)
+		CHECK(counts.allocations == 0);
+}
+
+TEST_CASE("Looking up scenes by game state doesn't allocate")
+{
+	const GameDirectory game = load_game_directory("../../../data/TUBE-ADVENTURES 3");
+	const SceneStateIndex index(game.scenes);
+
+	std::size_t found = 0;
+
+	const AllocationScope scope;
+	for (std::size_t i = 0; i < game.scenes.size(); ++i)
+	{
+		const SceneVariant & variant = index.variant(i);
+		if (index.find(variant.scene, variant.state) == i)
+			++found;
+	}
+	const AllocationCounts counts = scope.counts();
+
+	// All but the duplicates
+	CHECK(found == game.scenes.size() - index.duplicates().size());
+
+	if constexpr (budgets_apply)
+		CHECK(counts.allocations == 0);
+}
+
+TEST_CASE("Position updates don't allocate once a scene is playing")
+{
+	// They don't allocate, so only the session's allocations are counted
+	HeadlessMedia media;
+	HeadlessView view;
+	GameSession session(media, view, headless_options());
+	UpdatePacer pacer;
+
+	const GameSession::clock::time_point start{};
+	session.set_viewport_size(1280, 720, start);
+	REQUIRE(session.load_scene(first_scene, start));
+	session.on_playing_changed(true, start);
+
+	// What MainWindow does for every position update of the player, and the update pass it requests
+	const auto tick = [&](const GameSession::clock::time_point now)
+	{
+		pacer.record_wakeup();
+		session.on_position_reported(std::chrono::duration_cast<GameSession::microseconds>(now - start), now);
+
+		if (pacer.request(now).has_value())
+			pacer.on_pass(now);
+
+		(void)session.update(now);
+	};
+
+	// The first pass shows the first annotations
+	tick(start);
+
+	// Showing and hiding annotations may allocate. Only the ticks where nothing changes are checked
+	std::uint64_t steady_ticks = 0;
+	std::uint64_t steady_allocations = 0;
+	for (auto now = start + 40ms; now < start + 2min; now += 40ms)
+	{
+		const std::uint64_t changes_before = view.annotations_shown + view.annotations_hidden;
+
+		const AllocationScope scope;
+		tick(now);
+		const AllocationCounts counts = scope.counts();
+
+		if (view.annotations_shown + view.annotations_hidden == changes_before)
+		{
+			++steady_ticks;
+			steady_allocations += counts.allocations;
+		}
+	}
+
+	CHECK(view.error_count == 0);
+	CHECK(steady_ticks > 2'000);
+
+	if constexpr (budgets_apply)
+		CHECK(steady_allocations == 0);
+}
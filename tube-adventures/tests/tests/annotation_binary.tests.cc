@@ -0,0 +1,154 @@
+#include <catch2/catch.hpp>
+
+#include "annotation_binary.hh"
+#include "binary_io.hh"
+#include "story_graph.hh"
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <vector>
+
+namespace
+{
+	const std::filesystem::path tube_adventures_1_dir = "../../../data/TUBE-ADVENTURES";
+	const std::filesystem::path ta61 = tube_adventures_1_dir / "TA61 F87N3uM33p0.xml";
+
+	void check_rect_regions_equal(const Annotation::RectRegion & lhs, const Annotation::RectRegion & rhs)
+	{
+		CHECK(lhs.x == rhs.x);
+		CHECK(lhs.y == rhs.y);
+		CHECK(lhs.width == rhs.width);
+		CHECK(lhs.height == rhs.height);
+		CHECK(lhs.time == rhs.time);
+	}
+
+	void check_annotations_equal(const std::vector<Annotation> & lhs, const std::vector<Annotation> & rhs)
+	{
+		REQUIRE(lhs.size() == rhs.size());
+
+		for (std::size_t i = 0; i < lhs.size(); ++i)
+		{
+			CHECK(lhs[i].id == rhs[i].id);
+			CHECK((lhs[i].text == rhs[i].text));
+			CHECK(lhs[i].click_url == rhs[i].click_url);
+			CHECK(lhs[i].type == rhs[i].type);
+
+			check_rect_regions_equal(lhs[i].start_rect, rhs[i].start_rect);
+			REQUIRE(lhs[i].end_rect.has_value() == rhs[i].end_rect.has_value());
+			if (lhs[i].end_rect.has_value())
+				check_rect_regions_equal(*lhs[i].end_rect, *rhs[i].end_rect);
+
+			REQUIRE(lhs[i].intermediate_rects.size() == rhs[i].intermediate_rects.size());
+			for (std::size_t j = 0; j < lhs[i].intermediate_rects.size(); ++j)
+				check_rect_regions_equal(lhs[i].intermediate_rects[j], rhs[i].intermediate_rects[j]);
+
+			CHECK(lhs[i].style == rhs[i].style);
+		}
+	}
+} // namespace
+
+TEST_CASE("The binary form of a game has the same annotations as the XML")
+{
+	const GameDirectory game = load_game_directory(tube_adventures_1_dir);
+	REQUIRE(game.scenes.size() == 68);
+
+	for (const GameScene & scene : game.scenes)
+	{
+		const std::vector<std::uint8_t> data = serialize_annotations(scene.annotations);
+		const ParseAnnotationsResult result = parse_binary_annotations(data.data(), data.size());
+
+		REQUIRE(result.error == ParseAnnotationsError::success);
+		check_annotations_equal(result.annotations, scene.annotations);
+	}
+}
+
+TEST_CASE("Binary annotations can be written to a file and read back")
+{
+	const ParseAnnotationsResult xml = parse_annotations(ta61.u8string().c_str());
+	REQUIRE(xml.error == ParseAnnotationsError::success);
+
+	const std::filesystem::path filename = std::filesystem::temp_directory_path() / ("binary_annotations" + binary_annotation_file_extension.string());
+	REQUIRE(write_binary_annotations(filename, xml.annotations));
+
+	const ParseAnnotationsResult binary = read_binary_annotations(filename);
+	std::filesystem::remove(filename);
+
+	REQUIRE(binary.error == ParseAnnotationsError::success);
+	check_annotations_equal(binary.annotations, xml.annotations);
+
+	CHECK(read_binary_annotations(filename).error == ParseAnnotationsError::cannot_read_file);
+}
+
+TEST_CASE("Invalid binary annotations are rejected")
+{
+	const ParseAnnotationsResult xml = parse_annotations(ta61.u8string().c_str());
+	REQUIRE(xml.error == ParseAnnotationsError::success);
+
+	const std::vector<std::uint8_t> data = serialize_annotations(xml.annotations);
+
+	SECTION("Truncated")
+	{
+		for (const std::size_t size : { std::size_t(0), std::size_t(3), std::size_t(5), data.size() / 2, data.size() - 1 })
+		{
+			const ParseAnnotationsResult result = parse_binary_annotations(data.data(), size);
+			CHECK(result.error == ParseAnnotationsError::invalid_format);
+			CHECK(result.annotations.empty());
+		}
+	}
+
+	SECTION("Invalid header")
+	{
+		std::vector<std::uint8_t> corrupt = data;
+		corrupt[0] = 'X';
+		CHECK(parse_binary_annotations(corrupt.data(), corrupt.size()).error == ParseAnnotationsError::invalid_format);
+	}
+
+	SECTION("Invalid style")
+	{
+		// The last byte is the index of the style of the last annotation, and all of them have the same one
+		std::vector<std::uint8_t> corrupt = data;
+		corrupt.back() = 1;
+		CHECK(parse_binary_annotations(corrupt.data(), corrupt.size()).error == ParseAnnotationsError::invalid_format);
+	}
+
+	SECTION("Trailing data")
+	{
+		std::vector<std::uint8_t> longer = data;
+		longer.push_back(0);
+		CHECK(parse_binary_annotations(longer.data(), longer.size()).error == ParseAnnotationsError::invalid_format);
+	}
+
+	// The only style of the file is before the annotations, so the first time its text size appears is in it
+	std::vector<std::uint8_t> text_size;
+	write_float(text_size, annotation_style(xml.annotations.front().style).text_size);
+	const auto text_size_position = std::search(data.begin(), data.end(), text_size.begin(), text_size.end()) - data.begin();
+	REQUIRE(static_cast<std::size_t>(text_size_position) < data.size());
+
+	const auto with_text_size = [&](const float size)
+	{
+		std::vector<std::uint8_t> changed = data;
+		std::vector<std::uint8_t> size_bytes;
+		write_float(size_bytes, size);
+		std::copy(size_bytes.begin(), size_bytes.end(), changed.begin() + text_size_position);
+		return changed;
+	};
+
+	SECTION("Text size that isn't a number")
+	{
+		const std::vector<std::uint8_t> corrupt = with_text_size(std::numeric_limits<float>::quiet_NaN());
+		CHECK(parse_binary_annotations(corrupt.data(), corrupt.size()).error == ParseAnnotationsError::invalid_format);
+	}
+
+	SECTION("The styles of invalid files aren't interned")
+	{
+		const std::vector<std::uint8_t> new_style = with_text_size(987.25f);
+		const std::size_t style_count = annotation_style_count();
+
+		CHECK(parse_binary_annotations(new_style.data(), new_style.size() - 1).error == ParseAnnotationsError::invalid_format);
+		CHECK(annotation_style_count() == style_count);
+
+		CHECK(parse_binary_annotations(new_style.data(), new_style.size()).error == ParseAnnotationsError::success);
+		CHECK(annotation_style_count() == style_count + 1);
+	}
+}
@@ -0,0 +1,77 @@
+#include <catch2/catch.hpp>
+
+#include "annotation_layout.hh"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	[[nodiscard]] Annotation annotation_at(const Annotation::RectRegion & start, const std::optional<Annotation::RectRegion> & end = std::nullopt)
+	{
+		Annotation annotation{};
+		annotation.start_rect = start;
+		annotation.end_rect = end;
+
+		return annotation;
+	}
+
+	void check_pixel_rect(const PixelRect & actual, const PixelRect & expected)
+	{
+		CHECK(actual.x == expected.x);
+		CHECK(actual.y == expected.y);
+		CHECK(actual.width == expected.width);
+		CHECK(actual.height == expected.height);
+	}
+} // namespace
+
+TEST_CASE("The displayed video rect keeps the aspect ratio of the video")
+{
+	SECTION("Pillarbox")
+	{
+		check_pixel_rect(AnnotationLayout::displayed_video_rect(1000, 360, 640, 360), { 180, 0, 640, 360 });
+	}
+
+	SECTION("Letterbox")
+	{
+		check_pixel_rect(AnnotationLayout::displayed_video_rect(640, 600, 640, 360), { 0, 120, 640, 360 });
+	}
+
+	SECTION("Unknown video size")
+	{
+		check_pixel_rect(AnnotationLayout::displayed_video_rect(800, 600, 0, 0), { 0, 0, 800, 600 });
+	}
+}
+
+TEST_CASE("Annotation layout maps percentages to pixels of the displayed video")
+{
+	const MotionPaths paths({
+		annotation_at({ 10.0f, 50.0f, 25.0f, 10.0f, 0s }),
+		annotation_at({ 0.0f, 0.0f, 10.0f, 10.0f, 0s }, Annotation::RectRegion{ 50.0f, 0.0f, 10.0f, 10.0f, 1s }),
+	});
+
+	AnnotationLayout layout;
+	CHECK(layout.update(1000, 360, 640, 360, paths));
+	CHECK_FALSE(layout.update(1000, 360, 640, 360, paths));
+
+	check_pixel_rect(layout.geometry(paths, 0, 0s), { 180 + 64, 180, 160, 36 });
+
+	check_pixel_rect(layout.geometry(paths, 1, 0s), { 180, 0, 64, 36 });
+	check_pixel_rect(layout.geometry(paths, 1, 500ms), { 180 + 160, 0, 64, 36 });
+	check_pixel_rect(layout.geometry(paths, 1, 2s), { 180 + 320, 0, 64, 36 });
+
+	SECTION("Resizing recomputes the cached geometry")
+	{
+		CHECK(layout.update(640, 360, 640, 360, paths));
+		check_pixel_rect(layout.geometry(paths, 0, 0s), { 64, 180, 160, 36 });
+	}
+
+	SECTION("Batched")
+	{
+		std::vector<PixelRect> rects;
+		layout.geometry(paths, 500ms, { 1, 0 }, rects);
+
+		REQUIRE(rects.size() == 2);
+		check_pixel_rect(rects[0], { 180 + 160, 0, 64, 36 });
+		check_pixel_rect(rects[1], { 180 + 64, 180, 160, 36 });
+	}
+}
@@ -0,0 +1,178 @@
+#include <catch2/catch.hpp>
+
+#include "annotation_timeline.hh"
+#include "video_clock.hh"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	[[nodiscard]] Annotation annotation_between(const std::chrono::milliseconds start, const std::optional<std::chrono::milliseconds> end)
+	{
+		Annotation annotation{};
+		annotation.start_rect.time = start;
+		if (end.has_value())
+		{
+			annotation.end_rect = annotation.start_rect;
+			annotation.end_rect->time = *end;
+		}
+
+		return annotation;
+	}
+
+	[[nodiscard]] std::vector<AnnotationTimeline::Change> advance(AnnotationTimeline & timeline, const AnnotationTimeline::microseconds position, bool * continuous = nullptr)
+	{
+		std::vector<AnnotationTimeline::Change> changes;
+		const bool was_continuous = timeline.advance(position, changes);
+		if (continuous != nullptr)
+			*continuous = was_continuous;
+
+		return changes;
+	}
+} // namespace
+
+TEST_CASE("Annotation timeline shows and hides annotations in order")
+{
+	AnnotationTimeline timeline({
+		annotation_between(1s, 2s),
+		annotation_between(1500ms, 3s),
+		annotation_between(2500ms, std::nullopt),
+	});
+
+	bool continuous = true;
+	CHECK(advance(timeline, 0us, &continuous).empty());
+	CHECK_FALSE(continuous); // The first update positions the timeline
+	CHECK(timeline.next_event_time() == 1s);
+
+	auto changes = advance(timeline, 1'000'000us, &continuous);
+	CHECK(continuous);
+	REQUIRE(changes.size() == 1);
+	CHECK(changes[0].annotation_index == 0);
+	CHECK(changes[0].visible);
+	CHECK(changes[0].scheduled_time == 1s);
+
+	changes = advance(timeline, 1'600'000us);
+	REQUIRE(changes.size() == 1);
+	CHECK(changes[0].annotation_index == 1);
+
+	// Visible until the end time, inclusive
+	CHECK(advance(timeline, 2'000'000us).empty());
+	CHECK(timeline.is_visible(0));
+
+	changes = advance(timeline, 2'000'001us);
+	REQUIRE(changes.size() == 1);
+	CHECK(changes[0].annotation_index == 0);
+	CHECK_FALSE(changes[0].visible);
+
+	changes = advance(timeline, 2'900'000us);
+	REQUIRE(changes.size() == 1);
+	CHECK(changes[0].annotation_index == 2);
+	CHECK(changes[0].visible);
+}
+
+TEST_CASE("Annotation timeline handles seeks and clock jitter")
+{
+	AnnotationTimeline timeline({
+		annotation_between(1s, 2s),
+		annotation_between(5s, 6s),
+	});
+
+	CHECK(advance(timeline, 1'500'000us).size() == 1);
+	CHECK(timeline.is_visible(0));
+
+	SECTION("Small backwards moves are ignored")
+	{
+		bool continuous = false;
+		CHECK(advance(timeline, 1'450'000us, &continuous).empty());
+		CHECK(continuous);
+		CHECK(timeline.is_visible(0));
+	}
+
+	SECTION("Seeking forward")
+	{
+		bool continuous = true;
+		const auto changes = advance(timeline, 5'500'000us, &continuous);
+		CHECK_FALSE(continuous);
+		REQUIRE(changes.size() == 2);
+		CHECK_FALSE(timeline.is_visible(0));
+		CHECK(timeline.is_visible(1));
+		CHECK(timeline.next_event_time() == 6'000'001us);
+	}
+
+	SECTION("Seeking backward")
+	{
+		bool continuous = true;
+		const auto changes = advance(timeline, 0us, &continuous);
+		CHECK_FALSE(continuous);
+		REQUIRE(changes.size() == 1);
+		CHECK_FALSE(timeline.is_visible(0));
+		CHECK(timeline.next_event_time() == 1s);
+	}
+}
+
+TEST_CASE("Annotation timeline events can be snapped to the frame grid")
+{
+	AnnotationTimeline timeline({
+		annotation_between(1010ms, 2000ms),
+		annotation_between(1000ms, std::nullopt),
+	});
+	timeline.snap_to_frame_grid(40ms);
+
+	CHECK(advance(timeline, 0us).empty());
+	CHECK(timeline.next_event_time() == 1000ms);
+
+	auto changes = advance(timeline, 1'000'000us);
+	REQUIRE(changes.size() == 1);
+	CHECK(changes[0].annotation_index == 1);
+
+	// Shown with the frame that starts after 1010ms
+	changes = advance(timeline, 1'040'000us);
+	REQUIRE(changes.size() == 1);
+	CHECK(changes[0].annotation_index == 0);
+	CHECK(changes[0].scheduled_time == 1040ms);
+
+	// Hidden with the frame after the one that contains the end time
+	CHECK(timeline.next_event_time() == 2040ms);
+}
+
+TEST_CASE("Annotation timing skew statistics")
+{
+	AnnotationTimingSkew skew;
+	skew.record(10ms, 33ms);
+	skew.record(-20ms, 33ms);
+	skew.record(40ms, 33ms);
+
+	CHECK(skew.events == 3);
+	CHECK(skew.events_off_by_more_than_a_frame == 1);
+	CHECK(skew.max_absolute_skew == 40ms);
+	CHECK(skew.mean_absolute_skew() == 70'000us / 3);
+}
+
+TEST_CASE("Video clock interpolates between frames")
+{
+	const VideoClock::clock::time_point start{};
+
+	VideoClock clock;
+	clock.reset(0us, start);
+	clock.set_playing(true, start);
+
+	clock.on_frame(1'000'000us, start);
+	clock.on_frame(1'040'000us, start + 40ms);
+	CHECK(clock.frame_duration() == 40ms);
+
+	CHECK(clock.position(start + 50ms) == 1'050'000us);
+
+	// Doesn't run too far ahead if frames stop arriving
+	CHECK(clock.position(start + 1s) == 1'040'000us + 2 * 40ms);
+
+	// Coarse position reports are ignored while frames arrive, unless they are a seek
+	clock.on_position_reported(1'000'000us, start + 50ms);
+	CHECK(clock.position(start + 50ms) == 1'050'000us);
+
+	clock.on_position_reported(10'000'000us, start + 50ms);
+	CHECK(clock.position(start + 50ms) == 10'000'000us);
+
+	// Paused: the position doesn't advance
+	clock.set_playing(false, start + 60ms);
+	CHECK(clock.position(start + 1s) == 10'010'000us);
+}
@@ -4,6 +4,7 @@
 
 #include <string_view>
 #include <filesystem>
+#include <fstream>
 #include <set>
 
 #include <QUrl>
@@ -62,11 +63,9 @@ namespace
 		INFO(info);
 		CHECK(actual.text == expected.text);
 		CHECK(actual.click_url == expected.click_url);
-		CHECK(actual.background_color == expected.background_color);
-		CHECK(actual.foreground_color == expected.foreground_color);
+		CHECK(actual.style == expected.style);
 		CHECK(actual.id == expected.id);
 		CHECK(actual.text == expected.text);
-		CHECK(actual.text_size == expected.text_size);
 		CHECK(actual.type == expected.type);
 
 		check_rect_region(actual.start_rect, expected.start_rect);
@@ -74,6 +73,10 @@ namespace
 		CHECK(actual.end_rect.has_value() == expected.end_rect.has_value());
 		if (actual.end_rect.has_value() && expected.end_rect.has_value())
 			check_rect_region(*actual.end_rect, *expected.end_rect);
+
+		REQUIRE(actual.intermediate_rects.size() == expected.intermediate_rects.size());
+		for (std::size_t i = 0; i < actual.intermediate_rects.size(); ++i)
+			check_rect_region(actual.intermediate_rects[i], expected.intermediate_rects[i]);
 	}
 } // namespace
 
@@ -100,6 +103,8 @@ TEST_CASE("Can parse an annotation file")
 
 	constexpr float text_size = 3.6107f;
 
+	const AnnotationStyleId style = intern_annotation_style({ background_color, foreground_color, text_size });
+
 	check_annotation("annotations[0]", annotations[0], Annotation{
 		"annotation_103323"s,
 		u8"M\u00FAsica y + info en www.tube-adventures.blogspot.com"s,
@@ -113,9 +118,8 @@ TEST_CASE("Can parse an annotation file")
 			71.25000f, 12.22200f,
 			time_to_timestamp(0h, 0min, 8s, centiseconds{ 0 })
 		},
-		background_color, // background color (RGBA)
-		foreground_color, // foreground color (RGB)
-		text_size, // text size
+		{}, // intermediate keyframes
+		style, // appearance
 		missing_url, // url
 		Annotation::Type::notes
 	});
@@ -133,9 +137,8 @@ TEST_CASE("Can parse an annotation file")
 			27.70800f, 7.03700f,
 			time_to_timestamp(0h, 0min, 36s, centiseconds{ 50 })
 		},
-		background_color, // background color (RGBA)
-		foreground_color, // foreground color (RGB)
-		text_size, // text size
+		{}, // intermediate keyframes
+		style, // appearance
 		missing_url, // url
 		Annotation::Type::notes
 	});
@@ -153,9 +156,8 @@ TEST_CASE("Can parse an annotation file")
 			18.75000f, 8.51800f,
 			time_to_timestamp(0h, 0min, 21s, centiseconds{ 89 })
 		},
-		background_color, // background color (RGBA)
-		foreground_color, // foreground color (RGB)
-		text_size, // text size
+		{}, // intermediate keyframes
+		style, // appearance
 		missing_url, // url
 		Annotation::Type::notes
 	});
@@ -173,9 +175,8 @@ TEST_CASE("Can parse an annotation file")
 			26.45800f, 8.05600f,
 			time_to_timestamp(0h, 1min, 59s, centiseconds{ 4 })
 		},
-		background_color, // background color (RGBA)
-		foreground_color, // foreground color (RGB)
-		text_size, // text size
+		{}, // intermediate keyframes
+		style, // appearance
 		"https://www.youtube.com/watch?annotation_id=annotation_671574&ei=hKMCXMeuJIG5Va7bkYAJ&feature=iv&src_vid=BckqqsJiDUI&v=yVebIlvkOnU"s, // url
 		Annotation::Type::gameplay
 	});
@@ -193,9 +194,8 @@ TEST_CASE("Can parse an annotation file")
 			27.29200f, 8.05600f,
 			time_to_timestamp(0h, 1min, 59s, centiseconds{ 4 })
 		},
-		background_color, // background color (RGBA)
-		foreground_color, // foreground color (RGB)
-		text_size, // text size
+		{}, // intermediate keyframes
+		style, // appearance
 		"https://www.youtube.com/watch?annotation_id=annotation_776505&ei=hKMCXMeuJIG5Va7bkYAJ&feature=iv&src_vid=BckqqsJiDUI&v=MnBL8LY4kgc"s, // url
 		Annotation::Type::gameplay
 	});
@@ -213,9 +213,8 @@ TEST_CASE("Can parse an annotation file")
 			52.08300f, 11.66700f,
 			time_to_timestamp(0h, 1min, 13s, centiseconds{ 40 })
 		},
-		background_color, // background color (RGBA)
-		foreground_color, // foreground color (RGB)
-		text_size, // text size
+		{}, // intermediate keyframes
+		style, // appearance
 		missing_url, // url
 		Annotation::Type::notes
 	});
@@ -233,18 +232,119 @@ TEST_CASE("Can parse an annotation file")
 			27.50000f, 8.05600f,
 			time_to_timestamp(0h, 1min, 59s, centiseconds{ 4 })
 		},
-		background_color, // background color (RGBA)
-		foreground_color, // foreground color (RGB)
-		text_size, // text size
+		{}, // intermediate keyframes
+		style, // appearance
 		"https://www.youtube.com/watch?annotation_id=annotation_953980&ei=hKMCXMeuJIG5Va7bkYAJ&feature=iv&src_vid=BckqqsJiDUI&v=5AkWHfJV8RQ"s, // url
 		Annotation::Type::gameplay
 	});
 }
 
 
+TEST_CASE("Can parse a moving region with more than 2 keyframes")
+{
+	using namespace std::chrono_literals;
+
+	const auto filename = std::filesystem::temp_directory_path() / "tube-adventures-moving-region.xml";
+	{
+		std::ofstream file(filename);
+		file << R"(<?xml version="1.0" encoding="UTF-8" ?><document><annotations>
+<annotation id="annotation_moving" type="text" style="popup">
+  <TEXT>Moving</TEXT>
+  <segment>
+    <movingRegion type="rect">
+      <rectRegion x="10.00000" y="20.00000" w="30.00000" h="5.00000" t="0:00:01.00"/>
+      <rectRegion x="50.00000" y="20.00000" w="30.00000" h="5.00000" t="0:00:02.00"/>
+      <rectRegion x="50.00000" y="60.00000" w="10.00000" h="5.00000" t="0:00:04.00"/>
+    </movingRegion>
+  </segment>
+  <appearance bgAlpha="0.8" bgColor="16777215" fgColor="1710618" textSize="3.6107" effects=""/>
+</annotation>
+</annotations></document>)";
+	}
+
+	const ParseAnnotationsResult result = parse_annotations(filename.u8string().c_str());
+	std::filesystem::remove(filename);
+
+	REQUIRE(result.error == ParseAnnotationsError::success);
+	REQUIRE(result.annotations.size() == 1);
+
+	const Annotation & annotation = result.annotations[0];
+	check_rect_region(annotation.start_rect, { 10.0f, 20.0f, 30.0f, 5.0f, 1s });
+	REQUIRE(annotation.intermediate_rects.size() == 1);
+	check_rect_region(annotation.intermediate_rects[0], { 50.0f, 20.0f, 30.0f, 5.0f, 2s });
+	REQUIRE(annotation.end_rect.has_value());
+	check_rect_region(*annotation.end_rect, { 50.0f, 60.0f, 10.0f, 5.0f, 4s });
+}
+
+TEST_CASE("A text size that isn't a number is rejected")
+{
+	const auto filename = std::filesystem::temp_directory_path() / "tube-adventures-nan-text-size.xml";
+	{
+		std::ofstream file(filename);
+		file << R"(<?xml version="1.0" encoding="UTF-8" ?><document><annotations>
+<annotation id="annotation_nan" type="text" style="popup">
+  <TEXT>Not a number</TEXT>
+  <segment>
+    <movingRegion type="rect">
+      <rectRegion x="10.00000" y="20.00000" w="30.00000" h="5.00000" t="0:00:01.00"/>
+      <rectRegion x="10.00000" y="20.00000" w="30.00000" h="5.00000" t="0:00:02.00"/>
+    </movingRegion>
+  </segment>
+  <appearance bgAlpha="0.8" bgColor="16777215" fgColor="1710618" textSize="nan" effects=""/>
+</annotation>
+</annotations></document>)";
+	}
+
+	// Parsing it again would intern another style every time
+	const std::size_t style_count = annotation_style_count();
+	const ParseAnnotationsResult result = parse_annotations(filename.u8string().c_str());
+	const ParseAnnotationsResult result_again = parse_annotations(filename.u8string().c_str());
+	std::filesystem::remove(filename);
+
+	CHECK(result.error == ParseAnnotationsError::invalid_format);
+	CHECK(result_again.error == ParseAnnotationsError::invalid_format);
+	CHECK(annotation_style_count() == style_count);
+}
+
+TEST_CASE("Equal styles are interned once")
+{
+	const AnnotationStyle style{ QColor::fromRgb(0x102030), QColor::fromRgb(0xFFFFFF), 4.25f };
+	const AnnotationStyleId id = intern_annotation_style(style);
+
+	CHECK(intern_annotation_style(style) == id);
+	CHECK(annotation_style(id) == style);
+
+	AnnotationStyle bigger = style;
+	bigger.text_size = 5.0f;
+	const AnnotationStyleId bigger_id = intern_annotation_style(bigger);
+
+	CHECK(bigger_id != id);
+	CHECK(annotation_style(bigger_id) == bigger);
+	CHECK(annotation_style_count() >= 2);
+}
+
+TEST_CASE("Can decode the attributes of a rect region")
+{
+	using namespace std::chrono_literals;
+
+	CHECK(parse_annotation_float("12.50000"sv) == 12.5f);
+	CHECK(parse_annotation_float("-3"sv) == -3.0f);
+	CHECK_FALSE(parse_annotation_float(""sv).has_value());
+	CHECK_FALSE(parse_annotation_float("x"sv).has_value());
+
+	CHECK(parse_annotation_timestamp("0:00:04.00"sv) == time_to_timestamp(0h, 0min, 4s, centiseconds{ 0 }));
+	CHECK(parse_annotation_timestamp("1:01:59.04"sv) == time_to_timestamp(1h, 1min, 59s, centiseconds{ 4 }));
+	CHECK(parse_annotation_timestamp("0:00:08.5"sv) == time_to_timestamp(0h, 0min, 8s, centiseconds{ 5 }));
+	CHECK_FALSE(parse_annotation_timestamp(""sv).has_value());
+	CHECK_FALSE(parse_annotation_timestamp("never"sv).has_value());
+	CHECK_FALSE(parse_annotation_timestamp("0:05.123"sv).has_value());
+	CHECK_FALSE(parse_annotation_timestamp("0:00:05"sv).has_value());
+}
+
 TEST_CASE("Can parse all of tube-adventures 1")
 {
 	int files_parsed = 0;
+	std::set<AnnotationStyleId> styles;
 
 	for (const auto & file : std::filesystem::directory_iterator(tube_adventures_1_dir))
 	{
@@ -260,9 +360,13 @@ TEST_CASE("Can parse all of tube-adventures 1")
 		{
 			INFO("The annotation ID \"" + annotation.id + "\" should be unique");
 			CHECK(annotation_ids.emplace(annotation.id).second);
+			styles.insert(annotation.style);
 		}
 	}
 
+	// Every annotation of the game looks the same
+	CHECK(styles.size() == 1);
+
 	std::printf("%d files parsed in the tube adventures 1 directory\n", files_parsed);
 }
 
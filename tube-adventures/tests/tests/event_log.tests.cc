@@ -0,0 +1,69 @@
+#include <catch2/catch.hpp>
+
+#include "event_log.hh"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+	[[nodiscard]] std::string strip_prefix(const std::string & line)
+	{
+		// "[    12.345678] info    #0 " is followed by the message
+		const std::size_t thread_end = line.find(' ', line.find('#'));
+		return thread_end == std::string::npos ? line : line.substr(thread_end + 1);
+	}
+} // namespace
+
+TEST_CASE("Event log stores the raw arguments and formats them when read")
+{
+	EventLogReader reader;
+	std::vector<LogRecord> records;
+	reader.read(records); // Whatever other tests logged
+	records.clear();
+
+	log_event<LogLevel::warning>("Annotation {} shown {} ms late ({}x, {})", 3, std::int64_t(-12), 1.5, "seeking");
+	log_event<LogLevel::error>("No arguments");
+
+	reader.read(records);
+	REQUIRE(records.size() == 2);
+
+	CHECK(records[0].level == LogLevel::warning);
+	CHECK(records[0].argument_count == 4);
+	CHECK(strip_prefix(format_log_record(records[0])) == "Annotation 3 shown -12 ms late (1.5x, seeking)");
+	CHECK(strip_prefix(format_log_record(records[1])) == "No arguments");
+	CHECK(records[0].timestamp <= records[1].timestamp);
+
+	records.clear();
+	reader.read(records);
+	CHECK(records.empty());
+}
+
+TEST_CASE("Event log keeps the last events of every thread")
+{
+	EventLogReader reader;
+	std::vector<LogRecord> records;
+	reader.read(records);
+	records.clear();
+
+	const std::size_t event_count = log_ring_capacity + 10;
+	std::thread([event_count]
+	{
+		for (std::size_t i = 0; i < event_count; ++i)
+			log_event<LogLevel::info>("Event {}", i);
+	}).join();
+
+	reader.read(records);
+	CHECK(records.size() == log_ring_capacity);
+	CHECK(reader.lost_events() == 10);
+	REQUIRE(!records.empty());
+	CHECK(strip_prefix(format_log_record(records.back())) == "Event " + std::to_string(event_count - 1));
+
+	std::vector<LogRecord> recent;
+	collect_recent_log_records(5, recent);
+	const bool has_last_event = std::any_of(recent.begin(), recent.end(), [&](const LogRecord & record)
+	{
+		return record.thread_index == records.back().thread_index && record.arguments[0].value == event_count - 1;
+	});
+	CHECK(has_last_event);
+}
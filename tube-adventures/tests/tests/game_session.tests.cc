@@ -0,0 +1,245 @@
+#include <catch2/catch.hpp>
+
+#include "game_session.hh"
+
+#include <filesystem>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	const std::filesystem::path tube_adventures_1_dir = "../../../data/TUBE-ADVENTURES";
+	const std::filesystem::path first_scene = tube_adventures_1_dir / "TUBE-ADVENTURES (aventura interactiva) BckqqsJiDUI.xml";
+
+	struct FakeMedia : public MediaBackend
+	{
+		void set_media(const std::string & location) override { media.push_back(location); }
+		void play() override { ++plays; }
+		bool seek(const VideoClock::microseconds position) override
+		{
+			seeks.push_back(position);
+			return loaded;
+		}
+		void loop_to(const VideoClock::microseconds position) override { loops.push_back(position); }
+
+		std::vector<std::string> media;
+		int plays = 0;
+		std::vector<VideoClock::microseconds> seeks;
+		std::vector<VideoClock::microseconds> loops;
+		bool loaded = true; // If not, seeks wait for GameSession::on_seek_issued
+	};
+
+	struct FakeView : public GameView
+	{
+		void on_scene_changing() override { shown.clear(); }
+		void on_scene_loaded() override { ++scenes_loaded; }
+		void show_annotation(const int annotation_index, const PixelRect &) override { shown.insert(annotation_index); ++times_shown; }
+		void hide_annotation(const int annotation_index) override { shown.erase(annotation_index); }
+		void on_layout_changed() override { ++layout_changes; }
+		void report_error(const std::string_view title, std::string_view) override { errors.emplace_back(title); }
+
+		std::set<int> shown;
+		int times_shown = 0;
+		int scenes_loaded = 0;
+		int layout_changes = 0;
+		std::vector<std::string> errors;
+	};
+
+	[[nodiscard]] GameSession::Options headless_options()
+	{
+		GameSession::Options options;
+		options.annotations_directory = tube_adventures_1_dir;
+		options.locate_video = [](const std::string_view youtube_id) { return "video/" + std::string(youtube_id) + ".mp4"; };
+
+		return options;
+	}
+
+	[[nodiscard]] std::set<int> visible_annotations(const GameSession & session)
+	{
+		std::set<int> visible;
+		for (int i = 0; i < static_cast<int>(session.annotations().size()); ++i)
+		{
+			if (session.is_annotation_visible(i))
+				visible.insert(i);
+		}
+
+		return visible;
+	}
+} // namespace
+
+TEST_CASE("Game session loads a scene and plays its video")
+{
+	FakeMedia media;
+	FakeView view;
+	GameSession session(media, view, headless_options());
+
+	REQUIRE(session.load_scene(first_scene, GameSession::clock::time_point{}));
+	CHECK(view.errors.empty());
+	CHECK(view.scenes_loaded == 1);
+	CHECK_FALSE(session.annotations().empty());
+	CHECK_FALSE(session.scene_key().empty());
+
+	REQUIRE(media.media.size() == 1);
+	CHECK(media.media[0] == "video/BckqqsJiDUI.mp4");
+	CHECK(media.plays == 1);
+	CHECK(media.seeks.empty());
+}
+
+TEST_CASE("Game session shows the annotations as the video plays, with a virtual clock")
+{
+	FakeMedia media;
+	FakeView view;
+	GameSession session(media, view, headless_options());
+
+	const GameSession::clock::time_point start{};
+	session.set_viewport_size(1280, 720, start);
+	REQUIRE(session.load_scene(first_scene, start));
+	session.on_playing_changed(true, start);
+
+	// Jumps straight to the next time something changes, with the player reporting the position it would be at
+	GameSession::clock::time_point now = start;
+	int updates = 0;
+	for (; updates < 10'000; ++updates)
+	{
+		session.on_position_reported(std::chrono::duration_cast<GameSession::microseconds>(now - start), now);
+		const std::optional<GameSession::clock::time_point> next_update = session.update(now);
+		REQUIRE(view.shown == visible_annotations(session));
+
+		if (!next_update.has_value())
+			break;
+
+		REQUIRE(*next_update >= now);
+		now = *next_update;
+	}
+
+	CHECK(updates < 10'000);
+	CHECK(view.times_shown > 0);
+	CHECK(session.position(now) == std::chrono::duration_cast<GameSession::microseconds>(now - start));
+}
+
+TEST_CASE("Game session follows the annotations to other scenes and goes back")
+{
+	FakeMedia media;
+	FakeView view;
+	GameSession session(media, view, headless_options());
+
+	const GameSession::clock::time_point start{};
+	REQUIRE(session.load_scene(first_scene, start));
+	session.on_playing_changed(true, start);
+	const std::string first_scene_key = session.scene_key();
+
+	// Annotations that aren't part of the game do nothing
+	const std::vector<Annotation> & annotations = session.annotations();
+	int gameplay_annotation = -1;
+	for (int i = 0; i < static_cast<int>(annotations.size()); ++i)
+	{
+		if (annotations[static_cast<std::size_t>(i)].type == Annotation::Type::gameplay)
+		{
+			if (gameplay_annotation < 0)
+				gameplay_annotation = i;
+		}
+		else
+			CHECK_FALSE(session.activate_annotation(i, start));
+	}
+	REQUIRE(gameplay_annotation >= 0);
+
+	const GameSession::clock::time_point click_time = start + 5s;
+	session.on_position_reported(5s, click_time);
+	REQUIRE(session.activate_annotation(gameplay_annotation, click_time));
+	CHECK(view.errors.empty());
+	CHECK(view.scenes_loaded == 2);
+	CHECK(media.media.size() == 2);
+	CHECK(session.history_size() == 1);
+	CHECK(session.scene_key() != first_scene_key);
+	CHECK(session.position(click_time) == 0us);
+
+	// Resumes where it was left, from the scene cache
+	REQUIRE(session.go_back(click_time + 1s));
+	CHECK(session.scene_key() == first_scene_key);
+	CHECK(session.history_size() == 0);
+	CHECK(session.scene_cache().stats().hits == 1);
+	REQUIRE(media.seeks.size() == 1);
+	CHECK(media.seeks[0] == 5'000'000us);
+	CHECK(session.position(click_time + 1s) == 5s);
+
+	CHECK_FALSE(session.go_back(click_time + 2s));
+}
+
+TEST_CASE("Game session waits for the media to load to resume where it was left")
+{
+	FakeMedia media;
+	FakeView view;
+	GameSession session(media, view, headless_options());
+
+	const GameSession::clock::time_point start{};
+	REQUIRE(session.load_scene(first_scene, start));
+
+	int gameplay_annotation = -1;
+	for (int i = 0; i < static_cast<int>(session.annotations().size()) && gameplay_annotation < 0; ++i)
+	{
+		if (session.annotations()[static_cast<std::size_t>(i)].type == Annotation::Type::gameplay)
+			gameplay_annotation = i;
+	}
+	REQUIRE(gameplay_annotation >= 0);
+
+	session.on_position_reported(5s, start + 5s);
+	REQUIRE(session.activate_annotation(gameplay_annotation, start + 5s));
+
+	// The player can't seek before the video is loaded, so it still starts from the beginning
+	media.loaded = false;
+	REQUIRE(session.go_back(start + 6s));
+	REQUIRE(media.seeks.size() == 1);
+	CHECK(session.position(start + 6s) == 0us);
+
+	session.on_seek_issued(5s, start + 7s);
+	CHECK(session.position(start + 7s) == 5s);
+}
+
+TEST_CASE("Game session loops the end of the video")
+{
+	FakeMedia media;
+	FakeView view;
+	GameSession session(media, view, headless_options());
+
+	const GameSession::clock::time_point start{};
+	REQUIRE(session.load_scene(first_scene, start));
+	session.on_playing_changed(true, start);
+	session.on_duration_reported(60'000'000us, start);
+
+	const GameSession::clock::time_point end = start + 60s;
+	session.on_end_of_media(end);
+
+	REQUIRE(media.loops.size() == 1);
+	CHECK(media.loops[0] == 60'000'000us - GameSession::loop_length);
+	CHECK(session.position(end) == 60'000'000us - GameSession::loop_length);
+	CHECK(session.is_playing());
+}
+
+TEST_CASE("Game session reports the errors to the view")
+{
+	FakeMedia media;
+	FakeView view;
+
+	SECTION("Missing annotations file")
+	{
+		GameSession session(media, view, headless_options());
+		CHECK_FALSE(session.load_scene(tube_adventures_1_dir / "missing 01234567890.xml", GameSession::clock::time_point{}));
+		CHECK(session.scene_key().empty());
+	}
+
+	SECTION("Missing video")
+	{
+		GameSession::Options options = headless_options();
+		options.locate_video = [](std::string_view) { return std::string(); };
+
+		GameSession session(media, view, std::move(options));
+		CHECK_FALSE(session.load_scene(first_scene, GameSession::clock::time_point{}));
+	}
+
+	CHECK(view.errors.size() == 1);
+	CHECK(view.scenes_loaded == 0);
+	CHECK(media.media.empty());
+}
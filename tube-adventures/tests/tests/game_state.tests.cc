@@ -0,0 +1,173 @@
+#include <catch2/catch.hpp>
+
+#include "game_state.hh"
+
+#include <filesystem>
+#include <string>
+
+namespace
+{
+	const std::filesystem::path tube_adventures_3_dir = "../../../data/TUBE-ADVENTURES 3";
+
+	using Variable = GameState::Variable;
+} // namespace
+
+TEST_CASE("Game state variables are packed independently")
+{
+	GameState state;
+	CHECK(state.packed() == 0);
+	CHECK(state.mask() == 0);
+
+	for (std::size_t i = 0; i < GameState::variable_count; ++i)
+	{
+		const auto variable = static_cast<Variable>(i);
+		state.set(variable, GameState::max_value(variable));
+	}
+
+	for (std::size_t i = 0; i < GameState::variable_count; ++i)
+	{
+		const auto variable = static_cast<Variable>(i);
+		CHECK(state.get(variable) == GameState::max_value(variable));
+	}
+
+	state.set(Variable::level, GameState::level_p2);
+	state.set(Variable::alc, 0);
+	CHECK(state.get(Variable::level) == GameState::level_p2);
+	CHECK(!state.has(Variable::alc));
+	CHECK(state.get(Variable::keys) == GameState::max_value(Variable::keys));
+	CHECK(state.get(Variable::items) == GameState::max_value(Variable::items));
+	CHECK(state.get(Variable::leche) == GameState::yes);
+	CHECK(state.get(Variable::g_plus) == GameState::yes);
+
+	CHECK(GameState::from_packed(state.packed()) == state);
+	CHECK((state.mask() & GameState::mask(Variable::alc)) == 0);
+	CHECK((state.mask() & GameState::mask(Variable::level)) == GameState::mask(Variable::level));
+}
+
+TEST_CASE("The game state is parsed from the names of the scenes")
+{
+	SECTION("Tags at the end")
+	{
+		const SceneVariant variant = parse_scene_variant("Chipriota (azul) y esperar K=EA P=1 LECHE");
+		CHECK(variant.scene == "Chipriota (azul) y esperar");
+		CHECK(variant.state.get(Variable::keys) == GameState::keys_ea);
+		CHECK(variant.state.get(Variable::level) == GameState::level_p1);
+		CHECK(variant.state.get(Variable::leche) == GameState::yes);
+		CHECK(!variant.state.has(Variable::alc));
+		CHECK(!variant.next_state.has_value());
+		CHECK(variant.state.to_string() == "K=EA P=1 LECHE");
+	}
+
+	SECTION("Tags in parentheses, at the start and joined with underscores")
+	{
+		CHECK(parse_scene_variant("(LECHE) Entrada Old Town Norte PIC NOITEM").scene == "Entrada Old Town Norte");
+		CHECK(parse_scene_variant("(LECHE) Entrada Old Town Norte PIC NOITEM").state.to_string() == "NOITEM LECHE PIC");
+		CHECK(parse_scene_variant("Patio NONE_NO_ITEMS").state.to_string() == "NONE NOITEM");
+		CHECK(parse_scene_variant("cuarto de llaves NO_ALC_FAIL").state.to_string() == "NOALC FAIL");
+		CHECK(parse_scene_variant("Entrada ZORRO K=ENT,ALC P=1").state.to_string() == "K=ENT P=1 ALC");
+		CHECK(parse_scene_variant("Cruce Paco entran F=0 (Paco no visited) (Mel visited)").state.to_string() == "F=0 (Paco no visited) (Mel visited)");
+		CHECK(parse_scene_variant("Entran derecha F=0 paco no visited mel visited").state.to_string() == "F=0 (Paco no visited) (Mel visited)");
+	}
+
+	SECTION("Notes and extensions are dropped")
+	{
+		const SceneVariant variant = parse_scene_variant("Cruce 1 van al norte - aparecen este F=0 (SW=0) (D)");
+		CHECK(variant.scene == "Cruce 1 van al norte - aparecen este");
+		CHECK(variant.state.to_string() == "F=0 SW=0");
+
+		CHECK(parse_scene_variant("Entregan piña K=EA P=2.mp4").state.to_string() == "K=EA P=2");
+	}
+
+	SECTION("The state before and after")
+	{
+		const SceneVariant variant = parse_scene_variant("Atrapan a Bufon K=EA NONE LECHE_ K=3 NONE LECHE");
+		CHECK(variant.scene == "Atrapan a Bufon");
+		CHECK(variant.state.to_string() == "K=EA NONE LECHE");
+		REQUIRE(variant.next_state.has_value());
+		CHECK(variant.next_state->to_string() == "K=3 NONE LECHE");
+
+		const SceneVariant change = parse_scene_variant("Melisa opcion mapa F=0 a P=1 Paco visited");
+		CHECK(change.scene == "Melisa opcion mapa");
+		CHECK(change.state.to_string() == "F=0");
+		REQUIRE(change.next_state.has_value());
+		CHECK(change.next_state->to_string() == "P=1 (Paco visited)");
+	}
+
+	SECTION("Names without tags")
+	{
+		CHECK(parse_scene_variant("Black Card 2-5").scene == "Black Card 2-5");
+		CHECK(parse_scene_variant("Black Card 2-5").state.packed() == 0);
+		CHECK(parse_scene_variant("cap final ira").scene == "cap final ira");
+		CHECK(parse_scene_variant("NONE").scene == "NONE");
+	}
+}
+
+TEST_CASE("The names of game states parse back to the same state")
+{
+	const GameDirectory game = load_game_directory(tube_adventures_3_dir);
+	REQUIRE(game.scenes.size() == 724);
+
+	for (const GameScene & scene : game.scenes)
+	{
+		const std::optional<SceneVariant> variant = scene_variant_from_path(scene.annotations_path);
+		REQUIRE(variant.has_value());
+
+		if (variant->state.packed() != 0)
+			CHECK(parse_scene_variant("Scene " + variant->state.to_string()).state == variant->state);
+	}
+}
+
+TEST_CASE("The scene to play in a state is found by scene and state")
+{
+	const GameDirectory game = load_game_directory(tube_adventures_3_dir);
+	const SceneStateIndex index(game.scenes);
+
+	CHECK(index.scene_count() == 216);
+	CHECK(index.duplicates().size() == 19);
+
+	const auto find_id = [&](const std::string & scene, const GameState state) -> std::string
+	{
+		const std::optional<std::size_t> found = index.find(scene, state);
+		return found.has_value() ? game.scenes[*found].youtube_id : "";
+	};
+
+	GameState state;
+	state.set(Variable::keys, GameState::keys_ea);
+	state.set(Variable::level, GameState::level_p1);
+
+	SECTION("Exactly as named")
+	{
+		CHECK(find_id("Generica", state) == "Tb4ajZhmrtA");
+
+		state.set(Variable::leche, GameState::yes);
+		CHECK(find_id("Generica", state) == "o0eAxrQgH3o");
+	}
+
+	SECTION("The variant that doesn't say a variable matches any value of it")
+	{
+		state.set(Variable::leche, GameState::no);
+		CHECK(find_id("Generica", state) == "Tb4ajZhmrtA");
+	}
+
+	SECTION("Variables no variant of the scene is named after are ignored")
+	{
+		state.set(Variable::switch_on, GameState::yes);
+		state.set(Variable::paco_visited, GameState::no);
+		CHECK(find_id("Generica", state) == "Tb4ajZhmrtA");
+		CHECK(index.scene_mask("Generica") == (GameState::mask(Variable::keys) | GameState::mask(Variable::level) | GameState::mask(Variable::leche)));
+	}
+
+	SECTION("Missing combinations and scenes aren't found")
+	{
+		state.set(Variable::keys, GameState::keys_0);
+		CHECK(!index.find("Generica", state).has_value());
+		CHECK(!index.find("Not a scene", state).has_value());
+		CHECK(index.scene_mask("Not a scene") == 0);
+	}
+
+	SECTION("Scenes without tags")
+	{
+		CHECK(find_id("Hall of Fame", GameState()) == "_Y9AXwtXnYM");
+		CHECK(find_id("Hall of Fame", state) == "_Y9AXwtXnYM");
+	}
+}
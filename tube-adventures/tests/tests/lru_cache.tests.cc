@@ -0,0 +1,52 @@
+#include <catch2/catch.hpp>
+
+#include "lru_cache.hh"
+
+#include <string>
+
+TEST_CASE("LRU cache evicts the least recently used values to stay under the budget")
+{
+	LruCache<std::string, int> cache(10);
+
+	REQUIRE(cache.insert("a", 1, 4) != nullptr);
+	REQUIRE(cache.insert("b", 2, 4) != nullptr);
+	CHECK(cache.cost() == 8);
+
+	// Using "a" makes "b" the least recently used
+	const int * const a = cache.find("a");
+	REQUIRE(a != nullptr);
+	CHECK(*a == 1);
+
+	REQUIRE(cache.insert("c", 3, 4) != nullptr);
+	CHECK(cache.contains("a"));
+	CHECK_FALSE(cache.contains("b"));
+	CHECK(cache.contains("c"));
+	CHECK(cache.cost() == 8);
+	CHECK(cache.stats().evictions == 1);
+
+	CHECK(cache.find("b") == nullptr);
+	CHECK(cache.stats().hits == 1);
+	CHECK(cache.stats().misses == 1);
+}
+
+TEST_CASE("LRU cache replaces, takes and rejects values")
+{
+	LruCache<std::string, int> cache(10);
+
+	REQUIRE(cache.insert("a", 1, 4) != nullptr);
+	REQUIRE(cache.insert("a", 2, 6) != nullptr);
+	CHECK(cache.size() == 1);
+	CHECK(cache.cost() == 6);
+
+	// More expensive than the whole budget
+	CHECK(cache.insert("b", 3, 11) == nullptr);
+	CHECK_FALSE(cache.contains("b"));
+	CHECK(cache.size() == 1);
+
+	const std::optional<int> a = cache.take("a");
+	REQUIRE(a.has_value());
+	CHECK(*a == 2);
+	CHECK(cache.size() == 0);
+	CHECK(cache.cost() == 0);
+	CHECK_FALSE(cache.take("a").has_value());
+}
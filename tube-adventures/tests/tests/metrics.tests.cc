@@ -0,0 +1,108 @@
+#include <catch2/catch.hpp>
+
+#include "metrics.hh"
+
+#include <cstdio>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Latency histogram buckets keep 12.5% precision")
+{
+	CHECK(LatencyHistogram::bucket_index(0) == 0);
+	CHECK(LatencyHistogram::bucket_index(7) == 7);
+	CHECK(LatencyHistogram::bucket_index(8) == 8);
+	CHECK(LatencyHistogram::bucket_index(15) == 15);
+	CHECK(LatencyHistogram::bucket_index(16) == 16);
+	CHECK(LatencyHistogram::bucket_index(17) == 16);
+	CHECK(LatencyHistogram::bucket_index(std::uint64_t(1) << 62) == LatencyHistogram::bucket_count - 1);
+
+	for (std::size_t i = 1; i < LatencyHistogram::bucket_count; ++i)
+	{
+		const std::uint64_t lower_bound = LatencyHistogram::bucket_lower_bound(i);
+		REQUIRE(LatencyHistogram::bucket_index(lower_bound) == i);
+		REQUIRE(LatencyHistogram::bucket_index(lower_bound - 1) == i - 1);
+	}
+}
+
+TEST_CASE("Latency histogram quantiles")
+{
+	LatencyHistogram histogram;
+	CHECK(histogram.quantile(0.5) == 0us);
+
+	for (int i = 0; i < 90; ++i)
+		histogram.record(1000us);
+	for (int i = 0; i < 10; ++i)
+		histogram.record(100'000us);
+
+	CHECK(histogram.count() == 100);
+	CHECK(histogram.sum() == 1'090'000us);
+
+	// Within the precision of the buckets
+	CHECK(histogram.quantile(0.5) >= 1000us);
+	CHECK(histogram.quantile(0.5) <= 1125us);
+	CHECK(histogram.quantile(0.99) >= 100'000us);
+	CHECK(histogram.quantile(0.99) <= 112'500us);
+
+	CHECK(histogram.count_at_most(1024us) == 90);
+	CHECK(histogram.count_at_most(512us) == 0);
+
+	// Like the "le" buckets of Prometheus
+	histogram.record(1024us);
+	histogram.record(1025us);
+	CHECK(histogram.count_at_most(1024us) == 91);
+	CHECK(histogram.count_at_most(2048us) == 92);
+}
+
+TEST_CASE("Metrics are exported in the Prometheus text format")
+{
+	MetricsRegistry registry;
+	Counter & clicks = registry.counter("tube_adventures_clicks_total", "Annotations clicked");
+	Gauge & widgets = registry.gauge("tube_adventures_widgets", "Annotation widgets");
+	LatencyHistogram & latency = registry.histogram("tube_adventures_latency_seconds", "Latency");
+
+	int collections = 0;
+	registry.add_collector([&] { ++collections; widgets.set(3); });
+
+	clicks.add();
+	clicks.add(2);
+	latency.record(100us);
+	latency.record(2s);
+
+	const std::string text = registry.to_prometheus_text();
+	CHECK(collections == 1);
+
+	CHECK(text.find("# HELP tube_adventures_clicks_total Annotations clicked\n# TYPE tube_adventures_clicks_total counter\ntube_adventures_clicks_total 3\n") != std::string::npos);
+	CHECK(text.find("# TYPE tube_adventures_widgets gauge\ntube_adventures_widgets 3\n") != std::string::npos);
+	CHECK(text.find("# TYPE tube_adventures_latency_seconds histogram\n") != std::string::npos);
+	CHECK(text.find("tube_adventures_latency_seconds_bucket{le=\"6.4e-05\"} 0\n") != std::string::npos);
+	CHECK(text.find("tube_adventures_latency_seconds_bucket{le=\"0.000128\"} 1\n") != std::string::npos);
+	CHECK(text.find("tube_adventures_latency_seconds_bucket{le=\"+Inf\"} 2\n") != std::string::npos);
+	CHECK(text.find("tube_adventures_latency_seconds_sum 2.0001\n") != std::string::npos);
+	CHECK(text.find("tube_adventures_latency_seconds_count 2\n") != std::string::npos);
+}
+
+TEST_CASE("Resident set size")
+{
+#if defined(_WIN32) || defined(__linux__)
+	const std::optional<std::size_t> rss = resident_set_size();
+	REQUIRE(rss.has_value());
+	CHECK(*rss > 0);
+#endif
+}
+
+TEST_CASE("Open handle count")
+{
+#if defined(_WIN32) || defined(__linux__)
+	const std::optional<std::size_t> before = open_handle_count();
+	REQUIRE(before.has_value());
+
+	std::FILE * const file = std::fopen("../../../data/TUBE-ADVENTURES/TA61 F87N3uM33p0.xml", "rb");
+	REQUIRE(file != nullptr);
+	const std::optional<std::size_t> open = open_handle_count();
+	std::fclose(file);
+
+	REQUIRE(open.has_value());
+	CHECK(*open == *before + 1);
+	CHECK(open_handle_count() == before);
+#endif
+}
@@ -0,0 +1,98 @@
+#include <catch2/catch.hpp>
+
+#include "motion_path.hh"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	[[nodiscard]] Annotation::RectRegion rect_at(const float x, const float y, const std::chrono::milliseconds time) noexcept
+	{
+		return { x, y, 10.0f, 10.0f, time };
+	}
+
+	[[nodiscard]] Annotation annotation_with_keyframes(std::vector<Annotation::RectRegion> keyframes)
+	{
+		Annotation annotation{};
+		annotation.start_rect = keyframes.front();
+		if (keyframes.size() > 1)
+		{
+			annotation.end_rect = keyframes.back();
+			annotation.intermediate_rects.assign(keyframes.begin() + 1, keyframes.end() - 1);
+		}
+
+		return annotation;
+	}
+} // namespace
+
+TEST_CASE("Static annotations take a single keyframe")
+{
+	const MotionPaths paths({
+		annotation_with_keyframes({ rect_at(5.0f, 5.0f, 1s) }),
+		annotation_with_keyframes({ rect_at(5.0f, 5.0f, 1s), rect_at(5.0f, 5.0f, 2s) }),
+	});
+
+	REQUIRE(paths.size() == 2);
+	CHECK(paths.keyframe_count() == 2);
+	CHECK_FALSE(paths.is_moving(0));
+	CHECK_FALSE(paths.is_moving(1));
+
+	const AnnotationRect rect = paths.evaluate(1, 1500ms);
+	CHECK(rect.x == 5.0f);
+	CHECK(rect.y == 5.0f);
+}
+
+TEST_CASE("Moving annotations are interpolated between keyframes")
+{
+	const MotionPaths paths({
+		annotation_with_keyframes({ rect_at(0.0f, 0.0f, 1s), rect_at(40.0f, 0.0f, 2s), rect_at(40.0f, 80.0f, 4s) }),
+	});
+
+	REQUIRE(paths.size() == 1);
+	CHECK(paths.is_moving(0));
+	CHECK(paths.keyframe_count() == 3);
+
+	SECTION("Before the first keyframe")
+	{
+		const AnnotationRect rect = paths.evaluate(0, 0us);
+		CHECK(rect.x == 0.0f);
+		CHECK(rect.y == 0.0f);
+	}
+
+	SECTION("Between keyframes")
+	{
+		AnnotationRect rect = paths.evaluate(0, 1'250'000us);
+		CHECK(rect.x == Approx(10.0f));
+		CHECK(rect.y == 0.0f);
+
+		rect = paths.evaluate(0, 3s);
+		CHECK(rect.x == 40.0f);
+		CHECK(rect.y == Approx(40.0f));
+	}
+
+	SECTION("At and after the last keyframe")
+	{
+		AnnotationRect rect = paths.evaluate(0, 4s);
+		CHECK(rect.y == 80.0f);
+
+		rect = paths.evaluate(0, 10s);
+		CHECK(rect.x == 40.0f);
+		CHECK(rect.y == 80.0f);
+	}
+}
+
+TEST_CASE("Motion paths can be evaluated in batches")
+{
+	const MotionPaths paths({
+		annotation_with_keyframes({ rect_at(0.0f, 0.0f, 0s), rect_at(100.0f, 0.0f, 1s) }),
+		annotation_with_keyframes({ rect_at(7.0f, 7.0f, 0s) }),
+		annotation_with_keyframes({ rect_at(0.0f, 100.0f, 0s), rect_at(0.0f, 0.0f, 1s) }),
+	});
+
+	std::vector<AnnotationRect> rects;
+	paths.evaluate(500ms, { 2, 0 }, rects);
+
+	REQUIRE(rects.size() == 2);
+	CHECK(rects[0].y == Approx(50.0f));
+	CHECK(rects[1].x == Approx(50.0f));
+}
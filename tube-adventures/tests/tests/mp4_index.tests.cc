@@ -0,0 +1,153 @@
+#include <catch2/catch.hpp>
+
+#include "mp4_index.hh"
+
+#include <string_view>
+
+using namespace std::chrono_literals;
+using namespace std::string_view_literals;
+
+#ifdef TUBE_ADVENTURES_DEBUG
+namespace Catch
+{
+	template<>
+	struct StringMaker<Mp4Error>
+	{
+		[[nodiscard]] static std::string convert(const Mp4Error error)
+		{
+			return std::to_string(static_cast<int>(error));
+		}
+	};
+} // namespace Catch
+#endif // TUBE_ADVENTURES_DEBUG
+
+namespace
+{
+	using ByteVector = std::vector<std::uint8_t>;
+
+	void append_u32(ByteVector & bytes, const std::uint32_t value)
+	{
+		bytes.push_back(static_cast<std::uint8_t>(value >> 24));
+		bytes.push_back(static_cast<std::uint8_t>(value >> 16));
+		bytes.push_back(static_cast<std::uint8_t>(value >> 8));
+		bytes.push_back(static_cast<std::uint8_t>(value));
+	}
+
+	[[nodiscard]] ByteVector box(const std::string_view type, const std::initializer_list<ByteVector> children)
+	{
+		ByteVector payload;
+		for (const ByteVector & child : children)
+			payload.insert(payload.end(), child.begin(), child.end());
+
+		ByteVector bytes;
+		append_u32(bytes, static_cast<std::uint32_t>(8 + payload.size()));
+		bytes.insert(bytes.end(), type.begin(), type.end());
+		bytes.insert(bytes.end(), payload.begin(), payload.end());
+
+		return bytes;
+	}
+
+	[[nodiscard]] ByteVector u32s(const std::initializer_list<std::uint32_t> values)
+	{
+		ByteVector bytes;
+		for (const std::uint32_t value : values)
+			append_u32(bytes, value);
+
+		return bytes;
+	}
+
+	// Version 0 mvhd/mdhd: version and flags, creation and modification times, timescale, duration
+	[[nodiscard]] ByteVector header_box(const std::string_view type, const std::uint32_t timescale, const std::uint32_t duration)
+	{
+		return box(type, { u32s({ 0, 0, 0, timescale, duration }) });
+	}
+
+	[[nodiscard]] ByteVector track(const std::string_view handler, const std::initializer_list<ByteVector> sample_tables)
+	{
+		return box("trak", {
+			box("mdia", {
+				header_box("mdhd", 1000, 4000),
+				box("hdlr", { u32s({ 0, 0 }), ByteVector(handler.begin(), handler.end()), u32s({ 0, 0, 0 }) }),
+				box("minf", { box("stbl", sample_tables) }),
+			}),
+		});
+	}
+
+	// 25 fps (40 ticks of 1/1000 s per sample), a keyframe every 50 frames.
+	// The moov is at the end, after the media data
+	[[nodiscard]] ByteVector moov_at_end_file()
+	{
+		const ByteVector ftyp = box("ftyp", { ByteVector{ 'i', 's', 'o', 'm', 0, 0, 0, 0 } });
+		const ByteVector mdat = box("mdat", { ByteVector(1000, 0xAB) });
+
+		const ByteVector moov = box("moov", {
+			header_box("mvhd", 600, 2460), // 4.1 s
+			track("soun", { box("stts", { u32s({ 0, 1, 172, 1024 }) }) }),
+			track("vide", {
+				box("stts", { u32s({ 0, 2, 60, 40, 40, 40 }) }),
+				box("stss", { u32s({ 0, 2, 1, 51 }) }),
+			}),
+		});
+
+		ByteVector file;
+		for (const ByteVector * part : { &ftyp, &mdat, &moov })
+			file.insert(file.end(), part->begin(), part->end());
+
+		return file;
+	}
+} // namespace
+
+TEST_CASE("Can read the video track of an MP4 with the moov at the end")
+{
+	const ByteVector file = moov_at_end_file();
+	const Mp4ParseResult result = parse_mp4(file.data(), file.size());
+
+	REQUIRE(result.error == Mp4Error::success);
+	CHECK(result.info.duration == 4'100'000us);
+	CHECK(result.info.frame_count == 100);
+	CHECK(result.info.frame_duration == 40ms);
+	CHECK(result.info.frame_rate == Approx(25.0f));
+
+	REQUIRE(result.info.keyframe_times.size() == 2);
+	CHECK(result.info.keyframe_times[0] == 0us);
+	CHECK(result.info.keyframe_times[1] == 2s);
+}
+
+TEST_CASE("MP4 parsing errors")
+{
+	SECTION("Truncated")
+	{
+		ByteVector file = moov_at_end_file();
+		file.resize(file.size() - 10);
+
+		CHECK(parse_mp4(file.data(), file.size()).error == Mp4Error::truncated);
+	}
+
+	SECTION("No moov")
+	{
+		const ByteVector file = box("mdat", { ByteVector(16, 0) });
+		CHECK(parse_mp4(file.data(), file.size()).error == Mp4Error::no_moov);
+	}
+
+	SECTION("No video track")
+	{
+		const ByteVector file = box("moov", {
+			header_box("mvhd", 600, 2460),
+			track("soun", { box("stts", { u32s({ 0, 0 }) }) }),
+		});
+
+		CHECK(parse_mp4(file.data(), file.size()).error == Mp4Error::no_video_track);
+	}
+
+	SECTION("Sync sample outside of the track")
+	{
+		const ByteVector file = box("moov", {
+			track("vide", {
+				box("stts", { u32s({ 0, 1, 10, 40 }) }),
+				box("stss", { u32s({ 0, 1, 11 }) }),
+			}),
+		});
+
+		CHECK(parse_mp4(file.data(), file.size()).error == Mp4Error::invalid_format);
+	}
+}
@@ -0,0 +1,88 @@
+#include <catch2/catch.hpp>
+
+#include "scene_cache.hh"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	[[nodiscard]] Scene scene_with_annotations(const std::size_t annotation_count)
+	{
+		Scene scene;
+		scene.annotations.resize(annotation_count);
+		scene.timeline = AnnotationTimeline(scene.annotations);
+		scene.motion_paths = MotionPaths(scene.annotations);
+		scene.video_url = "file:///video.mp4";
+
+		return scene;
+	}
+} // namespace
+
+TEST_CASE("Scene cache returns the scenes inserted in it")
+{
+	SceneCache cache;
+
+	CHECK_FALSE(cache.take("a").has_value());
+	CHECK(cache.stats().misses == 1);
+
+	cache.insert("a", scene_with_annotations(3));
+	CHECK(cache.size() == 1);
+	CHECK(cache.memory_usage() == memory_usage(scene_with_annotations(3)));
+
+	const std::optional<Scene> scene = cache.take("a");
+	REQUIRE(scene.has_value());
+	CHECK(scene->annotations.size() == 3);
+	CHECK(scene->timeline.size() == 3);
+	CHECK(cache.stats().hits == 1);
+
+	// Taking a scene removes it from the cache
+	CHECK(cache.size() == 0);
+	CHECK(cache.memory_usage() == 0);
+	CHECK_FALSE(cache.take("a").has_value());
+}
+
+TEST_CASE("Scene cache evicts the least recently used scenes")
+{
+	const std::size_t scene_memory_usage = memory_usage(scene_with_annotations(10));
+	SceneCache cache(scene_memory_usage * 2);
+
+	cache.insert("a", scene_with_annotations(10));
+	cache.insert("b", scene_with_annotations(10));
+	CHECK(cache.size() == 2);
+
+	// Reinserting "a" makes it the most recently used
+	std::optional<Scene> a = cache.take("a");
+	REQUIRE(a.has_value());
+	cache.insert("a", std::move(*a));
+
+	cache.insert("c", scene_with_annotations(10));
+	CHECK(cache.size() == 2);
+	CHECK(cache.stats().evictions == 1);
+	CHECK(cache.memory_usage() <= cache.memory_budget());
+
+	CHECK(cache.take("a").has_value());
+	CHECK(cache.take("c").has_value());
+	CHECK_FALSE(cache.take("b").has_value());
+
+	SECTION("Scenes bigger than the budget aren't kept")
+	{
+		cache.insert("huge", scene_with_annotations(1000));
+		CHECK(cache.size() == 0);
+	}
+}
+
+TEST_CASE("Annotation timeline can be reset after being cached")
+{
+	AnnotationTimeline timeline(std::vector<Annotation>(1));
+
+	std::vector<AnnotationTimeline::Change> changes;
+	CHECK_FALSE(timeline.advance(1s, changes));
+	CHECK(timeline.is_visible(0));
+
+	timeline.reset();
+	CHECK_FALSE(timeline.is_visible(0));
+
+	changes.clear();
+	CHECK_FALSE(timeline.advance(1s, changes));
+	CHECK(changes.size() == 1);
+}
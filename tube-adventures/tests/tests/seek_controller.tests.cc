@@ -0,0 +1,95 @@
+#include <catch2/catch.hpp>
+
+#include "seek_controller.hh"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Seek controller coalesces requests made while a seek is in flight")
+{
+	std::vector<SeekController::milliseconds> seeks;
+	SeekController controller([&seeks](const SeekController::milliseconds position) { seeks.push_back(position); });
+	controller.set_duration(10min);
+
+	const SeekController::clock::time_point start{};
+
+	controller.seek_by(10s, 0s, false, start);
+	REQUIRE(seeks.size() == 1);
+	CHECK(seeks.back() == 10s);
+	CHECK(controller.has_seek_in_flight());
+
+	// Auto-repeat: accumulates from the target, not from the (stale) playback position
+	controller.seek_by(10s, 0s, false, start + 30ms);
+	controller.seek_by(10s, 0s, false, start + 60ms);
+	controller.seek_by(10s, 0s, false, start + 90ms);
+	CHECK(seeks.size() == 1);
+	CHECK(controller.stats().requests_coalesced == 2);
+
+	controller.on_seek_completed(start + 100ms);
+	REQUIRE(seeks.size() == 2);
+	CHECK(seeks.back() == 40s);
+
+	controller.on_seek_completed(start + 150ms);
+	CHECK_FALSE(controller.is_seeking());
+	CHECK_FALSE(controller.next_deadline().has_value());
+	CHECK(controller.stats().seeks_issued == 2);
+	CHECK(controller.stats().requests == 4);
+}
+
+TEST_CASE("Seek controller snaps coarse seeks to keyframes and seeks exactly once settled")
+{
+	std::vector<SeekController::milliseconds> seeks;
+	SeekController controller([&seeks](const SeekController::milliseconds position) { seeks.push_back(position); });
+	controller.set_duration(10min);
+	controller.set_keyframes({ 0s, 58s, 65s, 119s, 130s });
+
+	const SeekController::clock::time_point start{};
+
+	controller.seek_by(1min, 0s, true, start);
+	REQUIRE(seeks.size() == 1);
+	CHECK(seeks.back() == 58s);
+	CHECK(controller.stats().seeks_snapped_to_keyframe == 1);
+
+	controller.on_seek_completed(start + 50ms);
+	CHECK(controller.current_target() == 1min);
+
+	controller.seek_by(1min, 0s, true, start + 100ms);
+	REQUIRE(seeks.size() == 2);
+	CHECK(seeks.back() == 119s);
+	controller.on_seek_completed(start + 150ms);
+
+	// Not settled yet
+	controller.on_timeout(start + 200ms);
+	CHECK(seeks.size() == 2);
+
+	REQUIRE(controller.next_deadline().has_value());
+	controller.on_timeout(*controller.next_deadline());
+	REQUIRE(seeks.size() == 3);
+	CHECK(seeks.back() == 2min);
+
+	controller.on_seek_completed(start + 500ms);
+	CHECK_FALSE(controller.is_seeking());
+}
+
+TEST_CASE("Seek controller doesn't wait forever for the backend")
+{
+	std::vector<SeekController::milliseconds> seeks;
+	SeekController controller([&seeks](const SeekController::milliseconds position) { seeks.push_back(position); });
+	controller.set_duration(20s);
+
+	const SeekController::clock::time_point start{};
+
+	controller.seek_to(5s, false, start);
+	controller.seek_to(30s, false, start + 10ms); // Clamped to the end
+	CHECK(seeks.size() == 1);
+
+	controller.on_timeout(start + SeekController::in_flight_timeout);
+	REQUIRE(seeks.size() == 2);
+	CHECK(seeks.back() == 19s);
+
+	SECTION("Seeking before the start")
+	{
+		controller.on_seek_completed(start + 1s);
+		controller.seek_by(-1min, 0s, false, start + 2s);
+		CHECK(seeks.back() == 0s);
+	}
+}
@@ -0,0 +1,160 @@
+#include <catch2/catch.hpp>
+
+#include "game_session.hh"
+#include "headless_session.hh"
+#include "session_recording.hh"
+#include "session_replay.hh"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	const std::filesystem::path tube_adventures_1_dir = "../../../data/TUBE-ADVENTURES";
+	const std::filesystem::path first_scene = tube_adventures_1_dir / "TUBE-ADVENTURES (aventura interactiva) BckqqsJiDUI.xml";
+
+	[[nodiscard]] std::vector<std::uint8_t> read_file(const std::filesystem::path & filename)
+	{
+		std::vector<std::uint8_t> data(static_cast<std::size_t>(std::filesystem::file_size(filename)));
+		std::FILE * const file = std::fopen(filename.string().c_str(), "rb");
+		REQUIRE(file != nullptr);
+		CHECK(std::fread(data.data(), 1, data.size(), file) == data.size());
+		std::fclose(file);
+
+		return data;
+	}
+} // namespace
+
+TEST_CASE("Session recordings read back the events recorded")
+{
+	const auto filename = std::filesystem::temp_directory_path() / "tube-adventures-recording.tasr";
+
+	const SessionRecorder::clock::time_point start = SessionRecorder::clock::now();
+	{
+		SessionRecorder recorder(filename.string());
+		REQUIRE(recorder.is_open());
+
+		recorder.record_load_scene("data/escena ñ 01234567890.xml", 1, start);
+		recorder.record(SessionEvent::Type::viewport_size, start + 1ms, 1280, 720);
+		recorder.record(SessionEvent::Type::position, start + 1s, -40'000);
+		recorder.record(SessionEvent::Type::go_back, start + 2s);
+		// Out of order, it keeps the time of the previous event
+		recorder.record(SessionEvent::Type::update, start + 1s);
+
+		CHECK(recorder.events_recorded() == 5);
+	}
+
+	const SessionRecordingReadResult result = read_session_recording(filename.string());
+	REQUIRE(result.error == SessionRecordingError::success);
+	REQUIRE(result.events.size() == 5);
+
+	CHECK(result.events[0].type == SessionEvent::Type::load_scene);
+	CHECK(result.events[0].time == 0us);
+	CHECK(result.events[0].value == 1);
+	CHECK(result.events[0].path == "data/escena ñ 01234567890.xml");
+
+	CHECK(result.events[1].type == SessionEvent::Type::viewport_size);
+	CHECK(result.events[1].time == 1ms);
+	CHECK(result.events[1].value == 1280);
+	CHECK(result.events[1].second_value == 720);
+
+	CHECK(result.events[2].type == SessionEvent::Type::position);
+	CHECK(result.events[2].time == 1s);
+	CHECK(result.events[2].value == -40'000);
+
+	CHECK(result.events[3].type == SessionEvent::Type::go_back);
+	CHECK(result.events[4].type == SessionEvent::Type::update);
+	CHECK(result.events[4].time == 2s);
+
+	SECTION("Truncated")
+	{
+		const std::vector<std::uint8_t> data = read_file(filename);
+		const SessionRecordingReadResult truncated = parse_session_recording(data.data(), data.size() - 1);
+		CHECK(truncated.error == SessionRecordingError::truncated);
+		CHECK(truncated.events.size() == 4);
+	}
+
+	SECTION("Invalid")
+	{
+		std::vector<std::uint8_t> data = read_file(filename);
+		data.push_back(static_cast<std::uint8_t>(SessionEvent::type_count));
+		data.push_back(0);
+		CHECK(parse_session_recording(data.data(), data.size()).error == SessionRecordingError::invalid_event);
+
+		data[0] = 'X';
+		CHECK(parse_session_recording(data.data(), data.size()).error == SessionRecordingError::invalid_header);
+		CHECK(parse_session_recording(data.data(), 2).error == SessionRecordingError::invalid_header);
+	}
+
+	std::filesystem::remove(filename);
+
+	CHECK(read_session_recording(filename.string()).error == SessionRecordingError::cannot_read_file);
+}
+
+TEST_CASE("Recorded game sessions replay the same")
+{
+	const auto filename = std::filesystem::temp_directory_path() / "tube-adventures-session.tasr";
+
+	GameSession::Options options;
+	options.annotations_directory = tube_adventures_1_dir;
+	options.locate_video = [](const std::string_view youtube_id) { return "video/" + std::string(youtube_id) + ".mp4"; };
+
+	{
+		SessionRecorder recorder(filename.string());
+		REQUIRE(recorder.is_open());
+
+		GameSession::Options recording_options = options;
+		recording_options.recorder = &recorder;
+
+		HeadlessMedia media;
+		HeadlessView view;
+		GameSession session(media, view, recording_options);
+
+		const GameSession::clock::time_point start = GameSession::clock::now();
+		session.set_viewport_size(1280, 720, start);
+		REQUIRE(session.load_scene(first_scene, start));
+		session.on_playing_changed(true, start);
+
+		int gameplay_annotation = -1;
+		for (int i = 0; i < static_cast<int>(session.annotations().size()); ++i)
+		{
+			if (session.annotations()[static_cast<std::size_t>(i)].type == Annotation::Type::gameplay)
+			{
+				gameplay_annotation = i;
+				break;
+			}
+		}
+		REQUIRE(gameplay_annotation >= 0);
+
+		for (auto time = 0ms; time < 5s; time += 100ms)
+		{
+			session.on_position_reported(time, start + time);
+			(void)session.update(start + time);
+		}
+
+		REQUIRE(session.activate_annotation(gameplay_annotation, start + 5s));
+		REQUIRE(session.go_back(start + 6s));
+	}
+
+	const SessionRecordingReadResult recording = read_session_recording(filename.string());
+	std::filesystem::remove(filename);
+	REQUIRE(recording.error == SessionRecordingError::success);
+	CHECK(recording.events.size() == 1 + 1 + 1 + 2 * 50 + 1 + 1 + 1); // Going back resumes with a seek
+
+	const GameSession::Options recorded_options = recorded_session_options(recording.events);
+	CHECK(recorded_options.annotations_directory == tube_adventures_1_dir);
+	CHECK(recorded_options.video_directory == tube_adventures_1_dir / "video");
+
+	const ReplayReport report = replay_session(recording.events, options, 3);
+	CHECK(report.errors.empty());
+	CHECK(report.scenes_loaded == 3);
+	CHECK(report.annotations_shown > 0);
+	CHECK(report.session_time == 6s);
+	CHECK(report.steps[static_cast<std::size_t>(SessionEvent::Type::update)].count == 50);
+	CHECK(report.steps[static_cast<std::size_t>(SessionEvent::Type::seek_issued)].count == 1);
+	CHECK(report.slowest_steps.size() == 3);
+	CHECK_FALSE(format_replay_report(report).empty());
+}
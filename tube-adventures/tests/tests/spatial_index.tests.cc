@@ -0,0 +1,68 @@
+#include <catch2/catch.hpp>
+
+#include "spatial_index.hh"
+
+TEST_CASE("Uniform grid index finds the rect under a point")
+{
+	UniformGridIndex index;
+
+	SECTION("Empty index")
+	{
+		index.build({});
+		CHECK(index.empty());
+		CHECK(index.query(0, 0) == std::nullopt);
+	}
+
+	SECTION("Separate rects")
+	{
+		index.build({
+			{ { 10, 10, 100, 50 }, 0 },
+			{ { 300, 200, 40, 40 }, 1 },
+			{ { 1000, 700, 10, 10 }, 2 },
+		});
+
+		CHECK(index.query(10, 10) == 0);
+		CHECK(index.query(109, 59) == 0);
+		CHECK(index.query(110, 59) == std::nullopt); // Right and bottom edges are exclusive
+		CHECK(index.query(320, 220) == 1);
+		CHECK(index.query(1005, 705) == 2);
+		CHECK(index.query(500, 500) == std::nullopt);
+		CHECK(index.query(-5, 20) == std::nullopt);
+		CHECK(index.query(2000, 2000) == std::nullopt);
+	}
+
+	SECTION("Overlapping rects return the top-most (last) one")
+	{
+		index.build({
+			{ { 0, 0, 200, 200 }, 7 },
+			{ { 50, 50, 20, 20 }, 3 },
+		});
+
+		CHECK(index.query(10, 10) == 7);
+		CHECK(index.query(55, 55) == 3);
+		CHECK(index.query(150, 150) == 7);
+	}
+
+	SECTION("Empty rects are ignored")
+	{
+		index.build({
+			{ { 0, 0, 0, 10 }, 0 },
+			{ { 0, 0, 10, 0 }, 1 },
+		});
+
+		CHECK(index.empty());
+		CHECK(index.query(0, 0) == std::nullopt);
+	}
+
+	SECTION("Rects spread very far apart")
+	{
+		index.build({
+			{ { 0, 0, 10, 10 }, 0 },
+			{ { 1'000'000, 1'000'000, 10, 10 }, 1 },
+		});
+
+		CHECK(index.query(5, 5) == 0);
+		CHECK(index.query(1'000'005, 1'000'005) == 1);
+		CHECK(index.query(500'000, 500'000) == std::nullopt);
+	}
+}
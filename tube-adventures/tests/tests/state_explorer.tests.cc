@@ -0,0 +1,179 @@
+#include <catch2/catch.hpp>
+
+#include "state_explorer.hh"
+
+#include <algorithm>
+#include <filesystem>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const std::filesystem::path tube_adventures_3_dir = "../../../data/TUBE-ADVENTURES 3";
+
+	[[nodiscard]] GameScene make_scene(const std::string & name, const std::string & youtube_id, const std::initializer_list<std::string> targets)
+	{
+		GameScene scene;
+		scene.annotations_path = std::filesystem::u8path(name + " " + youtube_id + ".xml");
+		scene.youtube_id = youtube_id;
+
+		for (const std::string & target : targets)
+		{
+			Annotation annotation{};
+			annotation.type = Annotation::Type::gameplay;
+			annotation.click_url = "https://www.youtube.com/watch?v=" + target;
+			scene.annotations.push_back(annotation);
+		}
+
+		return scene;
+	}
+
+	// The keys picked decide which door opens, but one of them leads to the wrong one, and there is no door for the other
+	[[nodiscard]] std::vector<GameScene> make_game()
+	{
+		return {
+			make_scene("Inicio", "AAAAAAAAAAA", { "BBBBBBBBBBB", "CCCCCCCCCCC" }),
+			make_scene("Llaves K=E", "BBBBBBBBBBB", { "DDDDDDDDDDD", "EEEEEEEEEEE" }),
+			make_scene("Llaves K=3", "CCCCCCCCCCC", { "DDDDDDDDDDD" }),
+			make_scene("Puerta K=E", "DDDDDDDDDDD", { "AAAAAAAAAAA" }),
+			make_scene("Puerta K=EA", "EEEEEEEEEEE", {}),
+			make_scene("Salida", "FFFFFFFFFFF", {}),
+		};
+	}
+
+	[[nodiscard]] GameState keys(const GameState::Keys value)
+	{
+		GameState state;
+		state.set(GameState::Variable::keys, value);
+		return state;
+	}
+} // namespace
+
+TEST_CASE("Every scene and state the game can get to is explored")
+{
+	const std::vector<GameScene> scenes = make_game();
+	const SceneIdIndex ids(scenes);
+	const StoryGraph graph = build_story_graph(scenes, ids);
+	const SceneStateIndex index(scenes);
+
+	StateExplorerOptions options;
+	options.start_scenes = { 0 };
+	options.threads = GENERATE(1u, 4u);
+
+	const StateExploration exploration = explore_game_states(scenes, graph, index, options);
+	CHECK_FALSE(exploration.truncated);
+
+	// Going through the door goes back to the start, where the game starts again with no keys
+	CHECK(exploration.reachable_states == 5);
+	CHECK(exploration.states_per_scene == std::vector<std::size_t>{ 1, 1, 1, 1, 1, 0 });
+
+	REQUIRE(exploration.missing_combinations.size() == 1);
+	CHECK(exploration.missing_combinations[0].scene == "Puerta");
+	CHECK(exploration.missing_combinations[0].state == keys(GameState::keys_3));
+	CHECK(exploration.missing_combinations[0].from_scene == 2);
+	CHECK(exploration.missing_combinations[0].annotation_index == 0);
+
+	REQUIRE(exploration.contradictions.size() == 2);
+
+	CHECK(exploration.contradictions[0].from_scene == 1);
+	CHECK(exploration.contradictions[0].annotation_index == 1);
+	CHECK(exploration.contradictions[0].target_scene == 4);
+	CHECK(exploration.contradictions[0].state == keys(GameState::keys_e));
+	CHECK(exploration.contradictions[0].expected_scene == std::optional<std::size_t>(3));
+
+	CHECK(exploration.contradictions[1].from_scene == 2);
+	CHECK(exploration.contradictions[1].target_scene == 3);
+	CHECK(exploration.contradictions[1].state == keys(GameState::keys_3));
+	CHECK_FALSE(exploration.contradictions[1].expected_scene.has_value());
+}
+
+TEST_CASE("The links of the highlights are explored too")
+{
+	std::vector<GameScene> scenes = make_game();
+
+	// The door opened with a highlight instead
+	scenes[2].annotations.clear();
+	scenes[2].highlight_links.push_back({ "annotation_highlight", "DDDDDDDDDDD" });
+
+	const SceneIdIndex ids(scenes);
+	const StoryGraph graph = build_story_graph(scenes, ids);
+	const SceneStateIndex index(scenes);
+
+	StateExplorerOptions options;
+	options.start_scenes = { 0 };
+
+	const StateExploration exploration = explore_game_states(scenes, graph, index, options);
+	CHECK(exploration.states_per_scene == std::vector<std::size_t>{ 1, 1, 1, 1, 1, 0 });
+
+	REQUIRE(exploration.missing_combinations.size() == 1);
+	CHECK(exploration.missing_combinations[0].from_scene == 2);
+	CHECK(exploration.missing_combinations[0].annotation_index == 0);
+	CHECK(exploration.missing_combinations[0].highlight);
+
+	REQUIRE(exploration.contradictions.size() == 2);
+	CHECK_FALSE(exploration.contradictions[0].highlight);
+	CHECK(exploration.contradictions[1].from_scene == 2);
+	CHECK(exploration.contradictions[1].annotation_index == 0);
+	CHECK(exploration.contradictions[1].highlight);
+}
+
+TEST_CASE("The exploration stops at the most states")
+{
+	const std::vector<GameScene> scenes = make_game();
+	const SceneIdIndex ids(scenes);
+	const StoryGraph graph = build_story_graph(scenes, ids);
+	const SceneStateIndex index(scenes);
+
+	StateExplorerOptions options;
+	options.start_scenes = { 0 };
+	options.max_states = 3;
+
+	const StateExploration exploration = explore_game_states(scenes, graph, index, options);
+	CHECK(exploration.truncated);
+	CHECK(exploration.reachable_states == 3);
+}
+
+TEST_CASE("Exploring a whole game finds the same with any number of threads")
+{
+	const GameDirectory game = load_game_directory(tube_adventures_3_dir);
+	REQUIRE(game.scenes.size() == 724);
+
+	const SceneIdIndex ids(game.scenes);
+	const StoryGraph graph = build_story_graph(game.scenes, ids);
+	const SceneStateIndex index(game.scenes);
+
+	// The menu almost every scene links to
+	const std::optional<std::size_t> menu = ids.find("didjeU8pjRc");
+	REQUIRE(menu.has_value());
+
+	StateExplorerOptions options;
+	options.start_scenes = { *menu };
+
+	options.threads = 1;
+	const StateExploration single = explore_game_states(game.scenes, graph, index, options);
+
+	options.threads = 8;
+	const StateExploration multiple = explore_game_states(game.scenes, graph, index, options);
+
+	CHECK_FALSE(single.truncated);
+	CHECK(single.reachable_states >= game.scenes.size());
+	CHECK(std::count(single.states_per_scene.begin(), single.states_per_scene.end(), 0) == 0);
+	CHECK(single.reachable_states == multiple.reachable_states);
+	CHECK(single.states_per_scene == multiple.states_per_scene);
+
+	REQUIRE(single.missing_combinations.size() == multiple.missing_combinations.size());
+	for (std::size_t i = 0; i < single.missing_combinations.size(); ++i)
+	{
+		CHECK(single.missing_combinations[i].scene == multiple.missing_combinations[i].scene);
+		CHECK(single.missing_combinations[i].state == multiple.missing_combinations[i].state);
+	}
+
+	REQUIRE(single.contradictions.size() == multiple.contradictions.size());
+	for (std::size_t i = 0; i < single.contradictions.size(); ++i)
+	{
+		CHECK(single.contradictions[i].from_scene == multiple.contradictions[i].from_scene);
+		CHECK(single.contradictions[i].annotation_index == multiple.contradictions[i].annotation_index);
+	}
+}
@@ -0,0 +1,145 @@
+#include <catch2/catch.hpp>
+
+#include "story_graph.hh"
+
+#include <filesystem>
+#include <utility>
+
+namespace
+{
+	const std::filesystem::path tube_adventures_1_dir = "../../../data/TUBE-ADVENTURES";
+	const std::filesystem::path tube_adventures_2_dir = "../../../data/TUBE-ADVENTURES 2";
+	const std::filesystem::path tube_adventures_3_dir = "../../../data/TUBE-ADVENTURES 3";
+} // namespace
+
+TEST_CASE("Can load a whole game and index it by youtube ID")
+{
+	const GameDirectory game = load_game_directory(tube_adventures_1_dir);
+	CHECK(game.errors.empty());
+	CHECK(game.files_without_id == 0);
+	REQUIRE(game.scenes.size() == 68);
+
+	const SceneIdIndex index(game.scenes);
+	CHECK(index.size() == game.scenes.size());
+
+	const std::optional<std::size_t> first_scene = index.find("BckqqsJiDUI");
+	REQUIRE(first_scene.has_value());
+	CHECK(game.scenes[*first_scene].youtube_id == "BckqqsJiDUI");
+	CHECK(game.scenes[*first_scene].annotations_path.filename() == "TUBE-ADVENTURES (aventura interactiva) BckqqsJiDUI.xml");
+
+	CHECK_FALSE(index.find("").has_value());
+	CHECK_FALSE(index.find("00000000000").has_value());
+}
+
+TEST_CASE("The story graph links the gameplay annotations to the scenes they lead to")
+{
+	const GameDirectory game = load_game_directory(tube_adventures_1_dir);
+	const SceneIdIndex index(game.scenes);
+	const StoryGraph graph = build_story_graph(game.scenes, index);
+
+	REQUIRE(graph.links.size() == game.scenes.size());
+	CHECK(graph.link_count() == 203);
+	CHECK(graph.broken_link_count() == 2);
+
+	for (std::size_t scene = 0; scene < game.scenes.size(); ++scene)
+	{
+		for (const StoryLink & link : graph.links[scene])
+		{
+			REQUIRE_FALSE(link.highlight); // The first game has no highlights
+			REQUIRE(link.annotation_index >= 0);
+			REQUIRE(static_cast<std::size_t>(link.annotation_index) < game.scenes[scene].annotations.size());
+
+			const Annotation & annotation = game.scenes[scene].annotations[static_cast<std::size_t>(link.annotation_index)];
+			CHECK(annotation.type == Annotation::Type::gameplay);
+
+			if (link.target_scene.has_value())
+				CHECK(youtube_video_id_from_url(annotation.click_url) == game.scenes[*link.target_scene].youtube_id);
+		}
+	}
+}
+
+TEST_CASE("The story graph has the links of the highlights")
+{
+	const GameDirectory game = load_game_directory(tube_adventures_3_dir);
+	REQUIRE(game.scenes.size() == 724);
+
+	const SceneIdIndex index(game.scenes);
+	const StoryGraph graph = build_story_graph(game.scenes, index);
+
+	// Most of the choices of the game are highlights, not text annotations
+	std::size_t highlight_links = 0;
+	for (std::size_t scene = 0; scene < game.scenes.size(); ++scene)
+	{
+		for (const StoryLink & link : graph.links[scene])
+		{
+			if (!link.highlight)
+				continue;
+
+			++highlight_links;
+			REQUIRE(static_cast<std::size_t>(link.annotation_index) < game.scenes[scene].highlight_links.size());
+
+			const AnnotationLink & highlight = game.scenes[scene].highlight_links[static_cast<std::size_t>(link.annotation_index)];
+			if (link.target_scene.has_value())
+				CHECK(highlight.target_id == game.scenes[*link.target_scene].youtube_id);
+		}
+	}
+
+	CHECK(highlight_links == 2147);
+	CHECK(graph.link_count() == 2212);
+	CHECK(graph.broken_link_count() == 6);
+}
+
+TEST_CASE("Loading a missing game directory reports it")
+{
+	const GameDirectory game = load_game_directory(tube_adventures_1_dir / "missing");
+	CHECK(game.scenes.empty());
+	CHECK(game.errors.size() == 1);
+}
+
+TEST_CASE("Annotations with the same content but their ID count once")
+{
+	GameDirectory game = load_game_directory(tube_adventures_1_dir);
+
+	const AnnotationDedupStats stats = annotation_dedup_stats(game.scenes);
+	CHECK(stats.annotations == 338);
+	CHECK(stats.unique == 338);
+	CHECK(stats.highlight_links == 0);
+	CHECK(stats.ignored == 68);
+	CHECK(stats.unique_memory_usage == stats.memory_usage);
+	CHECK(stats.dedup_ratio() == 1.0);
+
+	// The first scene again, as another video. The URLs of its choices are tracked differently
+	REQUIRE_FALSE(game.scenes.front().annotations.empty());
+	GameScene copy = game.scenes.front();
+	for (Annotation & annotation : copy.annotations)
+	{
+		annotation.id += "_copy";
+		if (!annotation.click_url.empty())
+			annotation.click_url += "&feature=copy";
+	}
+	game.scenes.push_back(std::move(copy));
+
+	const AnnotationDedupStats copied_stats = annotation_dedup_stats(game.scenes);
+	CHECK(copied_stats.annotations == 338 + game.scenes.front().annotations.size());
+	CHECK(copied_stats.unique == 338);
+	CHECK(copied_stats.unique_memory_usage == stats.unique_memory_usage);
+	CHECK(copied_stats.memory_usage > stats.memory_usage);
+}
+
+TEST_CASE("The highlights that open the same video count once")
+{
+	const AnnotationDedupStats stats_2 = annotation_dedup_stats(load_game_directory(tube_adventures_2_dir).scenes);
+	CHECK(stats_2.annotations == 512);
+	CHECK(stats_2.unique == 482);
+	CHECK(stats_2.highlight_links == 1365);
+	CHECK(stats_2.unique_highlight_links == 554);
+	CHECK(stats_2.ignored == 583);
+
+	const AnnotationDedupStats stats_3 = annotation_dedup_stats(load_game_directory(tube_adventures_3_dir).scenes);
+	CHECK(stats_3.annotations == 111);
+	CHECK(stats_3.unique == 111);
+	CHECK(stats_3.highlight_links == 2147);
+	CHECK(stats_3.unique_highlight_links == 710);
+	CHECK(stats_3.ignored == 3210);
+	CHECK(stats_3.unique_memory_usage < stats_3.memory_usage);
+}
@@ -0,0 +1,60 @@
+#include <catch2/catch.hpp>
+
+#include "trace.hh"
+
+TEST_CASE("Trace spans are only recorded while tracing")
+{
+	{
+		const TraceSpan span("untraced");
+		trace_instant("untraced instant");
+	}
+
+	start_tracing();
+	{
+		const TraceSpan outer("outer");
+		{
+			const TraceSpan inner("inner");
+		}
+		trace_async_begin("load", 7);
+		trace_instant("first frame");
+		trace_async_end("load", 7);
+	}
+	const std::vector<TraceEvent> events = stop_tracing();
+
+	{
+		const TraceSpan span("untraced");
+	}
+
+	REQUIRE(events.size() == 5);
+
+	// Spans are recorded when they end
+	CHECK(std::string(events[0].name) == "inner");
+	CHECK(events[0].phase == TraceEvent::Phase::complete);
+	CHECK(std::string(events[1].name) == "load");
+	CHECK(events[1].phase == TraceEvent::Phase::async_begin);
+	CHECK(events[1].id == 7);
+	CHECK(events[2].phase == TraceEvent::Phase::instant);
+	CHECK(events[3].phase == TraceEvent::Phase::async_end);
+	CHECK(std::string(events[4].name) == "outer");
+
+	const TraceEvent & inner = events[0];
+	const TraceEvent & outer = events[4];
+	CHECK(outer.timestamp <= inner.timestamp);
+	CHECK(inner.timestamp + inner.duration <= outer.timestamp + outer.duration);
+
+	CHECK(stop_tracing().empty());
+}
+
+TEST_CASE("Trace events are written in the Chrome trace event format")
+{
+	const std::vector<TraceEvent> events{
+		{ "parse \"annotations\"", TraceEvent::Phase::complete, std::chrono::microseconds(100), std::chrono::microseconds(20), 0, 0 },
+		{ "load", TraceEvent::Phase::async_begin, std::chrono::microseconds(130), std::chrono::microseconds(0), 3, 1 },
+	};
+
+	CHECK(to_chrome_trace_json(events) ==
+		"{\"displayTimeUnit\":\"ms\",\"traceEvents\":["
+		"\n{\"name\":\"parse \\\"annotations\\\"\",\"ph\":\"X\",\"ts\":100,\"pid\":1,\"tid\":0,\"dur\":20},"
+		"\n{\"name\":\"load\",\"ph\":\"b\",\"ts\":130,\"pid\":1,\"tid\":1,\"cat\":\"async\",\"id\":3}"
+		"\n]}\n");
+}
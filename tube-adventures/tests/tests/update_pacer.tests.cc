@@ -0,0 +1,81 @@
+#include <catch2/catch.hpp>
+
+#include "update_pacer.hh"
+
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Update pacer batches requests into one pass per refresh")
+{
+	UpdatePacer pacer;
+	pacer.set_refresh_interval(16ms);
+
+	const UpdatePacer::clock::time_point start{};
+
+	// The first request is served right away
+	std::optional<UpdatePacer::clock::time_point> pass_time = pacer.request(start);
+	REQUIRE(pass_time.has_value());
+	CHECK(*pass_time == start);
+
+	CHECK_FALSE(pacer.request(start + 1ms).has_value());
+	pacer.on_pass(start + 1ms);
+
+	// Too soon after the previous pass: waits until the next refresh
+	pass_time = pacer.request(start + 5ms);
+	REQUIRE(pass_time.has_value());
+	CHECK(*pass_time == start + 17ms);
+	CHECK_FALSE(pacer.request(start + 6ms).has_value());
+	CHECK_FALSE(pacer.request(start + 7ms).has_value());
+	pacer.on_pass(*pass_time);
+
+	// Long after the previous pass: right away
+	pass_time = pacer.request(start + 100ms);
+	REQUIRE(pass_time.has_value());
+	CHECK(*pass_time == start + 100ms);
+
+	CHECK(pacer.stats().requests == 6);
+	CHECK(pacer.stats().passes == 2);
+}
+
+TEST_CASE("Update pacer does nothing while the window isn't visible")
+{
+	UpdatePacer pacer;
+	const UpdatePacer::clock::time_point start{};
+
+	CHECK(pacer.request(start).has_value());
+
+	// The scheduled pass is dropped
+	CHECK_FALSE(pacer.set_visible(false, start + 1ms).has_value());
+	CHECK_FALSE(pacer.is_visible());
+	CHECK_FALSE(pacer.request(start + 2ms).has_value());
+	CHECK_FALSE(pacer.request(start + 3ms).has_value());
+
+	// One pass when visible again
+	const std::optional<UpdatePacer::clock::time_point> pass_time = pacer.set_visible(true, start + 1s);
+	REQUIRE(pass_time.has_value());
+	CHECK(*pass_time == start + 1s);
+	CHECK_FALSE(pacer.request(start + 1s).has_value());
+
+	pacer.on_pass(start + 1s);
+	CHECK(pacer.stats().passes == 1);
+}
+
+TEST_CASE("Process CPU time doesn't count the time spent waiting")
+{
+	const std::chrono::microseconds before = process_cpu_time();
+	std::this_thread::sleep_for(200ms);
+	const std::chrono::microseconds slept = process_cpu_time() - before;
+
+	CHECK(slept >= 0us);
+	CHECK(slept < 100ms);
+
+	// Busy for a while, which is counted
+	const auto busy_start = std::chrono::steady_clock::now();
+	volatile unsigned counter = 0;
+	while (std::chrono::steady_clock::now() - busy_start < 100ms)
+		counter = counter + 1;
+
+	CHECK(process_cpu_time() - before >= 50ms);
+}